@@ -0,0 +1,18 @@
+# 在本机启动 N 个节点组成的集群，slot 平均分配
+# 用法: ./cluster.sh [节点数] [起始端口]
+set -x
+nodes=${1:-3}
+base_port=${2:-7001}
+conf=`pwd`/build/cluster.conf
+mkdir -p `pwd`/build
+: > $conf
+slots=16384
+for ((i = 0; i < nodes; i++)); do
+    begin=$((slots * i / nodes))
+    end=$((slots * (i + 1) / nodes - 1))
+    echo "127.0.0.1:$((base_port + i)) $begin-$end" >> $conf
+done
+for ((i = 0; i < nodes; i++)); do
+    `pwd`/bin/Server --port $((base_port + i)) --cluster-config $conf &
+done
+wait
@@ -0,0 +1,359 @@
+#ifndef ASYNC_CLIENT_H
+#define ASYNC_CLIENT_H
+
+/*
+异步客户端
+一条连接上同时可以有任意多个请求在途：Send 只负责编码并排队，真正的读写在连接自己的 I/O 线程里完成。
+    - 两次唤醒 I/O 线程之间排队的请求会合并成一次 write 发出
+    - 服务端按请求顺序回复，回调按同样的顺序排在 pending_ 中，收到回复时依次取出
+    - 回调在 I/O 线程中执行，不能在回调里阻塞等待同一条连接上的其它回复
+
+AsyncPool 管理多条连接，按 key 所在的 slot 选择连接：
+同一个 key 的请求总是走同一条连接，因此同一个 key 上的请求保持先后顺序。
+集群模式下先按 slot 找到负责的节点，收到 MOVED 时更新映射并重新发送。
+*/
+
+#include <poll.h>
+#include <sys/eventfd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "public.h"
+#include "file.h"
+#include "cluster.h"
+#include "client.h"
+
+namespace kath
+{
+    using Callback = std::function<void(Value &&)>;
+
+    inline auto LostValue() -> Value
+    {
+        Value val;
+        val.type_ = SerType::ERR;
+        val.int_ = static_cast<int64_t>(CmdErr::Err_UNKNOWN);
+        val.str_ = "connection lost";
+        return val;
+    }
+
+    class AsyncClient
+    {
+    private:
+        static constexpr size_t k_read_size = 64 * 1024;
+
+        File fd_;
+        File wake_; // eventfd，通知 I/O 线程有新的请求
+
+        // 以下由 mu_ 保护
+        std::mutex mu_;
+        Bytes queued_{};                 // 已编码、还没交给 I/O 线程的请求
+        std::deque<Callback> pending_{}; // 所有还没收到回复的请求的回调，顺序与请求一致
+        bool wake_armed_{false};         // 已经通知过 I/O 线程、它还没来取
+        bool closed_{false};
+
+        // 以下只在 I/O 线程中访问
+        Bytes sending_{};
+        Bytes rbuf_{};
+        std::vector<Value> replies_{};
+
+        std::atomic<bool> stop_{false};
+        std::thread io_;
+
+        auto Wake() -> void
+        {
+            uint64_t one = 1;
+            [[maybe_unused]] auto rv = write(wake_.Data(), &one, sizeof(one));
+        }
+
+        // 发送中的数据写完后才取下一批，保证请求按排队顺序写出
+        auto TakeQueued() -> void
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            wake_armed_ = false;
+            if (sending_.Remain() == 0 && queued_.Size() != 0)
+            {
+                sending_.Clear();
+                std::swap(sending_, queued_);
+            }
+        }
+
+        auto Flush() -> bool
+        {
+            while (sending_.Remain() != 0)
+            {
+                auto rv = fd_.WriteByte_nb(sending_);
+                if (rv == -1)
+                    return true;
+                if (rv == 1)
+                    return false;
+            }
+            sending_.Clear();
+            return true;
+        }
+
+        // 读出所有完整的回复，然后一次性取出对应的回调
+        auto ReadReplies() -> bool
+        {
+            auto rv = fd_.ReadByte_nb(rbuf_, k_read_size);
+            if (rv == -1)
+                return true;
+            if (rv != 0)
+                return false;
+
+            while (rbuf_.Remain() >= 4)
+            {
+                size_t start = rbuf_.Pos();
+                auto len = rbuf_.GetNum<uint32_t>(4);
+                if (rbuf_.Remain() < len)
+                {
+                    rbuf_.Seek(start);
+                    break;
+                }
+                size_t body = rbuf_.Pos();
+                Value val;
+                if (!ParseValue(rbuf_, val) || rbuf_.Pos() != body + len)
+                {
+                    Msg("bad reply");
+                    return false;
+                }
+                replies_.push_back(std::move(val));
+            }
+            rbuf_.Compact();
+            if (replies_.empty())
+                return true;
+
+            std::vector<Callback> cbs;
+            cbs.reserve(replies_.size());
+            {
+                std::lock_guard<std::mutex> lock(mu_);
+                for (size_t index = 0; index < replies_.size() && !pending_.empty(); index++)
+                {
+                    cbs.push_back(std::move(pending_.front()));
+                    pending_.pop_front();
+                }
+            }
+            for (size_t index = 0; index < cbs.size(); index++)
+            {
+                if (cbs[index])
+                    cbs[index](std::move(replies_[index]));
+            }
+            bool ok = cbs.size() == replies_.size();
+            replies_.clear();
+            return ok;
+        }
+
+        // 连接断开后所有未完成的请求都以错误结束
+        auto Close() -> void
+        {
+            std::deque<Callback> pending;
+            {
+                std::lock_guard<std::mutex> lock(mu_);
+                closed_ = true;
+                queued_.Clear();
+                std::swap(pending, pending_);
+            }
+            for (auto &cb : pending)
+            {
+                if (cb)
+                    cb(LostValue());
+            }
+        }
+
+        auto Loop() -> void
+        {
+            while (!stop_.load(std::memory_order_acquire))
+            {
+                pollfd fds[2] = {{fd_.Data(), POLLIN, 0}, {wake_.Data(), POLLIN, 0}};
+                if (sending_.Remain() != 0)
+                {
+                    fds[0].events |= POLLOUT;
+                }
+                if (poll(fds, 2, -1) < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    break;
+                }
+                if (fds[1].revents & POLLIN)
+                {
+                    uint64_t cnt = 0;
+                    [[maybe_unused]] auto rv = read(wake_.Data(), &cnt, sizeof(cnt));
+                }
+                TakeQueued();
+                if (!Flush())
+                    break;
+                if ((fds[0].revents & (POLLIN | POLLERR | POLLHUP)) && !ReadReplies())
+                    break;
+            }
+            Close();
+        }
+
+    public:
+        AsyncClient(const std::string &host, int port)
+            : fd_(Client::GenerateSocket(host, port)), wake_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+        {
+            if (wake_.Data() < 0)
+            {
+                Err("eventfd");
+            }
+            fd_.SetNb();
+            io_ = std::thread([this]
+                              { Loop(); });
+        }
+        AsyncClient(const AsyncClient &) = delete;
+        AsyncClient &operator=(const AsyncClient &) = delete;
+        ~AsyncClient()
+        {
+            stop_.store(true, std::memory_order_release);
+            Wake();
+            io_.join();
+        }
+
+        // 排队一条命令，回复到达后在 I/O 线程中调用 cb；连接已经断开时直接以错误调用 cb
+        auto Send(const std::vector<std::string> &cmds, Callback cb) -> void
+        {
+            bool notify = false;
+            bool closed = false;
+            {
+                std::lock_guard<std::mutex> lock(mu_);
+                closed = closed_;
+                if (!closed)
+                {
+                    EncodeReq(queued_, cmds);
+                    pending_.push_back(std::move(cb));
+                    notify = !wake_armed_;
+                    wake_armed_ = true;
+                }
+            }
+            if (closed)
+            {
+                if (cb)
+                    cb(LostValue());
+                return;
+            }
+            if (notify)
+            {
+                Wake();
+            }
+        }
+
+        auto Call(const std::vector<std::string> &cmds) -> std::future<Value>
+        {
+            auto promise = std::make_shared<std::promise<Value>>();
+            auto future = promise->get_future();
+            Send(cmds, [promise](Value &&val)
+                 { promise->set_value(std::move(val)); });
+            return future;
+        }
+
+        // 已发出或排队中、还没收到回复的请求数
+        auto InFlight() -> size_t
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            return pending_.size();
+        }
+    };
+
+    class AsyncPool
+    {
+    private:
+        static constexpr int k_max_redirects = 5;
+
+        std::string host_;
+        int port_;
+        size_t conns_per_node_;
+        bool cluster_;
+
+        std::mutex mu_;
+        cluster::SlotMap slots_{};
+        // 每个节点 conns_per_node_ 条连接，按节点地址索引
+        std::unordered_map<std::string, std::vector<std::unique_ptr<AsyncClient>>> conns_{};
+
+        auto GetConn(const cluster::NodeAddr &addr, uint32_t slot) -> AsyncClient &
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            auto &conns = conns_[addr.ToString()];
+            if (conns.empty())
+            {
+                for (size_t index = 0; index < conns_per_node_; index++)
+                {
+                    conns.push_back(std::make_unique<AsyncClient>(addr.host_, addr.port_));
+                }
+            }
+            return *conns[slot % conns.size()];
+        }
+
+        auto Route(uint32_t slot) -> cluster::NodeAddr
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            const auto *owner = cluster_ ? slots_.Owner(slot) : nullptr;
+            return owner != nullptr ? *owner : cluster::NodeAddr{host_, port_};
+        }
+
+        auto Dispatch(std::shared_ptr<const std::vector<std::string>> cmds, const cluster::NodeAddr &addr,
+                      uint32_t slot, int redirects, Callback cb) -> void
+        {
+            auto &conn = GetConn(addr, slot);
+            const auto &req = *cmds;
+            conn.Send(req, [this, cmds = std::move(cmds), redirects, cb = std::move(cb)](Value &&val) mutable
+                      {
+                          uint32_t moved_slot = 0;
+                          cluster::NodeAddr moved_to;
+                          if (cluster_ && redirects < k_max_redirects && val.IsErr() &&
+                              val.ErrCode() == CmdErr::ERR_MOVED && ParseMoved(val.str_, moved_slot, moved_to))
+                          {
+                              {
+                                  std::lock_guard<std::mutex> lock(mu_);
+                                  slots_.Assign(moved_slot, moved_slot, slots_.AddNode(moved_to));
+                              }
+                              return Dispatch(std::move(cmds), moved_to, moved_slot, redirects + 1, std::move(cb));
+                          }
+                          if (cb)
+                              cb(std::move(val)); });
+        }
+
+    public:
+        // cluster 为 true 时从 host:port 拉取 slot 映射，否则所有连接都连到 host:port
+        AsyncPool(const std::string &host, int port, size_t conns_per_node = 4, bool cluster = false)
+            : host_(host), port_(port), conns_per_node_(std::max<size_t>(1, conns_per_node)), cluster_(cluster)
+        {
+            if (cluster_)
+            {
+                Client seed(host_, port_);
+                if (!ParseSlots(seed.Call({"cluster", "slots"}), slots_))
+                {
+                    Msg("fetch cluster slots failed");
+                }
+            }
+        }
+
+        // 第一个参数视为 key，没有 key 的命令固定走 slot 0 对应的连接
+        auto Send(const std::vector<std::string> &cmds, Callback cb) -> void
+        {
+            uint32_t slot = cmds.size() >= 2 ? cluster::KeyHashSlot(cmds[1]) : 0;
+            auto req = std::make_shared<const std::vector<std::string>>(cmds);
+            Dispatch(std::move(req), Route(slot), slot, 0, std::move(cb));
+        }
+
+        auto Call(const std::vector<std::string> &cmds) -> std::future<Value>
+        {
+            auto promise = std::make_shared<std::promise<Value>>();
+            auto future = promise->get_future();
+            Send(cmds, [promise](Value &&val)
+                 { promise->set_value(std::move(val)); });
+            return future;
+        }
+    };
+}
+
+#endif
@@ -11,6 +11,8 @@ https://en.wikipedia.org/wiki/AVL_tree
 
 */
 
+#include <vector>
+
 #include "public.h"
 
 namespace kath::avl
@@ -217,6 +219,73 @@ namespace kath::avl
             }
             return node;
         } // Offset function
+
+        // 由已经按顺序排好的 nodes[lo, hi) 直接建一棵平衡树，O(n)，返回根（父节点为空）
+        template <typename Ptr>
+        static auto BuildSorted(const std::vector<Ptr> &nodes, size_t lo, size_t hi) -> AVLNodePtr
+        {
+            if (lo >= hi)
+            {
+                return AVLNodePtr();
+            }
+            size_t mid = lo + (hi - lo) / 2;
+            AVLNodePtr node = nodes[mid];
+            node->left_ = BuildSorted(nodes, lo, mid);
+            node->right_ = BuildSorted(nodes, mid + 1, hi);
+            node->parent_.reset();
+            if (node->left_ != nullptr)
+            {
+                node->left_->parent_ = node;
+            }
+            if (node->right_ != nullptr)
+            {
+                node->right_->parent_ = node;
+            }
+            node->Update();
+            return node;
+        }
+
+        // node 在整棵树中的排名（从 0 开始），沿父节点走到根，O(log n)
+        static auto Rank(AVLNodePtr node) -> int64_t
+        {
+            int64_t rank = AVLNode::Size(node->left_);
+            for (AVLNodePtr parent = node->parent_.lock(); parent != nullptr; parent = parent->parent_.lock())
+            {
+                if (parent->right_ == node)
+                {
+                    rank += AVLNode::Size(parent->left_) + 1;
+                }
+                node = parent;
+            }
+            return rank;
+        }
+
+        // 以 root 为根的树中排名为 rank 的节点，越界时返回空
+        static auto AtRank(AVLNodePtr root, int64_t rank) -> AVLNodePtr
+        {
+            if (rank < 0)
+            {
+                return AVLNodePtr();
+            }
+            while (root != nullptr)
+            {
+                int64_t left = AVLNode::Size(root->left_);
+                if (rank == left)
+                {
+                    return root;
+                }
+                if (rank < left)
+                {
+                    root = root->left_;
+                }
+                else
+                {
+                    rank -= left + 1;
+                    root = root->right_;
+                }
+            }
+            return root;
+        }
     };
 }
 
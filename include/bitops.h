@@ -0,0 +1,256 @@
+#ifndef BITOPS_H
+#define BITOPS_H
+
+/*
+位图（string 当作位数组）的计数与按位运算
+位的编号与 Redis 相同：第 n 位在第 n/8 个字节中，每个字节从最高位开始编号。
+
+按 simd.h 选择实现：
+    AVX-512    带 VPOPCNTDQ 时直接用 vpopcntq，否则用 64 字节的半字节查表（vpshufb）加 vpsadbw 累加
+    AVX2       32 字节的半字节查表加 vpsadbw
+    标量       每次 8 字节的 SWAR 计数，不依赖 popcnt 指令
+按位运算每次处理一个向量宽度，尾部不足一个向量的部分逐字节处理。
+计数可以分段：SplitRange 把位区间拆成两端的零散位和中间完整的字节，中间部分按段调用 Popcount 累加，
+超过 g_bitcount_step 字节的 BITCOUNT 由此分到多轮事件循环中做（见 exec.h 的 StepBitCounts）。
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "public.h"
+#include "simd.h"
+
+namespace kath::bitops
+{
+    enum class Op : uint8_t
+    {
+        AND = 0,
+        OR,
+        XOR,
+    };
+
+    // 单独检测：有的 AVX-512 机器没有 VPOPCNTDQ
+    inline auto DetectVPopcnt() -> bool
+    {
+#if KATH_X86
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512vpopcntdq");
+#else
+        return false;
+#endif
+    }
+    inline const bool k_vpopcnt = DetectVPopcnt();
+
+    // BITCOUNT 在一轮事件循环中最多计数的字节数，标量实现下约 2ms
+    inline size_t g_bitcount_step = 4 << 20;
+
+    inline auto PopcountScalar(const uint8_t *data, size_t len) -> uint64_t
+    {
+        uint64_t count = 0;
+        size_t pos = 0;
+        for (; pos + 8 <= len; pos += 8)
+        {
+            uint64_t word = 0;
+            std::memcpy(&word, data + pos, 8);
+            word = word - ((word >> 1) & 0x5555555555555555ull);
+            word = (word & 0x3333333333333333ull) + ((word >> 2) & 0x3333333333333333ull);
+            word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0full;
+            count += (word * 0x0101010101010101ull) >> 56;
+        }
+        for (; pos < len; pos++)
+        {
+            uint8_t byte = data[pos];
+            for (; byte != 0; byte &= static_cast<uint8_t>(byte - 1))
+            {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    inline auto ApplyScalar(Op op, uint8_t *dst, const uint8_t *src, size_t len) -> void
+    {
+        for (size_t pos = 0; pos < len; pos++)
+        {
+            switch (op)
+            {
+            case Op::AND:
+                dst[pos] &= src[pos];
+                break;
+            case Op::OR:
+                dst[pos] |= src[pos];
+                break;
+            default:
+                dst[pos] ^= src[pos];
+                break;
+            }
+        }
+    }
+
+#if KATH_X86
+    KATH_TARGET("avx2")
+    inline auto PopcountAVX2(const uint8_t *data, size_t len) -> uint64_t
+    {
+        const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                               0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i low = _mm256_set1_epi8(0x0f);
+        __m256i total = _mm256_setzero_si256();
+        size_t pos = 0;
+        for (; pos + 32 <= len; pos += 32)
+        {
+            __m256i vec = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + pos));
+            __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(vec, low));
+            __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(vec, 4), low));
+            // 每个字节最多 8，vpsadbw 把每 8 个字节加到一个 64 位 lane
+            total = _mm256_add_epi64(total, _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256()));
+        }
+        uint64_t lanes[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), total);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] + PopcountScalar(data + pos, len - pos);
+    }
+
+    // 先存回内存再相加；_mm512_reduce_add_epi64 内部同样用到未初始化的向量，GCC 12 会报 -Wmaybe-uninitialized
+    KATH_TARGET("avx512f")
+    inline auto SumLanes(__m512i vec) -> uint64_t
+    {
+        uint64_t lanes[8];
+        _mm512_storeu_si512(lanes, vec);
+        uint64_t sum = 0;
+        for (auto lane : lanes)
+        {
+            sum += lane;
+        }
+        return sum;
+    }
+
+    KATH_TARGET("avx512f,avx512bw")
+    inline auto PopcountAVX512(const uint8_t *data, size_t len) -> uint64_t
+    {
+        // 不带掩码的 broadcast 以未初始化的向量为底，GCC 会报 -Wuninitialized，这里用全 1 掩码的 maskz 版本
+        const __m512i table =
+            _mm512_maskz_broadcast_i32x4(0xffff, _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4));
+        const __m512i low = _mm512_set1_epi8(0x0f);
+        __m512i total = _mm512_setzero_si512();
+        size_t pos = 0;
+        for (; pos + 64 <= len; pos += 64)
+        {
+            __m512i vec = _mm512_loadu_si512(data + pos);
+            __m512i lo = _mm512_shuffle_epi8(table, _mm512_and_si512(vec, low));
+            __m512i hi = _mm512_shuffle_epi8(table, _mm512_and_si512(_mm512_srli_epi16(vec, 4), low));
+            total = _mm512_add_epi64(total, _mm512_sad_epu8(_mm512_add_epi8(lo, hi), _mm512_setzero_si512()));
+        }
+        return SumLanes(total) + PopcountScalar(data + pos, len - pos);
+    }
+
+    KATH_TARGET("avx512f,avx512vpopcntdq")
+    inline auto PopcountVPopcnt(const uint8_t *data, size_t len) -> uint64_t
+    {
+        __m512i total = _mm512_setzero_si512();
+        size_t pos = 0;
+        for (; pos + 64 <= len; pos += 64)
+        {
+            total = _mm512_add_epi64(total, _mm512_popcnt_epi64(_mm512_loadu_si512(data + pos)));
+        }
+        return SumLanes(total) + PopcountScalar(data + pos, len - pos);
+    }
+
+    KATH_TARGET("avx2")
+    inline auto ApplyAVX2(Op op, uint8_t *dst, const uint8_t *src, size_t len) -> void
+    {
+        size_t pos = 0;
+        for (; pos + 32 <= len; pos += 32)
+        {
+            auto *out = reinterpret_cast<__m256i *>(dst + pos);
+            __m256i lhs = _mm256_loadu_si256(out);
+            __m256i rhs = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + pos));
+            __m256i res = op == Op::AND  ? _mm256_and_si256(lhs, rhs)
+                          : op == Op::OR ? _mm256_or_si256(lhs, rhs)
+                                         : _mm256_xor_si256(lhs, rhs);
+            _mm256_storeu_si256(out, res);
+        }
+        ApplyScalar(op, dst + pos, src + pos, len - pos);
+    }
+
+    KATH_TARGET("avx512f")
+    inline auto ApplyAVX512(Op op, uint8_t *dst, const uint8_t *src, size_t len) -> void
+    {
+        size_t pos = 0;
+        for (; pos + 64 <= len; pos += 64)
+        {
+            __m512i lhs = _mm512_loadu_si512(dst + pos);
+            __m512i rhs = _mm512_loadu_si512(src + pos);
+            __m512i res = op == Op::AND  ? _mm512_and_si512(lhs, rhs)
+                          : op == Op::OR ? _mm512_or_si512(lhs, rhs)
+                                         : _mm512_xor_si512(lhs, rhs);
+            _mm512_storeu_si512(dst + pos, res);
+        }
+        ApplyScalar(op, dst + pos, src + pos, len - pos);
+    }
+#endif
+
+    inline auto Popcount(const uint8_t *data, size_t len) -> uint64_t
+    {
+#if KATH_X86
+        if (simd::g_level >= simd::Level::AVX512)
+            return k_vpopcnt ? PopcountVPopcnt(data, len) : PopcountAVX512(data, len);
+        if (simd::g_level >= simd::Level::AVX2)
+            return PopcountAVX2(data, len);
+#endif
+        return PopcountScalar(data, len);
+    }
+
+    // dst[0, len) op= src[0, len)
+    inline auto Apply(Op op, uint8_t *dst, const uint8_t *src, size_t len) -> void
+    {
+#if KATH_X86
+        if (simd::g_level >= simd::Level::AVX512)
+            return ApplyAVX512(op, dst, src, len);
+        if (simd::g_level >= simd::Level::AVX2)
+            return ApplyAVX2(op, dst, src, len);
+#endif
+        ApplyScalar(op, dst, src, len);
+    }
+
+    inline auto Not(uint8_t *dst, size_t len) -> void
+    {
+        for (size_t pos = 0; pos < len; pos++)
+        {
+            dst[pos] = static_cast<uint8_t>(~dst[pos]);
+        }
+    }
+
+    // 位区间 [first_bit, last_bit] 拆成两端字节中 1 的个数 edges_ 和中间完整的字节 [first_, last_)
+    struct Span
+    {
+        uint64_t edges_;
+        size_t first_;
+        size_t last_;
+    };
+    inline auto SplitRange(const uint8_t *data, uint64_t first_bit, uint64_t last_bit) -> Span
+    {
+        uint64_t first_byte = first_bit / 8;
+        uint64_t last_byte = last_bit / 8;
+        // 字节内从最高位开始编号
+        auto head_mask = static_cast<uint8_t>(0xff >> (first_bit % 8));
+        auto tail_mask = static_cast<uint8_t>(0xff << (7 - last_bit % 8));
+        if (first_byte == last_byte)
+        {
+            uint8_t byte = data[first_byte] & head_mask & tail_mask;
+            return {PopcountScalar(&byte, 1), 0, 0};
+        }
+        uint8_t head = data[first_byte] & head_mask;
+        uint8_t tail = data[last_byte] & tail_mask;
+        return {PopcountScalar(&head, 1) + PopcountScalar(&tail, 1), static_cast<size_t>(first_byte + 1),
+                static_cast<size_t>(last_byte)};
+    }
+
+    // [first_bit, last_bit] 中 1 的个数，两端都包含
+    inline auto CountRange(const uint8_t *data, uint64_t first_bit, uint64_t last_bit) -> uint64_t
+    {
+        auto span = SplitRange(data, first_bit, last_bit);
+        return span.edges_ + Popcount(data + span.first_, span.last_ - span.first_);
+    }
+}
+
+#endif
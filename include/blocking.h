@@ -0,0 +1,184 @@
+#ifndef BLOCKING_H
+#define BLOCKING_H
+
+/*
+BLPOP / BRPOP 阻塞的客户端
+所有 key 都为空时，连接（Client）挂起：不再处理它后面的请求，也不再读新的数据（只等对端关闭），
+不在空闲超时的链表中。
+每个 key 有一个等待队列，先挂起的先得到元素；有超时的客户端同时放进截止时间的最小堆，
+事件循环的等待时间（Server::NextTimerMS）会考虑堆顶。
+push 只把有人等待的 key 记为就绪，命令执行完后再统一把元素交给等待的客户端（见 exec.h 的 ServeBlocked），
+所以挂起的客户端只占等待队列和堆中的位置，在它的 key 被 push 之前，事件循环不需要为它做任何事。
+唤醒时只写入回复并记入 woken_，它后面的请求由事件循环在当前命令结束后接着处理（见 Server::ResumeWoken），
+不会在别的连接的命令中执行。
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "public.h"
+#include "heap.h"
+
+namespace kath
+{
+    class OutBuf;
+
+    namespace block
+    {
+        struct Client;
+        using WaitList = std::list<Client *>;
+
+        struct Waiter
+        {
+            std::vector<std::string> keys_;
+            std::vector<WaitList::iterator> links_; // 在每个 key 的等待队列中的位置
+            bool front_{true};                      // BLPOP 为 true
+            uint64_t deadline_us_{0};               // 0 表示一直等
+            size_t heap_index_{0};
+        };
+
+        // 可以被挂起的连接，作为成员放在 Conn 中，unblock_ 由 Conn 设置
+        struct Client
+        {
+            std::unique_ptr<Waiter> waiter_{};
+            void (*unblock_)(Client *, const std::function<void(OutBuf &)> &){nullptr};
+            bool woken_{false}; // 在 Registry 的 woken_ 中，等待事件循环接着处理
+
+            [[nodiscard]] auto Blocked() const -> bool { return waiter_ != nullptr; }
+            [[nodiscard]] auto GetWaiter() const -> const Waiter * { return waiter_.get(); }
+            // 等到了元素或者超时：reply 写入回复，后面的请求等事件循环接着处理
+            auto Unblock(const std::function<void(OutBuf &)> &reply) -> void { unblock_(this, reply); }
+        };
+
+        // 正在执行的命令来自哪个连接，在 Interpret 之前设置
+        inline Client *g_current = nullptr;
+
+        class Registry
+        {
+        private:
+            std::unordered_map<std::string, WaitList> queues_{};
+            Heap deadlines_{};
+            std::vector<std::string> ready_{};
+            std::vector<Client *> woken_{};
+            size_t blocked_{0};
+
+        public:
+            auto Park(Client *client, std::vector<std::string> keys, bool front, uint64_t deadline_us) -> void
+            {
+                auto waiter = std::make_unique<Waiter>();
+                waiter->front_ = front;
+                waiter->deadline_us_ = deadline_us;
+                for (auto &key : keys)
+                {
+                    auto &queue = queues_[key];
+                    waiter->links_.push_back(queue.insert(queue.end(), client));
+                }
+                waiter->keys_ = std::move(keys);
+                if (deadline_us != 0)
+                {
+                    deadlines_.Push(deadline_us, &waiter->heap_index_);
+                }
+                client->waiter_ = std::move(waiter);
+                blocked_++;
+            }
+
+            // 从所有等待队列、堆和 woken_ 中移除，没有挂起也没有被唤醒时什么也不做
+            auto Remove(Client *client) -> void
+            {
+                if (client->woken_)
+                {
+                    woken_.erase(std::find(woken_.begin(), woken_.end(), client));
+                    client->woken_ = false;
+                }
+                auto waiter = std::move(client->waiter_);
+                if (!waiter)
+                    return;
+                for (size_t index = 0; index < waiter->keys_.size(); index++)
+                {
+                    auto queue = queues_.find(waiter->keys_[index]);
+                    queue->second.erase(waiter->links_[index]);
+                    if (queue->second.empty())
+                        queues_.erase(queue);
+                }
+                if (waiter->deadline_us_ != 0)
+                {
+                    deadlines_.Del(waiter->heap_index_);
+                }
+                blocked_--;
+            }
+
+            [[nodiscard]] auto Waiting(const std::string &key) const -> bool { return queues_.count(key) != 0; }
+            // key 的等待队列中最早挂起的客户端，没有时返回 nullptr
+            [[nodiscard]] auto First(const std::string &key) const -> Client *
+            {
+                auto queue = queues_.find(key);
+                return queue == queues_.end() ? nullptr : queue->second.front();
+            }
+
+            // push 之后调用，只记录有人等待的 key
+            auto Signal(const std::string &key) -> void
+            {
+                if (Waiting(key))
+                    ready_.push_back(key);
+            }
+            [[nodiscard]] auto HasReady() const -> bool { return !ready_.empty(); }
+            auto TakeReady() -> std::vector<std::string>
+            {
+                return std::exchange(ready_, {});
+            }
+
+            // 最早的截止时间，没有时返回 uint64_t 的最大值
+            [[nodiscard]] auto NextDeadline() const -> uint64_t
+            {
+                return deadlines_.Empty() ? std::numeric_limits<uint64_t>::max() : deadlines_.Get(0);
+            }
+            // 截止时间不晚于 now_us 的客户端，已经从队列和堆中移除
+            auto Expire(uint64_t now_us) -> std::vector<Client *>
+            {
+                std::vector<Client *> expired;
+                while (!deadlines_.Empty() && deadlines_.Get(0) <= now_us)
+                {
+                    size_t *ref = deadlines_.GetMinRef();
+                    auto *waiter = container_of(ref, Waiter, heap_index_);
+                    // 堆中只有 deadline，按 key 的等待队列找回客户端
+                    Client *client = *waiter->links_.front();
+                    Remove(client);
+                    expired.push_back(client);
+                }
+                return expired;
+            }
+
+            // 唤醒之后调用，连接后面的请求由事件循环通过 TakeWoken 取出后接着处理
+            auto Wake(Client *client) -> void
+            {
+                if (!client->woken_)
+                {
+                    client->woken_ = true;
+                    woken_.push_back(client);
+                }
+            }
+            [[nodiscard]] auto HasWoken() const -> bool { return !woken_.empty(); }
+            auto TakeWoken() -> std::vector<Client *>
+            {
+                for (auto *client : woken_)
+                {
+                    client->woken_ = false;
+                }
+                return std::exchange(woken_, {});
+            }
+
+            [[nodiscard]] auto Blocked() const -> size_t { return blocked_; }
+        };
+        inline Registry g_registry{};
+    }
+}
+
+#endif
@@ -0,0 +1,386 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+/*
+连接用的读写缓冲区
+
+Bytes 底层是 std::vector，每次 read() 前后都要 resize，resize 会把新空间清零，
+Clear() 之后容量也会被释放，下一个请求又要重新分配。
+IoBuf 从所有连接共享的 BlockPool 中取固定大小的块，读写只移动下标：
+    [0, rpos_)        已经消费
+    [rpos_, wpos_)    可读
+    [wpos_, cap_)     可写
+可写空间不够时先把未读数据挪到块头部，仍然不够（大帧）才分配更大的块。
+缓冲区读空后把块还给 BlockPool，稳态下请求不会触发内存分配，也不会清零读空间。
+*/
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "public.h"
+
+namespace kath
+{
+    inline constexpr size_t k_io_block_size = 16 * 1024;
+    inline constexpr size_t k_max_free_blocks = 1024;
+
+    // 固定大小块的空闲链表，事件循环是单线程的，不需要加锁
+    class BlockPool
+    {
+    private:
+        std::vector<std::byte *> free_{};
+        size_t allocated_{0};
+
+    public:
+        BlockPool() = default;
+        BlockPool(const BlockPool &) = delete;
+        BlockPool &operator=(const BlockPool &) = delete;
+        ~BlockPool()
+        {
+            for (auto *block : free_)
+            {
+                delete[] block;
+            }
+        }
+
+        // new std::byte[] 是默认初始化，不会清零
+        auto Get() -> std::byte *
+        {
+            if (free_.empty())
+            {
+                allocated_++;
+                return new std::byte[k_io_block_size];
+            }
+            auto *block = free_.back();
+            free_.pop_back();
+            return block;
+        }
+        auto Put(std::byte *block) -> void
+        {
+            if (free_.size() >= k_max_free_blocks)
+            {
+                allocated_--;
+                delete[] block;
+                return;
+            }
+            free_.push_back(block);
+        }
+        [[nodiscard]] auto Allocated() const -> size_t { return allocated_; }
+        [[nodiscard]] auto FreeCount() const -> size_t { return free_.size(); }
+    };
+    inline BlockPool g_block_pool{};
+
+    class IoBuf
+    {
+    private:
+        std::byte *data_{nullptr};
+        size_t cap_{0};
+        size_t rpos_{0};
+        size_t wpos_{0};
+
+        auto FreeData() -> void
+        {
+            if (data_ == nullptr)
+                return;
+            if (cap_ == k_io_block_size)
+            {
+                g_block_pool.Put(data_);
+            }
+            else
+            {
+                delete[] data_;
+            }
+            data_ = nullptr;
+            cap_ = 0;
+        }
+
+    public:
+        IoBuf() = default;
+        IoBuf(const IoBuf &) = delete;
+        IoBuf &operator=(const IoBuf &) = delete;
+        ~IoBuf() { FreeData(); }
+
+        [[nodiscard]] auto Readable() const -> size_t { return wpos_ - rpos_; }
+        [[nodiscard]] auto Writable() const -> size_t { return cap_ - wpos_; }
+        [[nodiscard]] auto Capacity() const -> size_t { return cap_; }
+        [[nodiscard]] auto Empty() const -> bool { return rpos_ == wpos_; }
+
+        [[nodiscard]] auto Peek() const -> const std::byte * { return data_ + rpos_; }
+        auto Consume(size_t len) -> void
+        {
+            assert(len <= Readable());
+            rpos_ += len;
+            if (rpos_ == wpos_)
+            {
+                rpos_ = wpos_ = 0;
+            }
+        }
+
+        // 去掉末尾 len 字节还没读走的数据
+        auto Unwrite(size_t len) -> void
+        {
+            assert(len <= Readable());
+            wpos_ -= len;
+        }
+
+        [[nodiscard]] auto BeginWrite() -> std::byte * { return data_ + wpos_; }
+        auto HasWritten(size_t len) -> void
+        {
+            assert(len <= Writable());
+            wpos_ += len;
+        }
+
+        // 保证至少有len字节的可写空间
+        auto Reserve(size_t len) -> void
+        {
+            if (Writable() >= len)
+                return;
+            const size_t readable = Readable();
+            if (data_ != nullptr && cap_ - readable >= len)
+            {
+                std::memmove(data_, data_ + rpos_, readable);
+                rpos_ = 0;
+                wpos_ = readable;
+                return;
+            }
+            size_t new_cap = std::max(cap_, k_io_block_size);
+            while (new_cap - readable < len)
+            {
+                new_cap *= 2;
+            }
+            std::byte *new_data = (new_cap == k_io_block_size) ? g_block_pool.Get() : new std::byte[new_cap];
+            if (readable)
+            {
+                std::memcpy(new_data, data_ + rpos_, readable);
+            }
+            FreeData();
+            data_ = new_data;
+            cap_ = new_cap;
+            rpos_ = 0;
+            wpos_ = readable;
+        }
+
+        // 覆盖可读区域中 [offset, offset+len) 的内容，用于回填长度
+        auto Overwrite(size_t offset, const void *src, size_t len) -> void
+        {
+            assert(offset + len <= Readable());
+            std::memcpy(data_ + rpos_ + offset, src, len);
+        }
+
+        auto Append(const void *src, size_t len) -> void
+        {
+            Reserve(len);
+            std::memcpy(data_ + wpos_, src, len);
+            wpos_ += len;
+        }
+        template <typename T, std::enable_if_t<std::is_arithmetic_v<T>, bool> = true>
+        auto AppendNum(const T &num, size_t N) -> void
+        {
+            assert(N <= sizeof(T));
+            Append(&num, N);
+        }
+
+        // 读空时把块还回去，空闲连接不占用缓冲区
+        auto Release() -> void
+        {
+            if (!Empty())
+                return;
+            FreeData();
+            rpos_ = wpos_ = 0;
+        }
+    };
+
+    using StrPin = std::shared_ptr<const std::string>;
+
+    inline constexpr size_t k_ref_min_size = 1024; // 更小的 value 直接拷贝，省掉一个 iovec
+    inline constexpr int k_max_iov = 64;
+    // 单段剩余长度不小于该值时用 MSG_ZEROCOPY 发送，0 表示不启用
+    inline size_t g_zerocopy_min = 0;
+
+    /*
+    回复队列
+    协议头等小数据拷贝进 inline_，大的 value 只记录一个引用（StrPin），
+    写出时按追加顺序拼成 iovec 交给 writev，value 本身不会被拷贝。
+    Ref::at_ 记录该引用插在 inline 数据流的哪个位置，
+    appended_/consumed_ 分别是累计追加进、写出 inline_ 的字节数。
+    引用计数保证写出之前 value 即使被覆盖或删除也不会被释放。
+    */
+    class OutBuf
+    {
+    private:
+        struct Ref
+        {
+            uint64_t at_;
+            StrPin pin_;
+            size_t sent_{0};
+        };
+        IoBuf inline_{};
+        std::deque<Ref> refs_{};
+        uint64_t appended_{0};
+        uint64_t consumed_{0};
+        uint64_t total_{0}; // 累计追加的总字节数（含引用）
+        size_t ref_bytes_{0};
+        Proto proto_{Proto::NATIVE}; // 回复的编码方式
+
+    public:
+        [[nodiscard]] auto GetProto() const -> Proto { return proto_; }
+        auto SetProto(Proto proto) -> void { proto_ = proto; }
+        [[nodiscard]] auto Size() const -> size_t { return inline_.Readable() + ref_bytes_; }
+        [[nodiscard]] auto Empty() const -> bool { return inline_.Empty() && refs_.empty(); }
+        [[nodiscard]] auto Total() const -> uint64_t { return total_; }
+
+        auto Append(const void *src, size_t len) -> void
+        {
+            inline_.Append(src, len);
+            appended_ += len;
+            total_ += len;
+        }
+        template <typename T, std::enable_if_t<std::is_arithmetic_v<T>, bool> = true>
+        auto AppendNum(const T &num, size_t N) -> void
+        {
+            Append(&num, N);
+        }
+        auto AppendStr(const std::string &str) -> void { Append(str.data(), str.size()); }
+        auto AppendStrView(std::string_view str_view) -> void { Append(str_view.data(), str_view.size()); }
+
+        // 追加一个引用，小于 min_size 的 value 仍然拷贝；多个连接共享的数据（如发布的消息）传 0，总是引用
+        auto AppendRef(StrPin pin, size_t min_size = k_ref_min_size) -> void
+        {
+            if (pin->size() < min_size)
+            {
+                AppendStr(*pin);
+                return;
+            }
+            ref_bytes_ += pin->size();
+            total_ += pin->size();
+            refs_.push_back({appended_, std::move(pin), 0});
+        }
+
+        // 内容稍后才确定的一段（如元素个数未知的 RESP 数组头），写出之前必须 FillDeferred
+        auto AppendDeferred(const std::shared_ptr<std::string> &slot) -> void
+        {
+            refs_.push_back({appended_, slot, 0});
+        }
+        auto FillDeferred(const std::shared_ptr<std::string> &slot, std::string text) -> void
+        {
+            *slot = std::move(text);
+            ref_bytes_ += slot->size();
+            total_ += slot->size();
+        }
+
+        // 记录当前 inline 写位置，之后可以用 Cover 回填
+        [[nodiscard]] auto Mark() const -> uint64_t { return appended_; }
+        auto Cover(uint64_t mark, const void *src, size_t len) -> void
+        {
+            assert(mark >= consumed_ && mark + len <= appended_);
+            inline_.Overwrite(mark - consumed_, src, len);
+        }
+
+        // 撤销 mark 之后追加的内容，mark 之后不能追加过引用
+        auto Rollback(uint64_t mark) -> void
+        {
+            assert(mark >= consumed_ && mark <= appended_);
+            assert(refs_.empty() || refs_.back().at_ <= mark);
+            inline_.Unwrite(appended_ - mark);
+            total_ -= appended_ - mark;
+            appended_ = mark;
+        }
+
+        // 全部内容拷贝成 string，用于预先序列化的一段回复，不能追加过引用
+        [[nodiscard]] auto ToString() const -> std::string
+        {
+            assert(refs_.empty());
+            return {reinterpret_cast<const char *>(inline_.Peek()), inline_.Readable()};
+        }
+
+        // 从当前写出位置开始收集 iovec
+        // 遇到剩余长度不小于 zc_min 的引用时，它必须单独作为第一段发送，此时 zerocopy 置为 true
+        auto BuildIov(iovec *iov, int max, size_t zc_min, bool &zerocopy) const -> int
+        {
+            int cnt = 0;
+            zerocopy = false;
+            uint64_t cur = consumed_;
+            const std::byte *base = inline_.Peek();
+            for (const auto &ref : refs_)
+            {
+                if (ref.at_ > cur)
+                {
+                    if (cnt == max)
+                        return cnt;
+                    iov[cnt++] = {const_cast<std::byte *>(base + (cur - consumed_)), ref.at_ - cur};
+                    cur = ref.at_;
+                }
+                if (cnt == max)
+                    return cnt;
+                size_t remain = ref.pin_->size() - ref.sent_;
+                void *data = const_cast<char *>(ref.pin_->data() + ref.sent_);
+                if (zc_min && remain >= zc_min)
+                {
+                    if (cnt == 0)
+                    {
+                        iov[cnt++] = {data, remain};
+                        zerocopy = true;
+                    }
+                    return cnt;
+                }
+                iov[cnt++] = {data, remain};
+            }
+            if (appended_ > cur && cnt < max)
+            {
+                iov[cnt++] = {const_cast<std::byte *>(base + (cur - consumed_)), appended_ - cur};
+            }
+            return cnt;
+        }
+
+        // 下一段要发送的引用（如果下一段是引用的话）
+        [[nodiscard]] auto FrontPin() const -> StrPin
+        {
+            if (!refs_.empty() && refs_.front().at_ == consumed_)
+                return refs_.front().pin_;
+            return nullptr;
+        }
+
+        // 已写出len字节
+        auto Consume(size_t len) -> void
+        {
+            while (len)
+            {
+                if (!refs_.empty() && refs_.front().at_ == consumed_)
+                {
+                    auto &ref = refs_.front();
+                    size_t step = std::min(len, ref.pin_->size() - ref.sent_);
+                    ref.sent_ += step;
+                    ref_bytes_ -= step;
+                    len -= step;
+                    if (ref.sent_ == ref.pin_->size())
+                    {
+                        refs_.pop_front();
+                    }
+                    continue;
+                }
+                uint64_t limit = refs_.empty() ? appended_ : refs_.front().at_;
+                size_t step = std::min<uint64_t>(len, limit - consumed_);
+                assert(step > 0);
+                inline_.Consume(step);
+                consumed_ += step;
+                len -= step;
+            }
+        }
+
+        auto Release() -> void
+        {
+            if (Empty())
+            {
+                inline_.Release();
+            }
+        }
+    };
+}
+
+#endif
@@ -27,6 +27,10 @@ namespace kath
     public:
         Bytes() = default;
         ~Bytes() = default;
+        Bytes(const Bytes &) = default;
+        Bytes &operator=(const Bytes &) = default;
+        Bytes(Bytes &&) noexcept = default;
+        Bytes &operator=(Bytes &&) noexcept = default;
 
         [[nodiscard]] auto Size() const -> size_t
         {
@@ -36,12 +40,26 @@ namespace kath
         auto Clear() -> void
         {
             data_.clear();
-            pos_ = 1;
+            pos_ = 0;
         }
 
         auto reset() -> void { pos_ = 0; }
 
         [[nodiscard]] bool IsReadEnd() const { return pos_ == data_.size(); }
+        [[nodiscard]] auto Remain() const -> size_t { return data_.size() - pos_; }
+        [[nodiscard]] auto Data() const -> const std::byte * { return data_.data(); }
+        [[nodiscard]] auto Pos() const -> size_t { return pos_; }
+        auto Seek(size_t pos) -> void
+        {
+            assert(pos <= data_.size());
+            pos_ = pos;
+        }
+        // 丢掉已经读过的部分
+        auto Compact() -> void
+        {
+            data_.erase(data_.begin(), data_.begin() + static_cast<std::ptrdiff_t>(pos_));
+            pos_ = 0;
+        }
 
         friend auto operator<<(std::ostream &ost, const Bytes &bytes) -> std::ostream &
         {
@@ -56,20 +74,23 @@ namespace kath
 
         auto AppendStr(const std::string &str) -> void
         {
-            data_.resize(str.size() + data_.size());
-            std::memcpy(data_.data() + data_.size(), str.c_str(), str.size());
+            const size_t last_size = data_.size();
+            data_.resize(str.size() + last_size);
+            std::memcpy(data_.data() + last_size, str.c_str(), str.size());
         }
         auto AppendStrView(const std::string_view &str_view) -> void
         {
-            data_.resize(str_view.size() + data_.size());
-            std::memcpy(data_.data() + data_.size(), str_view.data(), str_view.size());
+            const size_t last_size = data_.size();
+            data_.resize(str_view.size() + last_size);
+            std::memcpy(data_.data() + last_size, str_view.data(), str_view.size());
         }
 
         template <typename T, std::enable_if_t<std::is_arithmetic_v<T>, bool> = true>
         auto AppendNum(const T &num, size_t N) -> void
         {
-            data_.resize(data_.size() + N);
-            memcpy(data_.data() + data_.size(), &num, N);
+            const size_t last_size = data_.size();
+            data_.resize(last_size + N);
+            memcpy(data_.data() + last_size, &num, N);
         }
 
         template <typename T, std::enable_if_t<std::is_arithmetic_v<T>, bool> = true>
@@ -101,7 +122,7 @@ namespace kath
         auto GetNum(size_t len) -> T
         {
             const size_t read_size = std::min(len, data_.size() - pos_);
-            T num;
+            T num{};
             std::memcpy(&num, data_.data() + pos_, read_size);
             pos_ += read_size;
             return num;
@@ -7,19 +7,175 @@
 #include <memory>
 #include <vector>
 #include <string>
+#include <unordered_map>
 
 #include "public.h"
 #include "file.h"
+#include "cluster.h"
 namespace kath
 {
+    // 解析后的回复
+    struct Value
+    {
+        SerType type_{SerType::NIL};
+        int64_t int_{0}; // INT64 的值，或 ERR 的错误码
+        double dou_{0};
+        std::string str_; // STR 的值，或 ERR 的描述
+        std::vector<Value> arr_;
+
+        [[nodiscard]] auto IsErr() const -> bool { return type_ == SerType::ERR; }
+        [[nodiscard]] auto ErrCode() const -> CmdErr { return static_cast<CmdErr>(int_); }
+
+        auto Print(std::ostream &os, const std::string &pre = "") const -> void
+        {
+            switch (type_)
+            {
+            case SerType::NIL:
+                os << pre << "[nil]\n";
+                break;
+            case SerType::ARR:
+                os << pre << "[arr]: len = " << arr_.size() << std::endl;
+                for (const auto &val : arr_)
+                {
+                    val.Print(os, pre + "-");
+                }
+                break;
+            case SerType::DOU:
+                os << pre << "[dou]: " << dou_ << std::endl;
+                break;
+            case SerType::ERR:
+                os << pre << "[err]: " << str_ << std::endl;
+                break;
+            case SerType::INT64:
+                os << pre << "[int]: " << int_ << std::endl;
+                break;
+            case SerType::STR:
+                os << pre << "[str]: " << str_ << std::endl;
+                break;
+            default:
+                Msg("type dont find");
+                break;
+            }
+        }
+    };
+
+    // 从buff中解析出一个完整的回复，数据不完整时返回false
+    auto ParseValue(Bytes &buff, Value &val) -> bool
+    {
+        if (buff.Remain() < 1)
+            return false;
+        val.type_ = static_cast<SerType>(buff.GetNum<uint8_t>(1));
+        size_t len = 0;
+        switch (val.type_)
+        {
+        case SerType::NIL:
+            return true;
+        case SerType::ARR:
+            if (buff.Remain() < 4)
+                return false;
+            len = buff.GetNum<uint32_t>(4);
+            val.arr_.resize(len);
+            for (auto &sub : val.arr_)
+            {
+                if (!ParseValue(buff, sub))
+                    return false;
+            }
+            return true;
+        case SerType::DOU:
+            if (buff.Remain() < 8)
+                return false;
+            val.dou_ = buff.GetNum<double>(8);
+            return true;
+        case SerType::ERR:
+            if (buff.Remain() < 8)
+                return false;
+            val.int_ = buff.GetNum<uint32_t>(4);
+            len = buff.GetNum<uint32_t>(4);
+            if (buff.Remain() < len)
+                return false;
+            val.str_ = buff.GetStrView(len);
+            return true;
+        case SerType::INT64:
+            if (buff.Remain() < 8)
+                return false;
+            val.int_ = buff.GetNum<int64_t>(8);
+            return true;
+        case SerType::STR:
+            if (buff.Remain() < 4)
+                return false;
+            len = buff.GetNum<uint32_t>(4);
+            if (buff.Remain() < len)
+                return false;
+            val.str_ = buff.GetStrView(len);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // 把一条命令编码成请求帧追加到 buff 末尾
+    auto EncodeReq(Bytes &buff, const std::vector<std::string> &cmds) -> void
+    {
+        size_t size_sum = 4;
+        for (auto &cmd : cmds)
+        {
+            size_sum += cmd.size() + 4;
+        }
+        buff.AppendNum(size_sum, 4);
+        buff.AppendNum(cmds.size(), 4);
+        for (auto &cmd : cmds)
+        {
+            buff.AppendNum(cmd.size(), 4);
+            buff.AppendStr(cmd);
+        }
+    }
+
+    // 把 "cluster slots" 的回复填进 slots，回复不合法时 slots 保持原样
+    auto ParseSlots(const Value &val, cluster::SlotMap &slots) -> bool
+    {
+        if (val.type_ != SerType::ARR)
+        {
+            return false;
+        }
+        cluster::SlotMap parsed;
+        for (const auto &range : val.arr_)
+        {
+            // 回复来自网络，slot 和端口都要检查，负数转成 uint64_t 后同样会被 Assign 拒绝
+            if (range.arr_.size() != 4 || range.arr_[3].int_ <= 0 || range.arr_[3].int_ > 65535)
+            {
+                return false;
+            }
+            auto node = parsed.AddNode({range.arr_[2].str_, static_cast<int>(range.arr_[3].int_)});
+            if (!parsed.Assign(static_cast<uint64_t>(range.arr_[0].int_), static_cast<uint64_t>(range.arr_[1].int_), node))
+            {
+                return false;
+            }
+        }
+        slots = std::move(parsed);
+        return true;
+    }
+
+    // 解析 "MOVED slot host:port"
+    auto ParseMoved(const std::string &msg, uint32_t &slot, cluster::NodeAddr &addr) -> bool
+    {
+        std::istringstream iss(msg);
+        std::string word, node;
+        if (!(iss >> word >> slot >> node) || word != "MOVED" || slot >= cluster::k_slot_count)
+        {
+            return false;
+        }
+        return cluster::NodeAddr::Parse(node, addr);
+    }
+
     class Client
     {
     private:
         File fd_;
 
     public:
-        Client() : fd_(GenerateSocket()) {}
-        static int GenerateSocket()
+        Client() : fd_(GenerateSocket("127.0.0.1", server_port)) {}
+        Client(const std::string &host, int port) : fd_(GenerateSocket(host, port)) {}
+        static int GenerateSocket(const std::string &host, int port)
         {
             int fd = socket(AF_INET, SOCK_STREAM, 0);
             if (fd < 0)
@@ -29,8 +185,11 @@ namespace kath
 
             sockaddr_in server = {};
             server.sin_family = AF_INET;
-            server.sin_port = htons(server_port);
-            server.sin_addr.s_addr = ntohl(INADDR_LOOPBACK);
+            server.sin_port = htons(port);
+            if (inet_pton(AF_INET, host.c_str(), &server.sin_addr) != 1)
+            {
+                Err("bad host");
+            }
 
             int rv = connect(fd, reinterpret_cast<const sockaddr *>(&server), sizeof(server));
             if (rv)
@@ -40,77 +199,114 @@ namespace kath
             return fd;
         }
 
-        void Send(std::vector<std::string> cmds)
+        void Send(const std::vector<std::string> &cmds)
         {
             Bytes buff;
-            size_t size_sum = 4;
-            for (auto &cmd : cmds)
-            {
-                size_sum += cmd.size() + 4;
-            }
-            buff.AppendNum(size_sum, 4);
-            buff.AppendNum(cmds.size(), 4);
-            for (auto &cmd : cmds)
-            {
-                buff.AppendNum(cmd.size(), 4);
-                buff.AppendStr(cmd);
-            }
+            EncodeReq(buff, cmds);
             auto ok = fd_.WriteByte_b(buff);
             assert(ok);
         }
         void Handle(Bytes &buff, const std::string &pre = "")
         {
-            auto type = static_cast<SerType>(buff.GetNum<int>(1));
-            double dou_val;
-            size_t arr_len;
-            int str_len;
-            std::string_view str_view;
-            std::string_view msg;
-            switch (type)
+            Value val;
+            if (!ParseValue(buff, val))
             {
-            case SerType::NIL:
-                std::cout << pre << "[nil]\n";
-                break;
-            case SerType::ARR:
-                arr_len = buff.GetNum<size_t>(4);
-                std::cout << pre << "[arr]: len = " << arr_len << std::endl;
-                for (int index = 0; index < arr_len; index++)
-                {
-                    Handle(buff, pre + "-");
-                }
-                break;
-            case SerType::DOU:
-                dou_val = buff.GetNum<double>(8);
-                std::cout << pre << "[dou]: " << dou_val << std::endl;
-                break;
-            case SerType::ERR:
-                str_len = buff.GetNum<int>(4);
-                msg = buff.GetStrView(str_len);
-                std::cout << pre << "[err]: " << msg << std::endl;
-                break;
-            case SerType::INT64:
-                std::cout << pre << "[int]: " << buff.GetNum<int64_t>(8) << std::endl;
-                break;
-            case SerType::STR:
-                str_len = buff.GetNum<int>(4);
-                str_view = buff.GetStrView(str_len);
-                std::cout << pre << "[str]: " << str_view << std::endl;
-            default:
-                Msg("type dont find");
-                break;
+                Msg("bad reply");
+                return;
             }
+            val.Print(std::cout, pre);
+        }
+        // 读出一个完整的回复帧（不含长度前缀）
+        auto ReceiveBytes(Bytes &buff) -> bool
+        {
+            if (!fd_.ReadByte_b(buff, 4))
+                return false;
+            size_t size_sum = buff.GetNum<uint32_t>(4);
+            return fd_.ReadByte_b(buff, size_sum);
         }
         void Receive()
         {
             Bytes buff;
-            bool ok = fd_.ReadByte_b(buff, 4);
-            assert(ok);
-            size_t size_sum = buff.GetNum<size_t>(4);
-            ok = fd_.ReadByte_b(buff, size_sum);
+            bool ok = ReceiveBytes(buff);
             assert(ok);
             Handle(buff);
         }
+        // 发送一条命令并等待回复
+        auto Call(const std::vector<std::string> &cmds) -> Value
+        {
+            Send(cmds);
+            Bytes buff;
+            Value val;
+            if (!ReceiveBytes(buff) || !ParseValue(buff, val))
+            {
+                val.type_ = SerType::ERR;
+                val.int_ = static_cast<int64_t>(CmdErr::Err_UNKNOWN);
+                val.str_ = "connection lost";
+            }
+            return val;
+        }
+    };
+
+    // 集群客户端：缓存 slot -> 节点 的映射，按 key 直接发往负责的节点
+    // 收到 MOVED 时更新映射并重试
+    class ClusterClient
+    {
+    private:
+        static constexpr int k_max_redirects = 5;
+
+        cluster::NodeAddr seed_;
+        cluster::SlotMap slots_{};
+        std::unordered_map<std::string, std::unique_ptr<Client>> conns_{};
+
+        auto GetConn(const cluster::NodeAddr &addr) -> Client &
+        {
+            auto &conn = conns_[addr.ToString()];
+            if (!conn)
+            {
+                conn = std::make_unique<Client>(addr.host_, addr.port_);
+            }
+            return *conn;
+        }
+
+    public:
+        ClusterClient(const std::string &host, int port) : seed_{host, port}
+        {
+            RefreshSlots();
+        }
+
+        // 通过 "cluster slots" 重新拉取整张映射
+        auto RefreshSlots() -> bool
+        {
+            return ParseSlots(GetConn(seed_).Call({"cluster", "slots"}), slots_);
+        }
+
+        // 第一个参数视为 key，没有 key 的命令发往种子节点
+        auto Call(const std::vector<std::string> &cmds) -> Value
+        {
+            const cluster::NodeAddr *target = &seed_;
+            if (cmds.size() >= 2)
+            {
+                const auto *owner = slots_.Owner(cluster::KeyHashSlot(cmds[1]));
+                if (owner != nullptr)
+                {
+                    target = owner;
+                }
+            }
+            cluster::NodeAddr addr = *target;
+            Value val;
+            for (int redirect = 0; redirect <= k_max_redirects; redirect++)
+            {
+                val = GetConn(addr).Call(cmds);
+                uint32_t slot = 0;
+                if (!val.IsErr() || val.ErrCode() != CmdErr::ERR_MOVED || !ParseMoved(val.str_, slot, addr))
+                {
+                    break;
+                }
+                slots_.Assign(slot, slot, slots_.AddNode(addr));
+            }
+            return val;
+        }
     };
 }
 
-#endif
\ No newline at end of file
+#endif
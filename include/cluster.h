@@ -0,0 +1,260 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+/*
+集群模式：
+整个键空间被切分为 k_slot_count 个 hash slot，每个 key 通过 CRC16 映射到某个 slot，
+每个 Server 实例只负责配置文件中分配给它的 slot。
+配置文件每行描述一个节点：
+    127.0.0.1:7001 0-8191
+    127.0.0.1:7002 8192-16383
+所有节点与客户端共用同一份映射，key 包含 {tag} 时只对 tag 部分计算 slot，方便把相关的 key 放在同一个节点上。
+*/
+
+#include <array>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "public.h"
+
+namespace kath::cluster
+{
+    inline constexpr uint32_t k_slot_count = 16384;
+
+    // CRC16-CCITT (XMODEM)，与 Redis Cluster 使用的是同一个多项式
+    inline constexpr auto MakeCrc16Table() -> std::array<uint16_t, 256>
+    {
+        std::array<uint16_t, 256> table{};
+        for (uint32_t index = 0; index < 256; index++)
+        {
+            uint16_t crc = static_cast<uint16_t>(index << 8);
+            for (int bit = 0; bit < 8; bit++)
+            {
+                crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+            }
+            table[index] = crc;
+        }
+        return table;
+    }
+    inline constexpr std::array<uint16_t, 256> k_crc16_table = MakeCrc16Table();
+
+    inline auto Crc16(std::string_view buf) -> uint16_t
+    {
+        uint16_t crc = 0;
+        for (auto c : buf)
+        {
+            crc = static_cast<uint16_t>((crc << 8) ^ k_crc16_table[((crc >> 8) ^ static_cast<uint8_t>(c)) & 0xff]);
+        }
+        return crc;
+    }
+
+    // 如果 key 中存在非空的 {tag}，只对 tag 计算 slot
+    inline auto KeyHashSlot(std::string_view key) -> uint32_t
+    {
+        auto left = key.find('{');
+        if (left != std::string_view::npos)
+        {
+            auto right = key.find('}', left + 1);
+            if (right != std::string_view::npos && right != left + 1)
+            {
+                key = key.substr(left + 1, right - left - 1);
+            }
+        }
+        return Crc16(key) & (k_slot_count - 1);
+    }
+
+    struct NodeAddr
+    {
+        std::string host_;
+        int port_{0};
+
+        [[nodiscard]] auto ToString() const -> std::string { return host_ + ":" + std::to_string(port_); }
+        auto operator==(const NodeAddr &other) const -> bool { return port_ == other.port_ && host_ == other.host_; }
+
+        // 解析 host:port
+        static auto Parse(std::string_view str, NodeAddr &addr) -> bool
+        {
+            auto pos = str.rfind(':');
+            if (pos == std::string_view::npos || pos == 0 || pos + 1 == str.size())
+            {
+                return false;
+            }
+            char *endp = nullptr;
+            std::string port_str(str.substr(pos + 1));
+            long port = strtol(port_str.c_str(), &endp, 10);
+            if (endp != port_str.c_str() + port_str.size() || port <= 0 || port > 65535)
+            {
+                return false;
+            }
+            addr.host_ = std::string(str.substr(0, pos));
+            addr.port_ = static_cast<int>(port);
+            return true;
+        }
+    };
+
+    struct SlotRange
+    {
+        uint32_t begin_;
+        uint32_t end_; // 闭区间
+        int32_t node_;
+    };
+
+    // slot -> 节点 的映射，Server 与 Client 共用
+    class SlotMap
+    {
+    private:
+        std::vector<NodeAddr> nodes_{};
+        std::vector<int32_t> owner_ = std::vector<int32_t>(k_slot_count, -1);
+
+    public:
+        auto Clear() -> void
+        {
+            nodes_.clear();
+            owner_.assign(k_slot_count, -1);
+        }
+        [[nodiscard]] auto Empty() const -> bool { return nodes_.empty(); }
+
+        // 返回节点编号，不存在时追加
+        auto AddNode(const NodeAddr &addr) -> int32_t
+        {
+            for (size_t index = 0; index < nodes_.size(); index++)
+            {
+                if (nodes_[index] == addr)
+                {
+                    return static_cast<int32_t>(index);
+                }
+            }
+            nodes_.push_back(addr);
+            return static_cast<int32_t>(nodes_.size() - 1);
+        }
+        // 区间来自配置文件或服务端的回复，不合法时不做任何修改并返回 false
+        auto Assign(uint64_t begin, uint64_t end, int32_t node) -> bool
+        {
+            if (begin > end || end >= k_slot_count || node < 0 || static_cast<size_t>(node) >= nodes_.size())
+            {
+                return false;
+            }
+            for (auto slot = begin; slot <= end; slot++)
+            {
+                owner_[slot] = node;
+            }
+            return true;
+        }
+        [[nodiscard]] auto OwnerIndex(uint32_t slot) const -> int32_t { return owner_[slot]; }
+        [[nodiscard]] auto Owner(uint32_t slot) const -> const NodeAddr *
+        {
+            auto node = owner_[slot];
+            return node < 0 ? nullptr : &nodes_[node];
+        }
+        [[nodiscard]] auto Nodes() const -> const std::vector<NodeAddr> & { return nodes_; }
+
+        // 把连续且属于同一节点的 slot 合并成区间
+        [[nodiscard]] auto Ranges() const -> std::vector<SlotRange>
+        {
+            std::vector<SlotRange> ranges;
+            for (uint32_t slot = 0; slot < k_slot_count; slot++)
+            {
+                if (owner_[slot] < 0)
+                {
+                    continue;
+                }
+                if (!ranges.empty() && ranges.back().node_ == owner_[slot] && ranges.back().end_ + 1 == slot)
+                {
+                    ranges.back().end_ = slot;
+                }
+                else
+                {
+                    ranges.push_back({slot, slot, owner_[slot]});
+                }
+            }
+            return ranges;
+        }
+
+        // 解析单行配置 "host:port 0-100 200 300-400"
+        auto ParseLine(const std::string &line) -> bool
+        {
+            std::istringstream iss(line);
+            std::string word;
+            if (!(iss >> word) || word[0] == '#')
+            {
+                return true;
+            }
+            NodeAddr addr;
+            if (!NodeAddr::Parse(word, addr))
+            {
+                return false;
+            }
+            auto node = AddNode(addr);
+            while (iss >> word)
+            {
+                auto dash = word.find('-');
+                char *endp = nullptr;
+                unsigned long begin = strtoul(word.c_str(), &endp, 10);
+                unsigned long end = begin;
+                if (dash != std::string::npos)
+                {
+                    end = strtoul(word.c_str() + dash + 1, &endp, 10);
+                }
+                if (endp != word.c_str() + word.size() || !Assign(begin, end, node))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        auto LoadFile(const std::string &path) -> bool
+        {
+            std::ifstream ifs(path);
+            if (!ifs)
+            {
+                return false;
+            }
+            std::string line;
+            while (std::getline(ifs, line))
+            {
+                if (!ParseLine(line))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    // 当前进程在集群中的状态，enabled_ 为 false 时 Server 以单机模式运行
+    struct ClusterState
+    {
+        bool enabled_{false};
+        int32_t self_{-1};
+        SlotMap slots_{};
+
+        [[nodiscard]] auto IsMine(uint32_t slot) const -> bool { return slots_.OwnerIndex(slot) == self_; }
+    };
+    inline ClusterState g_cluster{};
+
+    // 以 host:port 匹配配置文件里属于自己的那一行，不同机器上的节点可以使用相同的端口
+    inline auto LoadConfig(const std::string &path, const NodeAddr &self) -> bool
+    {
+        g_cluster.slots_.Clear();
+        if (!g_cluster.slots_.LoadFile(path))
+        {
+            return false;
+        }
+        const auto &nodes = g_cluster.slots_.Nodes();
+        for (size_t index = 0; index < nodes.size(); index++)
+        {
+            if (nodes[index] == self)
+            {
+                g_cluster.self_ = static_cast<int32_t>(index);
+                g_cluster.enabled_ = true;
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+#endif
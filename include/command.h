@@ -0,0 +1,195 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+
+/*
+命令表
+每条命令由 CmdDesc 描述：参数个数、读写属性、key 所在的位置以及处理函数。
+命令名到 CmdDesc 的映射是编译期生成的完美哈希：
+对所有命令名（忽略大小写）搜索一个 seed，使 CmdHash(name, seed) 落到互不相同的槽中，
+查找时只需要算一次哈希再比较一次名字，与命令数量无关。
+*/
+
+#include <array>
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "public.h"
+
+namespace kath
+{
+    class OutBuf;
+    using Cmd = std::vector<std::string>;
+    using CmdHandler = void (*)(Cmd &, OutBuf &);
+
+    enum CmdFlag : uint32_t
+    {
+        CMD_READONLY = 1 << 0,  // 不修改数据
+        CMD_WRITE = 1 << 1,     // 可能修改数据，复制和 AOF 需要关心
+        CMD_MULTI_KEY = 1 << 2, // 涉及多个 key，集群模式下它们必须在同一个 slot
+        CMD_ADMIN = 1 << 3,     // 管理类命令，不涉及 key
+        CMD_PUBSUB = 1 << 4,    // 有订阅的 RESP2 / 原生协议连接只能执行这类命令
+        CMD_STREAMS = 1 << 5,   // 从 first_key_ 开始找 STREAMS，之后的参数前一半是 key、后一半是 ID（XREAD）
+        CMD_NUMKEYS = 1 << 6,   // first_key_ 到 last_key_ 之后是 numkeys，再跟 numkeys 个 key（ZUNIONSTORE）
+    };
+
+    namespace cmd
+    {
+        constexpr auto ToLower(char c) -> char
+        {
+            return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+
+        // word 忽略大小写后与 name 相同，name 为小写
+        constexpr auto NameEq(std::string_view word, std::string_view name) -> bool
+        {
+            if (word.size() != name.size())
+                return false;
+            for (size_t index = 0; index < word.size(); index++)
+            {
+                if (ToLower(word[index]) != name[index])
+                    return false;
+            }
+            return true;
+        }
+    }
+
+    struct CmdDesc
+    {
+        std::string_view name_;
+        int32_t arity_;     // 大于 0 时为精确的参数个数（含命令名），小于 0 时表示至少 -arity_ 个
+        uint32_t flags_;
+        int32_t first_key_; // 第一个 key 的下标，0 表示没有 key
+        int32_t last_key_;  // 最后一个 key 的下标，负数表示从末尾数
+        int32_t key_step_;
+        CmdHandler handler_;
+
+        [[nodiscard]] constexpr auto Has(CmdFlag flag) const -> bool { return flags_ & flag; }
+        [[nodiscard]] auto CheckArity(size_t argc) const -> bool
+        {
+            return arity_ > 0 ? argc == static_cast<size_t>(arity_) : argc >= static_cast<size_t>(-arity_);
+        }
+        // 对 cmd 中每个 key 的下标调用 fn
+        template <typename F>
+        auto ForEachKey(const Cmd &cmd, F &&fn) const -> void
+        {
+            if (first_key_ == 0)
+                return;
+            auto size = static_cast<int32_t>(cmd.size());
+            int32_t first = first_key_;
+            int32_t last = last_key_ < 0 ? size + last_key_ : last_key_;
+            if (Has(CMD_STREAMS))
+            {
+                while (first < size && !cmd::NameEq(cmd[first], "streams"))
+                    first++;
+                // 没有 STREAMS 时没有 key，由命令自己报错
+                first++;
+                last = first + (size - first) / 2 - 1;
+            }
+            for (int32_t index = first; index <= last && index < size; index += key_step_)
+            {
+                fn(index);
+            }
+            if (Has(CMD_NUMKEYS) && last + 1 < size)
+            {
+                // numkeys 不合法或者超出参数个数时只取到末尾，由命令自己报错
+                const auto &arg = cmd[last + 1];
+                int32_t numkeys = 0;
+                std::from_chars(arg.data(), arg.data() + arg.size(), numkeys);
+                for (int32_t index = last + 2; index < last + 2 + numkeys && index < size; index++)
+                {
+                    fn(index);
+                }
+            }
+        }
+    };
+
+    namespace cmd
+    {
+        // 登记了多个 key 位置的命令都要带 CMD_MULTI_KEY，CheckSlot 只对它们检查是否跨 slot
+        template <size_t N>
+        constexpr auto MultiKeyFlagged(const CmdDesc (&table)[N]) -> bool
+        {
+            for (const auto &desc : table)
+            {
+                bool multi = desc.Has(CMD_STREAMS) || desc.Has(CMD_NUMKEYS) || desc.last_key_ != desc.first_key_;
+                if (desc.first_key_ != 0 && multi && !desc.Has(CMD_MULTI_KEY))
+                    return false;
+            }
+            return true;
+        }
+
+        // 忽略大小写的 FNV-1a
+        constexpr auto CmdHash(std::string_view name, uint32_t seed) -> uint32_t
+        {
+            uint32_t hash = 2166136261u ^ seed;
+            for (char c : name)
+            {
+                hash ^= static_cast<uint8_t>(ToLower(c));
+                hash *= 16777619u;
+            }
+            return hash ^ (hash >> 15);
+        }
+
+        // 槽数至少为命令数的 8 倍：倍数小时要试上千个 seed，超出编译器的常量求值步数上限
+        // （2 倍时四十多条命令、4 倍时六十多条命令就会超出）
+        constexpr auto SlotCount(size_t n) -> size_t
+        {
+            size_t slots = 1;
+            while (slots < n * 8)
+            {
+                slots <<= 1;
+            }
+            return slots;
+        }
+
+        // slots_[CmdHash(name, seed_) & (M - 1)] 为命令在表中的下标，-1 为空槽
+        template <size_t M>
+        struct PerfectHash
+        {
+            uint32_t seed_{0};
+            std::array<int16_t, M> slots_{};
+        };
+
+        template <size_t N, size_t M = SlotCount(N)>
+        constexpr auto MakePerfectHash(const CmdDesc (&table)[N]) -> PerfectHash<M>
+        {
+            PerfectHash<M> res{};
+            for (uint32_t seed = 1; seed < (1u << 20); seed++)
+            {
+                for (auto &slot : res.slots_)
+                {
+                    slot = -1;
+                }
+                bool ok = true;
+                for (size_t index = 0; index < N && ok; index++)
+                {
+                    auto &slot = res.slots_[CmdHash(table[index].name_, seed) & (M - 1)];
+                    ok = (slot == -1);
+                    slot = static_cast<int16_t>(index);
+                }
+                if (ok)
+                {
+                    res.seed_ = seed;
+                    return res;
+                }
+            }
+            // 常量求值中走到这里会直接编译失败
+            throw "no perfect hash seed";
+        }
+
+        template <size_t N, size_t M>
+        auto Lookup(const CmdDesc (&table)[N], const PerfectHash<M> &index, std::string_view word) -> const CmdDesc *
+        {
+            auto slot = index.slots_[CmdHash(word, index.seed_) & (M - 1)];
+            if (slot < 0 || !NameEq(word, table[slot].name_))
+            {
+                return nullptr;
+            }
+            return &table[slot];
+        }
+    }
+}
+
+#endif
@@ -2,13 +2,19 @@
 #define CONNECT_H
 
 #include <poll.h>
+#include <algorithm>
+#include <deque>
 #include <vector>
 #include <string>
 
 #include "public.h"
 #include "file.h"
+#include "buffer.h"
 #include "list.h"
 #include "exec.h"
+#include "resp.h"
+#include "frame.h"
+#include "stats.h"
 
 namespace kath
 {
@@ -17,12 +23,33 @@ namespace kath
         friend class Server;
 
     private:
+        static constexpr size_t k_min_read_size = 4096;
+
         File file_;
         ConnState state_;
-        Bytes rbuf_, wbuf_;
+        IoBuf rbuf_;
+        OutBuf wbuf_;
+
+        // 每个请求复用的解析结果，避免重复分配
+        Cmd cmd_{};
+        // 协议在收到第一个请求时确定，之后不再变化（RESP2 / RESP3 之间可以用 HELLO 切换）
+        bool proto_known_{false};
+        frame::Parser frame_parser_{};
+        resp::Parser resp_parser_{};
+        // 协议错误时先把错误回复发出去，再关闭连接
+        bool close_after_reply_{false};
+
+        // 以 MSG_ZEROCOPY 发出、内核还没用完的 value，按 sendmsg 的序号排列
+        size_t zc_min_{0};
+        uint32_t zc_seq_{0};
+        std::deque<std::pair<uint32_t, StrPin>> zc_pins_{};
 
         uint64_t idle_start_;
         DList idle_node_;
+        // BLPOP / BRPOP 挂起时的状态
+        block::Client blocker_{};
+        // 订阅的 channel / 模式
+        pubsub::Subscriber subscriber_{};
 
     public:
         auto Check() -> void { file_.Check(); }
@@ -35,13 +62,34 @@ namespace kath
               idle_node_{}
         {
             file_.SetNb();
+            if (g_zerocopy_min && file_.SetZeroCopy())
+            {
+                zc_min_ = g_zerocopy_min;
+            }
+            blocker_.unblock_ = [](block::Client *client, const std::function<void(OutBuf &)> &reply)
+            { container_of(client, Conn, blocker_)->Unblock(reply); };
+            subscriber_.out_ = &wbuf_;
+            subscriber_.wake_ = [](pubsub::Subscriber *sub)
+            { container_of(sub, Conn, subscriber_)->Wake(); };
+        }
+        ~Conn()
+        {
+            block::g_registry.Remove(&blocker_);
+            CancelZStore(&blocker_);
+            CancelBitCount(&blocker_);
+            if (block::g_current == &blocker_)
+                block::g_current = nullptr;
+            pubsub::g_hub.Remove(&subscriber_);
+            if (pubsub::g_current == &subscriber_)
+                pubsub::g_current = nullptr;
         }
         auto GetFd() const -> int { return file_.Data(); }
 
         auto GetEvent() const -> short int
         {
+            // 挂起期间不读新的请求，只关心对端关闭，rbuf_ 不会因为对端不停地发送而增长
             if (state_ == ConnState::STATE_REQ)
-                return POLLIN;
+                return blocker_.Blocked() ? POLLRDHUP : POLLIN;
             if (state_ == ConnState::STATE_RES)
                 return POLLOUT;
             assert(false);
@@ -55,7 +103,11 @@ namespace kath
             // todo idle_node
             idle_start_ = GetMonotonicUsec();
             idle_node_.Detach();
-            head->InsertFront(&idle_node_);
+            if (blocker_.Blocked())
+                LeaveIdleList();
+            else
+                head->InsertFront(&idle_node_);
+            ReapZeroCopy();
             ConnectionIO();
         }
 
@@ -81,75 +133,229 @@ namespace kath
                 ;
         }
 
+        // 读一次数据，处理其中所有完整的请求，回复攒在wbuf_中一起写出
         auto TryFillBuffer() -> bool
         {
-            do
+            rbuf_.Reserve(k_min_read_size);
+            uint64_t read_start = stats::Cycles();
+            auto rv = file_.ReadBuf_nb(rbuf_);
+            stats::g_server.phases_.Add(stats::Phase::READ, stats::Cycles() - read_start);
+            switch (rv)
             {
-                auto rv = file_.ReadByte_nb(rbuf_, 4);
-                switch (rv)
-                {
-                case -1:
-                    Msg("nb read() error");
-                    state_ = ConnState::STATE_END;
-                    return false;
-                case 0:
-                    break;
-                case 1:
-                    return false;
-                case 2:
-                    rbuf_.Size() ? Msg("unexpected EOF") : Msg("EOF");
-                    state_ = ConnState::STATE_END;
-                    return false;
-                default:
-                    break;
-                }
-                auto len = rbuf_.GetNum<uint32_t>(4);
-                rv = file_.ReadByte_nb(rbuf_, len);
+            case 1:
+                Msg("nb read() error");
+                state_ = ConnState::STATE_END;
+                return false;
+            case 0:
+                break;
+            case -1:
+                rbuf_.Release();
+                return false;
+            case 2:
+                rbuf_.Empty() ? Msg("EOF") : Msg("unexpected EOF");
+                state_ = ConnState::STATE_END;
+                return false;
+            default:
+                break;
+            }
 
-                switch (rv)
-                {
-                case -1:
-                    Msg("nb read() error");
-                    state_ = ConnState::STATE_END;
-                    return false;
-                case 0:
-                    break;
-                case 1:
-                    return false;
-                case 2:
-                    rbuf_.Size() ? Msg("unexpected EOF") : Msg("EOF");
-                    state_ = ConnState::STATE_END;
-                    return false;
-                default:
-                    break;
-                }
-            } while (TryOneRequest());
+            while (TryOneRequest())
+                ;
+            if (state_ == ConnState::STATE_END)
+            {
+                return false;
+            }
+            if (!wbuf_.Empty())
+            {
+                state_ = ConnState::STATE_RES;
+                StateResponse();
+            }
             return state_ == ConnState::STATE_REQ;
         }
 
+        // rbuf_中有完整的一帧时处理它，帧不完整时为它预留空间并返回false
         auto TryOneRequest() -> bool
         {
-            std::vector<std::string> cmd;
-            auto ok = ParseReq(rbuf_, cmd);
-            if (!ok)
+            // 挂起期间收到的请求留在 rbuf_ 中，唤醒后再处理
+            if (blocker_.Blocked())
+                return false;
+            if (!proto_known_)
             {
-                Msg("bad req");
-                state_ = ConnState::STATE_END;
+                auto rv = resp::Detect(rbuf_.Peek(), rbuf_.Readable());
+                if (rv < 0)
+                    return false;
+                proto_known_ = true;
+                wbuf_.SetProto(rv ? Proto::RESP2 : Proto::NATIVE);
+            }
+            if (wbuf_.GetProto() == Proto::NATIVE)
+            {
+                return TryNativeRequest();
+            }
+            return TryRespRequest();
+        }
+
+        auto TryNativeRequest() -> bool
+        {
+            size_t consumed = 0;
+            auto rv = frame_parser_.Parse(rbuf_.Peek(), rbuf_.Readable(), cmd_, consumed);
+            if (rv < 0)
+            {
+                return ProtocolError(frame_parser_.Error());
+            }
+            if (rv == 0)
+            {
+                ReserveFor(frame_parser_.Need());
                 return false;
             }
+            rbuf_.Consume(consumed);
 
-            // 数据从Bytes中拷贝进cmd
-            Bytes out;
-            Interpret(cmd, out);
+            // 回复直接写进 wbuf_，长度前缀先占位，写完后回填
+            auto mark = BeginNativeReply();
+            slowlog::g_client_fd = GetFd();
+            block::g_current = &blocker_;
+            pubsub::g_current = &subscriber_;
+            subscriber_.busy_ = true;
+            Interpret(cmd_, wbuf_);
+            if (blocker_.Blocked())
+            {
+                // 回复要等唤醒时才写，先去掉占位的长度
+                wbuf_.Rollback(mark.first);
+                subscriber_.EndReply();
+                LeaveIdleList();
+                return false;
+            }
+            EndNativeReply(mark);
+            subscriber_.EndReply();
+            return true;
+        }
 
-            wbuf_.AppendNum(out.Size(), 4);
-            wbuf_.AppendBytes(std::move(out));
+        // RESP 的回复没有长度前缀；解析器会记住断点，不完整的帧下次从断点继续
+        auto TryRespRequest() -> bool
+        {
+            size_t consumed = 0;
+            auto rv = resp_parser_.Parse(rbuf_.Peek(), rbuf_.Readable(), cmd_, consumed);
+            if (rv < 0)
+            {
+                return ProtocolError(resp_parser_.Error());
+            }
+            if (rv == 0)
+            {
+                ReserveFor(resp_parser_.Need());
+                return false;
+            }
+            rbuf_.Consume(consumed);
+            if (!cmd_.empty())
+            {
+                slowlog::g_client_fd = GetFd();
+                block::g_current = &blocker_;
+                pubsub::g_current = &subscriber_;
+                subscriber_.busy_ = true;
+                Interpret(cmd_, wbuf_);
+                subscriber_.EndReply();
+            }
+            if (blocker_.Blocked())
+            {
+                LeaveIdleList();
+                return false;
+            }
+            return true;
+        }
 
-            state_ = ConnState::STATE_RES;
+        // 挂起的连接不受空闲超时的限制
+        auto LeaveIdleList() -> void
+        {
+            idle_node_.Detach();
+            idle_node_.prev_ = idle_node_.next_ = &idle_node_;
+        }
 
-            StateResponse();
+        // 写入唤醒时的回复；唤醒发生在别的连接的命令中，后面的请求等事件循环调用 Resume 时再处理
+        auto Unblock(const std::function<void(OutBuf &)> &reply) -> void
+        {
+            if (wbuf_.GetProto() == Proto::NATIVE)
+            {
+                auto mark = BeginNativeReply();
+                reply(wbuf_);
+                EndNativeReply(mark);
+            }
+            else
+            {
+                reply(wbuf_);
+            }
+            block::g_registry.Wake(&blocker_);
+            Wake();
+        }
 
-            return state_ == ConnState::STATE_REQ;
+        // 处理挂起期间留在 rbuf_ 中的请求，回复和唤醒时的回复一起写出
+        auto Resume() -> void
+        {
+            while (TryOneRequest())
+                ;
+            if (state_ != ConnState::STATE_END && !wbuf_.Empty())
+            {
+                state_ = ConnState::STATE_RES;
+                StateResponse();
+            }
+        }
+
+        // 回复队列有了新数据，下一轮事件循环等待可写
+        auto Wake() -> void
+        {
+            if (state_ == ConnState::STATE_REQ)
+                state_ = ConnState::STATE_RES;
+        }
+
+        // 帧不完整时为它预留空间，长度已经在解析器中检查过
+        // 帧长度由客户端给出，一次最多预留 k_max_reserve，剩下的随数据到达按倍数增长
+        auto ReserveFor(size_t need) -> void
+        {
+            if (need > rbuf_.Readable())
+            {
+                rbuf_.Reserve(std::min(need - rbuf_.Readable(), frame::k_max_reserve));
+            }
+        }
+
+        auto BeginNativeReply() -> std::pair<uint64_t, uint64_t>
+        {
+            std::pair<uint64_t, uint64_t> mark{wbuf_.Mark(), wbuf_.Total()};
+            wbuf_.AppendNum<uint32_t>(0, 4);
+            return mark;
+        }
+        auto EndNativeReply(std::pair<uint64_t, uint64_t> mark) -> void
+        {
+            auto out_len = static_cast<uint32_t>(wbuf_.Total() - mark.second - 4);
+            wbuf_.Cover(mark.first, &out_len, 4);
+        }
+
+        // 回复错误原因后关闭连接，之后的数据不再读取
+        auto ProtocolError(const char *err) -> bool
+        {
+            Msg(err);
+            if (wbuf_.GetProto() == Proto::NATIVE)
+            {
+                auto mark = BeginNativeReply();
+                OutErr(wbuf_, CmdErr::ERR_ARG, std::string("protocol error: ") + err);
+                EndNativeReply(mark);
+            }
+            else
+            {
+                resp::WriteErr(wbuf_, "ERR", std::string("Protocol error: ") + err);
+            }
+            close_after_reply_ = true;
+            return false;
+        }
+
+        // 内核发送完成后才能释放零拷贝发出的 value
+        auto ReapZeroCopy() -> void
+        {
+            uint32_t hi = 0;
+            bool done = false;
+            while (!zc_pins_.empty() && file_.ReadZeroCopyDone(hi, done))
+            {
+                while (done && !zc_pins_.empty() && static_cast<int32_t>(zc_pins_.front().first - hi) <= 0)
+                {
+                    zc_pins_.pop_front();
+                }
+            }
         }
 
         auto StateResponse() -> void
@@ -160,28 +366,42 @@ namespace kath
 
         auto TryFlushBuffer() -> bool
         {
-            auto rv = file_.WriteByte_nb(wbuf_);
+            auto pin = wbuf_.FrontPin();
+            bool zerocopy = false;
+            uint64_t write_start = stats::Cycles();
+            auto rv = file_.WriteOut_nb(wbuf_, zc_min_, zerocopy);
+            stats::g_server.phases_.Add(stats::Phase::WRITE, stats::Cycles() - write_start);
+            if (rv == 0 && zerocopy)
+            {
+                zc_pins_.emplace_back(zc_seq_++, std::move(pin));
+            }
             switch (rv)
             {
-            case -1:
+            case 1:
                 Msg("nb write() error");
                 state_ = ConnState::STATE_END;
                 return false;
             case 0:
                 break;
-            case 1:
+            case -1:
                 return false;
 
             default:
                 break;
             }
-            if (wbuf_.IsReadEnd())
+            if (wbuf_.Empty())
             {
+                if (close_after_reply_)
+                {
+                    state_ = ConnState::STATE_END;
+                    return false;
+                }
                 state_ = ConnState::STATE_REQ;
-                rbuf_.Clear();
-                wbuf_.Clear();
+                wbuf_.Release();
+                rbuf_.Release();
                 return false;
             }
+            return true;
         }
     };
 }
@@ -1,11 +1,35 @@
 #ifndef EXEC_H
 #define EXEC_H
 
+#include <unistd.h>
+#include <cmath>
+#include <cstdarg>
+#include <deque>
+#include <list>
+#include <variant>
+
 #include "public.h"
 #include "bytes.h"
+#include "buffer.h"
 #include "hashtable.h"
 #include "zset.h"
 #include "heap.h"
+#include "cluster.h"
+#include "command.h"
+#include "resp.h"
+#include "stats.h"
+#include "slowlog.h"
+#include "latency.h"
+#include "lfu.h"
+#include "zstore.h"
+#include "hashobj.h"
+#include "setobj.h"
+#include "bitops.h"
+#include "hyperloglog.h"
+#include "quicklist.h"
+#include "blocking.h"
+#include "pubsub.h"
+#include "stream.h"
 // 序列化 serialization
 inline auto str2dbl(const std::string &str, double &out) -> bool
 {
@@ -21,48 +45,141 @@ static auto str2int(const std::string &str, int64_t &out) -> bool
 }
 namespace kath
 {
-    using Cmd = std::vector<std::string>;
-    auto OutNil(Bytes &out) -> void
+    // 回复按连接的协议编码，RESP 的编码见 resp.h
+    auto OutNil(OutBuf &out) -> void
     {
+        if (out.GetProto() != Proto::NATIVE)
+            return resp::WriteNil(out);
         out.AppendNum(static_cast<uint8_t>(SerType::NIL), 1);
     }
 
-    auto OutStr(Bytes &out, const std::string &str) -> void
+    auto OutStr(OutBuf &out, const std::string &str) -> void
     {
+        if (out.GetProto() != Proto::NATIVE)
+            return resp::WriteBulk(out, str);
         out.AppendNum(static_cast<uint8_t>(SerType::STR), 1);
         out.AppendNum<size_t>(str.size(), 4);
         out.AppendStr(str);
     }
 
-    auto OutInt(Bytes &out, int64_t val) -> void
+    // 与 OutStr 相同，用于直接引用容器内部的数据，不需要先构造 string
+    auto OutStrView(OutBuf &out, std::string_view str) -> void
+    {
+        if (out.GetProto() != Proto::NATIVE)
+            return resp::WriteBulk(out, str);
+        out.AppendNum(static_cast<uint8_t>(SerType::STR), 1);
+        out.AppendNum<size_t>(str.size(), 4);
+        out.AppendStrView(str);
+    }
+
+    // 表示成功的简单回复，RESP 下为 +OK 这类状态行，原生协议沿用原来的 NIL / STR
+    auto OutOk(OutBuf &out) -> void
+    {
+        if (out.GetProto() != Proto::NATIVE)
+            return resp::WriteStatus(out, "OK");
+        out.AppendNum(static_cast<uint8_t>(SerType::NIL), 1);
+    }
+    auto OutStatus(OutBuf &out, const std::string &str) -> void
+    {
+        if (out.GetProto() != Proto::NATIVE)
+            return resp::WriteStatus(out, str);
+        OutStr(out, str);
+    }
+
+    auto OutInt(OutBuf &out, int64_t val) -> void
     {
+        if (out.GetProto() != Proto::NATIVE)
+            return resp::WriteInt(out, val);
         out.AppendNum(static_cast<uint8_t>(SerType::INT64), 1);
         out.AppendNum(val, 8);
     }
 
-    auto OutErr(Bytes &out, CmdErr code, const std::string &msg)
+    // RESP 的错误以类型前缀开头，MOVED / CLUSTERDOWN / CROSSSLOT 的 msg 本身就带着前缀
+    auto OutErr(OutBuf &out, CmdErr code, const std::string &msg)
     {
+        if (out.GetProto() != Proto::NATIVE)
+        {
+            std::string_view prefix = "ERR";
+            if (code == CmdErr::ERR_MOVED || code == CmdErr::ERR_CLUSTERDOWN || code == CmdErr::ERR_CROSSSLOT)
+                prefix = "";
+            else if (code == CmdErr::ERR_TYPE)
+                prefix = "WRONGTYPE";
+            return resp::WriteErr(out, prefix, msg);
+        }
         out.AppendNum(static_cast<uint8_t>(SerType::ERR), 1);
         out.AppendNum(static_cast<uint32_t>(code), 4);
         out.AppendNum(msg.size(), 4);
         out.AppendStr(msg);
     }
 
-    auto OutDouble(Bytes &out, double val) -> void
+    auto OutCrossSlot(OutBuf &out) -> void
+    {
+        OutErr(out, CmdErr::ERR_CROSSSLOT, "CROSSSLOT Keys in request don't hash to the same slot");
+    }
+
+    auto OutDouble(OutBuf &out, double val) -> void
     {
+        if (out.GetProto() != Proto::NATIVE)
+            return resp::WriteDouble(out, val);
         out.AppendNum(static_cast<uint8_t>(SerType::DOU), 1);
         out.AppendNum(val, 8);
     }
-    auto OutArr(Bytes &out, uint32_t n) -> void
+    auto OutArr(OutBuf &out, uint32_t n) -> void
     {
+        if (out.GetProto() != Proto::NATIVE)
+            return resp::WriteArr(out, n);
         out.AppendNum(static_cast<uint8_t>(SerType::ARR), 1);
         out.AppendNum(n, 4);
     }
-    auto OutUpdateArr(Bytes &out, uint32_t n) -> void
+    // n 个键值对，RESP3 为 map，其余协议为 2n 个元素的数组
+    auto OutMap(OutBuf &out, uint32_t n) -> void
+    {
+        if (out.GetProto() != Proto::NATIVE)
+            return resp::WriteMap(out, n);
+        OutArr(out, n * 2);
+    }
+
+    // 服务器主动推送的数组，RESP3 为 push 类型
+    auto OutPush(OutBuf &out, uint32_t n) -> void
+    {
+        if (out.GetProto() != Proto::NATIVE)
+            return resp::WritePush(out, n);
+        OutArr(out, n);
+    }
+
+    // 元素个数事先不知道时，先占位，写完元素后再用 OutEndArr 回填
+    // 原生协议的个数是定长的，直接覆盖；RESP 的数组头是变长的，占一个延后填写的引用
+    struct ArrMark
+    {
+        uint64_t mark_{0};
+        std::shared_ptr<std::string> header_{};
+    };
+    auto OutBeginArr(OutBuf &out) -> ArrMark
+    {
+        ArrMark arr{out.Mark(), nullptr};
+        if (out.GetProto() != Proto::NATIVE)
+        {
+            arr.header_ = std::make_shared<std::string>();
+            out.AppendDeferred(arr.header_);
+            return arr;
+        }
+        OutArr(out, 0);
+        return arr;
+    }
+    auto OutEndArr(OutBuf &out, const ArrMark &arr, uint32_t n) -> void
     {
-        auto type = static_cast<SerType>(out.GetNum<int>(1));
-        assert(type == SerType::ARR);
-        out.CoverNum(n, 1, 4);
+        if (arr.header_ != nullptr)
+            return out.FillDeferred(arr.header_, resp::ArrHeader(n));
+        out.Cover(arr.mark_ + 1, &n, 4);
+    }
+    // value 以引用的方式放进回复，写出前一直持有它
+    auto OutStrRef(OutBuf &out, StrPin str) -> void
+    {
+        if (out.GetProto() != Proto::NATIVE)
+            return resp::WriteBulkRef(out, std::move(str));
+        out.AppendNum(static_cast<uint8_t>(SerType::STR), 1);
+        out.AppendNum<size_t>(str->size(), 4);
+        out.AppendRef(std::move(str));
     }
 
     namespace core
@@ -82,29 +199,114 @@ namespace kath
             CmdErr code_;
             std::string msg_;
         };
+        HMap m_map{};
+        Heap m_heap{};
+
         enum class EntryType
         {
             T_STR = 1,
             T_ZSET = 2,
+            T_HASH = 3,
+            T_SET = 4,
+            T_HLL = 5,
+            T_LIST = 6,
+            T_STREAM = 7,
+        };
+        // value 用引用计数保存，回复中引用它时不需要拷贝；
+        // 修改时如果还被回复引用着，就换成一份新的（写时复制）
+        using StrPtr = std::shared_ptr<std::string>;
+
+        // 每种对象对应的 EntryType，以及类型不符时的报错
+        template <typename T>
+        struct ObjTraits;
+        template <>
+        struct ObjTraits<ZSet>
+        {
+            static constexpr EntryType k_type = EntryType::T_ZSET;
+            static constexpr const char *k_expect = "expect zset";
+        };
+        template <>
+        struct ObjTraits<HashObj>
+        {
+            static constexpr EntryType k_type = EntryType::T_HASH;
+            static constexpr const char *k_expect = "expect hash";
+        };
+        template <>
+        struct ObjTraits<SetObj>
+        {
+            static constexpr EntryType k_type = EntryType::T_SET;
+            static constexpr const char *k_expect = "expect set";
+        };
+        template <>
+        struct ObjTraits<HyperLogLog>
+        {
+            static constexpr EntryType k_type = EntryType::T_HLL;
+            static constexpr const char *k_expect = "expect hyperloglog";
+        };
+        template <>
+        struct ObjTraits<QuickList>
+        {
+            static constexpr EntryType k_type = EntryType::T_LIST;
+            static constexpr const char *k_expect = "expect list";
+        };
+        template <>
+        struct ObjTraits<Stream>
+        {
+            static constexpr EntryType k_type = EntryType::T_STREAM;
+            static constexpr const char *k_expect = "expect stream";
         };
+
         struct Entry : public HNode
         {
             EntryType type_;
+            // 访问频率，见 lfu.h
+            uint8_t lfu_{lfu::k_init};
+            uint16_t lfu_time_{lfu::g_clock_min};
             std::string key_;
-            std::string val_;
-            std::shared_ptr<ZSet> zset_;
+            StrPtr val_;
+            // string 以外的 value，按 type_ 存放其中一种，用 As<T>() 取出
+            std::variant<std::monostate, std::shared_ptr<ZSet>, std::shared_ptr<HashObj>, std::shared_ptr<SetObj>,
+                         std::shared_ptr<HyperLogLog>, std::shared_ptr<QuickList>, std::shared_ptr<Stream>>
+                obj_{};
             size_t heap_index_;
             Entry() = default;
             ~Entry() { SetTTL(-1); };
             Entry(const std::string &key)
-                : HNode(string_hash(key)), type_(EntryType::T_STR), key_(key), zset_{nullptr}, heap_index_(0)
+                : HNode(string_hash(key)), type_(EntryType::T_STR), key_(key), heap_index_(0)
             {
             }
-            Entry(const std::string &key, const std::string &value)
+            Entry(const std::string &key, std::string value)
                 : HNode(string_hash(key)), type_(EntryType::T_STR),
-                  key_(key), val_(value), zset_{nullptr}, heap_index_(0)
+                  key_(key), val_(std::make_shared<std::string>(std::move(value))), heap_index_(0)
             {
             }
+            Entry(const std::string &key, std::string value, size_t hcode)
+                : HNode(hcode), type_(EntryType::T_STR),
+                  key_(key), val_(std::make_shared<std::string>(std::move(value))), heap_index_(0)
+            {
+            }
+            [[nodiscard]] auto KeyView() const -> std::string_view override { return key_; }
+            // type_ 必须与 T 对应
+            template <typename T>
+            auto As() -> std::shared_ptr<T> &
+            {
+                return std::get<std::shared_ptr<T>>(obj_);
+            }
+            template <typename T>
+            auto Reset(std::shared_ptr<T> obj) -> void
+            {
+                type_ = ObjTraits<T>::k_type;
+                obj_ = std::move(obj);
+            }
+            // 就地修改 value 之前调用，保证不会改到正在发送的数据
+            auto MutableVal() -> std::string &
+            {
+                if (val_.use_count() > 1)
+                {
+                    val_ = std::make_shared<std::string>(*val_);
+                }
+                return *val_;
+            }
             auto SetTTL(int64_t ttl_ms) -> void
             {
                 if (ttl_ms < 0 && heap_index_ != 0)
@@ -127,38 +329,51 @@ namespace kath
             }
         };
 
-        HMap m_map{};
-        Heap m_heap{};
         using EntryPtr = std::shared_ptr<Entry>;
+
+        // 计数器最大的 key，HOTKEYS 从这里读
+        inline lfu::TopK g_hot{};
+
+        // 每次命中 key 时调用
+        inline auto Touch(Entry &ent) -> void
+        {
+            lfu::Access(ent.lfu_, ent.lfu_time_);
+            if (ent.lfu_ > g_hot.Floor())
+            {
+                g_hot.Offer(ent.key_, ent.hcode_, ent.lfu_);
+            }
+        }
+
         NodeCmp EntryEq = [](HNodePtr lhs, HNodePtr rhs) -> bool
         {
             auto le = dyn_cast<Entry, HNode>(lhs);
             auto re = dyn_cast<Entry, HNode>(rhs);
             return lhs->hcode_ == rhs->hcode_ && le->key_ == re->key_;
         };
-        auto Scan(Bytes &buf) -> void
+        auto Scan(OutBuf &buf) -> void
         {
             NodeScan node_scan = [](HNodePtr node, void *arg)
             {
-                Bytes &buf = *(Bytes *)arg;
+                OutBuf &buf = *(OutBuf *)arg;
                 OutStr(buf, dyn_cast<Entry, HNode>(node)->key_);
             };
             m_map.Scan(node_scan, &buf);
         }
-        auto Get(const std::string &key) -> std::optional<std::string>
+        auto Get(const std::string &key) -> StrPtr
         {
             HNodePtr node = std::make_shared<Entry>(key);
             HNodePtr target = m_map.Lookup(node, EntryEq);
             if (!target)
-                return {};
+                return nullptr;
             std::shared_ptr<Entry> entry = dyn_cast<Entry, HNode>(target);
             if (entry->type_ != EntryType::T_STR)
             {
                 throw CoreException(CmdErr::ERR_TYPE, "expect string");
             }
-            return std::make_optional<std::string>(entry->val_);
+            Touch(*entry);
+            return entry->val_;
         }
-        auto Set(const std::string &key, const std::string &value) -> void
+        auto Set(const std::string &key, std::string value) -> void
         {
             HNodePtr tmp_entry = std::make_shared<Entry>(key);
             HNodePtr target_node = m_map.Lookup(tmp_entry, EntryEq);
@@ -169,11 +384,16 @@ namespace kath
                 {
                     throw CoreException(CmdErr::ERR_TYPE, "except string");
                 }
-                target_entry->val_ = value;
+                Touch(*target_entry);
+                // 整个替换，不需要 MutableVal 的写时复制：旧 value 还被回复引用时直接换一个新的
+                if (target_entry->val_.use_count() == 1)
+                    *target_entry->val_ = std::move(value);
+                else
+                    target_entry->val_ = std::make_shared<std::string>(std::move(value));
             }
             else
             {
-                HNodePtr new_entry = std::make_shared<Entry>(key, value);
+                HNodePtr new_entry = std::make_shared<Entry>(key, std::move(value));
                 m_map.Insert(new_entry);
             }
         }
@@ -196,34 +416,184 @@ namespace kath
                 return nullptr;
 
             EntryPtr ent = dyn_cast<Entry, HNode>(hnode);
-            if (ent->type_ == EntryType::T_STR)
+            if (ent->type_ != EntryType::T_ZSET)
                 return nullptr;
+            Touch(*ent);
+            return ent;
+        }
+        // 修改 zset 之前调用：异步的 ZUNIONSTORE / ZINTERSTORE 还在读它时先拷贝一份
+        auto MutableZSet(Entry &ent) -> ZSet &
+        {
+            auto &zset = ent.As<ZSet>();
+            if (zset.use_count() > 1)
+                zset = zset->Clone();
+            return *zset;
+        }
+
+        // key 不存在时，create 为 true 则新建一个空串，否则返回 nullptr
+        auto GetStrEntry(const std::string &key, bool create) -> EntryPtr
+        {
+            EntryPtr probe = std::make_shared<Entry>(key);
+            HNodePtr hnode = m_map.Lookup(probe, EntryEq);
+            if (hnode == nullptr)
+            {
+                if (!create)
+                    return nullptr;
+                probe->val_ = std::make_shared<std::string>();
+                m_map.Insert(probe);
+                return probe;
+            }
+            EntryPtr ent = dyn_cast<Entry, HNode>(hnode);
+            if (ent->type_ != EntryType::T_STR)
+            {
+                throw CoreException(CmdErr::ERR_TYPE, "expect string");
+            }
+            Touch(*ent);
             return ent;
         }
 
+        // key 不存在时，create 为 true 则新建一个空的对象，否则返回 nullptr；key 是别的类型时抛出 ERR_TYPE
+        // 对象变空后是否删除 key 由命令决定，stream 变空后 key 仍然保留
+        template <typename T>
+        auto GetObj(const std::string &key, bool create) -> std::shared_ptr<T>
+        {
+            EntryPtr probe = std::make_shared<Entry>(key);
+            HNodePtr hnode = m_map.Lookup(probe, EntryEq);
+            if (hnode == nullptr)
+            {
+                if (!create)
+                    return nullptr;
+                probe->Reset(std::make_shared<T>());
+                m_map.Insert(probe);
+                return probe->As<T>();
+            }
+            EntryPtr ent = dyn_cast<Entry, HNode>(hnode);
+            if (ent->type_ != ObjTraits<T>::k_type)
+            {
+                throw CoreException(CmdErr::ERR_TYPE, ObjTraits<T>::k_expect);
+            }
+            Touch(*ent);
+            return ent->As<T>();
+        }
+
+        // BIGKEYS 的后台扫描：事件循环每轮推进 k_step_buckets 个桶，不会长时间占住循环
+        // 分别记录字节数最大的 string、成员最多的 zset / set / list、条目最多的 stream 和 field 最多的 hash
+        class BigKeys
+        {
+        public:
+            struct Item
+            {
+                std::string key_;
+                size_t size_;
+            };
+            enum class State
+            {
+                IDLE,
+                RUNNING,
+                DONE,
+            };
+
+        private:
+            static constexpr size_t k_step_buckets = 1024;
+            State state_{State::IDLE};
+            size_t cursor_{0};
+            uint64_t scanned_{0};
+            size_t top_{10};
+            std::vector<Item> strs_{};
+            std::vector<Item> zsets_{};
+            std::vector<Item> hashes_{};
+            std::vector<Item> sets_{};
+            std::vector<Item> lists_{};
+            std::vector<Item> streams_{};
+
+            // items 按 size_ 从大到小排列，最多 top_ 个
+            auto Keep(std::vector<Item> &items, const std::string &key, size_t size) -> void
+            {
+                if (items.size() == top_ && (top_ == 0 || items.back().size_ >= size))
+                    return;
+                auto pos = std::upper_bound(items.begin(), items.end(), size, [](size_t val, const Item &item)
+                                            { return val > item.size_; });
+                items.insert(pos, {key, size});
+                if (items.size() > top_)
+                    items.pop_back();
+            }
+
+        public:
+            auto Start(size_t top) -> void
+            {
+                state_ = State::RUNNING;
+                cursor_ = 0;
+                scanned_ = 0;
+                top_ = top;
+                strs_.clear();
+                zsets_.clear();
+                hashes_.clear();
+                sets_.clear();
+                lists_.clear();
+                streams_.clear();
+            }
+            [[nodiscard]] auto GetState() const -> State { return state_; }
+            [[nodiscard]] auto Running() const -> bool { return state_ == State::RUNNING; }
+            [[nodiscard]] auto Scanned() const -> uint64_t { return scanned_; }
+            [[nodiscard]] auto Strings() const -> const std::vector<Item> & { return strs_; }
+            [[nodiscard]] auto ZSets() const -> const std::vector<Item> & { return zsets_; }
+            [[nodiscard]] auto Hashes() const -> const std::vector<Item> & { return hashes_; }
+            [[nodiscard]] auto Sets() const -> const std::vector<Item> & { return sets_; }
+            [[nodiscard]] auto Lists() const -> const std::vector<Item> & { return lists_; }
+            [[nodiscard]] auto Streams() const -> const std::vector<Item> & { return streams_; }
+
+            auto Step() -> void
+            {
+                NodeScan node_scan = [](HNodePtr node, void *arg)
+                {
+                    auto &self = *static_cast<BigKeys *>(arg);
+                    auto ent = dyn_cast<Entry, HNode>(node);
+                    self.scanned_++;
+                    if (ent->type_ == EntryType::T_ZSET)
+                        self.Keep(self.zsets_, ent->key_, ent->As<ZSet>()->Size());
+                    else if (ent->type_ == EntryType::T_HASH)
+                        self.Keep(self.hashes_, ent->key_, ent->As<HashObj>()->Size());
+                    else if (ent->type_ == EntryType::T_SET)
+                        self.Keep(self.sets_, ent->key_, ent->As<SetObj>()->Size());
+                    else if (ent->type_ == EntryType::T_LIST)
+                        self.Keep(self.lists_, ent->key_, ent->As<QuickList>()->Size());
+                    else if (ent->type_ == EntryType::T_STREAM)
+                        self.Keep(self.streams_, ent->key_, ent->As<Stream>()->Length());
+                    else if (ent->val_ != nullptr)
+                        self.Keep(self.strs_, ent->key_, ent->val_->size());
+                };
+                if (!m_map.ScanStep(cursor_, k_step_buckets, node_scan, this))
+                {
+                    state_ = State::DONE;
+                }
+            }
+        };
+        inline BigKeys g_bigkeys{};
+
     } // namespace core
+    // cmd 必须是小写
     auto CmdEq(const std::string_view word, const std::string_view cmd) -> bool
     {
-        return word == cmd;
+        return cmd::NameEq(word, cmd);
     }
 
-    auto DoKeys(const Cmd &cmd, Bytes &out) -> void
+    auto DoKeys(Cmd &cmd, OutBuf &out) -> void
     {
         OutArr(out, core::m_map.Size());
         core::Scan(out);
     }
-    auto DoDel(const Cmd &cmd, Bytes &out) -> void
+    auto DoDel(Cmd &cmd, OutBuf &out) -> void
     {
         OutInt(out, core::Del(cmd[1]));
     }
-    auto DoGet(const Cmd &cmd, Bytes &out) -> void
+    auto DoGet(Cmd &cmd, OutBuf &out) -> void
     {
         try
         {
             auto res = core::Get(cmd[1]);
-            if (res.has_value())
+            if (res != nullptr)
             {
-                OutStr(out, res.value());
+                OutStrRef(out, std::move(res));
             }
             else
             {
@@ -237,12 +607,12 @@ namespace kath
             OutErr(out, code, msg);
         }
     }
-    auto DoSet(const Cmd &cmd, Bytes &out) -> void
+    auto DoSet(Cmd &cmd, OutBuf &out) -> void
     {
         try
         {
-            core::Set(cmd[1], cmd[2]);
-            OutNil(out);
+            core::Set(cmd[1], std::move(cmd[2]));
+            OutOk(out);
         }
         catch (const core::CoreException &err)
         {
@@ -251,22 +621,7 @@ namespace kath
             OutErr(out, code, msg);
         }
     }
-    auto ParseReq(Bytes &data, std::vector<std::string> &cmd) -> bool
-    {
-        if (data.IsReadEnd())
-            return false;
-
-        auto cmd_num = data.GetNum<size_t>(4);
-
-        while (cmd_num--)
-        {
-            auto cmd_len = data.GetNum<size_t>(4);
-            cmd.emplace_back(data.GetStrView(cmd_len));
-        }
-
-        return true;
-    }
-    auto DoZAdd(Cmd &cmd, Bytes &out) -> void
+    auto DoZAdd(Cmd &cmd, OutBuf &out) -> void
     {
         double score = 0;
         if (!str2dbl(cmd[2], score))
@@ -280,8 +635,7 @@ namespace kath
         if (hnode == nullptr)
         {
             ent = std::make_shared<core::Entry>(std::move(key->key_), "", key->hcode_);
-            ent->type_ = core::EntryType::T_ZSET;
-            ent->zset_ = std::make_shared<ZSet>();
+            ent->Reset(std::make_shared<ZSet>());
             core::m_map.Insert(ent);
         }
         else
@@ -291,12 +645,13 @@ namespace kath
             {
                 return OutErr(out, CmdErr::ERR_TYPE, "expect zset");
             }
+            core::Touch(*ent);
         }
         const std::string &name = cmd[3];
-        auto ok = ent->zset_->Add(name, score);
+        auto ok = core::MutableZSet(*ent).Add(name, score);
         OutInt(out, static_cast<int64_t>(ok));
     }
-    auto DoZRem(Cmd &cmd, Bytes &out) -> void
+    auto DoZRem(Cmd &cmd, OutBuf &out) -> void
     {
         core::EntryPtr ent = core::GetZsetEntry(cmd[1]);
         if (!ent)
@@ -305,10 +660,10 @@ namespace kath
             return;
         }
         const std::string &name = cmd[2];
-        auto ok = ent->zset_->Pop(name);
+        auto ok = core::MutableZSet(*ent).Pop(name);
         OutInt(out, (int64_t)ok);
     }
-    auto DoZScore(Cmd &cmd, Bytes &out) -> void
+    auto DoZScore(Cmd &cmd, OutBuf &out) -> void
     {
         core::EntryPtr entry_ptr = core::GetZsetEntry(cmd[1]);
         if (!entry_ptr)
@@ -317,7 +672,7 @@ namespace kath
             return;
         }
         const std::string &name = cmd[2];
-        auto res = entry_ptr->zset_->Find(name);
+        auto res = entry_ptr->As<ZSet>()->Find(name);
         if (res.has_value())
         {
             OutDouble(out, res.value());
@@ -327,7 +682,7 @@ namespace kath
             OutNil(out);
         }
     }
-    auto DoZQuery(const Cmd &cmd, Bytes &out) -> void
+    auto DoZQuery(Cmd &cmd, OutBuf &out) -> void
     {
         double score = 0;
         if (!str2dbl(cmd[2], score))
@@ -352,52 +707,1980 @@ namespace kath
         }
         if(limit &1) limit++;
         limit >>=1;
-        auto ite = ent_ptr->zset_->Query(name,score,offset,limit);
+        auto ite = ent_ptr->As<ZSet>()->Query(name,score,offset,limit);
 
         uint32_t n =0;
-        Bytes buff;
+        auto arr = OutBeginArr(out);
         for (auto sam :ite) {
-            OutStr(buff,sam.name_);
-            OutDouble(buff,sam.score_);
+            OutStr(out,sam.name_);
+            OutDouble(out,sam.score_);
             n+=2;
         }
-        OutArr(out,n);
-        out.AppendBytes(std::move(buff));
+        OutEndArr(out,arr,n);
+    }
+    // 分数区间的端点：以 "(" 开头为开区间，-inf / +inf 表示无界
+    auto ParseScoreBound(const std::string &str, double &score, bool &exclusive) -> bool
+    {
+        exclusive = !str.empty() && str[0] == '(';
+        return str2dbl(exclusive ? str.substr(1) : str, score);
+    }
+
+    auto ZRankReply(Cmd &cmd, OutBuf &out, bool rev) -> void
+    {
+        core::EntryPtr ent = core::GetZsetEntry(cmd[1]);
+        if (!ent)
+        {
+            return OutNil(out);
+        }
+        auto rank = ent->As<ZSet>()->Rank(cmd[2]);
+        if (!rank.has_value())
+        {
+            return OutNil(out);
+        }
+        OutInt(out, rev ? static_cast<int64_t>(ent->As<ZSet>()->Size()) - 1 - rank.value() : rank.value());
+    }
+    // ZRANK key member，按 score 从小到大的排名，从 0 开始
+    auto DoZRank(Cmd &cmd, OutBuf &out) -> void
+    {
+        ZRankReply(cmd, out, false);
+    }
+    // ZREVRANK key member，按 score 从大到小的排名
+    auto DoZRevRank(Cmd &cmd, OutBuf &out) -> void
+    {
+        ZRankReply(cmd, out, true);
+    }
+
+    // ZRANGE key start stop [WITHSCORES]，start / stop 为排名，负数从末尾数，两端都包含
+    auto DoZRange(Cmd &cmd, OutBuf &out) -> void
+    {
+        int64_t start = 0;
+        int64_t stop = 0;
+        if (!str2int(cmd[2], start) || !str2int(cmd[3], stop))
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "expect int");
+        }
+        bool with_scores = cmd.size() == 5 && CmdEq(cmd[4], "withscores");
+        if (cmd.size() > 5 || (cmd.size() == 5 && !with_scores))
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "syntax error");
+        }
+        core::EntryPtr ent = core::GetZsetEntry(cmd[1]);
+        auto size = ent ? static_cast<int64_t>(ent->As<ZSet>()->Size()) : 0;
+        if (start < 0)
+            start += size;
+        if (stop < 0)
+            stop += size;
+        start = std::max<int64_t>(start, 0);
+        stop = std::min(stop, size - 1);
+        if (start > stop)
+        {
+            return OutArr(out, 0);
+        }
+        auto len = stop - start + 1;
+        OutArr(out, static_cast<uint32_t>(with_scores ? len * 2 : len));
+        for (auto &node : ZNodeCollection(ent->As<ZSet>()->At(start), len))
+        {
+            OutStr(out, node.name_);
+            if (with_scores)
+                OutDouble(out, node.score_);
+        }
+    }
+
+    // ZREVRANGEBYSCORE key max min [WITHSCORES] [LIMIT offset count]
+    // 先用两次查找算出区间两端的排名，再从 max 一端往前走，O(log n + 返回的个数)
+    auto DoZRevRangeByScore(Cmd &cmd, OutBuf &out) -> void
+    {
+        double max = 0;
+        double min = 0;
+        bool max_ex = false;
+        bool min_ex = false;
+        if (!ParseScoreBound(cmd[2], max, max_ex) || !ParseScoreBound(cmd[3], min, min_ex))
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "min or max is not a float");
+        }
+        bool with_scores = false;
+        int64_t offset = 0;
+        int64_t count = -1;
+        for (size_t index = 4; index < cmd.size(); index++)
+        {
+            if (CmdEq(cmd[index], "withscores"))
+            {
+                with_scores = true;
+            }
+            else if (CmdEq(cmd[index], "limit") && index + 2 < cmd.size())
+            {
+                if (!str2int(cmd[index + 1], offset) || !str2int(cmd[index + 2], count))
+                {
+                    return OutErr(out, CmdErr::ERR_ARG, "expect int");
+                }
+                index += 2;
+            }
+            else
+            {
+                return OutErr(out, CmdErr::ERR_ARG, "syntax error");
+            }
+        }
+        core::EntryPtr ent = core::GetZsetEntry(cmd[1]);
+        if (!ent || offset < 0)
+        {
+            return OutArr(out, 0);
+        }
+        auto &zset = *ent->As<ZSet>();
+        int64_t high = zset.CountBelow(max, !max_ex) - 1; // 最后一个不超过 max 的成员
+        int64_t low = zset.CountBelow(min, min_ex);       // 第一个不低于 min 的成员
+        int64_t len = high - low + 1 - offset;
+        if (count >= 0)
+            len = std::min(len, count);
+        if (len <= 0)
+        {
+            return OutArr(out, 0);
+        }
+        OutArr(out, static_cast<uint32_t>(with_scores ? len * 2 : len));
+        avl::AVLNodePtr cur = zset.At(high - offset);
+        for (int64_t index = 0; index < len && cur != nullptr; index++)
+        {
+            auto node = dyn_cast<ZNode, avl::AVLNode>(cur);
+            OutStr(out, node->name_);
+            if (with_scores)
+                OutDouble(out, node->score_);
+            cur = avl::AVLOperate::Offset(cur, -1);
+        }
+    }
+
+    // ZCOUNT key min max，区间两端各一次从根往下的查找
+    auto DoZCount(Cmd &cmd, OutBuf &out) -> void
+    {
+        double min = 0;
+        double max = 0;
+        bool min_ex = false;
+        bool max_ex = false;
+        if (!ParseScoreBound(cmd[2], min, min_ex) || !ParseScoreBound(cmd[3], max, max_ex))
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "min or max is not a float");
+        }
+        core::EntryPtr ent = core::GetZsetEntry(cmd[1]);
+        if (!ent)
+        {
+            return OutInt(out, 0);
+        }
+        int64_t count = ent->As<ZSet>()->CountBelow(max, !max_ex) - ent->As<ZSet>()->CountBelow(min, min_ex);
+        OutInt(out, std::max<int64_t>(count, 0));
+    }
+
+    // ZUNIONSTORE / ZINTERSTORE 需要分片合并时不在命令中等待：连接挂起，任务放进 g_zstore_jobs，
+    // 由事件循环调用 FinishZStoreJobs 写入结果并回复
+    struct ZStoreJob
+    {
+        Cmd cmd_;
+        bool inter_;
+        std::vector<std::shared_ptr<ZSet>> sources_; // 与输入的 key 一一对应，不存在的 key 为 nullptr
+        std::unique_ptr<zstore::AsyncMerge> merge_;
+        block::Client *client_; // 连接已经关闭时为 nullptr
+    };
+    inline std::deque<ZStoreJob> g_zstore_jobs{};
+
+    // 结果写入 dest，返回成员数；结果为空时删除 dest
+    auto StoreZSet(const std::string &dest, zstore::Result &&res) -> int64_t
+    {
+        core::Del(dest);
+        auto size = static_cast<int64_t>(res.size());
+        if (size != 0)
+        {
+            auto zset = std::make_shared<ZSet>();
+            zset->BuildSorted(std::move(res));
+            auto ent = std::make_shared<core::Entry>(dest);
+            ent->Reset(std::move(zset));
+            core::m_map.Insert(ent);
+        }
+        return size;
+    }
+
+    // ZUNIONSTORE / ZINTERSTORE destination numkeys key [key ...] [WEIGHTS weight ...] [AGGREGATE SUM|MIN|MAX]
+    // 不存在的 key 当作空集合，destination 也可以是输入之一；async 为 false 时总是在当前线程中等待结果
+    auto ZStoreReply(Cmd &cmd, OutBuf &out, bool inter, bool async = true) -> void
+    {
+        int64_t numkeys = 0;
+        if (!str2int(cmd[2], numkeys) || numkeys <= 0)
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "at least 1 input key is needed");
+        }
+        if (static_cast<size_t>(numkeys) > cmd.size() - 3)
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "syntax error");
+        }
+        auto nkeys = static_cast<size_t>(numkeys);
+        std::vector<double> weights(nkeys, 1.0);
+        auto agg = zstore::Aggregate::SUM;
+        for (size_t index = 3 + nkeys; index < cmd.size(); index++)
+        {
+            if (CmdEq(cmd[index], "weights") && index + nkeys < cmd.size())
+            {
+                for (size_t key = 0; key < nkeys; key++)
+                {
+                    if (!str2dbl(cmd[index + 1 + key], weights[key]))
+                    {
+                        return OutErr(out, CmdErr::ERR_ARG, "weight value is not a float");
+                    }
+                }
+                index += nkeys;
+            }
+            else if (CmdEq(cmd[index], "aggregate") && index + 1 < cmd.size())
+            {
+                index++;
+                if (CmdEq(cmd[index], "sum"))
+                    agg = zstore::Aggregate::SUM;
+                else if (CmdEq(cmd[index], "min"))
+                    agg = zstore::Aggregate::MIN;
+                else if (CmdEq(cmd[index], "max"))
+                    agg = zstore::Aggregate::MAX;
+                else
+                    return OutErr(out, CmdErr::ERR_ARG, "syntax error");
+            }
+            else
+            {
+                return OutErr(out, CmdErr::ERR_ARG, "syntax error");
+            }
+        }
+        // 合并期间持有输入的 zset，Flatten 记下的成员名指针一直有效；修改它们的命令会先拷贝一份（见 MutableZSet）
+        std::vector<std::shared_ptr<ZSet>> sources(nkeys);
+        std::vector<zstore::Input> inputs(nkeys);
+        for (size_t index = 0; index < nkeys; index++)
+        {
+            auto probe = std::make_shared<core::Entry>(cmd[3 + index]);
+            HNodePtr hnode = core::m_map.Lookup(probe, core::EntryEq);
+            if (hnode == nullptr)
+                continue;
+            auto ent = dyn_cast<core::Entry, HNode>(hnode);
+            if (ent->type_ != core::EntryType::T_ZSET)
+            {
+                return OutErr(out, CmdErr::ERR_TYPE, "expect zset");
+            }
+            core::Touch(*ent);
+            sources[index] = ent->As<ZSet>();
+            zstore::Flatten(*ent->As<ZSet>(), inputs[index]);
+        }
+        size_t nparts = zstore::PartCount(inputs, inter);
+        if (!async || nparts <= 1 || block::g_current == nullptr)
+        {
+            return OutInt(out, StoreZSet(cmd[1], zstore::Merge(inputs, weights, agg, inter, nparts)));
+        }
+        // 不写回复，连接看到自己被挂起后停止处理后面的请求
+        auto merge = std::make_unique<zstore::AsyncMerge>(std::move(inputs), std::move(weights), agg, inter, nparts);
+        block::g_registry.Park(block::g_current, {}, true, 0);
+        g_zstore_jobs.push_back({cmd, inter, std::move(sources), std::move(merge), block::g_current});
+    }
+
+    // 按提交的顺序处理已经算完的任务，每轮事件循环调用
+    // 等待期间输入的 key 被修改过时结果已经过时，在当前线程中重新执行一遍命令
+    auto FinishZStoreJobs() -> void
+    {
+        while (!g_zstore_jobs.empty() && g_zstore_jobs.front().merge_->Ready())
+        {
+            auto job = std::move(g_zstore_jobs.front());
+            g_zstore_jobs.pop_front();
+            bool stale = false;
+            for (size_t index = 0; index < job.sources_.size() && !stale; index++)
+            {
+                auto probe = std::make_shared<core::Entry>(job.cmd_[3 + index]);
+                HNodePtr hnode = core::m_map.Lookup(probe, core::EntryEq);
+                core::EntryPtr ent = hnode ? dyn_cast<core::Entry, HNode>(hnode) : nullptr;
+                if (ent == nullptr)
+                    stale = job.sources_[index] != nullptr;
+                else
+                    stale = ent->type_ != core::EntryType::T_ZSET || ent->As<ZSet>() != job.sources_[index];
+            }
+            auto reply = [&job, stale](OutBuf &out)
+            {
+                if (stale)
+                    ZStoreReply(job.cmd_, out, job.inter_, false);
+                else
+                    OutInt(out, StoreZSet(job.cmd_[1], job.merge_->Take()));
+            };
+            if (job.client_ == nullptr)
+            {
+                OutBuf discard;
+                reply(discard);
+                continue;
+            }
+            block::g_registry.Remove(job.client_);
+            job.client_->Unblock(reply);
+        }
     }
-    auto Interpret(Cmd &cmd, Bytes &out) -> void
+    [[nodiscard]] auto ZStorePending() -> bool { return !g_zstore_jobs.empty(); }
+    // 连接关闭时调用，任务照常完成并写入结果，只是不再回复
+    auto CancelZStore(block::Client *client) -> void
     {
-        if (cmd.size() == 1 && CmdEq(cmd[0], "key"))
+        for (auto &job : g_zstore_jobs)
         {
-            DoKeys(cmd, out);
+            if (job.client_ == client)
+                job.client_ = nullptr;
         }
-        else if (cmd.size() == 2 && CmdEq(cmd[0], "get"))
+    }
+    auto DoZUnionStore(Cmd &cmd, OutBuf &out) -> void
+    {
+        ZStoreReply(cmd, out, false);
+    }
+    auto DoZInterStore(Cmd &cmd, OutBuf &out) -> void
+    {
+        ZStoreReply(cmd, out, true);
+    }
+
+    // HSET key field value [field value ...]，返回新增的 field 数
+    auto DoHSet(Cmd &cmd, OutBuf &out) -> void
+    {
+        if (cmd.size() % 2 != 0)
         {
-            DoGet(cmd, out);
+            return OutErr(out, CmdErr::ERR_ARG, "wrong number of arguments");
         }
-        else if (cmd.size() == 2 && CmdEq(cmd[0], "del"))
+        try
         {
-            DoDel(cmd, out);
+            auto hash = core::GetObj<HashObj>(cmd[1], true);
+            int64_t added = 0;
+            for (size_t index = 2; index < cmd.size(); index += 2)
+            {
+                added += hash->Set(cmd[index], cmd[index + 1]);
+            }
+            OutInt(out, added);
         }
-        else if (cmd.size() == 3 && CmdEq(cmd[0], "set"))
+        catch (const core::CoreException &err)
         {
-            DoSet(cmd, out);
+            OutErr(out, err.Code(), err.what());
         }
-        else if (cmd.size() == 4 && CmdEq(cmd[0], "zadd"))
+    }
+    auto DoHGet(Cmd &cmd, OutBuf &out) -> void
+    {
+        try
         {
-            DoZAdd(cmd, out);
+            auto hash = core::GetObj<HashObj>(cmd[1], false);
+            auto val = hash ? hash->Get(cmd[2]) : std::nullopt;
+            if (!val.has_value())
+            {
+                return OutNil(out);
+            }
+            OutStr(out, std::string(val.value()));
         }
-        else if (cmd.size() == 3 && CmdEq(cmd[0], "zrem"))
+        catch (const core::CoreException &err)
         {
-            DoZRem(cmd, out);
+            OutErr(out, err.Code(), err.what());
         }
-        else if (cmd.size() == 3 && CmdEq(cmd[0], "zscore"))
+    }
+    // HMGET key field [field ...]，不存在的 field 回复 nil
+    auto DoHMGet(Cmd &cmd, OutBuf &out) -> void
+    {
+        try
         {
-            DoZScore(cmd, out);
+            auto hash = core::GetObj<HashObj>(cmd[1], false);
+            OutArr(out, static_cast<uint32_t>(cmd.size() - 2));
+            for (size_t index = 2; index < cmd.size(); index++)
+            {
+                auto val = hash ? hash->Get(cmd[index]) : std::nullopt;
+                if (val.has_value())
+                    OutStr(out, std::string(val.value()));
+                else
+                    OutNil(out);
+            }
         }
-        else if (cmd.size() == 6 && CmdEq(cmd[0], "zquery"))
+        catch (const core::CoreException &err)
         {
-            DoZQuery(cmd, out);
+            OutErr(out, err.Code(), err.what());
+        }
+    }
+    // HDEL key field [field ...]，删掉最后一个 field 时 key 也一起删除
+    auto DoHDel(Cmd &cmd, OutBuf &out) -> void
+    {
+        try
+        {
+            auto hash = core::GetObj<HashObj>(cmd[1], false);
+            int64_t removed = 0;
+            for (size_t index = 2; hash && index < cmd.size(); index++)
+            {
+                removed += hash->Del(cmd[index]);
+            }
+            if (hash && hash->Size() == 0)
+            {
+                core::Del(cmd[1]);
+            }
+            OutInt(out, removed);
+        }
+        catch (const core::CoreException &err)
+        {
+            OutErr(out, err.Code(), err.what());
+        }
+    }
+    // HGETALL key，RESP3 下为 map
+    auto DoHGetAll(Cmd &cmd, OutBuf &out) -> void
+    {
+        try
+        {
+            auto hash = core::GetObj<HashObj>(cmd[1], false);
+            if (!hash)
+            {
+                return OutMap(out, 0);
+            }
+            OutMap(out, static_cast<uint32_t>(hash->Size()));
+            hash->ForEach([&](std::string_view field, std::string_view val)
+                          {
+                              OutStr(out, std::string(field));
+                              OutStr(out, std::string(val)); });
+        }
+        catch (const core::CoreException &err)
+        {
+            OutErr(out, err.Code(), err.what());
+        }
+    }
+    // HINCRBY key field increment，field 不存在时从 0 开始
+    auto DoHIncrBy(Cmd &cmd, OutBuf &out) -> void
+    {
+        int64_t incr = 0;
+        if (!str2int(cmd[3], incr))
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "expect int");
+        }
+        try
+        {
+            auto hash = core::GetObj<HashObj>(cmd[1], true);
+            int64_t val = 0;
+            auto old = hash->Get(cmd[2]);
+            if (old.has_value() && (old->empty() || !str2int(std::string(old.value()), val)))
+            {
+                return OutErr(out, CmdErr::ERR_ARG, "hash value is not an integer");
+            }
+            if (__builtin_add_overflow(val, incr, &val))
+            {
+                return OutErr(out, CmdErr::ERR_ARG, "increment or decrement would overflow");
+            }
+            hash->Set(cmd[2], std::to_string(val));
+            OutInt(out, val);
+        }
+        catch (const core::CoreException &err)
+        {
+            OutErr(out, err.Code(), err.what());
+        }
+    }
+
+    // SADD key member [member ...]，返回新增的成员数
+    auto DoSAdd(Cmd &cmd, OutBuf &out) -> void
+    {
+        try
+        {
+            auto set = core::GetObj<SetObj>(cmd[1], true);
+            std::vector<std::string> members(std::make_move_iterator(cmd.begin() + 2), std::make_move_iterator(cmd.end()));
+            OutInt(out, static_cast<int64_t>(set->Add(members)));
+        }
+        catch (const core::CoreException &err)
+        {
+            OutErr(out, err.Code(), err.what());
+        }
+    }
+    // SREM key member [member ...]，删掉最后一个成员时 key 也一起删除
+    auto DoSRem(Cmd &cmd, OutBuf &out) -> void
+    {
+        try
+        {
+            auto set = core::GetObj<SetObj>(cmd[1], false);
+            int64_t removed = 0;
+            for (size_t index = 2; set && index < cmd.size(); index++)
+            {
+                removed += set->Remove(cmd[index]);
+            }
+            if (set && set->Size() == 0)
+            {
+                core::Del(cmd[1]);
+            }
+            OutInt(out, removed);
+        }
+        catch (const core::CoreException &err)
+        {
+            OutErr(out, err.Code(), err.what());
+        }
+    }
+    auto DoSIsMember(Cmd &cmd, OutBuf &out) -> void
+    {
+        try
+        {
+            auto set = core::GetObj<SetObj>(cmd[1], false);
+            OutInt(out, set && set->Contains(cmd[2]) ? 1 : 0);
+        }
+        catch (const core::CoreException &err)
+        {
+            OutErr(out, err.Code(), err.what());
+        }
+    }
+    auto DoSCard(Cmd &cmd, OutBuf &out) -> void
+    {
+        try
+        {
+            auto set = core::GetObj<SetObj>(cmd[1], false);
+            OutInt(out, set ? static_cast<int64_t>(set->Size()) : 0);
+        }
+        catch (const core::CoreException &err)
+        {
+            OutErr(out, err.Code(), err.what());
+        }
+    }
+
+    // SINTER / SUNION / SDIFF key [key ...]，不存在的 key 当作空集合
+    template <typename Op>
+    auto SetOpReply(Cmd &cmd, OutBuf &out, Op &&op) -> void
+    {
+        // 先检查所有 key 的类型，回复开始写之后就不能再报错了
+        std::vector<std::shared_ptr<SetObj>> holds;
+        std::vector<const SetObj *> sets;
+        try
+        {
+            for (size_t index = 1; index < cmd.size(); index++)
+            {
+                holds.push_back(core::GetObj<SetObj>(cmd[index], false));
+                sets.push_back(holds.back().get());
+            }
+        }
+        catch (const core::CoreException &err)
+        {
+            return OutErr(out, err.Code(), err.what());
+        }
+        uint32_t n = 0;
+        auto arr = OutBeginArr(out);
+        op(sets, [&](const std::string &member)
+           {
+               OutStr(out, member);
+               n++; });
+        OutEndArr(out, arr, n);
+    }
+    auto DoSInter(Cmd &cmd, OutBuf &out) -> void
+    {
+        SetOpReply(cmd, out, setops::Inter);
+    }
+    auto DoSUnion(Cmd &cmd, OutBuf &out) -> void
+    {
+        SetOpReply(cmd, out, setops::Union);
+    }
+    auto DoSDiff(Cmd &cmd, OutBuf &out) -> void
+    {
+        SetOpReply(cmd, out, setops::Diff);
+    }
+
+    // 位图的偏移量，与 Redis 相同最大为 2^32 - 1，即 512MB 的 string
+    auto ParseBitOffset(const std::string &str, uint64_t &offset) -> bool
+    {
+        int64_t val = 0;
+        if (!str2int(str, val) || val < 0 || val >= (int64_t(1) << 32))
+            return false;
+        offset = static_cast<uint64_t>(val);
+        return true;
+    }
+
+    // SETBIT key offset 0|1，返回原来的位，string 不够长时用 0 补齐
+    auto DoSetBit(Cmd &cmd, OutBuf &out) -> void
+    {
+        uint64_t offset = 0;
+        if (!ParseBitOffset(cmd[2], offset))
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "bit offset is not an integer or out of range");
+        }
+        if (cmd[3] != "0" && cmd[3] != "1")
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "bit is not an integer or out of range");
+        }
+        try
+        {
+            auto &val = core::GetStrEntry(cmd[1], true)->MutableVal();
+            size_t byte = offset >> 3;
+            auto mask = static_cast<uint8_t>(0x80 >> (offset & 7));
+            if (val.size() <= byte)
+                val.resize(byte + 1, '\0');
+            auto old = static_cast<uint8_t>(val[byte]);
+            val[byte] = static_cast<char>(cmd[3] == "1" ? old | mask : old & ~mask);
+            OutInt(out, (old & mask) != 0);
+        }
+        catch (const core::CoreException &err)
+        {
+            OutErr(out, err.Code(), err.what());
+        }
+    }
+    auto DoGetBit(Cmd &cmd, OutBuf &out) -> void
+    {
+        uint64_t offset = 0;
+        if (!ParseBitOffset(cmd[2], offset))
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "bit offset is not an integer or out of range");
+        }
+        try
+        {
+            auto ent = core::GetStrEntry(cmd[1], false);
+            size_t byte = offset >> 3;
+            if (!ent || ent->val_->size() <= byte)
+            {
+                return OutInt(out, 0);
+            }
+            OutInt(out, (static_cast<uint8_t>((*ent->val_)[byte]) >> (7 - (offset & 7))) & 1);
+        }
+        catch (const core::CoreException &err)
+        {
+            OutErr(out, err.Code(), err.what());
+        }
+    }
+
+    // 超过 g_bitcount_step 字节的 BITCOUNT 分到多轮事件循环中计数，期间连接挂起
+    struct BitCountJob
+    {
+        core::StrPtr val_;
+        size_t pos_;  // 下一段的起始字节
+        size_t last_; // 不包含
+        uint64_t count_;
+        block::Client *client_; // 连接已经关闭时为 nullptr
+    };
+    inline std::list<BitCountJob> g_bitcount_jobs{};
+
+    // BITCOUNT key [start end [BYTE|BIT]]，区间两端都包含，负数从末尾数
+    auto DoBitCount(Cmd &cmd, OutBuf &out) -> void
+    {
+        int64_t start = 0;
+        int64_t end = -1;
+        bool bit_unit = false;
+        if (cmd.size() == 3 || cmd.size() > 5)
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "syntax error");
+        }
+        if (cmd.size() >= 4 && (!str2int(cmd[2], start) || !str2int(cmd[3], end)))
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "expect int");
+        }
+        if (cmd.size() == 5)
+        {
+            bit_unit = CmdEq(cmd[4], "bit");
+            if (!bit_unit && !CmdEq(cmd[4], "byte"))
+                return OutErr(out, CmdErr::ERR_ARG, "syntax error");
+        }
+        try
+        {
+            auto ent = core::GetStrEntry(cmd[1], false);
+            if (!ent)
+            {
+                return OutInt(out, 0);
+            }
+            core::StrPtr val = ent->val_;
+            auto total = static_cast<int64_t>(bit_unit ? val->size() * 8 : val->size());
+            if (start < 0)
+                start = std::max<int64_t>(start + total, 0);
+            if (end < 0)
+                end = std::max<int64_t>(end + total, 0);
+            end = std::min(end, total - 1);
+            if (start > end)
+            {
+                return OutInt(out, 0);
+            }
+            const auto *data = reinterpret_cast<const uint8_t *>(val->data());
+            bitops::Span span{0, static_cast<size_t>(start), static_cast<size_t>(end) + 1};
+            if (bit_unit)
+                span = bitops::SplitRange(data, static_cast<uint64_t>(start), static_cast<uint64_t>(end));
+            size_t len = span.last_ - span.first_;
+            if (len <= bitops::g_bitcount_step || block::g_current == nullptr)
+            {
+                return OutInt(out, static_cast<int64_t>(span.edges_ + bitops::Popcount(data + span.first_, len)));
+            }
+            // 不写回复，连接看到自己被挂起后停止处理后面的请求
+            // 任务持有 value，之后的写命令会先拷贝一份（见 MutableVal），计数的是执行命令时的内容
+            block::g_registry.Park(block::g_current, {}, true, 0);
+            g_bitcount_jobs.push_back({std::move(val), span.first_, span.last_, span.edges_, block::g_current});
+        }
+        catch (const core::CoreException &err)
+        {
+            OutErr(out, err.Code(), err.what());
+        }
+    }
+    // 每轮事件循环调用，每个任务最多计数 g_bitcount_step 字节，算完的回复并唤醒连接
+    auto StepBitCounts() -> void
+    {
+        for (auto job = g_bitcount_jobs.begin(); job != g_bitcount_jobs.end();)
+        {
+            size_t len = std::min(job->last_ - job->pos_, bitops::g_bitcount_step);
+            job->count_ += bitops::Popcount(reinterpret_cast<const uint8_t *>(job->val_->data()) + job->pos_, len);
+            job->pos_ += len;
+            if (job->pos_ < job->last_)
+            {
+                ++job;
+                continue;
+            }
+            auto *client = job->client_;
+            auto count = static_cast<int64_t>(job->count_);
+            job = g_bitcount_jobs.erase(job);
+            if (client == nullptr)
+                continue;
+            block::g_registry.Remove(client);
+            client->Unblock([count](OutBuf &out)
+                            { OutInt(out, count); });
+        }
+    }
+    [[nodiscard]] auto BitCountPending() -> bool { return !g_bitcount_jobs.empty(); }
+    // 连接关闭时调用
+    auto CancelBitCount(block::Client *client) -> void
+    {
+        for (auto &job : g_bitcount_jobs)
+        {
+            if (job.client_ == client)
+                job.client_ = nullptr;
+        }
+    }
+
+    // BITOP AND|OR|XOR|NOT destkey key [key ...]，返回结果的字节数
+    // 较短的输入和不存在的 key 按 0 补齐；结果为空时删除 destkey，否则不论原来是什么类型都覆盖
+    auto DoBitOp(Cmd &cmd, OutBuf &out) -> void
+    {
+        bool is_not = CmdEq(cmd[1], "not");
+        auto op = bitops::Op::AND;
+        if (CmdEq(cmd[1], "or"))
+            op = bitops::Op::OR;
+        else if (CmdEq(cmd[1], "xor"))
+            op = bitops::Op::XOR;
+        else if (!is_not && !CmdEq(cmd[1], "and"))
+            return OutErr(out, CmdErr::ERR_ARG, "syntax error");
+        if (is_not && cmd.size() != 4)
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "BITOP NOT must be called with a single source key");
+        }
+
+        std::vector<core::StrPtr> srcs;
+        size_t len = 0;
+        try
+        {
+            for (size_t index = 3; index < cmd.size(); index++)
+            {
+                auto ent = core::GetStrEntry(cmd[index], false);
+                srcs.push_back(ent ? ent->val_ : std::make_shared<std::string>());
+                len = std::max(len, srcs.back()->size());
+            }
+        }
+        catch (const core::CoreException &err)
+        {
+            return OutErr(out, err.Code(), err.what());
+        }
+
+        std::string res = *srcs[0];
+        res.resize(len, '\0');
+        auto *dst = reinterpret_cast<uint8_t *>(res.data());
+        if (is_not)
+        {
+            bitops::Not(dst, len);
+        }
+        for (size_t index = 1; index < srcs.size(); index++)
+        {
+            const auto &src = *srcs[index];
+            bitops::Apply(op, dst, reinterpret_cast<const uint8_t *>(src.data()), src.size());
+            if (op == bitops::Op::AND)
+                std::memset(dst + src.size(), 0, len - src.size());
+        }
+        core::Del(cmd[2]);
+        if (len != 0)
+        {
+            core::Set(cmd[2], std::move(res));
+        }
+        OutInt(out, static_cast<int64_t>(len));
+    }
+
+    // PFADD key [element ...]，有寄存器变化或者新建了 key 时返回 1
+    auto DoPfAdd(Cmd &cmd, OutBuf &out) -> void
+    {
+        try
+        {
+            auto hll = core::GetObj<HyperLogLog>(cmd[1], false);
+            bool changed = hll == nullptr;
+            if (hll == nullptr)
+                hll = core::GetObj<HyperLogLog>(cmd[1], true);
+            for (size_t index = 2; index < cmd.size(); index++)
+            {
+                changed = hll->Add(cmd[index]) || changed;
+            }
+            OutInt(out, changed ? 1 : 0);
+        }
+        catch (const core::CoreException &err)
+        {
+            OutErr(out, err.Code(), err.what());
+        }
+    }
+
+    // PFCOUNT key [key ...]，多个 key 时返回并集的估计值，不存在的 key 当作空
+    auto DoPfCount(Cmd &cmd, OutBuf &out) -> void
+    {
+        try
+        {
+            if (cmd.size() == 2)
+            {
+                auto hll = core::GetObj<HyperLogLog>(cmd[1], false);
+                return OutInt(out, hll ? static_cast<int64_t>(hll->Count()) : 0);
+            }
+            hll::Registers regs{};
+            for (size_t index = 1; index < cmd.size(); index++)
+            {
+                if (auto hll = core::GetObj<HyperLogLog>(cmd[index], false))
+                    hll->MaxInto(regs);
+            }
+            auto card = hll::Estimate(hll::GetStats(regs.data(), hll::k_registers));
+            OutInt(out, static_cast<int64_t>(card));
+        }
+        catch (const core::CoreException &err)
+        {
+            OutErr(out, err.Code(), err.what());
+        }
+    }
+
+    // PFMERGE destkey [sourcekey ...]，destkey 原有的寄存器也参与合并
+    auto DoPfMerge(Cmd &cmd, OutBuf &out) -> void
+    {
+        try
+        {
+            hll::Registers regs{};
+            for (size_t index = 1; index < cmd.size(); index++)
+            {
+                if (auto hll = core::GetObj<HyperLogLog>(cmd[index], false))
+                    hll->MaxInto(regs);
+            }
+            core::GetObj<HyperLogLog>(cmd[1], true)->Assign(regs);
+            OutOk(out);
+        }
+        catch (const core::CoreException &err)
+        {
+            OutErr(out, err.Code(), err.what());
+        }
+    }
+
+    // LPUSH / RPUSH key element [element ...]，按参数顺序逐个放到头部 / 尾部，返回 list 的长度
+    auto ListPush(Cmd &cmd, OutBuf &out, bool front) -> void
+    {
+        try
+        {
+            auto list = core::GetObj<QuickList>(cmd[1], true);
+            for (size_t index = 2; index < cmd.size(); index++)
+            {
+                list->Push(front, cmd[index]);
+            }
+            OutInt(out, static_cast<int64_t>(list->Size()));
+            block::g_registry.Signal(cmd[1]);
+        }
+        catch (const core::CoreException &err)
+        {
+            OutErr(out, err.Code(), err.what());
+        }
+    }
+    auto DoLPush(Cmd &cmd, OutBuf &out) -> void
+    {
+        ListPush(cmd, out, true);
+    }
+    auto DoRPush(Cmd &cmd, OutBuf &out) -> void
+    {
+        ListPush(cmd, out, false);
+    }
+
+    // LPOP / RPOP key [count]，不带 count 时回复一个元素，带 count 时回复数组
+    // 取空时 key 一起删除
+    auto ListPop(Cmd &cmd, OutBuf &out, bool front) -> void
+    {
+        int64_t count = 1;
+        if (cmd.size() > 3)
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "syntax error");
+        }
+        if (cmd.size() == 3 && (!str2int(cmd[2], count) || count < 0))
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "value is out of range, must be positive");
+        }
+        try
+        {
+            auto list = core::GetObj<QuickList>(cmd[1], false);
+            if (!list)
+            {
+                return OutNil(out);
+            }
+            if (cmd.size() == 2)
+            {
+                OutStr(out, *list->Pop(front));
+            }
+            else
+            {
+                auto n = static_cast<uint32_t>(std::min<size_t>(static_cast<size_t>(count), list->Size()));
+                OutArr(out, n);
+                for (uint32_t index = 0; index < n; index++)
+                {
+                    OutStr(out, *list->Pop(front));
+                }
+            }
+            if (list->Size() == 0)
+            {
+                core::Del(cmd[1]);
+            }
+        }
+        catch (const core::CoreException &err)
+        {
+            OutErr(out, err.Code(), err.what());
+        }
+    }
+    auto DoLPop(Cmd &cmd, OutBuf &out) -> void
+    {
+        ListPop(cmd, out, true);
+    }
+    auto DoRPop(Cmd &cmd, OutBuf &out) -> void
+    {
+        ListPop(cmd, out, false);
+    }
+
+    auto DoLLen(Cmd &cmd, OutBuf &out) -> void
+    {
+        try
+        {
+            auto list = core::GetObj<QuickList>(cmd[1], false);
+            OutInt(out, list ? static_cast<int64_t>(list->Size()) : 0);
+        }
+        catch (const core::CoreException &err)
+        {
+            OutErr(out, err.Code(), err.what());
+        }
+    }
+
+    // [start, stop] 按下标规范化，负数从末尾数，返回 false 表示区间为空
+    auto ListIndexRange(int64_t size, int64_t &start, int64_t &stop) -> bool
+    {
+        if (start < 0)
+            start += size;
+        if (stop < 0)
+            stop += size;
+        start = std::max<int64_t>(start, 0);
+        stop = std::min(stop, size - 1);
+        return start <= stop;
+    }
+
+    // LRANGE key start stop，元素直接从块里写到回复中
+    auto DoLRange(Cmd &cmd, OutBuf &out) -> void
+    {
+        int64_t start = 0;
+        int64_t stop = 0;
+        if (!str2int(cmd[2], start) || !str2int(cmd[3], stop))
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "expect int");
+        }
+        try
+        {
+            auto list = core::GetObj<QuickList>(cmd[1], false);
+            if (!list || !ListIndexRange(static_cast<int64_t>(list->Size()), start, stop))
+            {
+                return OutArr(out, 0);
+            }
+            OutArr(out, static_cast<uint32_t>(stop - start + 1));
+            list->Range(static_cast<size_t>(start), static_cast<size_t>(stop), [&](std::string_view elem)
+                        { OutStrView(out, elem); });
+        }
+        catch (const core::CoreException &err)
+        {
+            OutErr(out, err.Code(), err.what());
+        }
+    }
+
+    // LTRIM key start stop，只保留区间内的元素，区间为空时删除 key
+    auto DoLTrim(Cmd &cmd, OutBuf &out) -> void
+    {
+        int64_t start = 0;
+        int64_t stop = 0;
+        if (!str2int(cmd[2], start) || !str2int(cmd[3], stop))
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "expect int");
+        }
+        try
+        {
+            auto list = core::GetObj<QuickList>(cmd[1], false);
+            if (!list)
+            {
+                return OutOk(out);
+            }
+            if (!ListIndexRange(static_cast<int64_t>(list->Size()), start, stop))
+            {
+                core::Del(cmd[1]);
+                return OutOk(out);
+            }
+            list->Trim(static_cast<size_t>(start), static_cast<size_t>(stop));
+            OutOk(out);
+        }
+        catch (const core::CoreException &err)
+        {
+            OutErr(out, err.Code(), err.what());
+        }
+    }
+
+    // BLPOP / BRPOP 的 timeout 上限（秒），约 30 年，加上当前时间后仍在 uint64_t 的微秒范围内
+    constexpr double k_max_block_timeout_s = 1e9;
+
+    // BLPOP / BRPOP key [key ...] timeout，回复 [key, 元素]，超时回复 nil
+    // 按顺序第一个非空的 key 直接弹出；都为空时挂起当前连接，timeout 为秒数，0 表示一直等
+    auto BlockingPop(Cmd &cmd, OutBuf &out, bool front) -> void
+    {
+        // 转成微秒之前检查范围，NaN 和过大的值转成整数是未定义行为
+        double timeout = 0;
+        if (!str2dbl(cmd.back(), timeout) || !(timeout >= 0 && timeout <= k_max_block_timeout_s))
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "timeout is not a float or out of range");
+        }
+        std::vector<std::string> keys(cmd.begin() + 1, cmd.end() - 1);
+        try
+        {
+            for (const auto &key : keys)
+            {
+                auto list = core::GetObj<QuickList>(key, false);
+                if (!list)
+                    continue;
+                auto elem = list->Pop(front);
+                if (list->Size() == 0)
+                    core::Del(key);
+                OutArr(out, 2);
+                OutStr(out, key);
+                return OutStr(out, *elem);
+            }
+        }
+        catch (const core::CoreException &err)
+        {
+            return OutErr(out, err.Code(), err.what());
+        }
+        if (block::g_current == nullptr)
+        {
+            return OutNil(out);
+        }
+        uint64_t deadline_us = timeout == 0 ? 0 : GetMonotonicUsec() + static_cast<uint64_t>(timeout * 1e6);
+        // 不写回复，连接看到自己被挂起后停止处理后面的请求
+        block::g_registry.Park(block::g_current, std::move(keys), front, deadline_us);
+    }
+    auto DoBLPop(Cmd &cmd, OutBuf &out) -> void
+    {
+        BlockingPop(cmd, out, true);
+    }
+    auto DoBRPop(Cmd &cmd, OutBuf &out) -> void
+    {
+        BlockingPop(cmd, out, false);
+    }
+
+    // 把就绪的 key 中的元素按挂起的先后交给等待的客户端
+    // 每条命令执行完后调用；被唤醒的客户端只写入回复，它后面的请求由事件循环接着处理，不会在这里重入
+    auto ServeBlocked() -> void
+    {
+        auto &registry = block::g_registry;
+        while (registry.HasReady())
+        {
+            for (const auto &key : registry.TakeReady())
+            {
+                std::shared_ptr<QuickList> list;
+                try
+                {
+                    list = core::GetObj<QuickList>(key, false);
+                }
+                catch (const core::CoreException &)
+                {
+                    // push 之后 key 又被覆盖成了别的类型
+                    continue;
+                }
+                block::Client *client = nullptr;
+                while (list && list->Size() != 0 && (client = registry.First(key)) != nullptr)
+                {
+                    auto elem = list->Pop(client->GetWaiter()->front_);
+                    if (list->Size() == 0)
+                        core::Del(key);
+                    registry.Remove(client);
+                    client->Unblock([&](OutBuf &out)
+                                    {
+                                        OutArr(out, 2);
+                                        OutStr(out, key);
+                                        OutStr(out, *elem); });
+                }
+            }
+        }
+    }
+    // 截止时间不晚于 now_us 的客户端回复 nil
+    auto ExpireBlocked(uint64_t now_us) -> void
+    {
+        for (auto *client : block::g_registry.Expire(now_us))
+        {
+            client->Unblock([](OutBuf &out)
+                            { OutNil(out); });
+        }
+    }
+
+    // stream 的条目回复为 [ID, [field, value, ...]]
+    auto OutStreamEntry(OutBuf &out, const stream::Id &id, const std::vector<std::string_view> &pairs) -> void
+    {
+        OutArr(out, 2);
+        OutStr(out, id.ToString());
+        OutArr(out, static_cast<uint32_t>(pairs.size()));
+        for (auto part : pairs)
+        {
+            OutStrView(out, part);
+        }
+    }
+
+    constexpr const char *k_bad_stream_id = "Invalid stream ID specified as stream command argument";
+
+    // XADD / XTRIM 的 MAXLEN|MINID [=|~] threshold
+    struct StreamTrim
+    {
+        bool by_id_{false};
+        bool approx_{false};
+        size_t max_len_{0};
+        stream::Id min_id_{};
+    };
+    // 从 cmd[index] 开始解析，index 前进到之后的参数，格式错误时返回错误信息
+    auto ParseStreamTrim(const Cmd &cmd, size_t &index, StreamTrim &trim) -> const char *
+    {
+        trim.by_id_ = CmdEq(cmd[index], "minid");
+        if (!trim.by_id_ && !CmdEq(cmd[index], "maxlen"))
+            return "syntax error";
+        index++;
+        if (index < cmd.size() && (cmd[index] == "=" || cmd[index] == "~"))
+        {
+            trim.approx_ = cmd[index] == "~";
+            index++;
+        }
+        if (index >= cmd.size())
+            return "syntax error";
+        const auto &arg = cmd[index++];
+        if (trim.by_id_)
+            return stream::ParseId(arg, 0, trim.min_id_) ? nullptr : k_bad_stream_id;
+        int64_t max_len = 0;
+        if (!str2int(arg, max_len) || max_len < 0)
+            return "MAXLEN should be a non-negative integer";
+        trim.max_len_ = static_cast<size_t>(max_len);
+        return nullptr;
+    }
+    auto ApplyStreamTrim(Stream &stream, const StreamTrim &trim) -> size_t
+    {
+        return trim.by_id_ ? stream.TrimId(trim.min_id_, trim.approx_) : stream.TrimLen(trim.max_len_, trim.approx_);
+    }
+
+    // XADD key [MAXLEN|MINID [=|~] threshold] <* | ms-* | ms-seq> field value [field value ...]，回复新条目的 ID
+    auto DoXAdd(Cmd &cmd, OutBuf &out) -> void
+    {
+        size_t index = 2;
+        std::optional<StreamTrim> trim;
+        if (CmdEq(cmd[index], "maxlen") || CmdEq(cmd[index], "minid"))
+        {
+            trim.emplace();
+            if (const char *err = ParseStreamTrim(cmd, index, *trim))
+                return OutErr(out, CmdErr::ERR_ARG, err);
+        }
+        if (index + 3 > cmd.size() || (cmd.size() - index - 1) % 2 != 0)
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "wrong number of arguments");
+        }
+        const std::string &id_arg = cmd[index];
+        try
+        {
+            // 先确定 ID，出错时不创建 key
+            auto stream = core::GetObj<Stream>(cmd[1], false);
+            const stream::Id &last = stream ? stream->LastId() : stream::k_min_id;
+            stream::Id id;
+            bool ok = true;
+            if (id_arg == "*")
+            {
+                ok = stream::NextId(last, std::max(stream::NowMs(), last.ms_), false, id);
+            }
+            else if (id_arg.size() > 2 && id_arg.compare(id_arg.size() - 2, 2, "-*") == 0)
+            {
+                uint64_t ms = 0;
+                if (!stream::ParseU64(std::string_view(id_arg).substr(0, id_arg.size() - 2), ms))
+                    return OutErr(out, CmdErr::ERR_ARG, k_bad_stream_id);
+                ok = stream::NextId(last, ms, true, id);
+            }
+            else
+            {
+                if (!stream::ParseId(id_arg, 0, id))
+                    return OutErr(out, CmdErr::ERR_ARG, k_bad_stream_id);
+                if (id == stream::k_min_id)
+                    return OutErr(out, CmdErr::ERR_ARG, "The ID specified in XADD must be greater than 0-0");
+                ok = last < id;
+            }
+            if (!ok)
+            {
+                return OutErr(out, CmdErr::ERR_ARG, "The ID specified in XADD is equal or smaller than the target stream top item");
+            }
+            if (!stream)
+                stream = core::GetObj<Stream>(cmd[1], true);
+            std::vector<std::string_view> pairs(cmd.begin() + static_cast<ptrdiff_t>(index) + 1, cmd.end());
+            stream->Add(id, pairs);
+            if (trim)
+                ApplyStreamTrim(*stream, *trim);
+            OutStr(out, id.ToString());
+        }
+        catch (const core::CoreException &err)
+        {
+            OutErr(out, err.Code(), err.what());
+        }
+    }
+
+    auto DoXLen(Cmd &cmd, OutBuf &out) -> void
+    {
+        try
+        {
+            auto stream = core::GetObj<Stream>(cmd[1], false);
+            OutInt(out, stream ? static_cast<int64_t>(stream->Length()) : 0);
+        }
+        catch (const core::CoreException &err)
+        {
+            OutErr(out, err.Code(), err.what());
+        }
+    }
+
+    // XRANGE 的端点：- 和 + 为最小 / 最大，只有 ms 时起点取 ms-0、终点取 ms-最大，( 开头表示不包含
+    auto ParseRangeId(std::string_view arg, bool is_start, stream::Id &out) -> bool
+    {
+        if (arg == "-" || arg == "+")
+        {
+            out = arg == "-" ? stream::k_min_id : stream::k_max_id;
+            return true;
+        }
+        bool exclusive = !arg.empty() && arg[0] == '(';
+        if (exclusive)
+            arg.remove_prefix(1);
+        if (!stream::ParseId(arg, is_start ? 0 : std::numeric_limits<uint64_t>::max(), out))
+            return false;
+        return !exclusive || (is_start ? out.Incr() : out.Decr());
+    }
+
+    // XRANGE key start end [COUNT n]
+    auto DoXRange(Cmd &cmd, OutBuf &out) -> void
+    {
+        stream::Id first;
+        stream::Id last;
+        if (!ParseRangeId(cmd[2], true, first) || !ParseRangeId(cmd[3], false, last))
+        {
+            return OutErr(out, CmdErr::ERR_ARG, k_bad_stream_id);
+        }
+        int64_t count = 0;
+        if (cmd.size() != 4 && (cmd.size() != 6 || !CmdEq(cmd[4], "count") || !str2int(cmd[5], count) || count < 0))
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "syntax error");
+        }
+        try
+        {
+            auto stream = core::GetObj<Stream>(cmd[1], false);
+            if (!stream || (cmd.size() == 6 && count == 0))
+            {
+                return OutArr(out, 0);
+            }
+            auto arr = OutBeginArr(out);
+            size_t n = stream->Range(first, last, static_cast<size_t>(count), [&](const stream::Id &id, const std::vector<std::string_view> &pairs)
+                                     { OutStreamEntry(out, id, pairs); });
+            OutEndArr(out, arr, static_cast<uint32_t>(n));
+        }
+        catch (const core::CoreException &err)
+        {
+            OutErr(out, err.Code(), err.what());
+        }
+    }
+
+    // XREAD [COUNT n] STREAMS key [key ...] id [id ...]，返回每个 stream 中 ID 大于给定 ID 的条目，$ 为当前最后一个 ID
+    // 回复 [[key, [条目...]]...]，只包含有新条目的 stream，都没有时回复 nil；不支持 BLOCK
+    auto DoXRead(Cmd &cmd, OutBuf &out) -> void
+    {
+        size_t index = 1;
+        int64_t count = 0;
+        if (CmdEq(cmd[index], "count"))
+        {
+            if (index + 1 >= cmd.size() || !str2int(cmd[index + 1], count) || count < 0)
+                return OutErr(out, CmdErr::ERR_ARG, "syntax error");
+            index += 2;
+        }
+        if (index >= cmd.size() || !CmdEq(cmd[index], "streams"))
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "syntax error");
+        }
+        index++;
+        size_t keys = (cmd.size() - index) / 2;
+        if (keys == 0 || (cmd.size() - index) % 2 != 0)
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "Unbalanced 'xread' list of streams: for each stream key an ID or '$' must be specified.");
+        }
+        struct Source
+        {
+            const std::string *key_;
+            std::shared_ptr<Stream> stream_;
+            stream::Id first_;
+        };
+        std::vector<Source> sources;
+        try
+        {
+            for (size_t pos = 0; pos < keys; pos++)
+            {
+                const auto &key = cmd[index + pos];
+                const auto &id_arg = cmd[index + keys + pos];
+                auto stream = core::GetObj<Stream>(key, false);
+                stream::Id after;
+                if (id_arg == "$")
+                    after = stream ? stream->LastId() : stream::k_min_id;
+                else if (!stream::ParseId(id_arg, 0, after))
+                    return OutErr(out, CmdErr::ERR_ARG, k_bad_stream_id);
+                // 有条目的 ID 大于 after 当且仅当最后一个 ID 大于 after
+                if (stream && stream->Length() != 0 && after < stream->LastId())
+                {
+                    after.Incr();
+                    sources.push_back({&key, std::move(stream), after});
+                }
+            }
+        }
+        catch (const core::CoreException &err)
+        {
+            return OutErr(out, err.Code(), err.what());
+        }
+        if (sources.empty())
+        {
+            return OutNil(out);
+        }
+        OutArr(out, static_cast<uint32_t>(sources.size()));
+        for (const auto &source : sources)
+        {
+            OutArr(out, 2);
+            OutStr(out, *source.key_);
+            auto arr = OutBeginArr(out);
+            size_t n = source.stream_->Range(source.first_, stream::k_max_id, static_cast<size_t>(count), [&](const stream::Id &id, const std::vector<std::string_view> &pairs)
+                                             { OutStreamEntry(out, id, pairs); });
+            OutEndArr(out, arr, static_cast<uint32_t>(n));
+        }
+    }
+
+    // XTRIM key MAXLEN|MINID [=|~] threshold，回复删除的条目数；~ 时只丢弃整块
+    auto DoXTrim(Cmd &cmd, OutBuf &out) -> void
+    {
+        size_t index = 2;
+        StreamTrim trim;
+        if (const char *err = ParseStreamTrim(cmd, index, trim))
+        {
+            return OutErr(out, CmdErr::ERR_ARG, err);
+        }
+        if (index != cmd.size())
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "syntax error");
+        }
+        try
+        {
+            auto stream = core::GetObj<Stream>(cmd[1], false);
+            OutInt(out, stream ? static_cast<int64_t>(ApplyStreamTrim(*stream, trim)) : 0);
+        }
+        catch (const core::CoreException &err)
+        {
+            OutErr(out, err.Code(), err.what());
+        }
+    }
+
+    // 发布的消息 [message, channel, payload] 或 [pmessage, pattern, channel, payload]
+    // 原生协议的连接每条消息是单独的一帧，长度前缀一起序列化
+    auto EncodeMessage(Proto proto, const std::string *pattern, const std::string &channel, const std::string &payload) -> StrPin
+    {
+        OutBuf buf;
+        buf.SetProto(proto);
+        if (proto == Proto::NATIVE)
+            buf.AppendNum<uint32_t>(0, 4);
+        OutPush(buf, pattern != nullptr ? 4 : 3);
+        if (pattern != nullptr)
+        {
+            OutStrView(buf, "pmessage");
+            OutStr(buf, *pattern);
+        }
+        else
+        {
+            OutStrView(buf, "message");
+        }
+        OutStr(buf, channel);
+        OutStr(buf, payload);
+        if (proto == Proto::NATIVE)
+        {
+            auto len = static_cast<uint32_t>(buf.Total() - 4);
+            buf.Cover(0, &len, 4);
+        }
+        return std::make_shared<const std::string>(buf.ToString());
+    }
+
+    // PUBLISH channel message，回复收到消息的客户端数
+    auto DoPublish(Cmd &cmd, OutBuf &out) -> void
+    {
+        const auto &channel = cmd[1];
+        const auto &payload = cmd[2];
+        size_t receivers = pubsub::g_hub.Publish(channel, [&](Proto proto, const std::string *pattern)
+                                                 { return EncodeMessage(proto, pattern, channel, payload); });
+        OutInt(out, static_cast<int64_t>(receivers));
+    }
+
+    // (P)SUBSCRIBE / (P)UNSUBSCRIBE 对每个 channel / 模式回复 [kind, name, 当前订阅总数]
+    // RESP 下每个都是单独的回复；原生协议一个请求只对应一帧，整体再包一层数组
+    // 不带参数的 (P)UNSUBSCRIBE 退订全部，一个都没有时回复 [kind, nil, 0]
+    auto Subscription(Cmd &cmd, OutBuf &out, std::string_view kind, bool pattern, bool join) -> void
+    {
+        auto *sub = pubsub::g_current;
+        if (sub == nullptr)
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "subscription needs a client connection");
+        }
+        auto &hub = pubsub::g_hub;
+        std::vector<std::string> names(cmd.begin() + 1, cmd.end());
+        if (!join && names.empty())
+        {
+            for (const auto &[name, index] : pattern ? sub->patterns_ : sub->channels_)
+            {
+                names.push_back(name);
+            }
+        }
+        if (out.GetProto() == Proto::NATIVE)
+            OutArr(out, static_cast<uint32_t>(std::max<size_t>(names.size(), 1)));
+        if (names.empty())
+        {
+            OutPush(out, 3);
+            OutStrView(out, kind);
+            OutNil(out);
+            return OutInt(out, static_cast<int64_t>(sub->Count()));
+        }
+        for (const auto &name : names)
+        {
+            if (pattern)
+                join ? hub.PSubscribe(sub, name) : hub.PUnsubscribe(sub, name);
+            else
+                join ? hub.Subscribe(sub, name) : hub.Unsubscribe(sub, name);
+            OutPush(out, 3);
+            OutStrView(out, kind);
+            OutStr(out, name);
+            OutInt(out, static_cast<int64_t>(sub->Count()));
+        }
+    }
+    auto DoSubscribe(Cmd &cmd, OutBuf &out) -> void
+    {
+        Subscription(cmd, out, "subscribe", false, true);
+    }
+    auto DoUnsubscribe(Cmd &cmd, OutBuf &out) -> void
+    {
+        Subscription(cmd, out, "unsubscribe", false, false);
+    }
+    auto DoPSubscribe(Cmd &cmd, OutBuf &out) -> void
+    {
+        Subscription(cmd, out, "psubscribe", true, true);
+    }
+    auto DoPUnsubscribe(Cmd &cmd, OutBuf &out) -> void
+    {
+        Subscription(cmd, out, "punsubscribe", true, false);
+    }
+
+    auto DoClusterSlots(OutBuf &out) -> void
+    {
+        const auto &slots = cluster::g_cluster.slots_;
+        auto ranges = slots.Ranges();
+        OutArr(out, static_cast<uint32_t>(ranges.size()));
+        for (const auto &range : ranges)
+        {
+            const auto &node = slots.Nodes()[range.node_];
+            OutArr(out, 4);
+            OutInt(out, range.begin_);
+            OutInt(out, range.end_);
+            OutStr(out, node.host_);
+            OutInt(out, node.port_);
+        }
+    }
+
+    auto DoCluster(Cmd &cmd, OutBuf &out) -> void
+    {
+        if (CmdEq(cmd[1], "slots"))
+        {
+            return DoClusterSlots(out);
+        }
+        OutErr(out, CmdErr::ERR_ARG, "unknown cluster subcommand");
+    }
+
+    auto DoPing(Cmd &cmd, OutBuf &out) -> void
+    {
+        if (cmd.size() > 2)
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "wrong number of arguments");
+        }
+        if (cmd.size() == 2)
+        {
+            return OutStr(out, cmd[1]);
+        }
+        OutStatus(out, "PONG");
+    }
+
+    // HELLO [protover]，RESP 连接用它切换 RESP2 / RESP3，回复本身已经按新协议编码
+    auto DoHello(Cmd &cmd, OutBuf &out) -> void
+    {
+        if (out.GetProto() == Proto::NATIVE)
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "HELLO is only supported over RESP");
+        }
+        int64_t ver = out.GetProto() == Proto::RESP3 ? 3 : 2;
+        if (cmd.size() >= 2 && (!str2int(cmd[1], ver) || (ver != 2 && ver != 3)))
+        {
+            return resp::WriteErr(out, "NOPROTO", "unsupported protocol version");
+        }
+        out.SetProto(ver == 3 ? Proto::RESP3 : Proto::RESP2);
+        OutMap(out, 5);
+        OutStr(out, "server");
+        OutStr(out, "kredis");
+        OutStr(out, "version");
+        OutStr(out, "0.1.0");
+        OutStr(out, "proto");
+        OutInt(out, ver);
+        OutStr(out, "mode");
+        OutStr(out, cluster::g_cluster.enabled_ ? "cluster" : "standalone");
+        OutStr(out, "role");
+        OutStr(out, "master");
+    }
+
+    // SLOWLOG GET [count] | LEN | RESET
+    // GET 的每一条为 [id, unix 时间, 微秒, [参数...], 客户端 fd]，最新的在前
+    auto DoSlowlog(Cmd &cmd, OutBuf &out) -> void
+    {
+        auto &log = slowlog::g_slowlog;
+        if (CmdEq(cmd[1], "get") && cmd.size() <= 3)
+        {
+            int64_t count = 10;
+            if (cmd.size() == 3 && (!str2int(cmd[2], count) || count < -1))
+            {
+                return OutErr(out, CmdErr::ERR_ARG, "count should be greater than or equal to -1");
+            }
+            size_t len = count < 0 ? log.Len() : std::min(log.Len(), static_cast<size_t>(count));
+            OutArr(out, static_cast<uint32_t>(len));
+            log.ForEach(len, [&](const slowlog::Entry &entry)
+                        {
+                            OutArr(out, 5);
+                            OutInt(out, static_cast<int64_t>(entry.id_));
+                            OutInt(out, entry.time_);
+                            OutInt(out, static_cast<int64_t>(entry.usec_));
+                            OutArr(out, static_cast<uint32_t>(entry.args_.size()));
+                            for (const auto &arg : entry.args_)
+                            {
+                                OutStr(out, arg);
+                            }
+                            OutInt(out, entry.fd_); });
+            return;
+        }
+        if (CmdEq(cmd[1], "len") && cmd.size() == 2)
+        {
+            return OutInt(out, static_cast<int64_t>(log.Len()));
+        }
+        if (CmdEq(cmd[1], "reset") && cmd.size() == 2)
+        {
+            log.Reset();
+            return OutOk(out);
+        }
+        OutErr(out, CmdErr::ERR_ARG, "unknown slowlog subcommand or wrong number of arguments");
+    }
+
+    // LATENCY LATEST | HISTORY event | RESET [event ...] | PHASES
+    //   LATEST   每个有样本的事件：[名字, 最近一次的 unix 时间, 最近一次的微秒数, 最大微秒数]
+    //   HISTORY  [unix 时间, 微秒数, 这一轮中耗时最多的阶段]，从旧到新
+    //   PHASES   每个阶段：[名字, 累计微秒数, 单轮最大微秒数]，poll 为等待事件的时间
+    auto DoLatency(Cmd &cmd, OutBuf &out) -> void
+    {
+        auto &monitor = latency::g_monitor;
+        if (CmdEq(cmd[1], "latest") && cmd.size() == 2)
+        {
+            std::vector<size_t> events;
+            for (size_t index = 0; index < latency::k_events; index++)
+            {
+                if (!monitor.Get(index).Empty())
+                    events.push_back(index);
+            }
+            OutArr(out, static_cast<uint32_t>(events.size()));
+            for (size_t index : events)
+            {
+                const auto &event = monitor.Get(index);
+                OutArr(out, 4);
+                OutStr(out, std::string(latency::Monitor::Name(index)));
+                OutInt(out, event.Latest().time_);
+                OutInt(out, static_cast<int64_t>(event.Latest().usec_));
+                OutInt(out, static_cast<int64_t>(event.MaxUsec()));
+            }
+            return;
+        }
+        if (CmdEq(cmd[1], "history") && cmd.size() == 3)
+        {
+            size_t index = latency::Monitor::Find(cmd[2]);
+            if (index == latency::k_events)
+            {
+                return OutArr(out, 0);
+            }
+            const auto &event = monitor.Get(index);
+            OutArr(out, static_cast<uint32_t>(event.Len()));
+            event.ForEach([&](const latency::Sample &sample)
+                          {
+                              OutArr(out, 3);
+                              OutInt(out, sample.time_);
+                              OutInt(out, static_cast<int64_t>(sample.usec_));
+                              OutStr(out, stats::k_phase_names[static_cast<size_t>(sample.phase_)]); });
+            return;
+        }
+        if (CmdEq(cmd[1], "reset"))
+        {
+            int64_t reset = 0;
+            for (size_t index = 0; index < latency::k_events; index++)
+            {
+                bool wanted = cmd.size() == 2;
+                for (size_t arg = 2; arg < cmd.size() && !wanted; arg++)
+                {
+                    wanted = latency::Monitor::Find(cmd[arg]) == index;
+                }
+                if (wanted)
+                    reset += monitor.Reset(index);
+            }
+            return OutInt(out, reset);
+        }
+        if (CmdEq(cmd[1], "phases") && cmd.size() == 2)
+        {
+            const auto &phases = stats::g_server.phases_;
+            double us_per_cycle = stats::NsPerCycle() / 1000;
+            OutArr(out, static_cast<uint32_t>(stats::k_phases));
+            for (size_t index = 0; index < stats::k_phases; index++)
+            {
+                OutArr(out, 3);
+                OutStr(out, stats::k_phase_names[index]);
+                OutInt(out, static_cast<int64_t>(static_cast<double>(phases.Total()[index]) * us_per_cycle));
+                OutInt(out, static_cast<int64_t>(static_cast<double>(phases.Max()[index]) * us_per_cycle));
+            }
+            return;
+        }
+        OutErr(out, CmdErr::ERR_ARG, "unknown latency subcommand or wrong number of arguments");
+    }
+
+    // HOTKEYS [count]，按访问频率从高到低，每个为 [key, 计数器]；计数器是对数的，255 为上限
+    auto DoHotKeys(Cmd &cmd, OutBuf &out) -> void
+    {
+        int64_t count = 10;
+        if (cmd.size() > 2 || (cmd.size() == 2 && (!str2int(cmd[1], count) || count < 0)))
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "usage: HOTKEYS [count]");
+        }
+        // 表中的 key 可能已经删除，顺便清掉
+        std::vector<std::pair<std::string, uint8_t>> hot;
+        const auto &items = core::g_hot.Items();
+        for (size_t index = items.size(); index-- > 0;)
+        {
+            auto probe = std::make_shared<core::Entry>(items[index].key_);
+            HNodePtr hnode = core::m_map.Lookup(probe, core::EntryEq);
+            if (hnode == nullptr)
+            {
+                core::g_hot.Remove(index);
+                continue;
+            }
+            auto ent = dyn_cast<core::Entry, HNode>(hnode);
+            hot.emplace_back(ent->key_, lfu::Decay(ent->lfu_, ent->lfu_time_));
+        }
+        std::sort(hot.begin(), hot.end(), [](const auto &lhs, const auto &rhs)
+                  { return lhs.second > rhs.second; });
+        hot.resize(std::min(hot.size(), static_cast<size_t>(count)));
+        OutArr(out, static_cast<uint32_t>(hot.size()));
+        for (const auto &[key, counter] : hot)
+        {
+            OutArr(out, 2);
+            OutStr(out, key);
+            OutInt(out, counter);
+        }
+    }
+
+    // BIGKEYS START [top] 开始一次后台扫描；BIGKEYS STATUS 返回
+    // [状态, 已扫描的 key 数, [[key, 字节数]...], [[key, 成员数]...] ...]，依次为最大的 string、zset、hash、set、list、stream
+    auto DoBigKeys(Cmd &cmd, OutBuf &out) -> void
+    {
+        auto &big = core::g_bigkeys;
+        if (CmdEq(cmd[1], "start") && cmd.size() <= 3)
+        {
+            int64_t top = 10;
+            if (cmd.size() == 3 && (!str2int(cmd[2], top) || top <= 0))
+            {
+                return OutErr(out, CmdErr::ERR_ARG, "top should be positive");
+            }
+            big.Start(static_cast<size_t>(top));
+            return OutOk(out);
+        }
+        if (CmdEq(cmd[1], "status") && cmd.size() == 2)
+        {
+            using State = core::BigKeys::State;
+            auto state = big.GetState();
+            OutArr(out, 8);
+            OutStatus(out, state == State::IDLE ? "idle" : state == State::RUNNING ? "running"
+                                                                                  : "done");
+            OutInt(out, static_cast<int64_t>(big.Scanned()));
+            for (const auto *items : {&big.Strings(), &big.ZSets(), &big.Hashes(), &big.Sets(), &big.Lists(), &big.Streams()})
+            {
+                OutArr(out, static_cast<uint32_t>(items->size()));
+                for (const auto &item : *items)
+                {
+                    OutArr(out, 2);
+                    OutStr(out, item.key_);
+                    OutInt(out, static_cast<int64_t>(item.size_));
+                }
+            }
+            return;
+        }
+        OutErr(out, CmdErr::ERR_ARG, "unknown bigkeys subcommand or wrong number of arguments");
+    }
+
+    // 要遍历命令表，定义在命令表之后
+    auto DoInfo(Cmd &cmd, OutBuf &out) -> void;
+
+    // 命令表，新增命令只需要在这里加一行
+    //   name       arity  flags                        first last step handler
+    inline constexpr CmdDesc k_cmd_table[] = {
+        {"key", 1, CMD_READONLY, 0, 0, 0, DoKeys},
+        {"get", 2, CMD_READONLY, 1, 1, 1, DoGet},
+        {"set", 3, CMD_WRITE, 1, 1, 1, DoSet},
+        {"del", 2, CMD_WRITE, 1, 1, 1, DoDel},
+        {"zadd", 4, CMD_WRITE, 1, 1, 1, DoZAdd},
+        {"zrem", 3, CMD_WRITE, 1, 1, 1, DoZRem},
+        {"zscore", 3, CMD_READONLY, 1, 1, 1, DoZScore},
+        {"zquery", 6, CMD_READONLY, 1, 1, 1, DoZQuery},
+        {"zrank", 3, CMD_READONLY, 1, 1, 1, DoZRank},
+        {"zrevrank", 3, CMD_READONLY, 1, 1, 1, DoZRevRank},
+        {"zrange", -4, CMD_READONLY, 1, 1, 1, DoZRange},
+        {"zrevrangebyscore", -4, CMD_READONLY, 1, 1, 1, DoZRevRangeByScore},
+        {"zcount", 4, CMD_READONLY, 1, 1, 1, DoZCount},
+        {"zunionstore", -4, CMD_WRITE | CMD_MULTI_KEY | CMD_NUMKEYS, 1, 1, 1, DoZUnionStore},
+        {"zinterstore", -4, CMD_WRITE | CMD_MULTI_KEY | CMD_NUMKEYS, 1, 1, 1, DoZInterStore},
+        {"hset", -4, CMD_WRITE, 1, 1, 1, DoHSet},
+        {"hget", 3, CMD_READONLY, 1, 1, 1, DoHGet},
+        {"hmget", -3, CMD_READONLY, 1, 1, 1, DoHMGet},
+        {"hdel", -3, CMD_WRITE, 1, 1, 1, DoHDel},
+        {"hgetall", 2, CMD_READONLY, 1, 1, 1, DoHGetAll},
+        {"hincrby", 4, CMD_WRITE, 1, 1, 1, DoHIncrBy},
+        {"sadd", -3, CMD_WRITE, 1, 1, 1, DoSAdd},
+        {"srem", -3, CMD_WRITE, 1, 1, 1, DoSRem},
+        {"sismember", 3, CMD_READONLY, 1, 1, 1, DoSIsMember},
+        {"scard", 2, CMD_READONLY, 1, 1, 1, DoSCard},
+        {"sinter", -2, CMD_READONLY | CMD_MULTI_KEY, 1, -1, 1, DoSInter},
+        {"sunion", -2, CMD_READONLY | CMD_MULTI_KEY, 1, -1, 1, DoSUnion},
+        {"sdiff", -2, CMD_READONLY | CMD_MULTI_KEY, 1, -1, 1, DoSDiff},
+        {"setbit", 4, CMD_WRITE, 1, 1, 1, DoSetBit},
+        {"getbit", 3, CMD_READONLY, 1, 1, 1, DoGetBit},
+        {"bitcount", -2, CMD_READONLY, 1, 1, 1, DoBitCount},
+        {"bitop", -4, CMD_WRITE | CMD_MULTI_KEY, 2, -1, 1, DoBitOp},
+        {"pfadd", -2, CMD_WRITE, 1, 1, 1, DoPfAdd},
+        {"pfcount", -2, CMD_READONLY | CMD_MULTI_KEY, 1, -1, 1, DoPfCount},
+        {"pfmerge", -2, CMD_WRITE | CMD_MULTI_KEY, 1, -1, 1, DoPfMerge},
+        {"lpush", -3, CMD_WRITE, 1, 1, 1, DoLPush},
+        {"rpush", -3, CMD_WRITE, 1, 1, 1, DoRPush},
+        {"lpop", -2, CMD_WRITE, 1, 1, 1, DoLPop},
+        {"rpop", -2, CMD_WRITE, 1, 1, 1, DoRPop},
+        {"lrange", 4, CMD_READONLY, 1, 1, 1, DoLRange},
+        {"ltrim", 4, CMD_WRITE, 1, 1, 1, DoLTrim},
+        {"llen", 2, CMD_READONLY, 1, 1, 1, DoLLen},
+        {"blpop", -3, CMD_WRITE | CMD_MULTI_KEY, 1, -2, 1, DoBLPop},
+        {"brpop", -3, CMD_WRITE | CMD_MULTI_KEY, 1, -2, 1, DoBRPop},
+        {"cluster", 2, CMD_ADMIN, 0, 0, 0, DoCluster},
+        {"xadd", -5, CMD_WRITE, 1, 1, 1, DoXAdd},
+        {"xlen", 2, CMD_READONLY, 1, 1, 1, DoXLen},
+        {"xrange", -4, CMD_READONLY, 1, 1, 1, DoXRange},
+        {"xread", -4, CMD_READONLY | CMD_MULTI_KEY | CMD_STREAMS, 1, -1, 1, DoXRead},
+        {"xtrim", -4, CMD_WRITE, 1, 1, 1, DoXTrim},
+        {"publish", 3, CMD_READONLY, 0, 0, 0, DoPublish},
+        {"subscribe", -2, CMD_PUBSUB, 0, 0, 0, DoSubscribe},
+        {"unsubscribe", -1, CMD_PUBSUB, 0, 0, 0, DoUnsubscribe},
+        {"psubscribe", -2, CMD_PUBSUB, 0, 0, 0, DoPSubscribe},
+        {"punsubscribe", -1, CMD_PUBSUB, 0, 0, 0, DoPUnsubscribe},
+        {"ping", -1, CMD_READONLY | CMD_PUBSUB, 0, 0, 0, DoPing},
+        {"hello", -1, CMD_ADMIN, 0, 0, 0, DoHello},
+        {"info", -1, CMD_ADMIN, 0, 0, 0, DoInfo},
+        {"slowlog", -2, CMD_ADMIN, 0, 0, 0, DoSlowlog},
+        {"latency", -2, CMD_ADMIN, 0, 0, 0, DoLatency},
+        {"hotkeys", -1, CMD_ADMIN, 0, 0, 0, DoHotKeys},
+        {"bigkeys", -2, CMD_ADMIN, 0, 0, 0, DoBigKeys},
+    };
+    inline constexpr auto k_cmd_index = cmd::MakePerfectHash(k_cmd_table);
+    static_assert(cmd::MultiKeyFlagged(k_cmd_table), "commands with several key positions need CMD_MULTI_KEY");
+    // 与 k_cmd_table 一一对应
+    inline stats::CmdStat g_cmd_stats[std::size(k_cmd_table)];
+
+    auto LookupCmd(std::string_view name) -> const CmdDesc *
+    {
+        return cmd::Lookup(k_cmd_table, k_cmd_index, name);
+    }
+
+    // 集群模式下检查 key 是否由本节点负责，不是则回复 MOVED
+    // CMD_MULTI_KEY 命令的所有 key 必须在同一个 slot，其他命令只有 first_key_ 一个 key
+    auto CheckSlot(const CmdDesc &desc, const Cmd &cmd, OutBuf &out) -> bool
+    {
+        if (!cluster::g_cluster.enabled_ || desc.first_key_ == 0)
+        {
+            return true;
+        }
+        int64_t slot = -1;
+        bool cross_slot = false;
+        if (!desc.Has(CMD_MULTI_KEY))
+        {
+            slot = static_cast<int64_t>(cluster::KeyHashSlot(cmd[desc.first_key_]));
+        }
+        else
+        {
+            desc.ForEachKey(cmd, [&](int32_t index)
+                            {
+                                auto key_slot = static_cast<int64_t>(cluster::KeyHashSlot(cmd[index]));
+                                cross_slot |= (slot >= 0 && slot != key_slot);
+                                slot = key_slot; });
+        }
+        if (cross_slot)
+        {
+            OutCrossSlot(out);
+            return false;
+        }
+        if (slot < 0 || cluster::g_cluster.IsMine(slot))
+        {
+            return true;
+        }
+        const auto *owner = cluster::g_cluster.slots_.Owner(slot);
+        if (owner == nullptr)
+        {
+            OutErr(out, CmdErr::ERR_CLUSTERDOWN, "CLUSTERDOWN slot " + std::to_string(slot) + " is not served");
+            return false;
+        }
+        OutErr(out, CmdErr::ERR_MOVED, "MOVED " + std::to_string(slot) + " " + owner->ToString());
+        return false;
+    }
+
+    auto Interpret(Cmd &cmd, OutBuf &out) -> void
+    {
+        const CmdDesc *desc = cmd.empty() ? nullptr : LookupCmd(cmd[0]);
+        if (desc == nullptr)
+        {
+            OutErr(out, CmdErr::Err_UNKNOWN, "unknown command");
+            return;
+        }
+        if (!desc->CheckArity(cmd.size()))
+        {
+            OutErr(out, CmdErr::ERR_ARG, "wrong number of arguments");
+            return;
+        }
+        if (!CheckSlot(*desc, cmd, out))
+        {
+            return;
+        }
+        // 有订阅时 RESP2 / 原生协议分不清消息和回复，只允许管理订阅；RESP3 的消息是 push 类型，不受限制
+        if (pubsub::g_current != nullptr && pubsub::g_current->Count() != 0 && out.GetProto() != Proto::RESP3 &&
+            !desc->Has(CMD_PUBSUB))
+        {
+            OutErr(out, CmdErr::ERR_ARG, "only (P)SUBSCRIBE / (P)UNSUBSCRIBE / PING allowed in this context");
+            return;
+        }
+        // handler 可能把参数 move 走，先给慢查询日志留一份
+        bool slow_log = slowlog::g_slowlog.Enabled();
+        if (slow_log)
+        {
+            slowlog::g_slowlog.Capture(cmd);
+        }
+        uint64_t start = stats::Cycles();
+        desc->handler_(cmd, out);
+        uint64_t cycles = stats::Cycles() - start;
+        g_cmd_stats[desc - k_cmd_table].latency_.Record(cycles);
+        stats::g_server.commands_++;
+        stats::g_server.phases_.Add(stats::Phase::EXEC, cycles);
+        if (slow_log && cycles > slowlog::g_slowlog.Threshold())
+        {
+            slowlog::g_slowlog.Add(cycles, slowlog::g_client_fd);
+        }
+        if (block::g_registry.HasReady())
+        {
+            ServeBlocked();
+        }
+    }
+
+    namespace info
+    {
+        inline auto Line(std::string &text, const char *fmt, ...) -> void
+        {
+            char buf[256];
+            va_list args;
+            va_start(args, fmt);
+            int len = vsnprintf(buf, sizeof(buf), fmt, args);
+            va_end(args);
+            text.append(buf, static_cast<size_t>(std::clamp(len, 0, static_cast<int>(sizeof(buf)) - 1)));
+            text += "\r\n";
+        }
+
+        // section 为空、all 或与 name 相同时输出该段
+        inline auto Want(const std::string &section, std::string_view name) -> bool
+        {
+            return section.empty() || CmdEq(section, "all") || CmdEq(section, name);
+        }
+    }
+
+    // INFO [section]，格式与 Redis 相同：# 段名，之后每行一个 key:value
+    // 耗时都换算成微秒；commandstats / latencystats 只列出调用过的命令
+    auto DoInfo(Cmd &cmd, OutBuf &out) -> void
+    {
+        if (cmd.size() > 2)
+        {
+            return OutErr(out, CmdErr::ERR_ARG, "wrong number of arguments");
+        }
+        const std::string section = cmd.size() == 2 ? cmd[1] : "";
+        auto &srv = stats::g_server;
+        uint64_t now_us = GetMonotonicUsec();
+        srv.ops_.Tick(now_us, srv.commands_);
+        double us_per_cycle = stats::NsPerCycle() / 1000;
+        auto to_us = [&](uint64_t cycles)
+        { return static_cast<double>(cycles) * us_per_cycle; };
+
+        std::string text;
+        if (info::Want(section, "server"))
+        {
+            text += "# Server\r\n";
+            info::Line(text, "kredis_version:0.1.0");
+            info::Line(text, "process_id:%d", static_cast<int>(getpid()));
+            info::Line(text, "uptime_in_seconds:%llu", static_cast<unsigned long long>((now_us - srv.start_us_) / 1000000));
+            info::Line(text, "cluster_enabled:%d", cluster::g_cluster.enabled_ ? 1 : 0);
+        }
+        if (info::Want(section, "clients"))
+        {
+            text += "# Clients\r\n";
+            info::Line(text, "connected_clients:%llu", static_cast<unsigned long long>(srv.connected_clients_));
+            info::Line(text, "blocked_clients:%llu", static_cast<unsigned long long>(block::g_registry.Blocked()));
+        }
+        if (info::Want(section, "stats"))
+        {
+            text += "# Stats\r\n";
+            info::Line(text, "total_connections_received:%llu", static_cast<unsigned long long>(srv.connections_received_));
+            info::Line(text, "total_commands_processed:%llu", static_cast<unsigned long long>(srv.commands_));
+            info::Line(text, "instantaneous_ops_per_sec:%llu", static_cast<unsigned long long>(srv.ops_.PerSec()));
+            info::Line(text, "expired_keys:%llu", static_cast<unsigned long long>(srv.expired_keys_));
+            info::Line(text, "evicted_keys:%llu", static_cast<unsigned long long>(srv.evicted_keys_));
+            info::Line(text, "pubsub_channels:%zu", pubsub::g_hub.Channels());
+            info::Line(text, "pubsub_patterns:%zu", pubsub::g_hub.Patterns());
+            info::Line(text, "pubsub_output_limit_disconnections:%llu",
+                       static_cast<unsigned long long>(pubsub::g_hub.Disconnections()));
+            info::Line(text, "eventloop_cycles:%llu", static_cast<unsigned long long>(srv.loops_));
+            info::Line(text, "eventloop_duration_usec_mean:%.3f", srv.loop_.Mean() * us_per_cycle);
+            info::Line(text, "eventloop_duration_usec_p99:%.3f", to_us(srv.loop_.Percentile(99)));
+            info::Line(text, "eventloop_duration_usec_max:%.3f", to_us(srv.loop_.Max()));
+            for (size_t index = 0; index < stats::k_phases; index++)
+            {
+                info::Line(text, "eventloop_%s_usec:%.0f", stats::k_phase_names[index], to_us(srv.phases_.Total()[index]));
+            }
+        }
+        if (info::Want(section, "keyspace"))
+        {
+            text += "# Keyspace\r\n";
+            info::Line(text, "keys:%zu", core::m_map.Size());
+            info::Line(text, "rehashing_remaining:%zu", core::m_map.Migrating());
+        }
+        if (info::Want(section, "commandstats"))
+        {
+            text += "# Commandstats\r\n";
+            for (size_t index = 0; index < std::size(k_cmd_table); index++)
+            {
+                const auto &lat = g_cmd_stats[index].latency_;
+                if (lat.Count() == 0)
+                    continue;
+                info::Line(text, "cmdstat_%s:calls=%llu,usec=%.0f,usec_per_call=%.3f",
+                           std::string(k_cmd_table[index].name_).c_str(), static_cast<unsigned long long>(lat.Count()),
+                           to_us(lat.Sum()), lat.Mean() * us_per_cycle);
+            }
+        }
+        if (info::Want(section, "latencystats"))
+        {
+            text += "# Latencystats\r\n";
+            for (size_t index = 0; index < std::size(k_cmd_table); index++)
+            {
+                const auto &lat = g_cmd_stats[index].latency_;
+                if (lat.Count() == 0)
+                    continue;
+                info::Line(text, "latency_percentiles_usec_%s:p50=%.3f,p99=%.3f,p99.9=%.3f,max=%.3f",
+                           std::string(k_cmd_table[index].name_).c_str(), to_us(lat.Percentile(50)),
+                           to_us(lat.Percentile(99)), to_us(lat.Percentile(99.9)), to_us(lat.Max()));
+            }
         }
+        OutStr(out, text);
     }
 }
 
@@ -4,8 +4,12 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <linux/errqueue.h>
 
 #include "bytes.h"
+#include "buffer.h"
 namespace kath
 {
     auto FDSetNB(int fd) -> void
@@ -37,7 +41,13 @@ namespace kath
 
     public:
         File(int fd = -1) : fd_(fd){};
-        ~File();
+        ~File()
+        {
+            if (fd_ >= 0)
+            {
+                close(fd_);
+            }
+        }
         File(File &&other) : fd_(other.fd_) { other.fd_ = -1; }
         File(File &) = delete;
         File &operator=(const File &) = delete;
@@ -117,7 +127,7 @@ namespace kath
             }
             bytes.pos_ += write_len;
             assert(bytes.pos_ <= bytes.Size());
-            return bytes.pos_ != bytes.Size();
+            return 0;
         }
 
         // 从fd中以非阻塞模式写入bytes
@@ -149,6 +159,104 @@ namespace kath
             }
             return 1;
         }
+
+        // 以非阻塞模式把fd中的数据读进buf的可写空间，调用前需要先Reserve
+        // 返回值含义   1:失败   0:读成功    -1:阻塞    2:读到EOF
+        auto ReadBuf_nb(IoBuf &buf) -> int
+        {
+            assert(buf.Writable() > 0);
+            ssize_t read_len = 0;
+            do {
+                read_len = read(fd_, buf.BeginWrite(), buf.Writable());
+            } while (read_len < 0 && errno == EINTR);
+
+            if (read_len > 0)
+            {
+                buf.HasWritten(static_cast<size_t>(read_len));
+                return 0;
+            }
+            if (read_len == 0)
+            {
+                return 2;
+            }
+            if (errno == EAGAIN)
+            {
+                return -1;
+            }
+            return 1;
+        }
+
+        // 以非阻塞模式把out中排队的数据用sendmsg写出，大的引用段用 MSG_ZEROCOPY 发送
+        // zc_min 为 0 时不使用 MSG_ZEROCOPY，zerocopy 返回本次是否以零拷贝方式发出
+        // 每条路径都带 MSG_NOSIGNAL，对端重置时返回失败而不是收到 SIGPIPE
+        // 返回值含义   1:失败   0:写成功    -1:阻塞
+        auto WriteOut_nb(OutBuf &out, size_t zc_min, bool &zerocopy) -> int
+        {
+            iovec iov[k_max_iov];
+            int cnt = out.BuildIov(iov, k_max_iov, zc_min, zerocopy);
+            msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = cnt;
+            ssize_t write_len = 0;
+            do {
+                if (zerocopy)
+                {
+                    write_len = sendmsg(fd_, &msg, MSG_ZEROCOPY | MSG_NOSIGNAL);
+                    if (write_len < 0 && errno == ENOBUFS)
+                    {
+                        // 超出 optmem 限制时退回普通发送
+                        zerocopy = false;
+                        write_len = sendmsg(fd_, &msg, MSG_NOSIGNAL);
+                    }
+                }
+                else
+                {
+                    write_len = sendmsg(fd_, &msg, MSG_NOSIGNAL);
+                }
+            } while (write_len < 0 && errno == EINTR);
+            if (write_len < 0)
+            {
+                if (errno == EAGAIN)
+                {
+                    return -1;
+                }
+                return 1;
+            }
+            out.Consume(static_cast<size_t>(write_len));
+            return 0;
+        }
+
+        auto SetZeroCopy() -> bool
+        {
+            int val = 1;
+            return setsockopt(fd_, SOL_SOCKET, SO_ZEROCOPY, &val, sizeof(val)) == 0;
+        }
+
+        // 从错误队列中取一条消息，队列为空时返回false
+        // 如果是零拷贝完成通知，done 置为 true，序号不大于 hi 的 sendmsg 都已完成
+        auto ReadZeroCopyDone(uint32_t &hi, bool &done) -> bool
+        {
+            done = false;
+            char control[128];
+            msghdr msg{};
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            if (recvmsg(fd_, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+            {
+                return false;
+            }
+            for (cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm))
+            {
+                auto *serr = reinterpret_cast<sock_extended_err *>(CMSG_DATA(cm));
+                if (serr->ee_errno == 0 && serr->ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+                {
+                    hi = serr->ee_data;
+                    done = true;
+                    return true;
+                }
+            }
+            return true;
+        }
     };
 
 }
@@ -0,0 +1,179 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+/*
+原生协议的请求帧
+    u32 len | u32 argc | (u32 arg_len | arg) * argc
+len 为后面正文的长度。
+
+Parser 是可续传的状态机：数据不完整时记住断点，下次从断点继续，已经解析过的参数不会重新扫描。
+读到帧长度时就检查 g_max_frame，读到每个参数的长度时就检查它是否超出帧的剩余部分，
+超限的帧在正文到达之前就被拒绝。没有超限的帧也不会按客户端给出的长度一次分配好，
+连接每次最多多预留 k_max_reserve 字节，缓冲区随着数据的到达增长（见 connect.h 的 ReserveFor），
+只发一个帧头的客户端占不了多少内存。
+*/
+
+#include <cstddef>
+#include <cstring>
+
+#include "public.h"
+#include "command.h"
+
+namespace kath::frame
+{
+    // 单个请求帧（RESP 为单个参数）的最大长度与参数个数，两种协议共用，可以用 --max-frame 调大
+    inline size_t g_max_frame = 4ull * 1024 * 1024;
+    inline size_t g_max_args = 1024 * 1024;
+    // 为不完整的帧预先分配的最大字节数
+    inline constexpr size_t k_max_reserve = 64 * 1024;
+
+    class Parser
+    {
+    private:
+        enum class State
+        {
+            FRAME_LEN,
+            ARGC,
+            ARG_LEN,
+            ARG_BODY,
+        };
+        State state_{State::FRAME_LEN};
+        size_t pos_{0};
+        size_t frame_end_{0};
+        uint32_t argc_{0};
+        uint32_t argi_{0};
+        uint32_t arg_len_{0};
+        const char *err_{""};
+
+        static auto ReadU32(const std::byte *data) -> uint32_t
+        {
+            uint32_t val = 0;
+            std::memcpy(&val, data, 4);
+            return val;
+        }
+        auto Fail(const char *err) -> int
+        {
+            err_ = err;
+            return -1;
+        }
+        auto Done(size_t &consumed) -> int
+        {
+            consumed = frame_end_;
+            pos_ = 0;
+            state_ = State::FRAME_LEN;
+            return 1;
+        }
+
+        // 整帧已经到齐（pipeline 中的绝大多数请求）时不经过状态机，检查与逐段解析时相同
+        auto ParseWhole(const std::byte *data, Cmd &cmd, size_t &consumed) -> int
+        {
+            uint32_t argc = ReadU32(data + 4);
+            if (argc > g_max_args)
+                return Fail("too many arguments");
+            size_t pos = 8;
+            if (argc > (frame_end_ - pos) / 4)
+                return Fail("bad frame");
+            cmd.resize(argc);
+            for (auto &arg : cmd)
+            {
+                if (frame_end_ - pos < 4)
+                    return Fail("bad frame");
+                uint32_t arg_len = ReadU32(data + pos);
+                pos += 4;
+                if (frame_end_ - pos < arg_len)
+                    return Fail("bad frame");
+                arg.assign(reinterpret_cast<const char *>(data + pos), arg_len);
+                pos += arg_len;
+            }
+            if (pos != frame_end_)
+                return Fail("bad frame");
+            return Done(consumed);
+        }
+
+    public:
+        // 出错时的原因
+        [[nodiscard]] auto Error() const -> const char * { return err_; }
+
+        // 下一次至少需要多少字节才可能有进展，帧长度已知时为整帧的长度
+        [[nodiscard]] auto Need() const -> size_t
+        {
+            return state_ == State::FRAME_LEN ? 4 : frame_end_;
+        }
+
+        // 返回 1:得到一条完整命令，consumed 为整帧的字节数   0:数据不够   -1:帧不合法，原因见 Error()
+        // data 必须从帧头开始，两次调用之间调用方不能消费数据
+        auto Parse(const std::byte *data, size_t len, Cmd &cmd, size_t &consumed) -> int
+        {
+            for (;;)
+            {
+                switch (state_)
+                {
+                case State::FRAME_LEN:
+                {
+                    if (len < 4)
+                        return 0;
+                    uint32_t frame_len = ReadU32(data);
+                    if (frame_len > g_max_frame)
+                        return Fail("frame too large");
+                    if (frame_len < 4)
+                        return Fail("bad frame");
+                    frame_end_ = 4 + static_cast<size_t>(frame_len);
+                    pos_ = 4;
+                    if (len >= frame_end_)
+                    {
+                        return ParseWhole(data, cmd, consumed);
+                    }
+                    state_ = State::ARGC;
+                    break;
+                }
+                case State::ARGC:
+                {
+                    if (len < 8)
+                        return 0;
+                    argc_ = ReadU32(data + 4);
+                    // 每个参数至少占 4 字节的长度
+                    if (argc_ > g_max_args)
+                        return Fail("too many arguments");
+                    if (argc_ > (frame_end_ - 8) / 4)
+                        return Fail("bad frame");
+                    pos_ = 8;
+                    argi_ = 0;
+                    cmd.resize(argc_);
+                    state_ = State::ARG_LEN;
+                    break;
+                }
+                case State::ARG_LEN:
+                {
+                    if (argi_ == argc_)
+                    {
+                        if (pos_ != frame_end_)
+                            return Fail("bad frame");
+                        return Done(consumed);
+                    }
+                    if (len - pos_ < 4)
+                        return 0;
+                    arg_len_ = ReadU32(data + pos_);
+                    pos_ += 4;
+                    // 后面的参数至少还要各占 4 字节
+                    size_t rest = static_cast<size_t>(argc_ - argi_ - 1) * 4;
+                    if (frame_end_ - pos_ < rest || arg_len_ > frame_end_ - pos_ - rest)
+                        return Fail("bad frame");
+                    state_ = State::ARG_BODY;
+                    break;
+                }
+                case State::ARG_BODY:
+                {
+                    if (len - pos_ < arg_len_)
+                        return 0;
+                    cmd[argi_++].assign(reinterpret_cast<const char *>(data + pos_), arg_len_);
+                    pos_ += arg_len_;
+                    state_ = State::ARG_LEN;
+                    break;
+                }
+                }
+            }
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef HASH_H
+#define HASH_H
+
+/*
+参考 wyhash (https://github.com/wangyi-fudan/wyhash)
+每轮用 64x64->128 位乘法混合 16 字节，长 key 每轮 3 路并行处理 48 字节，
+相比逐字节 *257 的做法更快，前缀相同的 key（如 user:12345）低位也分布得很均匀。
+seed 参与每一轮混合，Server 每次启动都会重新随机 seed。
+乘法用 wyhash 的 protected 模式：乘积再异或回两个输入。否则一路输入为 0 时乘积为 0，
+例如 key 的前 8 字节等于 k_secret[1] 时 seed 被整个抹掉，之后的 hash 与 seed 无关，可以离线构造出碰撞；
+异或回输入后另一路（seed）仍然保留。即使这样，完全相同的 hcode 也由 HTab 把长链转成树兜底（见 hashtable.h）。
+*/
+
+#include <sys/random.h>
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string_view>
+
+namespace kath::hash
+{
+    inline constexpr uint64_t k_secret[4] = {0xa0761d6478bd642full, 0xe7037ed1a0b428dbull,
+                                             0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull};
+    inline constexpr uint64_t k_default_seed = 0x2d358dccaa6c78a5ull;
+
+    // 进程内所有 HNode 的 hcode 都用这个 seed 计算，必须在第一个 key 插入之前设置好
+    inline uint64_t g_hash_seed = k_default_seed;
+    inline auto SetSeed(uint64_t seed) -> void { g_hash_seed = seed; }
+
+    // 每次启动随机生成一个 seed，使外部无法预测 key 会落在哪个桶里
+    inline auto RandomSeed() -> uint64_t
+    {
+        uint64_t seed = 0;
+        if (getrandom(&seed, sizeof(seed), 0) == static_cast<ssize_t>(sizeof(seed)))
+        {
+            return seed;
+        }
+        std::random_device rd;
+        return (static_cast<uint64_t>(rd()) << 32) ^ rd();
+    }
+
+    // 128 位乘积，a 异或上低 64 位，b 异或上高 64 位；保留输入，乘积为 0 时也不会丢掉 seed
+    inline auto Mum(uint64_t &a, uint64_t &b) -> void
+    {
+        __uint128_t r = a;
+        r *= b;
+        a ^= static_cast<uint64_t>(r);
+        b ^= static_cast<uint64_t>(r >> 64);
+    }
+    inline auto Mix(uint64_t a, uint64_t b) -> uint64_t
+    {
+        Mum(a, b);
+        return a ^ b;
+    }
+    inline auto Read8(const uint8_t *p) -> uint64_t
+    {
+        uint64_t v;
+        std::memcpy(&v, p, 8);
+        return v;
+    }
+    inline auto Read4(const uint8_t *p) -> uint64_t
+    {
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+        return v;
+    }
+    // 1~3 字节
+    inline auto Read3(const uint8_t *p, size_t k) -> uint64_t
+    {
+        return (static_cast<uint64_t>(p[0]) << 16) | (static_cast<uint64_t>(p[k >> 1]) << 8) | p[k - 1];
+    }
+
+    inline auto Hash64(const void *key, size_t len, uint64_t seed) -> uint64_t
+    {
+        const auto *p = static_cast<const uint8_t *>(key);
+        seed ^= Mix(seed ^ k_secret[0], k_secret[1]);
+        uint64_t a = 0;
+        uint64_t b = 0;
+        if (len <= 16)
+        {
+            if (len >= 4)
+            {
+                a = (Read4(p) << 32) | Read4(p + ((len >> 3) << 2));
+                b = (Read4(p + len - 4) << 32) | Read4(p + len - 4 - ((len >> 3) << 2));
+            }
+            else if (len > 0)
+            {
+                a = Read3(p, len);
+            }
+        }
+        else
+        {
+            size_t remain = len;
+            if (remain > 48)
+            {
+                uint64_t see1 = seed;
+                uint64_t see2 = seed;
+                do
+                {
+                    seed = Mix(Read8(p) ^ k_secret[1], Read8(p + 8) ^ seed);
+                    see1 = Mix(Read8(p + 16) ^ k_secret[2], Read8(p + 24) ^ see1);
+                    see2 = Mix(Read8(p + 32) ^ k_secret[3], Read8(p + 40) ^ see2);
+                    p += 48;
+                    remain -= 48;
+                } while (remain > 48);
+                seed ^= see1 ^ see2;
+            }
+            while (remain > 16)
+            {
+                seed = Mix(Read8(p) ^ k_secret[1], Read8(p + 8) ^ seed);
+                p += 16;
+                remain -= 16;
+            }
+            a = Read8(p + remain - 16);
+            b = Read8(p + remain - 8);
+        }
+        a ^= k_secret[1];
+        b ^= seed;
+        Mum(a, b);
+        return Mix(a ^ k_secret[0] ^ len, b ^ k_secret[1]);
+    }
+
+    inline auto Hash64(std::string_view str, uint64_t seed = g_hash_seed) -> uint64_t
+    {
+        return Hash64(str.data(), str.size(), seed);
+    }
+}
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef HASHOBJ_H
+#define HASHOBJ_H
+
+/*
+hash 类型的值（field -> value）
+两种编码：
+    compact    所有 field / value 依次紧挨着存在一个 string 里：[flen][field][vlen][value]...，
+               长度各占 1 字节，查找时从头线性扫描。小 hash 只占一块内存，没有每个 field 的节点开销
+    table      HMap，每个 field 一个节点
+field 数超过 k_compact_max_entries，或者写入的 field / value 超过 k_compact_max_len 字节时，
+一次性转成 table，之后不再转回（与 Redis 的 listpack -> hashtable 相同）。
+*/
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "public.h"
+#include "hashtable.h"
+#include "zset.h"
+
+namespace kath
+{
+    struct HField : public HKey
+    {
+        std::string val_;
+        HField(std::string field, std::string val) : HKey(std::move(field)), val_(std::move(val)) {}
+    };
+    using HFieldPtr = std::shared_ptr<HField>;
+
+    class HashObj
+    {
+    public:
+        static constexpr size_t k_compact_max_entries = 128;
+        static constexpr size_t k_compact_max_len = 64;
+
+    private:
+        std::string compact_{};
+        size_t compact_size_{0};
+        std::unique_ptr<HMap> table_{}; // 为空时使用 compact 编码
+
+        // compact_ 中 field 的起始位置，找不到时返回 npos
+        [[nodiscard]] auto CompactFind(std::string_view field) const -> size_t
+        {
+            size_t pos = 0;
+            while (pos < compact_.size())
+            {
+                auto flen = static_cast<uint8_t>(compact_[pos]);
+                auto vlen = static_cast<uint8_t>(compact_[pos + 1 + flen]);
+                if (flen == field.size() && compact_.compare(pos + 1, flen, field) == 0)
+                    return pos;
+                pos += 2 + flen + vlen;
+            }
+            return std::string::npos;
+        }
+        // 从 field 的起始位置取出 value
+        [[nodiscard]] auto CompactVal(size_t pos) const -> std::string_view
+        {
+            auto flen = static_cast<uint8_t>(compact_[pos]);
+            auto vlen = static_cast<uint8_t>(compact_[pos + 1 + flen]);
+            return std::string_view(compact_).substr(pos + 2 + flen, vlen);
+        }
+        auto CompactAppend(std::string_view field, std::string_view val) -> void
+        {
+            compact_ += static_cast<char>(field.size());
+            compact_ += field;
+            compact_ += static_cast<char>(val.size());
+            compact_ += val;
+            compact_size_++;
+        }
+        auto ToTable() -> void
+        {
+            auto table = std::make_unique<HMap>();
+            ForEach([&](std::string_view field, std::string_view val)
+                    { table->Insert(std::make_shared<HField>(std::string(field), std::string(val))); });
+            table_ = std::move(table);
+            compact_.clear();
+            compact_.shrink_to_fit();
+            compact_size_ = 0;
+        }
+        auto TableFind(std::string_view field) const -> HFieldPtr
+        {
+            HNodePtr probe = std::make_shared<HKey>(std::string(field));
+            HNodePtr node = table_->Lookup(probe, hkey_cmp);
+            return node == nullptr ? nullptr : dyn_cast<HField, HNode>(node);
+        }
+
+    public:
+        [[nodiscard]] auto Compact() const -> bool { return table_ == nullptr; }
+        [[nodiscard]] auto Size() const -> size_t { return table_ ? table_->Size() : compact_size_; }
+
+        // 返回的 string_view 在下一次修改之前有效
+        [[nodiscard]] auto Get(std::string_view field) const -> std::optional<std::string_view>
+        {
+            if (table_ == nullptr)
+            {
+                size_t pos = CompactFind(field);
+                return pos == std::string::npos ? std::nullopt : std::optional(CompactVal(pos));
+            }
+            auto node = TableFind(field);
+            return node == nullptr ? std::nullopt : std::optional<std::string_view>(node->val_);
+        }
+
+        // 新增 field 时返回 true，覆盖已有的 field 时返回 false
+        auto Set(std::string_view field, std::string_view val) -> bool
+        {
+            if (table_ == nullptr)
+            {
+                if (field.size() > k_compact_max_len || val.size() > k_compact_max_len)
+                {
+                    ToTable();
+                    return Set(field, val);
+                }
+                size_t pos = CompactFind(field);
+                if (pos != std::string::npos)
+                {
+                    size_t old_len = CompactVal(pos).size();
+                    compact_[pos + 1 + field.size()] = static_cast<char>(val.size());
+                    compact_.replace(pos + 2 + field.size(), old_len, val);
+                    return false;
+                }
+                if (compact_size_ == k_compact_max_entries)
+                {
+                    ToTable();
+                    return Set(field, val);
+                }
+                CompactAppend(field, val);
+                return true;
+            }
+            auto node = TableFind(field);
+            if (node != nullptr)
+            {
+                node->val_.assign(val);
+                return false;
+            }
+            table_->Insert(std::make_shared<HField>(std::string(field), std::string(val)));
+            return true;
+        }
+
+        auto Del(std::string_view field) -> bool
+        {
+            if (table_ == nullptr)
+            {
+                size_t pos = CompactFind(field);
+                if (pos == std::string::npos)
+                    return false;
+                compact_.erase(pos, 2 + field.size() + CompactVal(pos).size());
+                compact_size_--;
+                return true;
+            }
+            HNodePtr probe = std::make_shared<HKey>(std::string(field));
+            return table_->Pop(probe, hkey_cmp) != nullptr;
+        }
+
+        // fn(field, value)，顺序不保证
+        template <typename F>
+        auto ForEach(F &&fn) const -> void
+        {
+            if (table_ == nullptr)
+            {
+                for (size_t pos = 0; pos < compact_.size();)
+                {
+                    auto flen = static_cast<uint8_t>(compact_[pos]);
+                    auto val = CompactVal(pos);
+                    fn(std::string_view(compact_).substr(pos + 1, flen), val);
+                    pos += 2 + flen + val.size();
+                }
+                return;
+            }
+            NodeScan node_scan = [&fn](HNodePtr node, void *)
+            {
+                auto field = dyn_cast<HField, HNode>(node);
+                fn(std::string_view(field->name_), std::string_view(field->val_));
+            };
+            table_->Scan(node_scan, nullptr);
+        }
+    };
+}
+
+#endif
@@ -3,11 +3,17 @@
 #include <vector>
 #include <iostream>
 #include <functional>
+#include <map>
 #include <optional>
+#include <string_view>
+#include <utility>
 
 #include "public.h"
+#include "hash.h"
 
 // 本身并不保证线程安全，需要用户自行保证
+// 链长超过 K_MAX_CHAIN 的桶整个转成按 (hcode, key) 排序的树，hcode 完全相同的 key 也只需要 O(log n) 次比较，
+// 同时提前扩容，扩容迁移时树中的节点重新按链插入新表，能分开的就不再留在树里
 namespace kath
 {
     struct HNode;
@@ -20,6 +26,8 @@ namespace kath
     const size_t HASH_TABLE_INIT_SIZE = 4;
     const size_t Load_FACTOR_MAX = 4;
     const size_t K_RESIZING_WORK = 128;
+    // 链长超过该值时转成树并提前扩容，正常负载下几乎不可能达到
+    const size_t K_MAX_CHAIN = 32;
 
     struct HNode
     {
@@ -28,32 +36,102 @@ namespace kath
         HNode() = delete;
         HNode(size_t hcode) : next_(nullptr), hcode_(hcode) {}
         virtual ~HNode() = default;
+        // 桶转成树后按 (hcode, KeyView()) 排序；不提供 key 的节点在树中 hcode 相同时只能逐个比较
+        [[nodiscard]] virtual auto KeyView() const -> std::string_view { return {}; }
     };
     class HTab
     {
         friend class HMap;
 
     private:
+        // 转成树的桶，同一个桶的节点相邻；key 指向节点自己的 KeyView()，节点在树中时一直有效
+        struct TreeKey
+        {
+            size_t index_;
+            size_t hcode_;
+            std::string_view key_;
+            auto operator<(const TreeKey &rhs) const -> bool
+            {
+                if (index_ != rhs.index_)
+                    return index_ < rhs.index_;
+                if (hcode_ != rhs.hcode_)
+                    return hcode_ < rhs.hcode_;
+                return key_ < rhs.key_;
+            }
+        };
+        using Tree = std::multimap<TreeKey, HNodePtr>;
+
         std::vector<HNodePtr> table_;
         size_t mask_;
         size_t size_;
+        bool long_chain_{false}; // 是否出现过超过 K_MAX_CHAIN 的链
+        Tree tree_{};            // 转成树的桶在 table_ 中为空
+
+        auto TreeKeyOf(size_t index, const HNodePtr &node) const -> TreeKey { return {index, node->hcode_, node->KeyView()}; }
+        // 桶 index 在树中的第一个节点，不在树中时返回 end
+        auto TreeBegin(size_t index) const -> Tree::const_iterator
+        {
+            if (tree_.empty())
+                return tree_.end();
+            auto iter = tree_.lower_bound({index, 0, {}});
+            return iter != tree_.end() && iter->first.index_ == index ? iter : tree_.end();
+        }
+        auto TreeFind(const HNodePtr &key, const NodeCmp &cmp) const -> Tree::const_iterator
+        {
+            auto range = tree_.equal_range(TreeKeyOf(GetIndex(key->hcode_), key));
+            for (auto iter = range.first; iter != range.second; ++iter)
+            {
+                if (cmp(iter->second, key))
+                    return iter;
+            }
+            return tree_.end();
+        }
+        // 链太长的桶整个移进树
+        auto ToTree(size_t index) -> void
+        {
+            for (auto cur_node = std::exchange(table_[index], nullptr); cur_node != nullptr;)
+            {
+                auto next_node = std::exchange(cur_node->next_, nullptr);
+                tree_.emplace(TreeKeyOf(index, cur_node), cur_node);
+                cur_node = next_node;
+            }
+            long_chain_ = true;
+        }
 
     public:
         // n必须是 是2^k
         HTab(size_t n) : mask_(n - 1), size_(0), table_{n}
         {
-            std::cout << "HTab:" << n << " table_.size():" << table_.size() << std::endl;
         }
         auto GetLoadFactor() const -> size_t { return size_ / (mask_ + 1); }
         auto CheckLoadFactor() const -> bool { return size_ && GetLoadFactor() >= Load_FACTOR_MAX; }
+        // 出现过长链时提前扩容，但负载因子低于 1/2 后就不再扩，
+        // 否则完全相同的 hcode 会让表无限增长；这样的桶怎么扩都分不开，一直留在树里
+        auto CheckChain() const -> bool { return long_chain_ && size_ * 2 >= mask_ + 1; }
 
         auto GetIndex(size_t hcode) const -> size_t { return hcode & mask_; }
+        auto BucketEmpty(size_t index) const -> bool { return table_[index] == nullptr && TreeBegin(index) == tree_.end(); }
+        auto TreeNodes() const -> size_t { return tree_.size(); }
         auto Insert(HNodePtr node) -> void
         {
             size_t pos = node->hcode_ & mask_;
+            size_++;
+            if (table_[pos] == nullptr && TreeBegin(pos) != tree_.end())
+            {
+                tree_.emplace(TreeKeyOf(pos, node), node);
+                return;
+            }
             node->next_ = table_[pos];
             table_[pos] = node;
-            size_++;
+            size_t len = 0;
+            for (auto cur_node = node; cur_node != nullptr && len <= K_MAX_CHAIN; cur_node = cur_node->next_)
+            {
+                len++;
+            }
+            if (len > K_MAX_CHAIN)
+            {
+                ToTree(pos);
+            }
         }
 
         // 返回key的上一个节点
@@ -62,7 +140,7 @@ namespace kath
         {
             size_t index = GetIndex(key->hcode_);
             auto pre_node = table_[index];
-            while (pre_node != nullptr)
+            while (pre_node != nullptr && pre_node->next_ != nullptr)
             {
                 if (cmp(pre_node->next_, key))
                     return pre_node;
@@ -70,18 +148,23 @@ namespace kath
             }
             return nullptr;
         }
-        //单纯用来查找的
+        //单纯用来查找的，链不会超过 K_MAX_CHAIN，更长的桶在树中
         auto Lookup(HNodePtr key, NodeCmp cmp) -> HNodePtr
         {
             size_t index = GetIndex(key->hcode_);
             auto cur_node = table_[index];
+            if (cur_node == nullptr && !tree_.empty())
+            {
+                auto iter = TreeFind(key, cmp);
+                return iter == tree_.end() ? nullptr : iter->second;
+            }
             while (cur_node != nullptr)
             {
                 if (cmp(cur_node, key))
-                    return cur_node;
+                    break;
                 cur_node = cur_node->next_;
             }
-            return nullptr;
+            return cur_node;
         }
 
         // 参数是需要删除的节点的上一个节点
@@ -96,21 +179,40 @@ namespace kath
             --size_;
             return node;
         }
+        // 桶 index 不能为空
         auto DetachFront(size_t index) -> HNodePtr
         {
             auto cur_node = table_[index];
-            table_[index] = cur_node->next_;
             --size_;
+            if (cur_node == nullptr)
+            {
+                auto iter = TreeBegin(index);
+                cur_node = iter->second;
+                tree_.erase(iter);
+                return cur_node;
+            }
+            table_[index] = cur_node->next_;
+            cur_node->next_ = nullptr;
             return cur_node;
         }
         // 删除key这个节点
         auto Detach(HNodePtr key, NodeCmp cmp) -> HNodePtr
         {
+            if (table_[GetIndex(key->hcode_)] == nullptr && !tree_.empty())
+            {
+                auto iter = TreeFind(key, cmp);
+                if (iter == tree_.end())
+                    return nullptr;
+                auto node = iter->second;
+                tree_.erase(iter);
+                --size_;
+                return node;
+            }
             auto pre_node = LookupPre(key, cmp);
             if (pre_node == nullptr)
             {
                 size_t index = GetIndex(key->hcode_);
-                if (cmp(key, table_[index]))
+                if (table_[index] != nullptr && cmp(table_[index], key))
                 {
                     return DetachFront(index);
                 }
@@ -131,6 +233,38 @@ namespace kath
                     cur_node = cur_node->next_;
                 }
             }
+            for (const auto &[tree_key, node] : tree_)
+            {
+                node_scan(node, extra);
+            }
+        }
+        // 桶 index 中的所有节点，包括树中的
+        auto ScanBucket(size_t index, NodeScan &node_scan, void *extra) const -> void
+        {
+            for (auto cur_node = table_[index]; cur_node != nullptr; cur_node = cur_node->next_)
+            {
+                node_scan(cur_node, extra);
+            }
+            for (auto iter = TreeBegin(index); iter != tree_.end() && iter->first.index_ == index; ++iter)
+            {
+                node_scan(iter->second, extra);
+            }
+        }
+
+        // hist[k] 为长度是 k 的链的数量，超过 hist.size()-1 的计入最后一格；转成树的桶按空链计
+        auto ChainHistogram(std::vector<size_t> &hist) const -> void
+        {
+            if (hist.empty() || !size_)
+                return;
+            for (const auto &head : table_)
+            {
+                size_t len = 0;
+                for (auto cur_node = head; cur_node != nullptr; cur_node = cur_node->next_)
+                {
+                    len++;
+                }
+                hist[std::min(len, hist.size() - 1)]++;
+            }
         }
 
         auto Dispose(NodeDispose node_dispose) -> void
@@ -146,6 +280,10 @@ namespace kath
                     cur_node = next_node;
                 }
             }
+            for (const auto &[tree_key, node] : tree_)
+            {
+                node_dispose(node);
+            }
         }
     };
     class HMap
@@ -153,10 +291,16 @@ namespace kath
     private:
         HTab ht1_{HASH_TABLE_INIT_SIZE}, ht2_{HASH_TABLE_INIT_SIZE};
         size_t resizing_pos{0};
+        size_t early_resizes_{0}; // 因长链触发的扩容次数
 
     public:
         HMap() = default;
         auto Size() const -> size_t { return ht1_.size_ + ht2_.size_; }
+        auto EarlyResizes() const -> size_t { return early_resizes_; }
+        // 在树中（而不是链上）的节点数
+        auto TreeNodes() const -> size_t { return ht1_.TreeNodes() + ht2_.TreeNodes(); }
+        // 渐进式扩容中旧表还剩多少节点没有迁移，为 0 表示没有在扩容
+        auto Migrating() const -> size_t { return ht2_.size_; }
 
         auto ResizingHlep() -> void
         {
@@ -167,7 +311,7 @@ namespace kath
             size_t nwork = 0;
             while (nwork < K_RESIZING_WORK && ht2_.size_ != 0)
             {
-                if (ht2_.table_[resizing_pos] == nullptr)
+                if (ht2_.BucketEmpty(resizing_pos))
                 {
                     ++resizing_pos;
                     continue;
@@ -180,9 +324,18 @@ namespace kath
         {
             assert(ht2_.size_ == 0);
             ht2_ = std::move(ht1_);
-            ht1_ = std::move(ht2_.size_ * 2);
+            ht1_ = HTab((ht2_.mask_ + 1) * 2);
             resizing_pos = 0;
         }
+        // 只有上一次扩容迁移完成后才会因长链再次扩容
+        auto CheckChain() -> void
+        {
+            if (ht2_.size_ == 0 && ht1_.CheckChain())
+            {
+                early_resizes_++;
+                Resizing();
+            }
+        }
         auto Insert(HNodePtr node) -> void
         {
             ht1_.Insert(node);
@@ -199,6 +352,7 @@ namespace kath
             auto res = ht1_.Lookup(key, cmp);
             if (res == nullptr)
                 res = ht2_.Lookup(key, cmp);
+            CheckChain();
             return res;
         }
         auto Pop(HNodePtr key, NodeCmp cmp) -> HNodePtr
@@ -213,18 +367,38 @@ namespace kath
             ht1_.Scan(node_scan, extra);
             ht2_.Scan(node_scan, extra);
         }
+        // 从 cursor 开始按桶遍历，最多走 nbuckets 个桶（先 ht1_ 后 ht2_），返回 false 表示已经遍历完
+        // 两次调用之间如果发生了扩容或迁移，节点可能被漏掉或重复访问，只适合统计类的用途
+        auto ScanStep(size_t &cursor, size_t nbuckets, NodeScan node_scan, void *extra) -> bool
+        {
+            size_t cap1 = ht1_.table_.size();
+            size_t cap2 = ht2_.size_ ? ht2_.table_.size() : 0;
+            for (size_t nwork = 0; nwork < nbuckets; nwork++, cursor++)
+            {
+                if (cursor < cap1)
+                    ht1_.ScanBucket(cursor, node_scan, extra);
+                else if (cursor - cap1 < cap2)
+                    ht2_.ScanBucket(cursor - cap1, node_scan, extra);
+                else
+                    return false;
+            }
+            return cursor < cap1 + cap2;
+        }
+        auto ChainHistogram(std::vector<size_t> &hist) const -> void
+        {
+            ht1_.ChainHistogram(hist);
+            ht2_.ChainHistogram(hist);
+        }
         auto Dispose(NodeDispose node_dispose) -> void
         {
             ht1_.Dispose(node_dispose);
             ht2_.Dispose(node_dispose);
         }
     };
-    uint64_t string_hash(const std::string &str) {
-        uint64_t hash = 0;
-        for(auto &c:str) {
-            hash = hash*257 + static_cast<uint8_t>(c);
-        }
-        return hash;
+    // 所有 HNode 的 hcode 都从这里计算，实现见 hash.h
+    inline auto string_hash(std::string_view str) -> uint64_t
+    {
+        return hash::Hash64(str);
     }
 } // namespace kath
 
@@ -74,7 +74,7 @@ namespace kath
                 {
                     next = RightSon(cur);
                 }
-                if (data_[cur] <= data_[next])
+                if (cur_item <= data_[next])
                 {
                     break;
                 }
@@ -82,6 +82,7 @@ namespace kath
                 data_[cur].ChangeRef(cur);
                 cur = next;
             }
+            data_[cur] = cur_item;
             data_[cur].ChangeRef(cur);
         }
 
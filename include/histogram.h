@@ -0,0 +1,124 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+/*
+HDR 直方图（参考 HdrHistogram）
+值域按 2 的幂分成若干段，每段再线性地分成 2^sub_bits 个桶，
+因此任何值的相对误差都不超过 2^-sub_bits（sub_bits = 10 时约为 0.1%），
+而桶的总数只和最大值的位数有关，记录一次只是几次位运算加一次自增。
+    [0, 2^(sub_bits+1))             每个值一个桶
+    [2^k, 2^(k+1)), k > sub_bits    桶宽 2^(k-sub_bits)
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace kath
+{
+    class Histogram
+    {
+    private:
+        int sub_bits_;
+        uint64_t sub_count_; // 2^(sub_bits_+1)，前两段的桶数
+        uint64_t half_;      // 2^sub_bits_
+        std::vector<uint64_t> counts_;
+        uint64_t total_{0};
+        uint64_t min_{UINT64_MAX};
+        uint64_t max_{0};
+        uint64_t sum_{0};
+
+        static auto Msb(uint64_t val) -> int { return 63 - __builtin_clzll(val); }
+
+    public:
+        // 能精确分桶的最大值为 max_value，更大的值记在最后一个桶里（min / max 仍然精确）
+        explicit Histogram(uint64_t max_value = 3600ull * 1000 * 1000 * 1000, int sub_bits = 10)
+            : sub_bits_(sub_bits), sub_count_(2ull << sub_bits), half_(1ull << sub_bits)
+        {
+            counts_.resize(Index(std::max<uint64_t>(max_value, sub_count_)) + 1);
+        }
+
+        [[nodiscard]] auto Index(uint64_t val) const -> size_t
+        {
+            if (val < sub_count_)
+                return static_cast<size_t>(val);
+            int shift = Msb(val) - sub_bits_;
+            return static_cast<size_t>(static_cast<uint64_t>(shift + 1) * half_ + ((val >> shift) - half_));
+        }
+        // 桶中的最小值
+        [[nodiscard]] auto ValueAt(size_t index) const -> uint64_t
+        {
+            if (index < sub_count_)
+                return index;
+            uint64_t shift = index / half_ - 1;
+            return (index % half_ + half_) << shift;
+        }
+        // 桶中的最大值
+        [[nodiscard]] auto HighestAt(size_t index) const -> uint64_t
+        {
+            if (index < sub_count_)
+                return index;
+            uint64_t shift = index / half_ - 1;
+            return ValueAt(index) + (1ull << shift) - 1;
+        }
+
+        auto Record(uint64_t val, uint64_t count = 1) -> void
+        {
+            counts_[std::min(Index(val), counts_.size() - 1)] += count;
+            total_ += count;
+            min_ = std::min(min_, val);
+            max_ = std::max(max_, val);
+            sum_ += val * count;
+        }
+
+        auto Merge(const Histogram &other) -> void
+        {
+            if (other.counts_.size() > counts_.size())
+            {
+                counts_.resize(other.counts_.size());
+            }
+            for (size_t index = 0; index < other.counts_.size(); index++)
+            {
+                counts_[index] += other.counts_[index];
+            }
+            total_ += other.total_;
+            min_ = std::min(min_, other.min_);
+            max_ = std::max(max_, other.max_);
+            sum_ += other.sum_;
+        }
+
+        auto Reset() -> void
+        {
+            std::fill(counts_.begin(), counts_.end(), 0);
+            total_ = 0;
+            min_ = UINT64_MAX;
+            max_ = 0;
+            sum_ = 0;
+        }
+
+        [[nodiscard]] auto Count() const -> uint64_t { return total_; }
+        [[nodiscard]] auto Min() const -> uint64_t { return total_ ? min_ : 0; }
+        [[nodiscard]] auto Max() const -> uint64_t { return max_; }
+        [[nodiscard]] auto Sum() const -> uint64_t { return sum_; }
+        [[nodiscard]] auto Mean() const -> double { return total_ ? static_cast<double>(sum_) / static_cast<double>(total_) : 0; }
+
+        // p 为 0~100，返回不小于 p% 的记录所在桶的上界（不超过记录到的最大值）
+        [[nodiscard]] auto Percentile(double p) const -> uint64_t
+        {
+            if (total_ == 0)
+                return 0;
+            auto rank = static_cast<uint64_t>(p / 100.0 * static_cast<double>(total_) + 0.5);
+            rank = std::clamp<uint64_t>(rank, 1, total_);
+            uint64_t seen = 0;
+            for (size_t index = 0; index < counts_.size(); index++)
+            {
+                seen += counts_[index];
+                if (seen >= rank)
+                    return std::min(HighestAt(index), max_);
+            }
+            return max_;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,437 @@
+#ifndef HYPERLOGLOG_H
+#define HYPERLOGLOG_H
+
+/*
+HyperLogLog 基数估计，参数与 Redis 相同：2^14 个寄存器，64 位 hash，标准误差约 0.81%
+元素的 hash 低 14 位选寄存器，其余 50 位中末尾 0 的个数加 1 为这次的值，寄存器保存见过的最大值（最大 51）。
+两种编码：
+    sparse     只保存非 0 的寄存器，有序的 (index << 8) | value 数组，每个 4 字节
+    dense      每个寄存器 6 位紧挨着存放，共 12KB（末尾多 1 字节，读写时可以一次取 2 字节）
+非 0 的寄存器超过 k_sparse_max_entries（约 3KB）时一次性转成 dense，之后不再转回，
+所以不论加入多少元素，一个 HLL 最多占 12KB 多一点。
+
+估计值用 Ertl 的改进估计（Redis 5 之后也用它），全范围没有偏差，不需要线性计数和偏差表：
+    z = m * tau(1 - C[q+1]/m) * 2^-q + sum(C[k] * 2^-k, k = 1..q) + m * sigma(C[0]/m)
+    E = alpha_inf * m^2 / z
+中间一项就是寄存器的调和和去掉值为 0 和 q+1 的部分，所以只需要一遍扫描得到：
+所有寄存器的 2^-value 之和、值为 0 的个数和值为 q+1 的个数。
+dense 先展开成每个寄存器 1 字节，这一遍和 PFMERGE 的逐字节取最大值按 simd.h 选择实现。
+单个 key 的估计值缓存到下一次修改。
+*/
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "public.h"
+#include "hash.h"
+#include "simd.h"
+
+namespace kath::hll
+{
+    constexpr size_t k_precision = 14;
+    constexpr size_t k_registers = size_t(1) << k_precision;
+    constexpr size_t k_q = 64 - k_precision;
+    constexpr size_t k_dense_bytes = k_registers * 6 / 8;
+    // 固定的 seed，同一个元素在所有 key 中落到同一个寄存器，PFMERGE 才有意义
+    constexpr uint64_t k_seed = 0x5f3759df9e3779b9ull;
+
+    using Registers = std::array<uint8_t, k_registers>;
+
+    // 一遍扫描的结果，见文件开头
+    struct Stats
+    {
+        double sum_{0};
+        size_t zeros_{0};
+        size_t maxed_{0};
+    };
+
+    inline auto Locate(std::string_view elem, size_t &index, uint8_t &rank) -> void
+    {
+        uint64_t hcode = hash::Hash64(elem, k_seed);
+        index = static_cast<size_t>(hcode & (k_registers - 1));
+        // 最高位补 1，全 0 时得到 q + 1
+        uint64_t rest = (hcode >> k_precision) | (uint64_t(1) << k_q);
+        rank = static_cast<uint8_t>(__builtin_ctzll(rest) + 1);
+    }
+
+    // k_pow2neg[v] = 2^-v，寄存器是 6 位的，v 不超过 63
+    inline constexpr auto MakePow2Neg() -> std::array<double, 64>
+    {
+        std::array<double, 64> table{};
+        double val = 1.0;
+        for (auto &elem : table)
+        {
+            elem = val;
+            val /= 2;
+        }
+        return table;
+    }
+    inline constexpr auto k_pow2neg = MakePow2Neg();
+
+    inline auto StatsScalar(const uint8_t *regs, size_t n) -> Stats
+    {
+        Stats stats;
+        for (size_t index = 0; index < n; index++)
+        {
+            stats.sum_ += k_pow2neg[regs[index]];
+            stats.zeros_ += regs[index] == 0;
+            stats.maxed_ += regs[index] == k_q + 1;
+        }
+        return stats;
+    }
+
+    inline auto MaxScalar(uint8_t *dst, const uint8_t *src, size_t n) -> void
+    {
+        for (size_t index = 0; index < n; index++)
+        {
+            dst[index] = std::max(dst[index], src[index]);
+        }
+    }
+
+#if KATH_X86
+    // 2^-v 直接拼出 double 的指数位：(1023 - v) << 52
+    KATH_TARGET("avx2")
+    inline auto StatsAVX2(const uint8_t *regs, size_t n) -> Stats
+    {
+        const __m256i bias = _mm256_set1_epi64x(1023);
+        const __m256i maxed = _mm256_set1_epi8(static_cast<char>(k_q + 1));
+        __m256d sum = _mm256_setzero_pd();
+        size_t zeros = 0;
+        size_t full = 0;
+        size_t pos = 0;
+        for (; pos + 32 <= n; pos += 32)
+        {
+            __m256i vec = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(regs + pos));
+            zeros += static_cast<size_t>(__builtin_popcount(static_cast<unsigned>(
+                _mm256_movemask_epi8(_mm256_cmpeq_epi8(vec, _mm256_setzero_si256())))));
+            full += static_cast<size_t>(__builtin_popcount(static_cast<unsigned>(
+                _mm256_movemask_epi8(_mm256_cmpeq_epi8(vec, maxed)))));
+            for (size_t off = 0; off < 32; off += 4)
+            {
+                int32_t four = 0;
+                std::memcpy(&four, regs + pos + off, 4);
+                __m256i wide = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(four));
+                __m256i bits = _mm256_slli_epi64(_mm256_sub_epi64(bias, wide), 52);
+                sum = _mm256_add_pd(sum, _mm256_castsi256_pd(bits));
+            }
+        }
+        double lanes[4];
+        _mm256_storeu_pd(lanes, sum);
+        Stats tail = StatsScalar(regs + pos, n - pos);
+        tail.sum_ += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        tail.zeros_ += zeros;
+        tail.maxed_ += full;
+        return tail;
+    }
+
+    KATH_TARGET("avx512f,avx512bw")
+    inline auto StatsAVX512(const uint8_t *regs, size_t n) -> Stats
+    {
+        const __m512i bias = _mm512_set1_epi64(1023);
+        const __m512i maxed = _mm512_set1_epi8(static_cast<char>(k_q + 1));
+        __m512d sum = _mm512_setzero_pd();
+        size_t zeros = 0;
+        size_t full = 0;
+        size_t pos = 0;
+        for (; pos + 64 <= n; pos += 64)
+        {
+            __m512i vec = _mm512_loadu_si512(regs + pos);
+            zeros += static_cast<size_t>(__builtin_popcountll(_mm512_cmpeq_epi8_mask(vec, _mm512_setzero_si512())));
+            full += static_cast<size_t>(__builtin_popcountll(_mm512_cmpeq_epi8_mask(vec, maxed)));
+            for (size_t off = 0; off < 64; off += 8)
+            {
+                // 不带掩码的 cvtepu8 / slli 以未初始化的向量为底，GCC 会报 -Wmaybe-uninitialized，这里用全 1 掩码的 maskz 版本
+                __m128i eight = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(regs + pos + off));
+                __m512i wide = _mm512_maskz_cvtepu8_epi64(0xff, eight);
+                __m512i bits = _mm512_maskz_slli_epi64(0xff, _mm512_sub_epi64(bias, wide), 52);
+                sum = _mm512_add_pd(sum, _mm512_castsi512_pd(bits));
+            }
+        }
+        // 与 AVX2 版本一样存回内存再相加，_mm512_reduce_add_pd 同样会报 -Wmaybe-uninitialized
+        double lanes[8];
+        _mm512_storeu_pd(lanes, sum);
+        Stats tail = StatsScalar(regs + pos, n - pos);
+        for (auto lane : lanes)
+        {
+            tail.sum_ += lane;
+        }
+        tail.zeros_ += zeros;
+        tail.maxed_ += full;
+        return tail;
+    }
+
+    KATH_TARGET("avx2")
+    inline auto MaxAVX2(uint8_t *dst, const uint8_t *src, size_t n) -> void
+    {
+        size_t pos = 0;
+        for (; pos + 32 <= n; pos += 32)
+        {
+            auto *out = reinterpret_cast<__m256i *>(dst + pos);
+            __m256i rhs = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + pos));
+            _mm256_storeu_si256(out, _mm256_max_epu8(_mm256_loadu_si256(out), rhs));
+        }
+        MaxScalar(dst + pos, src + pos, n - pos);
+    }
+
+    KATH_TARGET("avx512f,avx512bw")
+    inline auto MaxAVX512(uint8_t *dst, const uint8_t *src, size_t n) -> void
+    {
+        size_t pos = 0;
+        for (; pos + 64 <= n; pos += 64)
+        {
+            __m512i res = _mm512_max_epu8(_mm512_loadu_si512(dst + pos), _mm512_loadu_si512(src + pos));
+            _mm512_storeu_si512(dst + pos, res);
+        }
+        MaxScalar(dst + pos, src + pos, n - pos);
+    }
+#endif
+
+    inline auto GetStats(const uint8_t *regs, size_t n) -> Stats
+    {
+#if KATH_X86
+        if (simd::g_level >= simd::Level::AVX512)
+            return StatsAVX512(regs, n);
+        if (simd::g_level >= simd::Level::AVX2)
+            return StatsAVX2(regs, n);
+#endif
+        return StatsScalar(regs, n);
+    }
+
+    // dst[i] = max(dst[i], src[i])
+    inline auto Max(uint8_t *dst, const uint8_t *src, size_t n) -> void
+    {
+#if KATH_X86
+        if (simd::g_level >= simd::Level::AVX512)
+            return MaxAVX512(dst, src, n);
+        if (simd::g_level >= simd::Level::AVX2)
+            return MaxAVX2(dst, src, n);
+#endif
+        MaxScalar(dst, src, n);
+    }
+
+    inline auto Sigma(double x) -> double
+    {
+        if (x == 1.0)
+            return HUGE_VAL;
+        double y = 1.0;
+        double z = x;
+        double prev = 0;
+        do
+        {
+            x *= x;
+            prev = z;
+            z += x * y;
+            y += y;
+        } while (prev != z);
+        return z;
+    }
+
+    inline auto Tau(double x) -> double
+    {
+        if (x == 0.0 || x == 1.0)
+            return 0.0;
+        double y = 1.0;
+        double z = 1 - x;
+        double prev = 0;
+        do
+        {
+            x = std::sqrt(x);
+            prev = z;
+            y *= 0.5;
+            z -= (1 - x) * (1 - x) * y;
+        } while (prev != z);
+        return z / 3;
+    }
+
+    inline auto Estimate(const Stats &stats) -> uint64_t
+    {
+        const auto m = static_cast<double>(k_registers);
+        // 调和和中值为 1..q 的部分
+        double mid = stats.sum_ - static_cast<double>(stats.zeros_) -
+                     static_cast<double>(stats.maxed_) * k_pow2neg[k_q + 1];
+        double z = m * Tau((m - static_cast<double>(stats.maxed_)) / m) * k_pow2neg[k_q] +
+                   mid + m * Sigma(static_cast<double>(stats.zeros_) / m);
+        const double alpha_inf = 0.5 / std::log(2.0);
+        return static_cast<uint64_t>(std::llround(alpha_inf * m * m / z));
+    }
+}
+
+namespace kath
+{
+    class HyperLogLog
+    {
+    public:
+        static constexpr size_t k_sparse_max_entries = 750;
+
+    private:
+        std::vector<uint32_t> sparse_{};
+        std::vector<uint8_t> dense_{}; // 为空时使用 sparse 编码
+        mutable std::optional<uint64_t> card_{};
+
+        [[nodiscard]] auto DenseGet(size_t index) const -> uint8_t
+        {
+            size_t bit = index * 6;
+            unsigned word = dense_[bit / 8] | (unsigned(dense_[bit / 8 + 1]) << 8);
+            return static_cast<uint8_t>((word >> (bit % 8)) & 63);
+        }
+        auto DenseSet(size_t index, uint8_t value) -> void
+        {
+            size_t bit = index * 6;
+            unsigned word = dense_[bit / 8] | (unsigned(dense_[bit / 8 + 1]) << 8);
+            word = (word & ~(63u << (bit % 8))) | (unsigned(value) << (bit % 8));
+            dense_[bit / 8] = static_cast<uint8_t>(word);
+            dense_[bit / 8 + 1] = static_cast<uint8_t>(word >> 8);
+        }
+        // 每 3 字节 4 个寄存器
+        static auto Unpack(const uint8_t *packed, uint8_t *regs) -> void
+        {
+            for (size_t group = 0; group < hll::k_registers / 4; group++)
+            {
+                const uint8_t *src = packed + group * 3;
+                uint8_t *dst = regs + group * 4;
+                dst[0] = src[0] & 63;
+                dst[1] = static_cast<uint8_t>(((src[0] >> 6) | (src[1] << 2)) & 63);
+                dst[2] = static_cast<uint8_t>(((src[1] >> 4) | (src[2] << 4)) & 63);
+                dst[3] = src[2] >> 2;
+            }
+        }
+        static auto Pack(const uint8_t *regs, uint8_t *packed) -> void
+        {
+            for (size_t group = 0; group < hll::k_registers / 4; group++)
+            {
+                const uint8_t *src = regs + group * 4;
+                uint8_t *dst = packed + group * 3;
+                dst[0] = static_cast<uint8_t>(src[0] | (src[1] << 6));
+                dst[1] = static_cast<uint8_t>((src[1] >> 2) | (src[2] << 4));
+                dst[2] = static_cast<uint8_t>((src[2] >> 4) | (src[3] << 2));
+            }
+        }
+        auto ToDense() -> void
+        {
+            dense_.assign(hll::k_dense_bytes + 1, 0);
+            for (uint32_t item : sparse_)
+            {
+                DenseSet(item >> 8, static_cast<uint8_t>(item));
+            }
+            sparse_.clear();
+            sparse_.shrink_to_fit();
+        }
+
+    public:
+        [[nodiscard]] auto IsSparse() const -> bool { return dense_.empty(); }
+        // 寄存器占用的字节数
+        [[nodiscard]] auto Bytes() const -> size_t
+        {
+            return IsSparse() ? sparse_.capacity() * sizeof(uint32_t) : dense_.size();
+        }
+
+        // 有寄存器变大时返回 true
+        auto Add(std::string_view elem) -> bool
+        {
+            size_t index = 0;
+            uint8_t rank = 0;
+            hll::Locate(elem, index, rank);
+            if (!IsSparse())
+            {
+                if (DenseGet(index) >= rank)
+                    return false;
+                DenseSet(index, rank);
+                card_.reset();
+                return true;
+            }
+            auto key = static_cast<uint32_t>(index << 8);
+            auto pos = std::lower_bound(sparse_.begin(), sparse_.end(), key);
+            if (pos != sparse_.end() && (*pos >> 8) == index)
+            {
+                if ((*pos & 0xff) >= rank)
+                    return false;
+                *pos = key | rank;
+            }
+            else if (sparse_.size() == k_sparse_max_entries)
+            {
+                ToDense();
+                return Add(elem);
+            }
+            else
+            {
+                sparse_.insert(pos, key | rank);
+            }
+            card_.reset();
+            return true;
+        }
+
+        // regs[i] = max(regs[i], 第 i 个寄存器)
+        auto MaxInto(hll::Registers &regs) const -> void
+        {
+            if (IsSparse())
+            {
+                for (uint32_t item : sparse_)
+                {
+                    regs[item >> 8] = std::max(regs[item >> 8], static_cast<uint8_t>(item));
+                }
+                return;
+            }
+            hll::Registers mine;
+            Unpack(dense_.data(), mine.data());
+            hll::Max(regs.data(), mine.data(), hll::k_registers);
+        }
+
+        // 用展开的寄存器整体替换，非 0 的寄存器不多时仍用 sparse
+        auto Assign(const hll::Registers &regs) -> void
+        {
+            auto nonzero = static_cast<size_t>(std::count_if(regs.begin(), regs.end(), [](uint8_t val)
+                                                             { return val != 0; }));
+            card_.reset();
+            if (nonzero <= k_sparse_max_entries && IsSparse())
+            {
+                sparse_.clear();
+                for (size_t index = 0; index < hll::k_registers; index++)
+                {
+                    if (regs[index] != 0)
+                        sparse_.push_back(static_cast<uint32_t>(index << 8) | regs[index]);
+                }
+                return;
+            }
+            sparse_.clear();
+            sparse_.shrink_to_fit();
+            dense_.assign(hll::k_dense_bytes + 1, 0);
+            Pack(regs.data(), dense_.data());
+        }
+
+        [[nodiscard]] auto Count() const -> uint64_t
+        {
+            if (card_)
+                return *card_;
+            hll::Stats stats;
+            if (IsSparse())
+            {
+                // 值为 0 的寄存器各贡献 1
+                stats.zeros_ = hll::k_registers - sparse_.size();
+                stats.sum_ = static_cast<double>(stats.zeros_);
+                for (uint32_t item : sparse_)
+                {
+                    auto val = static_cast<uint8_t>(item);
+                    stats.sum_ += hll::k_pow2neg[val];
+                    stats.maxed_ += val == hll::k_q + 1;
+                }
+            }
+            else
+            {
+                hll::Registers regs;
+                Unpack(dense_.data(), regs.data());
+                stats = hll::GetStats(regs.data(), hll::k_registers);
+            }
+            card_ = hll::Estimate(stats);
+            return *card_;
+        }
+    };
+}
+
+#endif
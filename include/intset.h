@@ -0,0 +1,330 @@
+#ifndef INTSET_H
+#define INTSET_H
+
+/*
+整数集合：有序、无重复的定长整数数组
+元素宽度取能容纳所有元素的最小宽度（2 / 4 / 8 字节），加入更大的数时整个数组一次性加宽，之后不再变窄。
+查找为二分，插入和删除需要移动插入点之后的元素，一次加入多个元素时先排序再整体归并，只移动一遍。
+
+两个集合求交：
+    大小相差悬殊（大的超过小的 k_gallop_ratio 倍）时，小集合的每个元素在大集合中倍增查找，
+    从上一次的位置开始，O(m log(n/m))
+    否则同时扫描两个数组；都是 4 字节宽时用 AVX2 一次比较 8x8 个元素（见 simd.h），
+    匹配的元素用查表得到的置换一次写出
+*/
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include "public.h"
+#include "simd.h"
+
+namespace kath
+{
+    class IntSet
+    {
+    private:
+        std::variant<std::vector<int16_t>, std::vector<int32_t>, std::vector<int64_t>> data_{};
+
+        template <typename T>
+        static auto Fits(int64_t val) -> bool
+        {
+            return val >= std::numeric_limits<T>::min() && val <= std::numeric_limits<T>::max();
+        }
+        template <typename T>
+        auto Widen() -> void
+        {
+            std::vector<T> wide;
+            std::visit([&](const auto &vals)
+                       { wide.assign(vals.begin(), vals.end()); },
+                       data_);
+            data_ = std::move(wide);
+        }
+        // 保证 val 能放下
+        auto Reserve(int64_t val) -> void
+        {
+            if (!Fits<int32_t>(val))
+            {
+                if (Width() < 8)
+                    Widen<int64_t>();
+            }
+            else if (!Fits<int16_t>(val) && Width() < 4)
+            {
+                Widen<int32_t>();
+            }
+        }
+
+    public:
+        // vals 必须有序且没有重复
+        static auto FromSorted(const std::vector<int64_t> &vals) -> IntSet
+        {
+            IntSet res;
+            if (!vals.empty())
+            {
+                res.Reserve(vals.front());
+                res.Reserve(vals.back());
+            }
+            std::visit([&](auto &data)
+                       { data.assign(vals.begin(), vals.end()); },
+                       res.data_);
+            return res;
+        }
+
+        [[nodiscard]] auto Size() const -> size_t
+        {
+            return std::visit([](const auto &vals)
+                              { return vals.size(); },
+                              data_);
+        }
+        [[nodiscard]] auto Width() const -> size_t
+        {
+            return std::visit([](const auto &vals)
+                              { return sizeof(vals[0]); },
+                              data_);
+        }
+
+        // fn(const std::vector<T> &)，T 为当前的元素类型
+        template <typename F>
+        auto Visit(F &&fn) const -> decltype(auto)
+        {
+            return std::visit(std::forward<F>(fn), data_);
+        }
+
+        [[nodiscard]] auto Contains(int64_t val) const -> bool
+        {
+            return std::visit([&](const auto &vals)
+                              {
+                                  using T = typename std::decay_t<decltype(vals)>::value_type;
+                                  return Fits<T>(val) && std::binary_search(vals.begin(), vals.end(), static_cast<T>(val)); },
+                              data_);
+        }
+
+        auto Add(int64_t val) -> bool
+        {
+            Reserve(val);
+            return std::visit([&](auto &vals)
+                              {
+                                  using T = typename std::decay_t<decltype(vals)>::value_type;
+                                  auto elem = static_cast<T>(val);
+                                  // 递增写入的常见情况不需要二分
+                                  if (vals.empty() || vals.back() < elem)
+                                  {
+                                      vals.push_back(elem);
+                                      return true;
+                                  }
+                                  auto pos = std::lower_bound(vals.begin(), vals.end(), elem);
+                                  if (*pos == elem)
+                                      return false;
+                                  vals.insert(pos, elem);
+                                  return true; },
+                              data_);
+        }
+
+        // 一次加入多个元素，返回新增的个数
+        auto AddMany(std::vector<int64_t> adds) -> size_t
+        {
+            if (adds.empty())
+                return 0;
+            std::sort(adds.begin(), adds.end());
+            adds.erase(std::unique(adds.begin(), adds.end()), adds.end());
+            Reserve(adds.front());
+            Reserve(adds.back());
+            return std::visit([&](auto &vals)
+                              {
+                                  using T = typename std::decay_t<decltype(vals)>::value_type;
+                                  size_t old = vals.size();
+                                  std::vector<T> merged;
+                                  merged.reserve(old + adds.size());
+                                  std::set_union(vals.begin(), vals.end(), adds.begin(), adds.end(), std::back_inserter(merged),
+                                                 [](auto lhs, auto rhs)
+                                                 { return static_cast<int64_t>(lhs) < static_cast<int64_t>(rhs); });
+                                  vals = std::move(merged);
+                                  return vals.size() - old; },
+                              data_);
+        }
+
+        auto Remove(int64_t val) -> bool
+        {
+            return std::visit([&](auto &vals)
+                              {
+                                  using T = typename std::decay_t<decltype(vals)>::value_type;
+                                  if (!Fits<T>(val))
+                                      return false;
+                                  auto pos = std::lower_bound(vals.begin(), vals.end(), static_cast<T>(val));
+                                  if (pos == vals.end() || *pos != static_cast<T>(val))
+                                      return false;
+                                  vals.erase(pos);
+                                  return true; },
+                              data_);
+        }
+    };
+
+    namespace intset
+    {
+        const size_t k_gallop_ratio = 32;
+
+        // 两路同时扫描，res 中追加交集
+        template <typename TA, typename TB>
+        auto MergeInter(const TA *lhs, size_t nl, const TB *rhs, size_t nr, std::vector<int64_t> &res) -> void
+        {
+            size_t il = 0;
+            size_t ir = 0;
+            while (il < nl && ir < nr)
+            {
+                auto lv = static_cast<int64_t>(lhs[il]);
+                auto rv = static_cast<int64_t>(rhs[ir]);
+                il += lv <= rv;
+                ir += rv <= lv;
+                if (lv == rv)
+                    res.push_back(lv);
+            }
+        }
+
+        // small 的每个元素在 large 中从上次的位置开始倍增查找
+        template <typename TS, typename TL>
+        auto GallopInter(const TS *small, size_t ns, const TL *large, size_t nl, std::vector<int64_t> &res) -> void
+        {
+            size_t base = 0;
+            for (size_t index = 0; index < ns && base < nl; index++)
+            {
+                auto val = static_cast<int64_t>(small[index]);
+                size_t step = 1;
+                while (base + step < nl && static_cast<int64_t>(large[base + step]) < val)
+                {
+                    step <<= 1;
+                }
+                auto first = large + base;
+                auto last = large + std::min(base + step + 1, nl);
+                auto pos = std::lower_bound(first, last, val, [](TL elem, int64_t key)
+                                            { return static_cast<int64_t>(elem) < key; });
+                base = static_cast<size_t>(pos - large);
+                if (base < nl && static_cast<int64_t>(large[base]) == val)
+                    res.push_back(val);
+            }
+        }
+
+#if KATH_X86
+        // k_compact[mask] 把 mask 中为 1 的 lane 依次移到最前面
+        inline constexpr auto MakeCompactTable() -> std::array<std::array<int32_t, 8>, 256>
+        {
+            std::array<std::array<int32_t, 8>, 256> table{};
+            for (size_t mask = 0; mask < 256; mask++)
+            {
+                size_t out = 0;
+                for (int32_t lane = 0; lane < 8; lane++)
+                {
+                    if (mask & (1u << lane))
+                        table[mask][out++] = lane;
+                }
+            }
+            return table;
+        }
+        inline constexpr auto k_compact = MakeCompactTable();
+
+        // 8 个 lhs 与 8 个 rhs 两两比较（rhs 循环移位 7 次），out 至少要能多写 8 个元素
+        KATH_TARGET("avx2")
+        inline auto InterAVX2(const int32_t *lhs, size_t nl, const int32_t *rhs, size_t nr, int32_t *out) -> size_t
+        {
+            const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+            size_t il = 0;
+            size_t ir = 0;
+            size_t count = 0;
+            while (il + 8 <= nl && ir + 8 <= nr)
+            {
+                __m256i lv = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lhs + il));
+                __m256i rv = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rhs + ir));
+                __m256i eq = _mm256_cmpeq_epi32(lv, rv);
+                for (int shift = 1; shift < 8; shift++)
+                {
+                    rv = _mm256_permutevar8x32_epi32(rv, rotate);
+                    eq = _mm256_or_si256(eq, _mm256_cmpeq_epi32(lv, rv));
+                }
+                auto mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(eq)));
+                __m256i perm = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(k_compact[mask].data()));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + count), _mm256_permutevar8x32_epi32(lv, perm));
+                count += static_cast<size_t>(__builtin_popcount(mask));
+                int32_t lmax = lhs[il + 7];
+                int32_t rmax = rhs[ir + 7];
+                il += lmax <= rmax ? 8 : 0;
+                ir += rmax <= lmax ? 8 : 0;
+            }
+            for (; il < nl && ir < nr;)
+            {
+                int32_t lv = lhs[il];
+                int32_t rv = rhs[ir];
+                il += lv <= rv;
+                ir += rv <= lv;
+                if (lv == rv)
+                    out[count++] = lv;
+            }
+            return count;
+        }
+#endif
+
+        template <typename TA, typename TB>
+        auto InterArrays(const std::vector<TA> &lhs, const std::vector<TB> &rhs, std::vector<int64_t> &res) -> void
+        {
+            if (lhs.size() > rhs.size())
+                return InterArrays(rhs, lhs, res);
+            if (lhs.empty())
+                return;
+            if (rhs.size() / lhs.size() >= k_gallop_ratio)
+                return GallopInter(lhs.data(), lhs.size(), rhs.data(), rhs.size(), res);
+#if KATH_X86
+            if constexpr (std::is_same_v<TA, int32_t> && std::is_same_v<TB, int32_t>)
+            {
+                if (simd::g_level >= simd::Level::AVX2)
+                {
+                    std::vector<int32_t> buf(lhs.size() + 8);
+                    size_t count = InterAVX2(lhs.data(), lhs.size(), rhs.data(), rhs.size(), buf.data());
+                    res.insert(res.end(), buf.begin(), buf.begin() + static_cast<std::ptrdiff_t>(count));
+                    return;
+                }
+            }
+#endif
+            MergeInter(lhs.data(), lhs.size(), rhs.data(), rhs.size(), res);
+        }
+
+        // 结果有序
+        inline auto Inter(const IntSet &lhs, const IntSet &rhs) -> std::vector<int64_t>
+        {
+            std::vector<int64_t> res;
+            lhs.Visit([&](const auto &lv)
+                      { rhs.Visit([&](const auto &rv)
+                                  { InterArrays(lv, rv, res); }); });
+            return res;
+        }
+
+        // 结果有序
+        inline auto Union(const IntSet &lhs, const IntSet &rhs) -> std::vector<int64_t>
+        {
+            std::vector<int64_t> res;
+            res.reserve(lhs.Size() + rhs.Size());
+            lhs.Visit([&](const auto &lv)
+                      { rhs.Visit([&](const auto &rv)
+                                  { std::set_union(lv.begin(), lv.end(), rv.begin(), rv.end(), std::back_inserter(res),
+                                                   [](auto lhs, auto rhs)
+                                                   { return static_cast<int64_t>(lhs) < static_cast<int64_t>(rhs); }); }); });
+            return res;
+        }
+        // lhs 中不在 rhs 里的元素，结果有序
+        inline auto Diff(const IntSet &lhs, const IntSet &rhs) -> std::vector<int64_t>
+        {
+            std::vector<int64_t> res;
+            lhs.Visit([&](const auto &lv)
+                      { rhs.Visit([&](const auto &rv)
+                                  { std::set_difference(lv.begin(), lv.end(), rv.begin(), rv.end(), std::back_inserter(res),
+                                                        [](auto lhs, auto rhs)
+                                                        { return static_cast<int64_t>(lhs) < static_cast<int64_t>(rhs); }); }); });
+            return res;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+/*
+延迟监控
+每轮事件循环结束时检查这一轮的耗时（不含 poll 的等待），超过阈值就记一次事件：
+    eventloop   整轮的耗时，同时记下这一轮中耗时最多的阶段
+    read / exec / write / timers / accept / other   单个阶段自身超过阈值
+每个事件保留最近 160 个样本，同一秒内的多次超时合并为一个样本，取最大值（与 Redis 的 LATENCY 相同）。
+阈值为 0 时关闭，没有超时的一轮只需要比较一次。
+*/
+
+#include <array>
+#include <cstdint>
+#include <ctime>
+#include <limits>
+#include <string_view>
+
+#include "public.h"
+#include "command.h"
+#include "stats.h"
+
+namespace kath::latency
+{
+    const size_t k_history = 160;
+    // 前 k_phases 个事件与 stats::Phase 一一对应，最后一个为 eventloop
+    inline constexpr size_t k_events = stats::k_phases + 1;
+    inline constexpr size_t k_eventloop = stats::k_phases;
+
+    struct Sample
+    {
+        int64_t time_{0}; // unix 时间，秒
+        uint64_t usec_{0};
+        stats::Phase phase_{stats::Phase::OTHER}; // 这一轮中耗时最多的阶段
+    };
+
+    class Event
+    {
+    private:
+        std::array<Sample, k_history> history_{};
+        size_t next_{0};
+        size_t len_{0};
+        uint64_t max_usec_{0};
+
+    public:
+        auto Add(const Sample &sample) -> void
+        {
+            max_usec_ = std::max(max_usec_, sample.usec_);
+            if (len_ != 0)
+            {
+                auto &last = history_[(next_ + k_history - 1) % k_history];
+                if (last.time_ == sample.time_)
+                {
+                    if (sample.usec_ > last.usec_)
+                        last = sample;
+                    return;
+                }
+            }
+            history_[next_] = sample;
+            next_ = (next_ + 1) % k_history;
+            len_ = std::min(len_ + 1, k_history);
+        }
+        [[nodiscard]] auto Empty() const -> bool { return len_ == 0; }
+        [[nodiscard]] auto Len() const -> size_t { return len_; }
+        [[nodiscard]] auto MaxUsec() const -> uint64_t { return max_usec_; }
+        [[nodiscard]] auto Latest() const -> const Sample & { return history_[(next_ + k_history - 1) % k_history]; }
+        // 从最旧的开始
+        template <typename F>
+        auto ForEach(F &&fn) const -> void
+        {
+            for (size_t index = 0; index < len_; index++)
+            {
+                fn(history_[(next_ + k_history - len_ + index) % k_history]);
+            }
+        }
+        auto Reset() -> void
+        {
+            next_ = 0;
+            len_ = 0;
+            max_usec_ = 0;
+        }
+    };
+
+    class Monitor
+    {
+    private:
+        uint64_t threshold_us_{0};
+        uint64_t threshold_{std::numeric_limits<uint64_t>::max()}; // 换算成 cycle 的阈值
+        std::array<Event, k_events> events_{};
+
+    public:
+        // threshold_us 为 0 时关闭
+        auto Configure(uint64_t threshold_us) -> void
+        {
+            threshold_us_ = threshold_us;
+            Calibrate();
+        }
+        auto Calibrate() -> void
+        {
+            threshold_ = threshold_us_ == 0 ? std::numeric_limits<uint64_t>::max()
+                                            : static_cast<uint64_t>(static_cast<double>(threshold_us_) * 1000 / stats::NsPerCycle());
+        }
+        [[nodiscard]] auto ThresholdUsec() const -> uint64_t { return threshold_us_; }
+
+        // 一轮事件循环结束时调用，iter 为这一轮各阶段的耗时，busy 为总耗时
+        auto Check(const stats::PhaseCycles &iter, uint64_t busy) -> void
+        {
+            if (busy <= threshold_)
+                return;
+            double us_per_cycle = stats::NsPerCycle() / 1000;
+            auto now = static_cast<int64_t>(std::time(nullptr));
+            size_t worst = static_cast<size_t>(stats::Phase::READ);
+            for (size_t index = worst; index < stats::k_phases; index++)
+            {
+                if (iter[index] > iter[worst])
+                    worst = index;
+                if (iter[index] > threshold_)
+                {
+                    events_[index].Add({now, static_cast<uint64_t>(static_cast<double>(iter[index]) * us_per_cycle),
+                                        static_cast<stats::Phase>(index)});
+                }
+            }
+            events_[k_eventloop].Add({now, static_cast<uint64_t>(static_cast<double>(busy) * us_per_cycle),
+                                      static_cast<stats::Phase>(worst)});
+        }
+
+        [[nodiscard]] static auto Name(size_t event) -> std::string_view
+        {
+            return event == k_eventloop ? "eventloop" : stats::k_phase_names[event];
+        }
+        // 忽略大小写，找不到时返回 k_events
+        [[nodiscard]] static auto Find(std::string_view name) -> size_t
+        {
+            for (size_t index = 0; index < k_events; index++)
+            {
+                if (cmd::NameEq(name, Name(index)))
+                    return index;
+            }
+            return k_events;
+        }
+        [[nodiscard]] auto Get(size_t event) const -> const Event & { return events_[event]; }
+        auto Reset(size_t event) -> bool
+        {
+            bool had = !events_[event].Empty();
+            events_[event].Reset();
+            return had;
+        }
+    };
+
+    inline Monitor g_monitor{};
+}
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef LFU_H
+#define LFU_H
+
+/*
+key 的访问频率（与 Redis 的 LFU 相同）
+每个 key 只用 1 字节的对数计数器加 2 字节的分钟时间戳：
+    - 访问时计数器以 1 / ((counter - k_init) * k_log_factor + 1) 的概率加一，255 封顶，
+      因此百万次访问才能把计数器推到 255 附近
+    - 每经过 k_decay_minutes 分钟没有访问，计数器减一
+时间取自事件循环定期更新的 g_clock_min，访问时不需要读时钟。
+
+TopK 记录计数器最大的若干个 key：计数器不超过表中最小值的访问只需要一次比较。
+表中的计数器与 key 上的计数器一样随时间衰减：g_clock_min 变化后第一次取 Floor() 时整表衰减一次并重算最小值，
+否则曾经热过的 key 会一直占着位置，新的热 key 永远超不过表中的最小值。
+表中的 key 可能已经被删除，读取时由调用方确认。
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "public.h"
+
+namespace kath::lfu
+{
+    const uint8_t k_init = 5;
+    const uint32_t k_log_factor = 10;
+    const uint16_t k_decay_minutes = 1;
+
+    inline uint16_t g_clock_min = 0;
+    inline uint64_t g_rand_state = 0x9e3779b97f4a7c15ull;
+
+    inline auto UpdateClock(uint64_t now_us) -> void
+    {
+        g_clock_min = static_cast<uint16_t>(now_us / (60ull * 1000 * 1000));
+    }
+
+    // xorshift64，只用来决定计数器是否加一
+    inline auto Rand() -> uint64_t
+    {
+        g_rand_state ^= g_rand_state << 13;
+        g_rand_state ^= g_rand_state >> 7;
+        g_rand_state ^= g_rand_state << 17;
+        return g_rand_state;
+    }
+
+    inline auto Decay(uint8_t counter, uint16_t last_min) -> uint8_t
+    {
+        auto elapsed = static_cast<uint16_t>(g_clock_min - last_min);
+        uint16_t periods = elapsed / k_decay_minutes;
+        return periods >= counter ? 0 : static_cast<uint8_t>(counter - periods);
+    }
+
+    inline auto LogIncr(uint8_t counter) -> uint8_t
+    {
+        if (counter == 255)
+            return counter;
+        uint32_t base = counter > k_init ? counter - k_init : 0;
+        if (base == 0 || Rand() % (base * k_log_factor + 1) == 0)
+        {
+            return static_cast<uint8_t>(counter + 1);
+        }
+        return counter;
+    }
+
+    // 一次访问：先按经过的时间衰减再计数，并更新时间戳
+    inline auto Access(uint8_t &counter, uint16_t &last_min) -> void
+    {
+        counter = LogIncr(Decay(counter, last_min));
+        last_min = g_clock_min;
+    }
+
+    class TopK
+    {
+    public:
+        struct Item
+        {
+            std::string key_;
+            uint64_t hcode_{0};
+            uint8_t counter_{0};
+            uint16_t last_min_{0};
+        };
+
+    private:
+        size_t capacity_;
+        std::vector<Item> items_{};
+        uint8_t floor_{0}; // 表满时的最小计数器，表未满时为 0
+        uint16_t aged_min_{0}; // 上一次整表衰减时的 g_clock_min
+
+        auto UpdateFloor() -> void
+        {
+            if (items_.size() < capacity_)
+            {
+                floor_ = 0;
+                return;
+            }
+            floor_ = std::min_element(items_.begin(), items_.end(), [](const Item &lhs, const Item &rhs)
+                                      { return lhs.counter_ < rhs.counter_; })
+                         ->counter_;
+        }
+
+    public:
+        explicit TopK(size_t capacity = 32) : capacity_(capacity) { items_.reserve(capacity); }
+
+        // 每分钟最多做一次，其余时候只有一次比较
+        auto Age() -> void
+        {
+            if (aged_min_ == g_clock_min)
+                return;
+            aged_min_ = g_clock_min;
+            for (auto &item : items_)
+            {
+                item.counter_ = Decay(item.counter_, item.last_min_);
+                item.last_min_ = g_clock_min;
+            }
+            UpdateFloor();
+        }
+
+        [[nodiscard]] auto Floor() -> uint8_t
+        {
+            Age();
+            return floor_;
+        }
+
+        // 调用方先判断 counter > Floor()
+        auto Offer(const std::string &key, uint64_t hcode, uint8_t counter) -> void
+        {
+            Age();
+            for (auto &item : items_)
+            {
+                if (item.hcode_ == hcode && item.key_ == key)
+                {
+                    bool was_floor = item.counter_ == floor_;
+                    item.counter_ = counter;
+                    item.last_min_ = g_clock_min;
+                    if (was_floor)
+                        UpdateFloor();
+                    return;
+                }
+            }
+            if (items_.size() < capacity_)
+            {
+                items_.push_back({key, hcode, counter, g_clock_min});
+            }
+            else
+            {
+                auto victim = std::min_element(items_.begin(), items_.end(), [](const Item &lhs, const Item &rhs)
+                                               { return lhs.counter_ < rhs.counter_; });
+                *victim = {key, hcode, counter, g_clock_min};
+            }
+            UpdateFloor();
+        }
+
+        [[nodiscard]] auto Items() const -> const std::vector<Item> & { return items_; }
+        auto Remove(size_t index) -> void
+        {
+            items_.erase(items_.begin() + static_cast<std::ptrdiff_t>(index));
+            UpdateFloor();
+        }
+        auto Clear() -> void
+        {
+            items_.clear();
+            floor_ = 0;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef LZF_H
+#define LZF_H
+
+/*
+LZF 压缩，输出格式与 liblzf 相同（Redis 压缩 list 节点用的也是它）
+压缩后的数据是一串指令，每条指令以一个控制字节开头：
+    000LLLLL                        之后跟 L + 1 个原样的字节
+    LLLooooo oooooooo               回到 o + 1 个字节之前复制 L + 2 个字节（L 为 1..6）
+    111ooooo LLLLLLLL oooooooo      同上，复制 L + 9 个字节
+查找重复用 3 字节的哈希表，只记最近一次出现的位置，不追求压缩率，速度和 liblzf 的默认档相当。
+*/
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "public.h"
+
+namespace kath::lzf
+{
+    constexpr size_t k_max_lit = 1 << 5;
+    constexpr size_t k_max_off = 1 << 13;
+    constexpr size_t k_max_ref = (1 << 8) + (1 << 3);
+    constexpr size_t k_hash_log = 12;
+
+    inline auto Hash3(const uint8_t *p) -> size_t
+    {
+        uint32_t val = (uint32_t(p[0]) << 16) | (uint32_t(p[1]) << 8) | p[2];
+        return (val * 2654435761u) >> (32 - k_hash_log);
+    }
+
+    // 返回压缩后的字节数，out 放不下（压缩不划算）时返回 0
+    inline auto Compress(const uint8_t *in, size_t len, uint8_t *out, size_t cap) -> size_t
+    {
+        std::array<uint32_t, size_t(1) << k_hash_log> table{};
+        size_t ip = 0;
+        size_t op = 0;
+        // 当前这段原样字节的控制字节的位置和长度
+        size_t lit_pos = op++;
+        size_t lit = 0;
+        if (cap == 0)
+            return 0;
+        auto emit_lit = [&](uint8_t byte) -> bool
+        {
+            if (op + 1 >= cap)
+                return false;
+            out[op++] = byte;
+            if (++lit == k_max_lit)
+            {
+                out[lit_pos] = static_cast<uint8_t>(lit - 1);
+                lit = 0;
+                lit_pos = op++;
+            }
+            return true;
+        };
+        while (ip + 2 < len)
+        {
+            size_t slot = Hash3(in + ip);
+            size_t ref = table[slot];
+            table[slot] = static_cast<uint32_t>(ip);
+            if (ref < ip && ip - ref <= k_max_off && std::memcmp(in + ref, in + ip, 3) == 0)
+            {
+                size_t max_len = std::min(k_max_ref, len - ip);
+                size_t match = 3;
+                while (match < max_len && in[ref + match] == in[ip + match])
+                {
+                    match++;
+                }
+                // 结束当前的原样段，没有字节时去掉预留的控制字节
+                if (lit != 0)
+                    out[lit_pos] = static_cast<uint8_t>(lit - 1);
+                else
+                    op--;
+                if (op + 4 >= cap)
+                    return 0;
+                size_t off = ip - ref - 1;
+                size_t code = match - 2;
+                if (code < 7)
+                {
+                    out[op++] = static_cast<uint8_t>((code << 5) | (off >> 8));
+                }
+                else
+                {
+                    out[op++] = static_cast<uint8_t>((7 << 5) | (off >> 8));
+                    out[op++] = static_cast<uint8_t>(code - 7);
+                }
+                out[op++] = static_cast<uint8_t>(off);
+                lit = 0;
+                lit_pos = op++;
+                ip += match;
+                continue;
+            }
+            if (!emit_lit(in[ip++]))
+                return 0;
+        }
+        while (ip < len)
+        {
+            if (!emit_lit(in[ip++]))
+                return 0;
+        }
+        if (lit != 0)
+            out[lit_pos] = static_cast<uint8_t>(lit - 1);
+        else
+            op--;
+        return op;
+    }
+
+    // 解压出的长度必须正好是 out_len，数据损坏时返回 false
+    inline auto Decompress(const uint8_t *in, size_t len, uint8_t *out, size_t out_len) -> bool
+    {
+        size_t ip = 0;
+        size_t op = 0;
+        while (ip < len)
+        {
+            size_t ctrl = in[ip++];
+            if (ctrl < k_max_lit)
+            {
+                size_t run = ctrl + 1;
+                if (ip + run > len || op + run > out_len)
+                    return false;
+                std::memcpy(out + op, in + ip, run);
+                ip += run;
+                op += run;
+                continue;
+            }
+            size_t run = ctrl >> 5;
+            if (run == 7)
+            {
+                if (ip >= len)
+                    return false;
+                run += in[ip++];
+            }
+            run += 2;
+            if (ip >= len)
+                return false;
+            size_t back = ((ctrl & 0x1f) << 8) + in[ip++] + 1;
+            if (back > op || op + run > out_len)
+                return false;
+            // 源和目标可能重叠，逐字节复制
+            for (size_t index = 0; index < run; index++, op++)
+            {
+                out[op] = out[op - back];
+            }
+        }
+        return op == out_len;
+    }
+}
+
+#endif
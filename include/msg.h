@@ -1,5 +1,6 @@
 #ifndef MSG_H
 #define MSG_H
+#include <cstddef>
 #include <cstdio>
 #include <cstdlib>
 #include <iostream>
@@ -25,6 +25,16 @@ namespace kath
         ERR_2Big,
         ERR_TYPE,
         ERR_ARG,
+        ERR_MOVED,       // key 所在的 slot 不属于当前节点，msg 为 "MOVED slot host:port"
+        ERR_CLUSTERDOWN, // slot 没有分配给任何节点
+        ERR_CROSSSLOT,   // 多 key 命令的 key 不在同一个 slot
+    };
+    // 连接使用的协议，由收到的第一个字节决定
+    enum class Proto : uint8_t
+    {
+        NATIVE = 0, // 长度前缀的二进制帧
+        RESP2,
+        RESP3,
     };
     enum class ConnState
     {
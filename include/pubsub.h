@@ -0,0 +1,515 @@
+#ifndef PUBSUB_H
+#define PUBSUB_H
+
+/*
+发布订阅 PUBLISH / SUBSCRIBE / PSUBSCRIBE
+每个 channel 的订阅者存在一个数组里，订阅者自己记着在各个数组中的下标，退订时与末尾交换，O(1) 删除。
+模式按记号（字面字符、?、*、[...]）插入一棵 trie，前缀相同的模式共享节点，
+发布时沿 trie 匹配 channel 名，不需要逐个模式尝试。
+
+一条消息对每种协议（原生、RESP2、RESP3）最多序列化一次，得到一个带引用计数的 string（StrPin），
+每个订阅者的回复队列只追加这个引用（见 buffer.h 的 OutBuf::AppendRef），
+所以 PUBLISH 对每个订阅者的开销只是一次指针追加。
+
+读得慢的订阅者会让回复队列一直变大，与 Redis 的 client-output-buffer-limit pubsub 相同：
+超过 g_pubsub_hard_limit 立即断开，超过 g_pubsub_soft_limit 持续 g_pubsub_soft_seconds 秒也断开。
+发布时只做标记，连接在事件循环这一轮结束前关闭（见 Server::CloseEvicted）。
+*/
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "public.h"
+#include "buffer.h"
+
+namespace kath
+{
+    inline size_t g_pubsub_hard_limit = 32 << 20;
+    inline size_t g_pubsub_soft_limit = 8 << 20;
+    inline uint64_t g_pubsub_soft_seconds = 60;
+
+    namespace pubsub
+    {
+        // 订阅的一方，作为成员放在 Conn 中，out_ 和 wake_ 由 Conn 设置
+        struct Subscriber
+        {
+            OutBuf *out_{nullptr};
+            // 回复队列有了新数据，需要等待可写
+            void (*wake_)(Subscriber *){nullptr};
+            // 订阅的 channel / 模式，以及自己在对应订阅者数组中的下标
+            std::unordered_map<std::string, size_t> channels_{};
+            std::unordered_map<std::string, size_t> patterns_{};
+            // 正在写一条回复时（原生协议的长度前缀还没回填）收到的消息先放在 pending_，回复写完后再追加
+            bool busy_{false};
+            std::vector<StrPin> pending_{};
+            uint64_t soft_since_us_{0};
+            bool evicted_{false};
+
+            [[nodiscard]] auto Count() const -> size_t { return channels_.size() + patterns_.size(); }
+            // 回复写完之后调用
+            auto EndReply() -> void
+            {
+                busy_ = false;
+                for (auto &frame : pending_)
+                {
+                    out_->AppendRef(std::move(frame), 0);
+                }
+                pending_.clear();
+            }
+        };
+
+        // 正在执行的命令来自哪个连接，在 Interpret 之前设置
+        inline Subscriber *g_current = nullptr;
+
+        // 与 Redis 的 stringmatch 相同：* 任意串，? 任意一个字符，[...] 字符集合（^ 取反，a-z 范围），\ 转义
+        // set 为方括号之间的内容
+        inline auto SetMatch(std::string_view set, char c) -> bool
+        {
+            bool negate = !set.empty() && set[0] == '^';
+            bool match = false;
+            for (size_t pos = negate ? 1 : 0; pos < set.size() && !match; pos++)
+            {
+                if (set[pos] == '\\' && pos + 1 < set.size())
+                {
+                    match = set[++pos] == c;
+                }
+                else if (pos + 2 < set.size() && set[pos + 1] == '-')
+                {
+                    auto lo = static_cast<uint8_t>(set[pos]);
+                    auto hi = static_cast<uint8_t>(set[pos + 2]);
+                    if (lo > hi)
+                        std::swap(lo, hi);
+                    match = static_cast<uint8_t>(c) >= lo && static_cast<uint8_t>(c) <= hi;
+                    pos += 2;
+                }
+                else
+                {
+                    match = set[pos] == c;
+                }
+            }
+            return match != negate;
+        }
+
+        class PatternTrie
+        {
+        private:
+            struct Node
+            {
+                std::unordered_map<char, std::unique_ptr<Node>> next_{}; // 字面字符
+                std::unique_ptr<Node> any_{};                            // ?
+                std::unique_ptr<Node> star_{};                           // *
+                std::vector<std::pair<std::string, std::unique_ptr<Node>>> sets_{};
+                // 在这里结束的模式，a** 与 a*、\a 与 a 这样写法不同的模式落在同一个节点
+                std::vector<const std::string *> patterns_{};
+                uint64_t seen_{0}; // 本次匹配是否已经报告过，见 Match
+                // 本次匹配中已经从哪些位置进入过这个节点，以及 star_ 已经试过 star_from_ 之后的所有位置；
+                // 同一个 (节点, 位置) 只展开一次，匹配的代价不超过 O(节点数 × channel 长度)
+                uint64_t visit_epoch_{0};
+                std::vector<bool> visited_{};
+                size_t star_from_{0};
+
+                [[nodiscard]] auto Empty() const -> bool
+                {
+                    return next_.empty() && !any_ && !star_ && sets_.empty() && patterns_.empty();
+                }
+            };
+            enum class Tok : uint8_t
+            {
+                LIT = 0,
+                ANY,
+                STAR,
+                SET,
+            };
+
+            Node root_{};
+            uint64_t epoch_{0};
+
+            // 从 pattern[pos] 取出一个记号，pos 前进到下一个记号；没有右括号的 [ 当作字面字符
+            static auto NextTok(std::string_view pattern, size_t &pos, std::string_view &text) -> Tok
+            {
+                char c = pattern[pos++];
+                if (c == '?')
+                    return Tok::ANY;
+                if (c == '*')
+                {
+                    // 连续的 * 与一个相同
+                    while (pos < pattern.size() && pattern[pos] == '*')
+                    {
+                        pos++;
+                    }
+                    return Tok::STAR;
+                }
+                if (c == '[')
+                {
+                    size_t end = pos;
+                    while (end < pattern.size() && pattern[end] != ']')
+                    {
+                        end += (pattern[end] == '\\' && end + 1 < pattern.size()) ? 2 : 1;
+                    }
+                    if (end < pattern.size())
+                    {
+                        text = pattern.substr(pos, end - pos);
+                        pos = end + 1;
+                        return Tok::SET;
+                    }
+                }
+                else if (c == '\\' && pos < pattern.size())
+                {
+                    // 转义的下一个字符按字面处理
+                    pos++;
+                }
+                text = pattern.substr(pos - 1, 1);
+                return Tok::LIT;
+            }
+
+            // 记号对应的子节点，create 为 false 时不存在返回 nullptr
+            static auto Child(Node *node, Tok tok, char lit, std::string_view set, bool create) -> std::unique_ptr<Node> *
+            {
+                switch (tok)
+                {
+                case Tok::ANY:
+                    return (create || node->any_) ? &node->any_ : nullptr;
+                case Tok::STAR:
+                    return (create || node->star_) ? &node->star_ : nullptr;
+                case Tok::SET:
+                    for (auto &[text, child] : node->sets_)
+                    {
+                        if (text == set)
+                            return &child;
+                    }
+                    if (!create)
+                        return nullptr;
+                    node->sets_.emplace_back(std::string(set), nullptr);
+                    return &node->sets_.back().second;
+                default:
+                {
+                    auto iter = node->next_.find(lit);
+                    if (iter != node->next_.end())
+                        return &iter->second;
+                    return create ? &node->next_[lit] : nullptr;
+                }
+                }
+            }
+
+            static auto Unlink(Node *node, Tok tok, char lit, std::string_view set) -> void
+            {
+                switch (tok)
+                {
+                case Tok::ANY:
+                    node->any_.reset();
+                    break;
+                case Tok::STAR:
+                    node->star_.reset();
+                    break;
+                case Tok::SET:
+                    for (auto iter = node->sets_.begin(); iter != node->sets_.end(); ++iter)
+                    {
+                        if (iter->first == set)
+                        {
+                            node->sets_.erase(iter);
+                            break;
+                        }
+                    }
+                    break;
+                default:
+                    node->next_.erase(lit);
+                    break;
+                }
+            }
+
+            // 删除 pattern[pos:] 的路径，返回 node 是否已经没用了
+            auto Erase(Node *node, std::string_view pattern, size_t pos) -> bool
+            {
+                if (pos == pattern.size())
+                {
+                    auto &ends = node->patterns_;
+                    ends.erase(std::find_if(ends.begin(), ends.end(), [&](const std::string *end)
+                                            { return *end == pattern; }));
+                    return node->Empty();
+                }
+                std::string_view text;
+                Tok tok = NextTok(pattern, pos, text);
+                char lit = tok == Tok::LIT ? text[0] : '\0';
+                auto *child = Child(node, tok, lit, text, false);
+                if (child != nullptr && Erase(child->get(), pattern, pos))
+                {
+                    Unlink(node, tok, lit, text);
+                }
+                return node->Empty();
+            }
+
+            template <typename F>
+            auto Report(Node *node, F &fn) -> void
+            {
+                if (node->seen_ == epoch_)
+                    return;
+                node->seen_ = epoch_;
+                for (const auto *pattern : node->patterns_)
+                {
+                    fn(*pattern);
+                }
+            }
+
+            template <typename F>
+            auto Visit(Node *node, std::string_view channel, size_t pos, F &fn) -> void
+            {
+                if (node->visit_epoch_ != epoch_)
+                {
+                    node->visit_epoch_ = epoch_;
+                    node->visited_.assign(channel.size() + 1, false);
+                    node->star_from_ = channel.size() + 1;
+                }
+                if (node->visited_[pos])
+                    return;
+                node->visited_[pos] = true;
+                if (node->star_)
+                {
+                    Node *star = node->star_.get();
+                    // 以 * 结尾的模式匹配任意后缀，只报告一次
+                    Report(star, fn);
+                    if (!star->next_.empty() || star->any_ || !star->sets_.empty())
+                    {
+                        // 之前从更后面的位置进来时已经试过 star_from_ 之后的位置；trie 没有环，循环中不会再进入 node
+                        for (size_t skip = pos; skip < node->star_from_; skip++)
+                        {
+                            Visit(star, channel, skip, fn);
+                        }
+                        node->star_from_ = std::min(node->star_from_, pos);
+                    }
+                }
+                if (pos == channel.size())
+                {
+                    Report(node, fn);
+                    return;
+                }
+                char c = channel[pos];
+                auto iter = node->next_.find(c);
+                if (iter != node->next_.end())
+                    Visit(iter->second.get(), channel, pos + 1, fn);
+                if (node->any_)
+                    Visit(node->any_.get(), channel, pos + 1, fn);
+                for (auto &[set, child] : node->sets_)
+                {
+                    if (SetMatch(set, c))
+                        Visit(child.get(), channel, pos + 1, fn);
+                }
+            }
+
+        public:
+            // pattern 指向 Hub 中保存的模式串，删除之前一直有效
+            auto Insert(const std::string *pattern) -> void
+            {
+                Node *node = &root_;
+                std::string_view text;
+                for (size_t pos = 0; pos < pattern->size();)
+                {
+                    Tok tok = NextTok(*pattern, pos, text);
+                    auto *child = Child(node, tok, tok == Tok::LIT ? text[0] : '\0', text, true);
+                    if (!*child)
+                        *child = std::make_unique<Node>();
+                    node = child->get();
+                }
+                node->patterns_.push_back(pattern);
+            }
+
+            auto Erase(std::string_view pattern) -> void { Erase(&root_, pattern, 0); }
+
+            // 对每个与 channel 匹配的模式调用一次 fn(const std::string &)
+            template <typename F>
+            auto Match(std::string_view channel, F &&fn) -> void
+            {
+                epoch_++;
+                Visit(&root_, channel, 0, fn);
+            }
+        };
+
+        class Hub
+        {
+        private:
+            using Table = std::unordered_map<std::string, std::vector<Subscriber *>>;
+            using Owned = std::unordered_map<std::string, size_t> Subscriber::*;
+
+            Table channels_{};
+            Table patterns_{};
+            PatternTrie trie_{};
+            std::vector<Subscriber *> evicted_{};
+            uint64_t disconnections_{0};
+
+            static auto Join(Table &table, Owned owned, Subscriber *sub, const std::string &name) -> bool
+            {
+                auto &mine = sub->*owned;
+                if (mine.count(name) != 0)
+                    return false;
+                auto &subs = table[name];
+                mine.emplace(name, subs.size());
+                subs.push_back(sub);
+                return true;
+            }
+            // 与数组末尾交换后删除，被换过来的订阅者更新自己记的下标
+            static auto Leave(Table &table, Owned owned, Subscriber *sub, const std::string &name) -> bool
+            {
+                auto &mine = sub->*owned;
+                auto found = mine.find(name);
+                if (found == mine.end())
+                    return false;
+                auto entry = table.find(name);
+                auto &subs = entry->second;
+                size_t index = found->second;
+                subs[index] = subs.back();
+                (subs[index]->*owned)[name] = index;
+                subs.pop_back();
+                mine.erase(found);
+                if (subs.empty())
+                    table.erase(entry);
+                return true;
+            }
+
+            auto LeaveAll(Subscriber *sub) -> void
+            {
+                while (!sub->channels_.empty())
+                {
+                    Unsubscribe(sub, std::string(sub->channels_.begin()->first));
+                }
+                while (!sub->patterns_.empty())
+                {
+                    PUnsubscribe(sub, std::string(sub->patterns_.begin()->first));
+                }
+            }
+
+            auto Evict(Subscriber *sub) -> void
+            {
+                sub->evicted_ = true;
+                evicted_.push_back(sub);
+                disconnections_++;
+            }
+
+            // 追加一条消息并检查回复队列的上限
+            auto Deliver(Subscriber *sub, const StrPin &frame, uint64_t &now_us) -> void
+            {
+                if (sub->evicted_)
+                    return;
+                if (sub->busy_)
+                {
+                    sub->pending_.push_back(frame);
+                    return;
+                }
+                sub->out_->AppendRef(frame, 0);
+                size_t size = sub->out_->Size();
+                if (size > g_pubsub_hard_limit)
+                    return Evict(sub);
+                if (size <= g_pubsub_soft_limit)
+                {
+                    sub->soft_since_us_ = 0;
+                }
+                else
+                {
+                    if (now_us == 0)
+                        now_us = GetMonotonicUsec();
+                    if (sub->soft_since_us_ == 0)
+                        sub->soft_since_us_ = now_us;
+                    else if (now_us - sub->soft_since_us_ >= g_pubsub_soft_seconds * 1000000)
+                        return Evict(sub);
+                }
+                sub->wake_(sub);
+            }
+
+        public:
+            auto Subscribe(Subscriber *sub, const std::string &channel) -> bool
+            {
+                return Join(channels_, &Subscriber::channels_, sub, channel);
+            }
+            auto Unsubscribe(Subscriber *sub, const std::string &channel) -> bool
+            {
+                return Leave(channels_, &Subscriber::channels_, sub, channel);
+            }
+            auto PSubscribe(Subscriber *sub, const std::string &pattern) -> bool
+            {
+                if (!Join(patterns_, &Subscriber::patterns_, sub, pattern))
+                    return false;
+                auto entry = patterns_.find(pattern);
+                if (entry->second.size() == 1)
+                    trie_.Insert(&entry->first);
+                return true;
+            }
+            auto PUnsubscribe(Subscriber *sub, const std::string &pattern) -> bool
+            {
+                if (sub->patterns_.count(pattern) == 0)
+                    return false;
+                // trie 中引用着 patterns_ 的 key，最后一个订阅者退订时先从 trie 删除
+                if (patterns_.find(pattern)->second.size() == 1)
+                    trie_.Erase(pattern);
+                return Leave(patterns_, &Subscriber::patterns_, sub, pattern);
+            }
+
+            // 连接关闭时调用：退订全部，并且不再等待关闭
+            auto Remove(Subscriber *sub) -> void
+            {
+                LeaveAll(sub);
+                if (sub->evicted_)
+                {
+                    evicted_.erase(std::remove(evicted_.begin(), evicted_.end(), sub), evicted_.end());
+                }
+            }
+
+            /*
+            把消息交给订阅 channel 的客户端和订阅了匹配模式的客户端，返回收到消息的客户端数（按订阅次数计）
+            encode(Proto, const std::string *pattern) -> StrPin 序列化一条消息，pattern 为 nullptr 时是 channel 消息，
+            同一个 pattern 对每种协议只调用一次
+            */
+            template <typename Encode>
+            auto Publish(const std::string &channel, Encode &&encode) -> size_t
+            {
+                size_t receivers = 0;
+                uint64_t now_us = 0;
+                size_t first_evicted = evicted_.size();
+                auto send = [&](const std::vector<Subscriber *> &subs, const std::string *pattern)
+                {
+                    std::array<StrPin, 3> frames{};
+                    for (auto *sub : subs)
+                    {
+                        auto &frame = frames[static_cast<size_t>(sub->out_->GetProto())];
+                        if (!frame)
+                            frame = encode(sub->out_->GetProto(), pattern);
+                        Deliver(sub, frame, now_us);
+                    }
+                    receivers += subs.size();
+                };
+                auto entry = channels_.find(channel);
+                if (entry != channels_.end())
+                    send(entry->second, nullptr);
+                if (!patterns_.empty())
+                {
+                    trie_.Match(channel, [&](const std::string &pattern)
+                                { send(patterns_.find(pattern)->second, &pattern); });
+                }
+                // 遍历数组时不能删除，超限的订阅者最后统一退订，之后不会再收到消息
+                for (size_t index = first_evicted; index < evicted_.size(); index++)
+                {
+                    LeaveAll(evicted_[index]);
+                }
+                return receivers;
+            }
+
+            // 超过回复队列上限、等待关闭的订阅者
+            auto TakeEvicted() -> std::vector<Subscriber *>
+            {
+                return std::exchange(evicted_, {});
+            }
+
+            [[nodiscard]] auto Channels() const -> size_t { return channels_.size(); }
+            [[nodiscard]] auto Patterns() const -> size_t { return patterns_.size(); }
+            [[nodiscard]] auto Disconnections() const -> uint64_t { return disconnections_; }
+        };
+        inline Hub g_hub{};
+    }
+}
+
+#endif
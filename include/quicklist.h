@@ -0,0 +1,374 @@
+#ifndef QUICKLIST_H
+#define QUICKLIST_H
+
+/*
+list 类型的值：由定长块组成的双向链表（与 Redis 的 quicklist 相同）
+每个块的元素紧挨着存在一个 string 里，块的大小不超过 g_list_chunk_bytes，元素的编码为
+    长度 < 128       [len][data][len]                         额外 2 字节
+    其他             [0x80][len 4 字节][data][len 4 字节][0x80]   额外 10 字节
+前后都有长度，所以两端都能直接取出第一个 / 最后一个元素。
+一个元素平均只多 2 字节，每个块再多一个链表节点和 string 头，8KB 的块里可以放几百个小元素。
+超过块大小的元素单独占一个块。
+
+g_list_compress_depth 不为 0 时，两端各 depth 个块保持原样，中间的块用 LZF 压缩（见 lzf.h）。
+修改只发生在两端的块上，中间的块只有 LRANGE 读取时解压到临时缓冲区，不会改回原样。
+每次修改后从两端向中间整理：depth 以内的块解压，刚进入中间的块压缩，遇到已经处理过的块就停下。
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "public.h"
+#include "list.h"
+#include "lzf.h"
+
+namespace kath
+{
+    inline size_t g_list_chunk_bytes = 8 << 10;
+    inline size_t g_list_compress_depth = 0;
+
+    namespace quick
+    {
+        constexpr size_t k_small = 0x80;
+        // 小于这个大小的块不压缩，压缩后至少要省下 k_min_saving 字节才保留压缩结果
+        constexpr size_t k_min_compress = 48;
+        constexpr size_t k_min_saving = 8;
+
+        inline auto EncodedSize(size_t len) -> size_t
+        {
+            return len < k_small ? len + 2 : len + 10;
+        }
+
+        inline auto Encode(std::string_view elem) -> std::string
+        {
+            std::string res;
+            res.reserve(EncodedSize(elem.size()));
+            if (elem.size() < k_small)
+            {
+                res += static_cast<char>(elem.size());
+                res += elem;
+                res += static_cast<char>(elem.size());
+                return res;
+            }
+            auto len = static_cast<uint32_t>(elem.size());
+            char bytes[4];
+            std::memcpy(bytes, &len, 4);
+            res += static_cast<char>(k_small);
+            res.append(bytes, 4);
+            res += elem;
+            res.append(bytes, 4);
+            res += static_cast<char>(k_small);
+            return res;
+        }
+
+        // 从 data[pos] 开始的元素，pos 前进到下一个元素
+        inline auto Next(std::string_view data, size_t &pos) -> std::string_view
+        {
+            auto head = static_cast<uint8_t>(data[pos]);
+            if (head < k_small)
+            {
+                auto elem = data.substr(pos + 1, head);
+                pos += head + 2;
+                return elem;
+            }
+            uint32_t len = 0;
+            std::memcpy(&len, data.data() + pos + 1, 4);
+            auto elem = data.substr(pos + 5, len);
+            pos += len + 10;
+            return elem;
+        }
+
+        // 结束于 end 的元素的起始位置
+        inline auto Prev(std::string_view data, size_t end) -> size_t
+        {
+            auto tail = static_cast<uint8_t>(data[end - 1]);
+            if (tail < k_small)
+                return end - tail - 2;
+            uint32_t len = 0;
+            std::memcpy(&len, data.data() + end - 5, 4);
+            return end - len - 10;
+        }
+    }
+
+    class QuickList
+    {
+    private:
+        enum class Enc : uint8_t
+        {
+            RAW = 0,
+            LZF,
+            RAW_INNER, // 在中间但压缩不划算，保持原样
+        };
+        struct Chunk
+        {
+            DList link_{};
+            std::string data_{};
+            uint32_t count_{0};
+            Enc enc_{Enc::RAW};
+            size_t raw_size_{0}; // 压缩前的大小
+        };
+
+        DList head_{};
+        size_t size_{0};
+        size_t chunks_{0};
+
+        static auto Of(DList *link) -> Chunk * { return container_of(link, Chunk, link_); }
+        static auto Of(const DList *link) -> const Chunk * { return Of(const_cast<DList *>(link)); }
+        [[nodiscard]] auto Front() const -> Chunk * { return head_.Empty() ? nullptr : Of(head_.next_); }
+        [[nodiscard]] auto Back() const -> Chunk * { return head_.Empty() ? nullptr : Of(head_.prev_); }
+
+        // 在 pos 之前插入一个空块
+        auto NewChunk(DList *pos) -> Chunk *
+        {
+            auto *chunk = new Chunk();
+            pos->InsertFront(&chunk->link_);
+            chunks_++;
+            return chunk;
+        }
+        auto FreeChunk(Chunk *chunk) -> void
+        {
+            chunk->link_.Detach();
+            size_ -= chunk->count_;
+            chunks_--;
+            delete chunk;
+        }
+
+        static auto Decompress(Chunk *chunk) -> void
+        {
+            if (chunk->enc_ == Enc::LZF)
+            {
+                std::string raw(chunk->raw_size_, '\0');
+                lzf::Decompress(reinterpret_cast<const uint8_t *>(chunk->data_.data()), chunk->data_.size(),
+                                reinterpret_cast<uint8_t *>(raw.data()), raw.size());
+                chunk->data_ = std::move(raw);
+            }
+            chunk->enc_ = Enc::RAW;
+        }
+        static auto Compress(Chunk *chunk) -> void
+        {
+            chunk->enc_ = Enc::RAW_INNER;
+            size_t len = chunk->data_.size();
+            if (len < quick::k_min_compress)
+                return;
+            std::string packed(len - quick::k_min_saving, '\0');
+            size_t packed_len = lzf::Compress(reinterpret_cast<const uint8_t *>(chunk->data_.data()), len,
+                                              reinterpret_cast<uint8_t *>(packed.data()), packed.size());
+            if (packed_len == 0)
+                return;
+            packed.resize(packed_len);
+            packed.shrink_to_fit();
+            chunk->raw_size_ = len;
+            chunk->data_ = std::move(packed);
+            chunk->enc_ = Enc::LZF;
+        }
+        // 块的原始内容，压缩的块解压到 scratch 中
+        static auto View(const Chunk *chunk, std::string &scratch) -> std::string_view
+        {
+            if (chunk->enc_ != Enc::LZF)
+                return chunk->data_;
+            scratch.resize(chunk->raw_size_);
+            lzf::Decompress(reinterpret_cast<const uint8_t *>(chunk->data_.data()), chunk->data_.size(),
+                            reinterpret_cast<uint8_t *>(scratch.data()), scratch.size());
+            return scratch;
+        }
+
+        // 见文件开头：两端 depth 以内的块为原样，中间的块都处理过
+        auto Recompress() -> void
+        {
+            size_t depth = g_list_compress_depth;
+            if (depth == 0)
+                return;
+            auto settle = [&](bool from_front)
+            {
+                DList *link = from_front ? head_.next_ : head_.prev_;
+                for (size_t index = 0; link != &head_; index++)
+                {
+                    Chunk *chunk = Of(link);
+                    if (index < depth || index + depth >= chunks_)
+                    {
+                        if (index < depth)
+                            Decompress(chunk);
+                    }
+                    else if (chunk->enc_ == Enc::RAW)
+                    {
+                        Compress(chunk);
+                    }
+                    else
+                    {
+                        break;
+                    }
+                    link = from_front ? link->next_ : link->prev_;
+                }
+            };
+            settle(true);
+            settle(false);
+        }
+
+    public:
+        QuickList() = default;
+        QuickList(const QuickList &) = delete;
+        auto operator=(const QuickList &) -> QuickList & = delete;
+        ~QuickList()
+        {
+            while (!head_.Empty())
+            {
+                FreeChunk(Front());
+            }
+        }
+
+        [[nodiscard]] auto Size() const -> size_t { return size_; }
+        [[nodiscard]] auto Chunks() const -> size_t { return chunks_; }
+        // 各块数据的字节数之和，压缩的块按压缩后计算
+        [[nodiscard]] auto Bytes() const -> size_t
+        {
+            size_t bytes = 0;
+            for (const DList *link = head_.next_; link != &head_; link = link->next_)
+            {
+                bytes += Of(link)->data_.size();
+            }
+            return bytes;
+        }
+
+        auto Push(bool front, std::string_view elem) -> void
+        {
+            Chunk *chunk = front ? Front() : Back();
+            size_t need = quick::EncodedSize(elem.size());
+            if (chunk == nullptr || (chunk->count_ != 0 && chunk->data_.size() + need > g_list_chunk_bytes))
+            {
+                // 写满的块不会再变大，去掉 string 按倍数增长多出的容量
+                if (chunk != nullptr)
+                    chunk->data_.shrink_to_fit();
+                chunk = NewChunk(front ? head_.next_ : &head_);
+            }
+            else
+            {
+                Decompress(chunk);
+            }
+            auto bytes = quick::Encode(elem);
+            if (front)
+                chunk->data_.insert(0, bytes);
+            else
+                chunk->data_ += bytes;
+            chunk->count_++;
+            size_++;
+            Recompress();
+        }
+
+        auto Pop(bool front) -> std::optional<std::string>
+        {
+            Chunk *chunk = front ? Front() : Back();
+            if (chunk == nullptr)
+                return std::nullopt;
+            Decompress(chunk);
+            std::string_view data = chunk->data_;
+            size_t first = front ? 0 : quick::Prev(data, data.size());
+            size_t last = first;
+            std::string elem(quick::Next(data, last));
+            chunk->data_.erase(first, last - first);
+            chunk->count_--;
+            size_--;
+            if (chunk->count_ == 0)
+                FreeChunk(chunk);
+            Recompress();
+            return elem;
+        }
+
+        // 按顺序对 [first, last] 中的每个元素调用 fn(std::string_view)，两端都必须在范围内
+        template <typename F>
+        auto Range(size_t first, size_t last, F &&fn) const -> void
+        {
+            // 从离 first 近的一端找到所在的块
+            const DList *link = nullptr;
+            size_t base = 0;
+            if (first < size_ / 2)
+            {
+                for (link = head_.next_; base + Of(link)->count_ <= first; link = link->next_)
+                {
+                    base += Of(link)->count_;
+                }
+            }
+            else
+            {
+                base = size_;
+                for (link = head_.prev_;; link = link->prev_)
+                {
+                    base -= Of(link)->count_;
+                    if (base <= first)
+                        break;
+                }
+            }
+            std::string scratch;
+            size_t index = base;
+            for (; link != &head_ && index <= last; link = link->next_)
+            {
+                std::string_view data = View(Of(link), scratch);
+                for (size_t pos = 0; pos < data.size() && index <= last; index++)
+                {
+                    auto elem = quick::Next(data, pos);
+                    if (index >= first)
+                        fn(elem);
+                }
+            }
+        }
+
+        // 只保留 [first, last]，first > last 或者超出范围时清空
+        auto Trim(size_t first, size_t last) -> void
+        {
+            if (first > last || first >= size_)
+            {
+                while (!head_.Empty())
+                {
+                    FreeChunk(Front());
+                }
+                return;
+            }
+            size_t drop_back = size_ - 1 - std::min(last, size_ - 1);
+            size_t drop_front = first;
+            // 整块丢弃
+            while (drop_front != 0 && Front()->count_ <= drop_front)
+            {
+                drop_front -= Front()->count_;
+                FreeChunk(Front());
+            }
+            while (drop_back != 0 && Back()->count_ <= drop_back)
+            {
+                drop_back -= Back()->count_;
+                FreeChunk(Back());
+            }
+            // 剩下的在两端的块内部
+            if (drop_front != 0)
+            {
+                Chunk *chunk = Front();
+                Decompress(chunk);
+                size_t pos = 0;
+                for (size_t index = 0; index < drop_front; index++)
+                {
+                    quick::Next(chunk->data_, pos);
+                }
+                chunk->data_.erase(0, pos);
+                chunk->count_ -= static_cast<uint32_t>(drop_front);
+                size_ -= drop_front;
+            }
+            if (drop_back != 0)
+            {
+                Chunk *chunk = Back();
+                Decompress(chunk);
+                size_t pos = chunk->data_.size();
+                for (size_t index = 0; index < drop_back; index++)
+                {
+                    pos = quick::Prev(chunk->data_, pos);
+                }
+                chunk->data_.erase(pos);
+                chunk->count_ -= static_cast<uint32_t>(drop_back);
+                size_ -= drop_back;
+            }
+            Recompress();
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef RADIX_H
+#define RADIX_H
+
+/*
+压缩路径的基数树（与 Redis 的 rax 同类），key 为字节串，值为 T *，不持有值
+每个节点保存一段路径 prefix_，子节点按 prefix_ 的第一个字节排序；
+只有一个子节点且没有值的节点会与子节点合并，所以节点数不超过 key 数的两倍。
+定长的大端 key（如 stream 的 ID）按字节比较就是按数值比较，Floor 找不大于给定 key 的最大 key，
+查找只走一条路径，代价与 key 的长度有关，与 key 的个数无关。
+*/
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "public.h"
+
+namespace kath
+{
+    template <typename T>
+    class RadixTree
+    {
+    private:
+        struct Node
+        {
+            std::string prefix_{};
+            std::vector<std::unique_ptr<Node>> children_{};
+            T *value_{nullptr};
+        };
+
+        Node root_{};
+        size_t size_{0};
+
+        static auto Common(std::string_view lhs, std::string_view rhs) -> size_t
+        {
+            size_t len = 0;
+            while (len < lhs.size() && len < rhs.size() && lhs[len] == rhs[len])
+            {
+                len++;
+            }
+            return len;
+        }
+
+        // 第一个字节不小于 byte 的子节点的位置
+        static auto LowerBound(Node *node, uint8_t byte) -> size_t
+        {
+            auto iter = std::lower_bound(node->children_.begin(), node->children_.end(), byte,
+                                         [](const std::unique_ptr<Node> &child, uint8_t val)
+                                         { return static_cast<uint8_t>(child->prefix_[0]) < val; });
+            return static_cast<size_t>(iter - node->children_.begin());
+        }
+
+        // 子树中最大的 key 的值
+        static auto Max(Node *node) -> T *
+        {
+            while (!node->children_.empty())
+            {
+                node = node->children_.back().get();
+            }
+            return node->value_;
+        }
+
+        // node 的路径已经与 key[0, depth) 相同
+        static auto Floor(Node *node, std::string_view key, size_t depth) -> T *
+        {
+            if (depth == key.size())
+                return node->value_;
+            auto byte = static_cast<uint8_t>(key[depth]);
+            size_t pos = LowerBound(node, byte);
+            if (pos < node->children_.size() && static_cast<uint8_t>(node->children_[pos]->prefix_[0]) == byte)
+            {
+                Node *child = node->children_[pos].get();
+                std::string_view rest = key.substr(depth);
+                size_t len = Common(child->prefix_, rest);
+                T *found = nullptr;
+                if (len == child->prefix_.size())
+                    found = Floor(child, key, depth + len);
+                else if (len < rest.size() && static_cast<uint8_t>(child->prefix_[len]) < static_cast<uint8_t>(rest[len]))
+                    // 在分叉处子树的路径更小，整棵子树都比 key 小
+                    found = Max(child);
+                if (found != nullptr)
+                    return found;
+            }
+            // 前面的兄弟子树都比 key 小，最近的一个里取最大的
+            for (size_t index = pos; index > 0; index--)
+            {
+                if (T *found = Max(node->children_[index - 1].get()))
+                    return found;
+            }
+            return node->value_;
+        }
+
+        // 返回 node 是否可以从父节点删除
+        auto Erase(Node *node, std::string_view key, size_t depth) -> bool
+        {
+            if (depth == key.size())
+            {
+                if (node->value_ != nullptr)
+                    size_--;
+                node->value_ = nullptr;
+            }
+            else
+            {
+                size_t pos = LowerBound(node, static_cast<uint8_t>(key[depth]));
+                if (pos == node->children_.size())
+                    return false;
+                Node *child = node->children_[pos].get();
+                std::string_view rest = key.substr(depth);
+                if (rest.substr(0, child->prefix_.size()) != child->prefix_)
+                    return false;
+                if (Erase(child, key, depth + child->prefix_.size()))
+                    node->children_.erase(node->children_.begin() + static_cast<ptrdiff_t>(pos));
+            }
+            if (node == &root_)
+                return false;
+            if (node->value_ == nullptr && node->children_.size() == 1)
+            {
+                // 与唯一的子节点合并
+                auto child = std::move(node->children_[0]);
+                node->prefix_ += child->prefix_;
+                node->value_ = child->value_;
+                node->children_ = std::move(child->children_);
+            }
+            return node->value_ == nullptr && node->children_.empty();
+        }
+
+    public:
+        [[nodiscard]] auto Size() const -> size_t { return size_; }
+        [[nodiscard]] auto Empty() const -> bool { return size_ == 0; }
+
+        // key 已经存在时替换它的值
+        auto Insert(std::string_view key, T *value) -> void
+        {
+            Node *node = &root_;
+            size_t depth = 0;
+            while (depth < key.size())
+            {
+                std::string_view rest = key.substr(depth);
+                size_t pos = LowerBound(node, static_cast<uint8_t>(rest[0]));
+                if (pos == node->children_.size() || node->children_[pos]->prefix_[0] != rest[0])
+                {
+                    auto leaf = std::make_unique<Node>();
+                    leaf->prefix_ = std::string(rest);
+                    leaf->value_ = value;
+                    node->children_.insert(node->children_.begin() + static_cast<ptrdiff_t>(pos), std::move(leaf));
+                    size_++;
+                    return;
+                }
+                auto &slot = node->children_[pos];
+                size_t len = Common(slot->prefix_, rest);
+                if (len < slot->prefix_.size())
+                {
+                    // 在公共前缀处拆开
+                    auto mid = std::make_unique<Node>();
+                    mid->prefix_ = slot->prefix_.substr(0, len);
+                    slot->prefix_.erase(0, len);
+                    mid->children_.push_back(std::move(slot));
+                    slot = std::move(mid);
+                }
+                node = slot.get();
+                depth += len;
+            }
+            if (node->value_ == nullptr)
+                size_++;
+            node->value_ = value;
+        }
+
+        auto Erase(std::string_view key) -> void { Erase(&root_, key, 0); }
+
+        // 不大于 key 的最大 key 的值，没有时返回 nullptr
+        [[nodiscard]] auto Floor(std::string_view key) const -> T *
+        {
+            return Floor(const_cast<Node *>(&root_), key, 0);
+        }
+    };
+}
+
+#endif
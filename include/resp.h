@@ -0,0 +1,300 @@
+#ifndef RESP_H
+#define RESP_H
+
+/*
+RESP2 / RESP3 协议
+https://redis.io/docs/reference/protocol-spec/
+
+连接上收到的第一个字节是 '*'，并且后面紧跟着数字和 \r\n 时认为是 RESP，否则按原生的二进制帧处理。
+原生帧的前 4 字节是长度，要同时满足这个格式，长度至少要 3MB 且第二个字段要超过 2573 个参数，实际中不会出现。
+RESP 连接默认是 RESP2，HELLO 3 之后切换为 RESP3。
+已经确定是 RESP 的连接也接受 inline 命令（如 "PING\r\n"）。
+*/
+
+#include <charconv>
+#include <cstring>
+#include <string_view>
+
+#include "public.h"
+#include "buffer.h"
+#include "command.h"
+#include "frame.h"
+
+namespace kath::resp
+{
+    // 单行（头部或 inline 命令）的最大长度，参数长度与个数的上限见 frame.h
+    inline constexpr size_t k_max_line = 64 * 1024;
+
+    // 返回 1:是 RESP   0:不是   -1:数据不够判断
+    inline auto Detect(const std::byte *data, size_t len) -> int
+    {
+        if (len == 0)
+            return -1;
+        if (static_cast<char>(data[0]) != '*')
+            return 0;
+        for (size_t index = 1; index < len && index < 12; index++)
+        {
+            auto c = static_cast<char>(data[index]);
+            if (c == '\r')
+            {
+                if (index == 1)
+                    return 0;
+                if (index + 1 == len)
+                    return -1;
+                return static_cast<char>(data[index + 1]) == '\n';
+            }
+            if (c < '0' || c > '9')
+                return 0;
+        }
+        return len < 12 ? -1 : 0;
+    }
+
+    /*
+    可续传的请求解析器
+    数据不完整时记住解析到的位置和状态，下次从断点继续，不会重新扫描已经解析过的部分。
+    pos_ 是相对于缓冲区可读起点的偏移，调用方只在得到完整命令后才消费数据，所以它一直有效。
+    参数在完整读到之前不会拷贝，读到后直接写进复用的 cmd 中。
+    */
+    class Parser
+    {
+    private:
+        enum class State
+        {
+            ARRAY_HEADER,
+            BULK_HEADER,
+            BULK_BODY,
+        };
+        State state_{State::ARRAY_HEADER};
+        size_t pos_{0};
+        int64_t argc_{0};
+        int64_t argi_{0};
+        int64_t bulk_len_{0};
+        const char *err_{""};
+
+        auto Fail(const char *err) -> int
+        {
+            err_ = err;
+            return -1;
+        }
+        // 在 [pos_, len) 中找 \r\n，返回 \r 的位置，找不到返回 npos
+        auto FindCrlf(const std::byte *data, size_t len) const -> size_t
+        {
+            const auto *begin = reinterpret_cast<const char *>(data);
+            const void *found = std::memchr(begin + pos_, '\r', len - pos_);
+            if (found == nullptr)
+                return std::string_view::npos;
+            size_t cr = static_cast<const char *>(found) - begin;
+            if (cr + 1 >= len)
+                return std::string_view::npos;
+            return cr;
+        }
+        static auto ParseInt(const std::byte *data, size_t begin, size_t end, int64_t &out) -> bool
+        {
+            const auto *first = reinterpret_cast<const char *>(data) + begin;
+            const auto *last = reinterpret_cast<const char *>(data) + end;
+            auto [ptr, ec] = std::from_chars(first, last, out);
+            return ec == std::errc() && ptr == last && first != last;
+        }
+
+        // inline 命令：按空白切分一行
+        auto ParseInline(const std::byte *data, size_t len, Cmd &cmd, size_t &consumed) -> int
+        {
+            const auto *begin = reinterpret_cast<const char *>(data);
+            const void *found = std::memchr(begin, '\n', len);
+            if (found == nullptr)
+                return len > k_max_line ? Fail("too big inline request") : 0;
+            size_t end = static_cast<const char *>(found) - begin;
+            consumed = end + 1;
+            if (end > 0 && begin[end - 1] == '\r')
+                end--;
+            size_t argc = 0;
+            for (size_t index = 0; index < end;)
+            {
+                while (index < end && (begin[index] == ' ' || begin[index] == '\t'))
+                    index++;
+                if (index == end)
+                    break;
+                size_t word = index;
+                while (index < end && begin[index] != ' ' && begin[index] != '\t')
+                    index++;
+                if (cmd.size() <= argc)
+                    cmd.emplace_back();
+                cmd[argc++].assign(begin + word, index - word);
+            }
+            cmd.resize(argc);
+            return 1;
+        }
+
+    public:
+        // 出错时的原因
+        [[nodiscard]] auto Error() const -> const char * { return err_; }
+
+        // 下一次至少需要多少字节才可能有进展
+        [[nodiscard]] auto Need() const -> size_t
+        {
+            if (state_ == State::BULK_BODY)
+                return pos_ + static_cast<size_t>(bulk_len_) + 2;
+            return pos_ + 1;
+        }
+
+        // 返回 1:得到一条完整命令，consumed 为它占用的字节数   0:数据不够   -1:协议错误，原因见 Error()
+        // 空命令（*0、空行）返回 1 且 cmd 为空
+        auto Parse(const std::byte *data, size_t len, Cmd &cmd, size_t &consumed) -> int
+        {
+            for (;;)
+            {
+                switch (state_)
+                {
+                case State::ARRAY_HEADER:
+                {
+                    if (len == 0)
+                        return 0;
+                    if (static_cast<char>(data[0]) != '*')
+                        return ParseInline(data, len, cmd, consumed);
+                    pos_ = 1;
+                    size_t cr = FindCrlf(data, len);
+                    if (cr == std::string_view::npos)
+                    {
+                        pos_ = 0;
+                        return len > k_max_line ? Fail("too big mbulk count string") : 0;
+                    }
+                    if (!ParseInt(data, 1, cr, argc_) || static_cast<char>(data[cr + 1]) != '\n')
+                        return Fail("invalid multibulk length");
+                    if (argc_ > static_cast<int64_t>(frame::g_max_args))
+                        return Fail("too many arguments");
+                    pos_ = cr + 2;
+                    argi_ = 0;
+                    cmd.resize(argc_ > 0 ? argc_ : 0);
+                    state_ = State::BULK_HEADER;
+                    break;
+                }
+                case State::BULK_HEADER:
+                {
+                    if (argi_ >= argc_)
+                    {
+                        consumed = pos_;
+                        pos_ = 0;
+                        state_ = State::ARRAY_HEADER;
+                        return 1;
+                    }
+                    if (pos_ == len)
+                        return 0;
+                    if (static_cast<char>(data[pos_]) != '$')
+                        return Fail("expected '$'");
+                    size_t cr = FindCrlf(data, len);
+                    if (cr == std::string_view::npos)
+                        return len - pos_ > k_max_line ? Fail("too big bulk count string") : 0;
+                    if (!ParseInt(data, pos_ + 1, cr, bulk_len_) || bulk_len_ < 0 ||
+                        static_cast<char>(data[cr + 1]) != '\n')
+                        return Fail("invalid bulk length");
+                    if (static_cast<size_t>(bulk_len_) > frame::g_max_frame)
+                        return Fail("bulk too large");
+                    pos_ = cr + 2;
+                    state_ = State::BULK_BODY;
+                    break;
+                }
+                case State::BULK_BODY:
+                {
+                    if (len - pos_ < static_cast<size_t>(bulk_len_) + 2)
+                        return 0;
+                    const auto *body = reinterpret_cast<const char *>(data) + pos_;
+                    if (body[bulk_len_] != '\r' || body[bulk_len_ + 1] != '\n')
+                        return Fail("bad bulk terminator");
+                    cmd[argi_++].assign(body, bulk_len_);
+                    pos_ += bulk_len_ + 2;
+                    state_ = State::BULK_HEADER;
+                    break;
+                }
+                }
+            }
+        }
+    };
+
+    // 序列化
+
+    // prefix + 十进制整数 + \r\n
+    inline auto AppendLine(OutBuf &out, char prefix, int64_t val) -> void
+    {
+        char buf[24];
+        buf[0] = prefix;
+        auto [ptr, ec] = std::to_chars(buf + 1, buf + sizeof(buf) - 2, val);
+        *ptr++ = '\r';
+        *ptr++ = '\n';
+        out.Append(buf, ptr - buf);
+    }
+    inline auto WriteNil(OutBuf &out) -> void
+    {
+        out.AppendStrView(out.GetProto() == Proto::RESP3 ? "_\r\n" : "$-1\r\n");
+    }
+    inline auto WriteStatus(OutBuf &out, std::string_view str) -> void
+    {
+        out.AppendStrView("+");
+        out.AppendStrView(str);
+        out.AppendStrView("\r\n");
+    }
+    inline auto WriteBulk(OutBuf &out, std::string_view str) -> void
+    {
+        AppendLine(out, '$', static_cast<int64_t>(str.size()));
+        out.AppendStrView(str);
+        out.AppendStrView("\r\n");
+    }
+    inline auto WriteBulkRef(OutBuf &out, StrPin str) -> void
+    {
+        AppendLine(out, '$', static_cast<int64_t>(str->size()));
+        out.AppendRef(std::move(str));
+        out.AppendStrView("\r\n");
+    }
+    inline auto WriteInt(OutBuf &out, int64_t val) -> void { AppendLine(out, ':', val); }
+    // 错误信息中不能出现换行
+    inline auto WriteErr(OutBuf &out, std::string_view prefix, std::string_view msg) -> void
+    {
+        out.AppendStrView("-");
+        if (!prefix.empty())
+        {
+            out.AppendStrView(prefix);
+            out.AppendStrView(" ");
+        }
+        for (char c : msg)
+        {
+            out.AppendNum(c == '\r' || c == '\n' ? ' ' : c, 1);
+        }
+        out.AppendStrView("\r\n");
+    }
+    // RESP2 没有浮点类型，以字符串返回
+    inline auto WriteDouble(OutBuf &out, double val) -> void
+    {
+        char buf[32];
+        auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), val);
+        std::string_view str(buf, ptr - buf);
+        if (out.GetProto() == Proto::RESP3)
+        {
+            out.AppendStrView(",");
+            out.AppendStrView(str);
+            out.AppendStrView("\r\n");
+            return;
+        }
+        WriteBulk(out, str);
+    }
+    inline auto WriteArr(OutBuf &out, uint32_t n) -> void { AppendLine(out, '*', n); }
+    // RESP2 的 map 用 2n 个元素的数组表示
+    inline auto WriteMap(OutBuf &out, uint32_t n) -> void
+    {
+        if (out.GetProto() == Proto::RESP3)
+        {
+            AppendLine(out, '%', n);
+            return;
+        }
+        AppendLine(out, '*', static_cast<int64_t>(n) * 2);
+    }
+    // 服务器主动推送的数据（发布的消息），RESP3 为 push 类型，RESP2 为普通数组
+    inline auto WritePush(OutBuf &out, uint32_t n) -> void
+    {
+        AppendLine(out, out.GetProto() == Proto::RESP3 ? '>' : '*', n);
+    }
+    inline auto ArrHeader(uint32_t n) -> std::string
+    {
+        return "*" + std::to_string(n) + "\r\n";
+    }
+}
+
+#endif
@@ -4,10 +4,14 @@
 #include <arpa/inet.h>
 #include <netinet/ip.h>
 #include <sys/socket.h>
+#include <limits>
 #include <unordered_map>
 #include "public.h"
 #include "file.h"
 #include "connect.h"
+#include "stats.h"
+#include "slowlog.h"
+#include "latency.h"
 namespace kath
 {
     const uint64_t k_idle_timeout_ms = 5 * 1000;
@@ -18,10 +22,13 @@ namespace kath
         File file_;
         DList head_;
         std::unordered_map<int, std::shared_ptr<Conn>> fd2conn_;
+        // 定期输出统计时，上一次输出的时间和各阶段的累计值
+        uint64_t last_dump_us_{GetMonotonicUsec()};
+        stats::PhaseCycles dumped_{};
 
     public:
-        Server() : file_(MakeSocket()) {}
-        static auto MakeSocket() -> int
+        explicit Server(int port = server_port) : file_(MakeSocket(port)) {}
+        static auto MakeSocket(int port) -> int
         {
             int fd = socket(AF_INET, SOCK_STREAM, 0);
             if (fd < 0)
@@ -35,7 +42,7 @@ namespace kath
 
             addr.sin_addr.s_addr = ntohl(0);
             addr.sin_family = AF_INET;
-            addr.sin_port = ntohs(1234);
+            addr.sin_port = htons(port);
 
             int rv = bind(fd, (const sockaddr *)&addr, sizeof(addr));
 
@@ -60,12 +67,16 @@ namespace kath
             assert(fd2conn_.find(conn_fd) != fd2conn_.end() ||
                    fd2conn_[conn_fd] == nullptr);
             fd2conn_[conn_fd] = std::move(conn);
+            stats::g_server.connections_received_++;
+            stats::g_server.connected_clients_ = fd2conn_.size();
         }
 
         auto DelConn(Conn* conn) -> void
         {
-            fd2conn_.erase(conn->GetFd());
+            // erase 可能释放 conn，先从空闲链表摘下
             conn->idle_node_.Detach();
+            fd2conn_.erase(conn->GetFd());
+            stats::g_server.connected_clients_ = fd2conn_.size();
         }
 
         auto AcceptConn() -> int32_t
@@ -98,11 +109,23 @@ namespace kath
             uint64_t now_us = GetMonotonicUsec();
             uint64_t next_us = std::numeric_limits<uint64_t>::max();
 
+            // 有后台扫描、没有做完的 BITCOUNT 或者被唤醒的连接时不在 poll 中等待
+            if (core::g_bigkeys.Running() || BitCountPending() || block::g_registry.HasWoken())
+            {
+                return 0;
+            }
+            // 线程池中有 ZUNIONSTORE / ZINTERSTORE 在算，每毫秒看一次是否算完
+            if (ZStorePending())
+            {
+                return 1;
+            }
             if (!head_.Empty())
             {
                 Conn *next = container_of(head_.next_, Conn, idle_node_);
-                next_us - std::min(next_us, next->idle_start_ + k_idle_timeout_ms * 1000);
+                next_us = std::min(next_us, next->idle_start_ + k_idle_timeout_ms * 1000);
             }
+            // BLPOP / BRPOP 的超时
+            next_us = std::min(next_us, block::g_registry.NextDeadline());
             // todo 实现heap
             // if(!heap.Empty()) {
             //     next_us = std::min(next_us,heap.get_min());
@@ -111,11 +134,13 @@ namespace kath
                 return 10000;
             if (next_us <= now_us)
                 return 0;
-            return static_cast<uint32_t>((next_us - now_us) / 1000);
+            // 向上取整，醒来时已经到期，不会空转一轮
+            return static_cast<uint32_t>((next_us - now_us + 999) / 1000);
         }
         void join()
         {
             file_.SetNb();
+            lfu::UpdateClock(GetMonotonicUsec());
             std::vector<struct pollfd> poll_args;
             for (;;)
             {
@@ -133,13 +158,18 @@ namespace kath
                     poll_args.push_back(pfd);
                 }
 
+                auto &srv = stats::g_server;
                 int timeout_ms = static_cast<int>(NextTimerMS());
+                uint64_t poll_start = stats::Cycles();
                 int rv =
                     poll(poll_args.data(), static_cast<nfds_t>(poll_args.size()), timeout_ms);
                 if (rv < 0)
                 {
                     Err("poll");
                 }
+                uint64_t busy_start = stats::Cycles();
+                srv.phases_.BeginIteration();
+                srv.phases_.Add(stats::Phase::POLL, busy_start - poll_start);
 
                 for (size_t index = 1; index < poll_args.size(); ++index)
                 {
@@ -155,17 +185,98 @@ namespace kath
                     }
                 }
 
-                ProcessTimers();
+                CloseEvicted();
+
+                {
+                    stats::PhaseTimer timer(srv.phases_, stats::Phase::TIMERS);
+                    ProcessTimers();
+                    if (core::g_bigkeys.Running())
+                    {
+                        core::g_bigkeys.Step();
+                    }
+                }
+                ResumeWoken();
                 if (poll_args[0].revents)
                 {
+                    stats::PhaseTimer timer(srv.phases_, stats::Phase::ACCEPT);
                     AcceptConn();
                 }
+
+                uint64_t busy = stats::Cycles() - busy_start;
+                srv.loop_.Record(busy);
+                srv.loops_++;
+                srv.phases_.EndIteration(busy);
+                latency::g_monitor.Check(srv.phases_.Iter(), busy);
+                uint64_t now_us = GetMonotonicUsec();
+                if (srv.ops_.Tick(now_us, srv.commands_))
+                {
+                    slowlog::g_slowlog.Calibrate();
+                    latency::g_monitor.Calibrate();
+                    lfu::UpdateClock(now_us);
+                    if (stats::g_dump_interval_s != 0 && now_us - last_dump_us_ >= stats::g_dump_interval_s * 1000000)
+                    {
+                        DumpStats(now_us);
+                    }
+                }
             }
         }
+
+        // 一行输出到 stderr：ops/sec、连接数，以及上次输出以来各阶段的耗时占比
+        auto DumpStats(uint64_t now_us) -> void
+        {
+            const auto &srv = stats::g_server;
+            const auto &total = srv.phases_.Total();
+            uint64_t sum = 0;
+            for (size_t index = 0; index < stats::k_phases; index++)
+            {
+                sum += total[index] - dumped_[index];
+            }
+            std::fprintf(stderr, "stats: ops/sec=%llu clients=%llu loop_p99=%.1fus phases:",
+                         static_cast<unsigned long long>(srv.ops_.PerSec()),
+                         static_cast<unsigned long long>(srv.connected_clients_),
+                         static_cast<double>(srv.loop_.Percentile(99)) * stats::NsPerCycle() / 1000);
+            for (size_t index = 0; index < stats::k_phases; index++)
+            {
+                uint64_t delta = total[index] - dumped_[index];
+                std::fprintf(stderr, " %s=%.1f%%", stats::k_phase_names[index],
+                             sum ? static_cast<double>(delta) * 100 / static_cast<double>(sum) : 0.0);
+            }
+            std::fprintf(stderr, "\n");
+            dumped_ = total;
+            last_dump_us_ = now_us;
+        }
+        // 回复队列超过上限的订阅者在发布时只做了标记，在这里关闭
+        auto CloseEvicted() -> void
+        {
+            for (auto *sub : pubsub::g_hub.TakeEvicted())
+            {
+                Msg("pubsub output buffer limit reached");
+                DelConn(container_of(sub, Conn, subscriber_));
+            }
+        }
+
+        // 这一轮中被唤醒的连接接着处理挂起期间收到的请求，其中的命令再唤醒的连接留到下一轮
+        auto ResumeWoken() -> void
+        {
+            for (auto *client : block::g_registry.TakeWoken())
+            {
+                auto *conn = container_of(client, Conn, blocker_);
+                conn->Resume();
+                if (conn->IsEnd())
+                {
+                    DelConn(conn);
+                }
+            }
+        }
+
         auto ProcessTimers() -> void
         {
             uint64_t now_us = GetMonotonicUsec();
 
+            ExpireBlocked(now_us);
+            FinishZStoreJobs();
+            StepBitCounts();
+
             while (!head_.Empty())
             {
                 Conn *next = container_of(head_.next_, Conn, idle_node_);
@@ -0,0 +1,247 @@
+#ifndef SETOBJ_H
+#define SETOBJ_H
+
+/*
+set 类型的值
+两种编码：
+    intset     所有成员都是规范写法的整数（没有前导 0、正号和空白，取回的字符串与写入的相同）时，
+               存成 IntSet，见 intset.h
+    table      HMap，每个成员一个节点
+加入非整数成员，或者成员数超过 g_intset_max_entries 时一次性转成 table，之后不再转回。
+intset 中间插入要移动后面的元素，查找是二分，上限越大单次插入和查找越慢（100 万个 4 字节元素插入约 0.1ms），
+默认与 Redis 的 set-max-intset-entries 相同取 512，成员多的整数 set 可以用 --set-max-intset-entries 调大。
+
+SINTER / SUNION / SDIFF 的输入都是 intset 时直接在有序数组上做，否则逐个成员查表。
+*/
+
+#include <algorithm>
+#include <charconv>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "public.h"
+#include "hashtable.h"
+#include "intset.h"
+#include "zset.h"
+
+namespace kath
+{
+    inline size_t g_intset_max_entries = 512;
+
+    // 只接受规范写法的整数
+    inline auto ParseSetInt(std::string_view str, int64_t &val) -> bool
+    {
+        if (str.empty() || str.size() > 20)
+            return false;
+        size_t digits = str[0] == '-' ? 1 : 0;
+        if (digits == str.size() || (str[digits] == '0' && str.size() > 1))
+            return false;
+        auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), val);
+        return ec == std::errc() && ptr == str.data() + str.size();
+    }
+
+    class SetObj
+    {
+    private:
+        IntSet ints_{};
+        std::unique_ptr<HMap> table_{}; // 为空时使用 intset 编码
+
+        auto ToTable() -> void
+        {
+            auto table = std::make_unique<HMap>();
+            ForEach([&](const std::string &member)
+                    { table->Insert(std::make_shared<HKey>(member)); });
+            table_ = std::move(table);
+            ints_ = IntSet();
+        }
+        auto TableFind(const std::string &member) const -> bool
+        {
+            HNodePtr probe = std::make_shared<HKey>(member);
+            return table_->Lookup(probe, hkey_cmp) != nullptr;
+        }
+
+    public:
+        [[nodiscard]] auto IsIntSet() const -> bool { return table_ == nullptr; }
+        [[nodiscard]] auto Ints() const -> const IntSet & { return ints_; }
+        [[nodiscard]] auto Size() const -> size_t { return table_ ? table_->Size() : ints_.Size(); }
+
+        [[nodiscard]] auto Contains(const std::string &member) const -> bool
+        {
+            if (table_ == nullptr)
+            {
+                int64_t val = 0;
+                return ParseSetInt(member, val) && ints_.Contains(val);
+            }
+            return TableFind(member);
+        }
+
+        // 返回新增的成员数
+        auto Add(const std::vector<std::string> &members) -> size_t
+        {
+            if (table_ == nullptr)
+            {
+                std::vector<int64_t> vals(members.size());
+                bool all_ints = true;
+                for (size_t index = 0; index < members.size() && all_ints; index++)
+                {
+                    all_ints = ParseSetInt(members[index], vals[index]);
+                }
+                // 按加入后的实际大小判断，重复加入已有的成员不会触发转换
+                if (all_ints)
+                {
+                    size_t added = vals.size() == 1 ? ints_.Add(vals[0]) : ints_.AddMany(std::move(vals));
+                    if (ints_.Size() > g_intset_max_entries)
+                        ToTable();
+                    return added;
+                }
+                ToTable();
+            }
+            size_t added = 0;
+            for (const auto &member : members)
+            {
+                if (!TableFind(member))
+                {
+                    table_->Insert(std::make_shared<HKey>(member));
+                    added++;
+                }
+            }
+            return added;
+        }
+
+        auto Remove(const std::string &member) -> bool
+        {
+            if (table_ == nullptr)
+            {
+                int64_t val = 0;
+                return ParseSetInt(member, val) && ints_.Remove(val);
+            }
+            HNodePtr probe = std::make_shared<HKey>(member);
+            return table_->Pop(probe, hkey_cmp) != nullptr;
+        }
+
+        // fn(const std::string &)，intset 按从小到大的顺序，table 的顺序不保证
+        template <typename F>
+        auto ForEach(F &&fn) const -> void
+        {
+            if (table_ == nullptr)
+            {
+                ints_.Visit([&](const auto &vals)
+                            {
+                                for (auto val : vals)
+                                {
+                                    fn(std::to_string(val));
+                                } });
+                return;
+            }
+            NodeScan node_scan = [&fn](HNodePtr node, void *)
+            {
+                fn(dyn_cast<HKey, HNode>(node)->name_);
+            };
+            table_->Scan(node_scan, nullptr);
+        }
+    };
+
+    namespace setops
+    {
+        inline auto EmitInts(const std::vector<int64_t> &vals, const std::function<void(const std::string &)> &emit) -> void
+        {
+            for (auto val : vals)
+            {
+                emit(std::to_string(val));
+            }
+        }
+        inline auto AllIntSets(const std::vector<const SetObj *> &sets) -> bool
+        {
+            return std::all_of(sets.begin(), sets.end(), [](const SetObj *set)
+                               { return set->IsIntSet(); });
+        }
+
+        // sets 中的空指针表示 key 不存在，当作空集合
+        // 从最小的集合开始，每一步的结果只会更小
+        inline auto Inter(std::vector<const SetObj *> sets, const std::function<void(const std::string &)> &emit) -> void
+        {
+            for (const auto *set : sets)
+            {
+                if (set == nullptr || set->Size() == 0)
+                    return;
+            }
+            std::sort(sets.begin(), sets.end(), [](const SetObj *lhs, const SetObj *rhs)
+                      { return lhs->Size() < rhs->Size(); });
+            if (AllIntSets(sets) && sets.size() > 1)
+            {
+                auto res = intset::Inter(sets[0]->Ints(), sets[1]->Ints());
+                for (size_t index = 2; index < sets.size() && !res.empty(); index++)
+                {
+                    res = intset::Inter(IntSet::FromSorted(res), sets[index]->Ints());
+                }
+                return EmitInts(res, emit);
+            }
+            sets[0]->ForEach([&](const std::string &member)
+                             {
+                                 for (size_t index = 1; index < sets.size(); index++)
+                                 {
+                                     if (!sets[index]->Contains(member))
+                                         return;
+                                 }
+                                 emit(member); });
+        }
+
+        inline auto Union(std::vector<const SetObj *> sets, const std::function<void(const std::string &)> &emit) -> void
+        {
+            sets.erase(std::remove(sets.begin(), sets.end(), nullptr), sets.end());
+            if (sets.empty())
+                return;
+            if (AllIntSets(sets))
+            {
+                std::vector<int64_t> res;
+                for (const auto *set : sets)
+                {
+                    res = intset::Union(IntSet::FromSorted(res), set->Ints());
+                }
+                return EmitInts(res, emit);
+            }
+            std::unordered_set<std::string> seen;
+            for (const auto *set : sets)
+            {
+                set->ForEach([&](const std::string &member)
+                             {
+                                 if (seen.insert(member).second)
+                                     emit(member); });
+            }
+        }
+
+        // sets[0] 中不在其余集合里的成员
+        inline auto Diff(std::vector<const SetObj *> sets, const std::function<void(const std::string &)> &emit) -> void
+        {
+            if (sets[0] == nullptr)
+                return;
+            const SetObj *first = sets[0];
+            sets.erase(std::remove(sets.begin() + 1, sets.end(), nullptr), sets.end());
+            if (AllIntSets(sets))
+            {
+                std::vector<int64_t> res;
+                first->Ints().Visit([&](const auto &vals)
+                                    { res.assign(vals.begin(), vals.end()); });
+                for (size_t index = 1; index < sets.size() && !res.empty(); index++)
+                {
+                    res = intset::Diff(IntSet::FromSorted(res), sets[index]->Ints());
+                }
+                return EmitInts(res, emit);
+            }
+            first->ForEach([&](const std::string &member)
+                           {
+                               for (size_t index = 1; index < sets.size(); index++)
+                               {
+                                   if (sets[index]->Contains(member))
+                                       return;
+                               }
+                               emit(member); });
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+/*
+运行时选择 SIMD 实现
+编译时不加 -mavx2 之类的选项，向量化的函数用 __attribute__((target(...))) 单独编译，
+启动时检测一次 CPU 支持的指令集，调用处按 g_level 选择实现，不支持时退回标量实现。
+g_level 可以手动调低（如基准测试中对比标量实现），不能调到 CPU 不支持的级别。
+*/
+
+#include <cstdint>
+
+#include "public.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KATH_X86 1
+#define KATH_TARGET(isa) __attribute__((target(isa)))
+#else
+#define KATH_X86 0
+#define KATH_TARGET(isa)
+#endif
+
+namespace kath::simd
+{
+    enum class Level : uint8_t
+    {
+        SCALAR = 0,
+        AVX2,
+        AVX512, // avx512f + avx512bw
+    };
+
+    inline auto Detect() -> Level
+    {
+#if KATH_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+            return Level::AVX512;
+        if (__builtin_cpu_supports("avx2"))
+            return Level::AVX2;
+#endif
+        return Level::SCALAR;
+    }
+
+    inline const Level k_detected = Detect();
+    inline Level g_level = k_detected;
+
+    inline auto LevelName(Level level) -> const char *
+    {
+        switch (level)
+        {
+        case Level::AVX512:
+            return "avx512";
+        case Level::AVX2:
+            return "avx2";
+        default:
+            return "scalar";
+        }
+    }
+}
+
+#endif
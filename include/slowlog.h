@@ -0,0 +1,134 @@
+#ifndef SLOWLOG_H
+#define SLOWLOG_H
+
+/*
+慢查询日志
+执行时间超过阈值的命令记录在固定大小的环形缓冲区中，写满后覆盖最旧的一条。
+阈值事先换算成 cycle，命令执行完后只需要和 stats 中已经算好的耗时比较一次；
+handler 可能把参数 move 走（如 SET 的 value），所以日志开启时每条命令执行前先把截断后的参数
+拷进 pending_，慢的命令再把 pending_ 与环形缓冲区的槽位交换。
+pending_ 与槽位的 string 在第一次写入后复用，之后记录一条通常不再分配内存。
+服务端只有一个线程写，读也在同一个线程中，不需要加锁。
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "public.h"
+#include "command.h"
+#include "stats.h"
+
+namespace kath::slowlog
+{
+    // 与 Redis 相同：最多记录 32 个参数，每个参数最多 128 字节
+    const size_t k_max_args = 32;
+    const size_t k_max_arg_len = 128;
+
+    struct Entry
+    {
+        uint64_t id_{0};
+        int64_t time_{0}; // unix 时间，秒
+        uint64_t usec_{0};
+        int fd_{-1};
+        std::vector<std::string> args_{};
+    };
+
+    class SlowLog
+    {
+    private:
+        int64_t slower_than_us_{10000};
+        uint64_t threshold_{std::numeric_limits<uint64_t>::max()}; // 换算成 cycle 的阈值
+        std::vector<Entry> ring_;
+        uint64_t next_id_{0};
+        uint64_t reset_id_{0}; // RESET 之前的记录不再返回
+        std::vector<std::string> pending_{}; // 正在执行的命令的参数
+
+    public:
+        explicit SlowLog(size_t max_len = 128) : ring_(std::max<size_t>(1, max_len)) { Calibrate(); }
+
+        // slower_than_us < 0 时关闭，0 表示记录所有命令
+        auto Configure(int64_t slower_than_us, size_t max_len) -> void
+        {
+            slower_than_us_ = slower_than_us;
+            ring_.assign(std::max<size_t>(1, max_len), Entry{});
+            next_id_ = 0;
+            reset_id_ = 0;
+            Calibrate();
+        }
+        // cycle 与时间的比例随运行时间变得更准，由事件循环定期调用
+        auto Calibrate() -> void
+        {
+            if (slower_than_us_ < 0)
+            {
+                threshold_ = std::numeric_limits<uint64_t>::max();
+                return;
+            }
+            threshold_ = static_cast<uint64_t>(static_cast<double>(slower_than_us_) * 1000 / stats::NsPerCycle());
+        }
+        [[nodiscard]] auto Threshold() const -> uint64_t { return threshold_; }
+
+        [[nodiscard]] auto Enabled() const -> bool { return slower_than_us_ >= 0; }
+
+        // 命令执行之前调用，记下截断后的参数
+        auto Capture(const Cmd &cmd) -> void
+        {
+            size_t argc = std::min(cmd.size(), k_max_args);
+            pending_.resize(argc);
+            for (size_t index = 0; index < argc; index++)
+            {
+                const auto &arg = cmd[index];
+                if (index + 1 == k_max_args && cmd.size() > k_max_args)
+                {
+                    pending_[index] = "... (" + std::to_string(cmd.size() - k_max_args + 1) + " more arguments)";
+                }
+                else if (arg.size() > k_max_arg_len)
+                {
+                    pending_[index].assign(arg, 0, k_max_arg_len);
+                    pending_[index] += "... (" + std::to_string(arg.size() - k_max_arg_len) + " more bytes)";
+                }
+                else
+                {
+                    pending_[index] = arg;
+                }
+            }
+        }
+
+        // 记录最近一次 Capture 的命令
+        auto Add(uint64_t cycles, int fd) -> void
+        {
+            auto &entry = ring_[next_id_ % ring_.size()];
+            entry.id_ = next_id_++;
+            entry.time_ = static_cast<int64_t>(std::time(nullptr));
+            entry.usec_ = static_cast<uint64_t>(static_cast<double>(cycles) * stats::NsPerCycle() / 1000);
+            entry.fd_ = fd;
+            entry.args_.swap(pending_);
+        }
+
+        [[nodiscard]] auto Len() const -> size_t
+        {
+            return static_cast<size_t>(std::min<uint64_t>(next_id_ - reset_id_, ring_.size()));
+        }
+        auto Reset() -> void { reset_id_ = next_id_; }
+
+        // 从最新的一条开始，依次对最多 count 条调用 fn
+        template <typename F>
+        auto ForEach(size_t count, F &&fn) const -> void
+        {
+            size_t len = std::min(count, Len());
+            for (size_t index = 0; index < len; index++)
+            {
+                fn(ring_[(next_id_ - 1 - index) % ring_.size()]);
+            }
+        }
+    };
+
+    inline SlowLog g_slowlog{};
+    // 当前正在执行的命令所属连接的 fd，由 Conn 在解释命令前设置
+    inline int g_client_fd = -1;
+}
+
+#endif
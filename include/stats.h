@@ -0,0 +1,192 @@
+#ifndef STATS_H
+#define STATS_H
+
+/*
+运行时统计，供 INFO 使用
+命令耗时用时间戳计数器（x86 上为 rdtsc）记录，记录一次只是两次读计数器加一次直方图自增，
+换算成时间的比例不需要启动时校准：启动时记下一对 (cycles, ns)，读取时用经过的时间现算。
+*/
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <ctime>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "public.h"
+#include "histogram.h"
+
+namespace kath::stats
+{
+    inline auto MonotonicNs() -> uint64_t
+    {
+        timespec tv = {0, 0};
+        clock_gettime(CLOCK_MONOTONIC, &tv);
+        return static_cast<uint64_t>(tv.tv_sec) * 1000000000 + static_cast<uint64_t>(tv.tv_nsec);
+    }
+
+    // 其它平台退回单调时钟的纳秒数
+    inline auto Cycles() -> uint64_t
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return MonotonicNs();
+#endif
+    }
+
+    inline const uint64_t g_start_cycles = Cycles();
+    inline const uint64_t g_start_ns = MonotonicNs();
+
+    inline auto NsPerCycle() -> double
+    {
+        uint64_t cycles = Cycles() - g_start_cycles;
+        uint64_t ns = MonotonicNs() - g_start_ns;
+        return cycles == 0 ? 1.0 : static_cast<double>(ns) / static_cast<double>(cycles);
+    }
+
+    // 按 cycle 记录的耗时直方图，sub_bits = 7 时相对误差不超过 1%，每个直方图约 30KB
+    inline auto MakeLatency() -> Histogram
+    {
+        return Histogram(100ull * 1000 * 1000 * 1000, 7);
+    }
+
+    struct CmdStat
+    {
+        Histogram latency_{MakeLatency()};
+    };
+
+    // 每 100ms 采样一次命令总数，ops/sec 为最近 16 次采样的平均
+    class OpsMeter
+    {
+    private:
+        static constexpr uint64_t k_interval_us = 100 * 1000;
+        static constexpr size_t k_samples = 16;
+        uint64_t last_us_{0};
+        uint64_t last_ops_{0};
+        std::array<uint64_t, k_samples> samples_{};
+        size_t next_{0};
+        size_t filled_{0};
+
+    public:
+        // 本次调用采样了时返回 true
+        auto Tick(uint64_t now_us, uint64_t ops) -> bool
+        {
+            if (last_us_ == 0)
+            {
+                last_us_ = now_us;
+                last_ops_ = ops;
+                return false;
+            }
+            uint64_t elapsed = now_us - last_us_;
+            if (elapsed < k_interval_us)
+                return false;
+            samples_[next_] = (ops - last_ops_) * 1000000 / elapsed;
+            next_ = (next_ + 1) % k_samples;
+            filled_ = std::min(filled_ + 1, k_samples);
+            last_us_ = now_us;
+            last_ops_ = ops;
+            return true;
+        }
+        [[nodiscard]] auto PerSec() const -> uint64_t
+        {
+            uint64_t sum = 0;
+            for (size_t index = 0; index < filled_; index++)
+            {
+                sum += samples_[index];
+            }
+            return filled_ ? sum / filled_ : 0;
+        }
+    };
+
+    // 事件循环的各个阶段，other 为一轮中没有归到任何阶段的耗时
+    enum class Phase : uint8_t
+    {
+        POLL = 0,
+        READ,
+        EXEC,
+        WRITE,
+        TIMERS,
+        ACCEPT,
+        OTHER,
+        NUM,
+    };
+    inline constexpr size_t k_phases = static_cast<size_t>(Phase::NUM);
+    inline constexpr const char *k_phase_names[k_phases] = {"poll", "read", "exec", "write", "timers", "accept", "other"};
+    using PhaseCycles = std::array<uint64_t, k_phases>;
+
+    // 按阶段累计事件循环的耗时（cycle），同时保留当前这一轮各阶段的耗时供延迟监控使用
+    class LoopProfile
+    {
+    private:
+        PhaseCycles iter_{};
+        PhaseCycles total_{};
+        PhaseCycles max_{}; // 单轮中的最大值
+
+    public:
+        auto Add(Phase phase, uint64_t cycles) -> void { iter_[static_cast<size_t>(phase)] += cycles; }
+        auto BeginIteration() -> void { iter_.fill(0); }
+        // busy 为这一轮除 poll 之外的总耗时
+        auto EndIteration(uint64_t busy) -> void
+        {
+            uint64_t known = 0;
+            for (size_t index = static_cast<size_t>(Phase::READ); index < static_cast<size_t>(Phase::OTHER); index++)
+            {
+                known += iter_[index];
+            }
+            iter_[static_cast<size_t>(Phase::OTHER)] = busy > known ? busy - known : 0;
+            for (size_t index = 0; index < k_phases; index++)
+            {
+                total_[index] += iter_[index];
+                max_[index] = std::max(max_[index], iter_[index]);
+            }
+        }
+        [[nodiscard]] auto Iter() const -> const PhaseCycles & { return iter_; }
+        [[nodiscard]] auto Total() const -> const PhaseCycles & { return total_; }
+        [[nodiscard]] auto Max() const -> const PhaseCycles & { return max_; }
+        auto Reset() -> void
+        {
+            total_.fill(0);
+            max_.fill(0);
+        }
+    };
+
+    // 作用域内的耗时计入 phase
+    class PhaseTimer
+    {
+    private:
+        LoopProfile &profile_;
+        Phase phase_;
+        uint64_t start_;
+
+    public:
+        PhaseTimer(LoopProfile &profile, Phase phase) : profile_(profile), phase_(phase), start_(Cycles()) {}
+        PhaseTimer(const PhaseTimer &) = delete;
+        PhaseTimer &operator=(const PhaseTimer &) = delete;
+        ~PhaseTimer() { profile_.Add(phase_, Cycles() - start_); }
+    };
+
+    struct ServerStats
+    {
+        uint64_t start_us_{GetMonotonicUsec()};
+        uint64_t commands_{0};
+        uint64_t connections_received_{0};
+        uint64_t connected_clients_{0};
+        // 过期与淘汰还没有实现，计数先留在这里，INFO 的字段保持稳定
+        uint64_t expired_keys_{0};
+        uint64_t evicted_keys_{0};
+        // 每轮事件循环处理就绪事件所花的 cycle，不含 poll 的等待
+        uint64_t loops_{0};
+        Histogram loop_{MakeLatency()};
+        LoopProfile phases_{};
+        OpsMeter ops_{};
+    };
+    inline ServerStats g_server{};
+    // 每隔多少秒向 stderr 输出一行统计，0 表示不输出
+    inline uint64_t g_dump_interval_s = 0;
+}
+
+#endif
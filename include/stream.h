@@ -0,0 +1,401 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+/*
+stream 类型的值：只追加的事件日志（与 Redis 的 stream 相同，没有消费组）
+ID 为 毫秒时间-序号，严格递增。条目按 ID 顺序放进块中，块组成双向链表，
+同时以块的第一个 ID（16 字节大端）为 key 放进基数树（见 radix.h），按 ID 查找时先用 Floor 找到块，再在块内顺序扫描。
+
+块内的条目紧挨着存在一个 string 里，每个条目为
+    [ms 与块首 ID 之差][seq][field 个数 << 1 | 与块的 field 相同][...]
+整数都是 varint。块的第一个条目的 field 名记在块上，之后 field 名与它相同的条目（日志中最常见的情况）只存 value，
+每个 value 前面是 varint 的长度。所以一个条目只比它的 value 多几个字节，不需要每个事件一个 core::Entry。
+块的条目数不超过 g_stream_block_entries，字节数不超过 g_stream_block_bytes。
+
+XTRIM 从最旧的块开始整块丢弃，每块 O(1)：从链表摘下，从基数树删除一个 key；
+精确裁剪时第一个块剩下的部分再按条目删除，块首 ID 不变，仍然可以作为基数树的 key。
+stream 变空后 key 仍然保留，以后的 ID 仍然要大于最后一个 ID。
+*/
+
+#include <ctime>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "public.h"
+#include "list.h"
+#include "radix.h"
+
+namespace kath
+{
+    inline size_t g_stream_block_entries = 100;
+    inline size_t g_stream_block_bytes = 4096;
+
+    namespace stream
+    {
+        struct Id
+        {
+            uint64_t ms_{0};
+            uint64_t seq_{0};
+
+            [[nodiscard]] auto operator<(const Id &rhs) const -> bool
+            {
+                return ms_ != rhs.ms_ ? ms_ < rhs.ms_ : seq_ < rhs.seq_;
+            }
+            [[nodiscard]] auto operator<=(const Id &rhs) const -> bool { return !(rhs < *this); }
+            [[nodiscard]] auto operator==(const Id &rhs) const -> bool { return ms_ == rhs.ms_ && seq_ == rhs.seq_; }
+
+            [[nodiscard]] auto ToString() const -> std::string
+            {
+                return std::to_string(ms_) + "-" + std::to_string(seq_);
+            }
+            // 大端，按字节比较与按数值比较相同
+            [[nodiscard]] auto Key() const -> std::string
+            {
+                std::string key(16, '\0');
+                for (size_t index = 0; index < 8; index++)
+                {
+                    key[index] = static_cast<char>(ms_ >> (56 - index * 8));
+                    key[8 + index] = static_cast<char>(seq_ >> (56 - index * 8));
+                }
+                return key;
+            }
+            // 下一个 / 上一个 ID，已经是最大 / 最小时返回 false
+            auto Incr() -> bool
+            {
+                if (seq_ != std::numeric_limits<uint64_t>::max())
+                {
+                    seq_++;
+                    return true;
+                }
+                if (ms_ == std::numeric_limits<uint64_t>::max())
+                    return false;
+                ms_++;
+                seq_ = 0;
+                return true;
+            }
+            auto Decr() -> bool
+            {
+                if (seq_ != 0)
+                {
+                    seq_--;
+                    return true;
+                }
+                if (ms_ == 0)
+                    return false;
+                ms_--;
+                seq_ = std::numeric_limits<uint64_t>::max();
+                return true;
+            }
+        };
+        inline const Id k_min_id{0, 0};
+        inline const Id k_max_id{std::numeric_limits<uint64_t>::max(), std::numeric_limits<uint64_t>::max()};
+
+        inline auto ParseU64(std::string_view str, uint64_t &out) -> bool
+        {
+            if (str.empty() || str.size() > 20)
+                return false;
+            uint64_t val = 0;
+            for (char c : str)
+            {
+                if (c < '0' || c > '9')
+                    return false;
+                uint64_t digit = static_cast<uint64_t>(c - '0');
+                if (val > (std::numeric_limits<uint64_t>::max() - digit) / 10)
+                    return false;
+                val = val * 10 + digit;
+            }
+            out = val;
+            return true;
+        }
+
+        // ms-seq 或者只有 ms，此时 seq 取 missing_seq
+        inline auto ParseId(std::string_view str, uint64_t missing_seq, Id &out) -> bool
+        {
+            auto dash = str.find('-');
+            if (dash == std::string_view::npos)
+            {
+                out.seq_ = missing_seq;
+                return ParseU64(str, out.ms_);
+            }
+            return ParseU64(str.substr(0, dash), out.ms_) && ParseU64(str.substr(dash + 1), out.seq_);
+        }
+
+        // XADD 的 *（ms 为当前时间与 last 的 ms 中较大的）与 ms-*（explicit_ms 为 true）
+        // 与 last 同一毫秒时序号加一；ms 比 last 小或者 ms-* 的序号用完时返回 false
+        inline auto NextId(const Id &last, uint64_t ms, bool explicit_ms, Id &out) -> bool
+        {
+            if (ms < last.ms_)
+                return false;
+            if (ms > last.ms_)
+            {
+                out = {ms, 0};
+                return true;
+            }
+            out = last;
+            return out.Incr() && (!explicit_ms || out.ms_ == ms);
+        }
+
+        inline auto NowMs() -> uint64_t
+        {
+            timespec tv = {0, 0};
+            clock_gettime(CLOCK_REALTIME, &tv);
+            return static_cast<uint64_t>(tv.tv_sec) * 1000 + static_cast<uint64_t>(tv.tv_nsec) / 1000000;
+        }
+
+        inline auto PutVarint(std::string &out, uint64_t val) -> void
+        {
+            while (val >= 0x80)
+            {
+                out += static_cast<char>((val & 0x7f) | 0x80);
+                val >>= 7;
+            }
+            out += static_cast<char>(val);
+        }
+        inline auto GetVarint(std::string_view data, size_t &pos) -> uint64_t
+        {
+            uint64_t val = 0;
+            for (int shift = 0;; shift += 7)
+            {
+                auto byte = static_cast<uint8_t>(data[pos++]);
+                val |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                if (byte < 0x80)
+                    return val;
+            }
+        }
+    }
+
+    class Stream
+    {
+    private:
+        struct Block
+        {
+            DList link_{};
+            stream::Id master_{}; // 块首 ID，基数树中的 key
+            stream::Id last_{};
+            std::vector<std::string> fields_{}; // 第一个条目的 field 名
+            std::string data_{};
+            uint32_t count_{0};
+        };
+
+        DList head_{};
+        RadixTree<Block> index_{};
+        size_t length_{0};
+        size_t blocks_{0};
+        stream::Id last_id_{};
+
+        static auto Of(DList *link) -> Block * { return container_of(link, Block, link_); }
+        [[nodiscard]] auto Front() const -> Block * { return head_.Empty() ? nullptr : Of(head_.next_); }
+        [[nodiscard]] auto Back() const -> Block * { return head_.Empty() ? nullptr : Of(head_.prev_); }
+
+        auto DropFront() -> void
+        {
+            Block *block = Front();
+            index_.Erase(block->master_.Key());
+            block->link_.Detach();
+            length_ -= block->count_;
+            blocks_--;
+            delete block;
+        }
+
+        // 解码 data[pos] 开始的条目，pos 前进到下一个条目；pairs 为交替的 field、value
+        static auto Decode(const Block *block, size_t &pos, std::vector<std::string_view> &pairs) -> stream::Id
+        {
+            std::string_view data = block->data_;
+            stream::Id id{block->master_.ms_ + stream::GetVarint(data, pos), 0};
+            id.seq_ = stream::GetVarint(data, pos);
+            uint64_t head = stream::GetVarint(data, pos);
+            size_t fields = head >> 1;
+            bool same = head & 1;
+            pairs.clear();
+            for (size_t index = 0; index < fields; index++)
+            {
+                if (same)
+                {
+                    pairs.emplace_back(block->fields_[index]);
+                }
+                else
+                {
+                    size_t len = stream::GetVarint(data, pos);
+                    pairs.push_back(data.substr(pos, len));
+                    pos += len;
+                }
+                size_t len = stream::GetVarint(data, pos);
+                pairs.push_back(data.substr(pos, len));
+                pos += len;
+            }
+            return id;
+        }
+        static auto SameFields(const Block *block, const std::vector<std::string_view> &pairs) -> bool
+        {
+            if (block->fields_.size() * 2 != pairs.size())
+                return false;
+            for (size_t index = 0; index < block->fields_.size(); index++)
+            {
+                if (block->fields_[index] != pairs[index * 2])
+                    return false;
+            }
+            return true;
+        }
+
+        // 删除第一个块中 ID 满足 drop 的前若干个条目
+        template <typename Drop>
+        auto TrimFront(Drop &&drop) -> size_t
+        {
+            Block *block = Front();
+            if (block == nullptr)
+                return 0;
+            size_t pos = 0;
+            size_t removed = 0;
+            std::vector<std::string_view> pairs;
+            while (removed < block->count_)
+            {
+                size_t next = pos;
+                if (!drop(Decode(block, next, pairs)))
+                    break;
+                pos = next;
+                removed++;
+            }
+            if (removed == block->count_)
+            {
+                DropFront();
+                return removed;
+            }
+            block->data_.erase(0, pos);
+            block->count_ -= static_cast<uint32_t>(removed);
+            length_ -= removed;
+            return removed;
+        }
+
+    public:
+        Stream() = default;
+        Stream(const Stream &) = delete;
+        auto operator=(const Stream &) -> Stream & = delete;
+        ~Stream()
+        {
+            while (!head_.Empty())
+            {
+                DropFront();
+            }
+        }
+
+        [[nodiscard]] auto Length() const -> size_t { return length_; }
+        [[nodiscard]] auto Blocks() const -> size_t { return blocks_; }
+        [[nodiscard]] auto LastId() const -> const stream::Id & { return last_id_; }
+
+        // 调用方保证 id 大于 LastId()，pairs 为交替的 field、value
+        auto Add(const stream::Id &id, const std::vector<std::string_view> &pairs) -> void
+        {
+            Block *block = Back();
+            size_t estimate = 24;
+            for (auto part : pairs)
+            {
+                estimate += part.size() + 5;
+            }
+            if (block == nullptr || block->count_ >= g_stream_block_entries ||
+                block->data_.size() + estimate > g_stream_block_bytes)
+            {
+                // 写满的块不会再变大
+                if (block != nullptr)
+                    block->data_.shrink_to_fit();
+                block = new Block();
+                block->master_ = id;
+                for (size_t index = 0; index < pairs.size(); index += 2)
+                {
+                    block->fields_.emplace_back(pairs[index]);
+                }
+                head_.InsertFront(&block->link_);
+                index_.Insert(id.Key(), block);
+                blocks_++;
+            }
+            bool same = SameFields(block, pairs);
+            auto &data = block->data_;
+            stream::PutVarint(data, id.ms_ - block->master_.ms_);
+            stream::PutVarint(data, id.seq_);
+            stream::PutVarint(data, (pairs.size() / 2) << 1 | (same ? 1 : 0));
+            for (size_t index = 0; index < pairs.size(); index++)
+            {
+                if (same && index % 2 == 0)
+                    continue;
+                stream::PutVarint(data, pairs[index].size());
+                data.append(pairs[index]);
+            }
+            block->count_++;
+            block->last_ = id;
+            length_++;
+            last_id_ = id;
+        }
+
+        // 按 ID 顺序对 [first, last] 中最多 count 个条目调用 fn(const stream::Id &, const std::vector<std::string_view> &)
+        // count 为 0 表示不限，返回条目数
+        template <typename F>
+        auto Range(const stream::Id &first, const stream::Id &last, size_t count, F &&fn) const -> size_t
+        {
+            if (last < first)
+                return 0;
+            const Block *block = index_.Floor(first.Key());
+            const DList *link = block != nullptr ? &block->link_ : head_.next_;
+            size_t emitted = 0;
+            std::vector<std::string_view> pairs;
+            for (; link != &head_; link = link->next_)
+            {
+                block = Of(const_cast<DList *>(link));
+                if (block->last_ < first)
+                    continue;
+                size_t pos = 0;
+                for (uint32_t index = 0; index < block->count_; index++)
+                {
+                    auto id = Decode(block, pos, pairs);
+                    if (last < id)
+                        return emitted;
+                    if (id < first)
+                        continue;
+                    fn(id, pairs);
+                    if (++emitted == count)
+                        return emitted;
+                }
+            }
+            return emitted;
+        }
+
+        // 只保留最新的 max_len 个条目；approx 时只整块丢弃，可能多留一些。返回删除的条目数
+        auto TrimLen(size_t max_len, bool approx) -> size_t
+        {
+            size_t removed = 0;
+            while (!head_.Empty() && length_ - Front()->count_ >= max_len)
+            {
+                removed += Front()->count_;
+                DropFront();
+            }
+            if (!approx && length_ > max_len)
+            {
+                size_t extra = length_ - max_len;
+                removed += TrimFront([&](const stream::Id &)
+                                     { return extra-- != 0; });
+            }
+            return removed;
+        }
+
+        // 删除 ID 小于 min_id 的条目；approx 时只整块丢弃
+        auto TrimId(const stream::Id &min_id, bool approx) -> size_t
+        {
+            size_t removed = 0;
+            while (!head_.Empty() && Front()->last_ < min_id)
+            {
+                removed += Front()->count_;
+                DropFront();
+            }
+            if (!approx)
+            {
+                removed += TrimFront([&](const stream::Id &id)
+                                     { return id < min_id; });
+            }
+            return removed;
+        }
+    };
+}
+
+#endif
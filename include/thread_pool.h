@@ -0,0 +1,104 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+/*
+固定大小的线程池
+事件循环只在单线程中修改数据，线程池用来把一条命令中可以拆开的纯计算（如 ZUNIONSTORE 的合并）
+分给多个线程，事件循环线程等待结果后再统一写回，工作线程不直接接触 core 中的数据结构。
+*/
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "public.h"
+
+namespace kath
+{
+    class ThreadPool
+    {
+    private:
+        std::mutex mu_;
+        std::condition_variable cv_;
+        std::deque<std::function<void()>> tasks_{};
+        bool stop_{false};
+        std::vector<std::thread> workers_{};
+
+        auto WorkerLoop() -> void
+        {
+            for (;;)
+            {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(mu_);
+                    cv_.wait(lock, [this]
+                             { return stop_ || !tasks_.empty(); });
+                    if (tasks_.empty())
+                        return;
+                    task = std::move(tasks_.front());
+                    tasks_.pop_front();
+                }
+                task();
+            }
+        }
+
+    public:
+        explicit ThreadPool(size_t nthreads)
+        {
+            nthreads = std::max<size_t>(1, nthreads);
+            for (size_t index = 0; index < nthreads; index++)
+            {
+                workers_.emplace_back([this]
+                                      { WorkerLoop(); });
+            }
+        }
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+        // 已经提交的任务执行完后才退出
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mu_);
+                stop_ = true;
+            }
+            cv_.notify_all();
+            for (auto &worker : workers_)
+            {
+                worker.join();
+            }
+        }
+
+        [[nodiscard]] auto Size() const -> size_t { return workers_.size(); }
+
+        template <typename F>
+        auto Submit(F &&fn) -> std::future<std::invoke_result_t<F>>
+        {
+            using R = std::invoke_result_t<F>;
+            // std::function 要求可拷贝，packaged_task 只能移动，所以放在 shared_ptr 里
+            auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(fn));
+            auto future = task->get_future();
+            {
+                std::lock_guard<std::mutex> lock(mu_);
+                tasks_.emplace_back([task]
+                                    { (*task)(); });
+            }
+            cv_.notify_one();
+            return future;
+        }
+    };
+
+    // 进程内共用的线程池，第一次使用时按 CPU 核数创建
+    inline auto WorkerPool() -> ThreadPool &
+    {
+        static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+        return pool;
+    }
+}
+
+#endif
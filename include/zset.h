@@ -2,7 +2,10 @@
 #define ZSET_H
 #include "avl_base.h"
 #include "hashtable.h"
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 namespace kath
 {
     struct HKey : public HNode
@@ -10,7 +13,8 @@ namespace kath
         std::string name_;
         HKey() = delete;
         virtual ~HKey() = default;
-        HKey(const std::string &name) : HNode(string_hash(name)), name_(name) {}
+        HKey(std::string name) : HNode(string_hash(name)), name_(std::move(name)) {}
+        [[nodiscard]] auto KeyView() const -> std::string_view override { return name_; }
     };
     struct ZNode : public avl::AVLNode, HKey
     {
@@ -18,8 +22,8 @@ namespace kath
         double score_;
         ZNode() = delete;
         ~ZNode() = default;
-        ZNode(const std::string &name, double score)
-            : HKey(name), avl::AVLNode(), score_(score) {}
+        ZNode(std::string name, double score)
+            : HKey(std::move(name)), avl::AVLNode(), score_(score) {}
         friend auto operator<<(std::ostream &os,
                                const ZNode &node) -> std::ostream &
         {
@@ -28,6 +32,11 @@ namespace kath
     };
     using HKeyPtr = std::shared_ptr<HKey>;
     using ZNodePtr = std::shared_ptr<ZNode>;
+    // 节点与探针都只当作 HKey 比较，HKey 的各种派生类（hash 的 field、set 的成员）共用
+    NodeCmp hkey_cmp = [](HNodePtr node, HNodePtr key) -> bool
+    {
+        return node->hcode_ == key->hcode_ && dyn_cast<HKey, HNode>(node)->name_ == dyn_cast<HKey, HNode>(key)->name_;
+    };
 
     auto ZLess(avl::AVLNodePtr lhs, double score, const std::string &name) -> bool
     {
@@ -101,7 +110,7 @@ namespace kath
             return false;
         }
         ZNodePtr znode_ptr = dyn_cast<ZNode, HNode>(node);
-        HKeyPtr hkey_ptr = dyn_cast<HKey, HNode>(node);
+        HKeyPtr hkey_ptr = dyn_cast<HKey, HNode>(key);
         return znode_ptr->name_ == hkey_ptr->name_;
     };
     class ZSet
@@ -120,7 +129,7 @@ namespace kath
             for (;;)
             {
                 avl::AVLNodePtr *from = ZLess(node, cur) ? &cur->left_ : &cur->right_;
-                if (*from = nullptr)
+                if (*from == nullptr)
                 {
                     *from = node;
                     node->parent_ = cur;
@@ -144,6 +153,34 @@ namespace kath
 
     public:
         ~ZSet() = default;
+        [[nodiscard]] auto Size() const -> size_t { return hmap_.Size(); }
+        // 只能用于空的 ZSet，items 必须已经按 (score, name) 排好序且没有重复的成员
+        auto BuildSorted(std::vector<std::pair<std::string, double>> &&items) -> void
+        {
+            assert(avl_root_ == nullptr);
+            std::vector<ZNodePtr> nodes;
+            nodes.reserve(items.size());
+            for (auto &[name, score] : items)
+            {
+                auto node = std::make_shared<ZNode>(std::move(name), score);
+                hmap_.Insert(node);
+                nodes.push_back(std::move(node));
+            }
+            avl_root_ = avl::AVLOperate::BuildSorted(nodes, 0, nodes.size());
+        }
+        // 写时复制用：按顺序拷贝出一份新的
+        [[nodiscard]] auto Clone() -> std::shared_ptr<ZSet>
+        {
+            std::vector<std::pair<std::string, double>> items;
+            items.reserve(Size());
+            for (auto &node : ZNodeCollection(At(0), static_cast<int64_t>(Size())))
+            {
+                items.emplace_back(node.name_, node.score_);
+            }
+            auto copy = std::make_shared<ZSet>();
+            copy->BuildSorted(std::move(items));
+            return copy;
+        }
         auto Add(const std::string &name, double score) -> bool
         {
             ZNodePtr node = Lookup(name);
@@ -163,8 +200,15 @@ namespace kath
             {
                 return;
             }
+            // hmap_ 中记录的还是这个节点，所以从树上摘下后原样插回，不能换成新节点
             avl_root_ = avl::AVLOperate::Delete(node);
-            TreeAdd(std::make_shared<ZNode>(node->name_, score));
+            node->left_ = nullptr;
+            node->right_ = nullptr;
+            node->parent_.reset();
+            node->depth_ = 1;
+            node->size_ = 1;
+            node->score_ = score;
+            TreeAdd(node);
         }
         auto Find(const std::string &name) -> std::optional<double>
         {
@@ -188,6 +232,40 @@ namespace kath
             avl_root_ = avl::AVLOperate::Delete(znode_ptr);
             return true;
         }
+        // 成员的排名（按 score 从小到大，从 0 开始）
+        auto Rank(const std::string &name) -> std::optional<int64_t>
+        {
+            ZNodePtr node = Lookup(name);
+            if (node == nullptr)
+                return std::optional<int64_t>();
+            return avl::AVLOperate::Rank(node);
+        }
+        auto At(int64_t rank) -> ZNodePtr
+        {
+            avl::AVLNodePtr found = avl::AVLOperate::AtRank(avl_root_, rank);
+            return found ? dyn_cast<ZNode, avl::AVLNode>(found) : nullptr;
+        }
+        // score 小于 score（inclusive 时为不大于）的成员个数，一次从根往下的查找
+        auto CountBelow(double score, bool inclusive) -> int64_t
+        {
+            int64_t count = 0;
+            avl::AVLNodePtr cur = avl_root_;
+            while (cur)
+            {
+                double cur_score = dyn_cast<ZNode, avl::AVLNode>(cur)->score_;
+                if (cur_score < score || (inclusive && cur_score == score))
+                {
+                    count += avl::AVLNode::Size(cur->left_) + 1;
+                    cur = cur->right_;
+                }
+                else
+                {
+                    cur = cur->left_;
+                }
+            }
+            return count;
+        }
+
         auto Query(const std::string &name, double score, int64_t offset) -> ZNodePtr
         {
             avl::AVLNodePtr found = nullptr;
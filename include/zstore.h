@@ -0,0 +1,276 @@
+#ifndef ZSTORE_H
+#define ZSTORE_H
+
+/*
+ZUNIONSTORE / ZINTERSTORE 的合并
+    1. 事件循环线程把各个输入 zset 的成员拍平成 (name 指针, score, hcode) 的数组
+    2. 按成员缓存的 hcode 分成 nparts 份，每份独立地做哈希聚合再按 (score, name) 排序，
+       同一个成员只会落在一份里，份与份之间不需要同步
+    3. 事件循环线程对 nparts 个有序数组做多路归并，结果直接建成平衡树，不再逐个插入
+输入较小时 nparts 为 1，全部在调用线程内完成；较大时第 2 步交给线程池。
+工作线程只读输入、只写自己那一份结果。
+Merge 在调用线程中等待全部结果；AsyncMerge 提交后立即返回，事件循环之后轮询 Ready()，
+等待期间继续处理别的连接（命令层的做法见 exec.h 的 ZStoreReply）。
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "public.h"
+#include "zset.h"
+#include "thread_pool.h"
+
+namespace kath::zstore
+{
+    enum class Aggregate : uint8_t
+    {
+        SUM = 0,
+        MIN,
+        MAX,
+    };
+
+    struct Member
+    {
+        const std::string *name_;
+        double score_;
+        size_t hcode_;
+    };
+    using Input = std::vector<Member>;
+    using Result = std::vector<std::pair<std::string, double>>;
+
+    // 输入成员总数达到该值才分给线程池
+    inline size_t g_parallel_threshold = 1 << 16;
+    // 最多分成几份，0 表示线程池的线程数
+    inline size_t g_max_parts = 0;
+
+    inline auto Flatten(ZSet &zset, Input &input) -> void
+    {
+        input.reserve(input.size() + zset.Size());
+        for (auto &node : ZNodeCollection(zset.At(0), static_cast<int64_t>(zset.Size())))
+        {
+            input.push_back({&node.name_, node.score_, node.hcode_});
+        }
+    }
+
+    // inf * 0 与 inf + -inf 得到 NaN，与 Redis 相同按 0 处理
+    inline auto Weighted(double score, double weight) -> double
+    {
+        double res = score * weight;
+        return std::isnan(res) ? 0 : res;
+    }
+    inline auto Combine(Aggregate agg, double acc, double val) -> double
+    {
+        switch (agg)
+        {
+        case Aggregate::MIN:
+            return std::min(acc, val);
+        case Aggregate::MAX:
+            return std::max(acc, val);
+        default:
+        {
+            double res = acc + val;
+            return std::isnan(res) ? 0 : res;
+        }
+        }
+    }
+
+    inline auto ResultLess(const std::pair<std::string, double> &lhs, const std::pair<std::string, double> &rhs) -> bool
+    {
+        if (lhs.second != rhs.second)
+            return lhs.second < rhs.second;
+        return lhs.first < rhs.first;
+    }
+
+    // 处理 hcode % nparts == part 的成员，返回按 (score, name) 排好序的结果
+    inline auto MergePart(const std::vector<Input> &inputs, const std::vector<double> &weights, Aggregate agg,
+                          bool inter, size_t part, size_t nparts) -> Result
+    {
+        struct Acc
+        {
+            double score_;
+            size_t seen_;
+        };
+        struct MemberHash
+        {
+            auto operator()(const Member *member) const -> size_t { return member->hcode_; }
+        };
+        struct MemberEq
+        {
+            auto operator()(const Member *lhs, const Member *rhs) const -> bool
+            {
+                return lhs->hcode_ == rhs->hcode_ && *lhs->name_ == *rhs->name_;
+            }
+        };
+
+        // 交集的结果不会超过最小的输入
+        size_t hint = 0;
+        for (const auto &input : inputs)
+        {
+            hint = inter ? (hint == 0 ? input.size() : std::min(hint, input.size())) : hint + input.size();
+        }
+        std::unordered_map<const Member *, Acc, MemberHash, MemberEq> acc;
+        acc.reserve(hint / nparts + 1);
+        for (size_t index = 0; index < inputs.size(); index++)
+        {
+            for (const auto &member : inputs[index])
+            {
+                if (member.hcode_ % nparts != part)
+                    continue;
+                double score = Weighted(member.score_, weights[index]);
+                auto [ite, inserted] = acc.try_emplace(&member, Acc{score, 1});
+                if (!inserted && ite->second.seen_ == index)
+                {
+                    ite->second.score_ = Combine(agg, ite->second.score_, score);
+                    ite->second.seen_++;
+                }
+                else if (!inserted && !inter)
+                {
+                    ite->second.score_ = Combine(agg, ite->second.score_, score);
+                }
+                // 交集中在前面某个输入里缺席的成员，seen_ 落后于 index，之后不会再追上
+            }
+        }
+
+        Result res;
+        res.reserve(acc.size());
+        for (auto &[member, val] : acc)
+        {
+            if (!inter || val.seen_ == inputs.size())
+                res.emplace_back(*member->name_, val.score_);
+        }
+        std::sort(res.begin(), res.end(), ResultLess);
+        return res;
+    }
+
+    // 多路归并各份的有序结果，份数不多，每次线性地找最小的头
+    inline auto MergeSorted(std::vector<Result> &parts) -> Result
+    {
+        if (parts.size() == 1)
+            return std::move(parts[0]);
+        size_t total = 0;
+        for (const auto &part : parts)
+        {
+            total += part.size();
+        }
+        Result res;
+        res.reserve(total);
+        std::vector<size_t> heads(parts.size(), 0);
+        while (res.size() < total)
+        {
+            size_t best = parts.size();
+            for (size_t index = 0; index < parts.size(); index++)
+            {
+                if (heads[index] == parts[index].size())
+                    continue;
+                if (best == parts.size() || ResultLess(parts[index][heads[index]], parts[best][heads[best]]))
+                    best = index;
+            }
+            res.push_back(std::move(parts[best][heads[best]++]));
+        }
+        return res;
+    }
+
+    // 按输入大小和线程池大小决定分成几份，交集中有空的输入时结果一定为空，返回 0
+    inline auto PartCount(const std::vector<Input> &inputs, bool inter) -> size_t
+    {
+        size_t total = 0;
+        for (const auto &input : inputs)
+        {
+            if (inter && input.empty())
+                return 0;
+            total += input.size();
+        }
+        if (total < g_parallel_threshold)
+            return 1;
+        size_t max_parts = g_max_parts != 0 ? g_max_parts : WorkerPool().Size();
+        return std::max<size_t>(1, std::min(max_parts, total / (g_parallel_threshold / 4)));
+    }
+
+    // 每一份交给线程池，inputs 和 weights 在所有 future 就绪之前必须有效
+    inline auto SubmitParts(const std::vector<Input> &inputs, const std::vector<double> &weights, Aggregate agg,
+                            bool inter, size_t nparts) -> std::vector<std::future<Result>>
+    {
+        std::vector<std::future<Result>> futures;
+        futures.reserve(nparts);
+        for (size_t part = 0; part < nparts; part++)
+        {
+            futures.push_back(WorkerPool().Submit([&inputs, &weights, agg, inter, part, nparts]
+                                                  { return MergePart(inputs, weights, agg, inter, part, nparts); }));
+        }
+        return futures;
+    }
+
+    // nparts 为 0 时由 PartCount 决定
+    inline auto Merge(const std::vector<Input> &inputs, const std::vector<double> &weights, Aggregate agg, bool inter,
+                      size_t nparts = 0) -> Result
+    {
+        if (nparts == 0)
+            nparts = PartCount(inputs, inter);
+        if (nparts == 0)
+            return {};
+
+        std::vector<Result> parts(nparts);
+        if (nparts == 1)
+        {
+            parts[0] = MergePart(inputs, weights, agg, inter, 0, 1);
+            return MergeSorted(parts);
+        }
+        auto futures = SubmitParts(inputs, weights, agg, inter, nparts);
+        for (size_t part = 0; part < nparts; part++)
+        {
+            parts[part] = futures[part].get();
+        }
+        return MergeSorted(parts);
+    }
+
+    // 不等待结果的 Merge：持有输入，工作线程算完之前调用线程可以去做别的事
+    class AsyncMerge
+    {
+    private:
+        std::vector<Input> inputs_;
+        std::vector<double> weights_;
+        std::vector<std::future<Result>> futures_{};
+
+    public:
+        AsyncMerge(std::vector<Input> inputs, std::vector<double> weights, Aggregate agg, bool inter, size_t nparts)
+            : inputs_(std::move(inputs)), weights_(std::move(weights))
+        {
+            futures_ = SubmitParts(inputs_, weights_, agg, inter, nparts);
+        }
+        AsyncMerge(const AsyncMerge &) = delete;
+        AsyncMerge &operator=(const AsyncMerge &) = delete;
+        // 工作线程引用着 inputs_，没取结果就析构时也要等它们结束
+        ~AsyncMerge()
+        {
+            for (auto &future : futures_)
+            {
+                if (future.valid())
+                    future.wait();
+            }
+        }
+
+        [[nodiscard]] auto Ready() const -> bool
+        {
+            return std::all_of(futures_.begin(), futures_.end(), [](const std::future<Result> &future)
+                               { return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; });
+        }
+        // Ready() 之后调用，只能调用一次
+        auto Take() -> Result
+        {
+            std::vector<Result> parts(futures_.size());
+            for (size_t part = 0; part < parts.size(); part++)
+            {
+                parts[part] = futures_[part].get();
+            }
+            return MergeSorted(parts);
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,734 @@
+// kredis-benchmark：端到端压测
+// N 条连接，每条连接保持 P 个请求在途，按 --mix 给出的比例混合 GET / SET / ZADD / ZQUERY，
+// 每个请求从写进发送缓冲到收到回复的耗时记进 HDR 直方图，最后输出吞吐和各分位延迟，
+// --json 输出固定格式的结果，方便在不同提交之间对比。
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "msg.h"
+#include "public.h"
+#include "hash.h"
+#include "histogram.h"
+
+namespace
+{
+    enum Op
+    {
+        OP_GET = 0,
+        OP_SET,
+        OP_ZADD,
+        OP_ZQUERY,
+        OP_COUNT,
+    };
+    constexpr const char *k_op_names[OP_COUNT] = {"get", "set", "zadd", "zquery"};
+
+    struct Options
+    {
+        std::string host_{"127.0.0.1"};
+        int port_{kath::server_port};
+        size_t conns_{50};
+        size_t pipeline_{1};
+        size_t threads_{1};
+        uint64_t requests_{100000};
+        double duration_{0}; // 大于 0 时按时长压测，忽略 requests_
+        uint64_t keyspace_{100000};
+        uint64_t zset_keys_{16};
+        size_t value_min_{100};
+        size_t value_max_{100};
+        double zipf_{0}; // 0 为均匀分布
+        double weights_[OP_COUNT]{1, 1, 0, 0};
+        std::string mix_{"get=1,set=1"};
+        bool resp_{false};
+        bool prefill_{false};
+        uint64_t seed_{1};
+        std::string json_{};
+    };
+
+    auto NowNs() -> uint64_t
+    {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+                .count());
+    }
+
+    // YCSB 的 zipfian 生成器（Gray et al., "Quickly Generating Billion-Record Synthetic Databases"）
+    // 初始化 O(n)，之后每次 O(1)，theta 须在 (0, 1) 之间
+    class Zipf
+    {
+    private:
+        uint64_t n_;
+        double theta_;
+        double alpha_;
+        double zetan_;
+        double eta_;
+        double half_pow_;
+
+        static auto Zeta(uint64_t n, double theta) -> double
+        {
+            double sum = 0;
+            for (uint64_t index = 1; index <= n; index++)
+            {
+                sum += 1.0 / std::pow(static_cast<double>(index), theta);
+            }
+            return sum;
+        }
+
+    public:
+        Zipf(uint64_t n, double theta) : n_(n), theta_(theta)
+        {
+            double zeta2 = Zeta(2, theta_);
+            zetan_ = Zeta(n_, theta_);
+            alpha_ = 1.0 / (1.0 - theta_);
+            eta_ = (1 - std::pow(2.0 / static_cast<double>(n_), 1 - theta_)) / (1 - zeta2 / zetan_);
+            half_pow_ = 1 + std::pow(0.5, theta_);
+        }
+        // 返回排名 [0, n)，0 最热
+        auto Next(double u) const -> uint64_t
+        {
+            double uz = u * zetan_;
+            if (uz < 1.0)
+                return 0;
+            if (uz < half_pow_)
+                return 1;
+            auto rank = static_cast<uint64_t>(static_cast<double>(n_) * std::pow(eta_ * u - eta_ + 1, alpha_));
+            return std::min(rank, n_ - 1);
+        }
+    };
+
+    class Workload
+    {
+    private:
+        const Options &opt_;
+        double cumulative_[OP_COUNT]{};
+        std::unique_ptr<Zipf> zipf_{};
+        std::string value_pool_;
+
+    public:
+        explicit Workload(const Options &opt) : opt_(opt), value_pool_(opt.value_max_, 'v')
+        {
+            double sum = 0;
+            for (int op = 0; op < OP_COUNT; op++)
+            {
+                sum += opt_.weights_[op];
+                cumulative_[op] = sum;
+            }
+            for (auto &val : cumulative_)
+            {
+                val /= sum;
+            }
+            if (opt_.zipf_ > 0)
+            {
+                zipf_ = std::make_unique<Zipf>(opt_.keyspace_, opt_.zipf_);
+            }
+        }
+
+        auto PickOp(std::mt19937_64 &rng) const -> Op
+        {
+            double u = std::uniform_real_distribution<double>(0, 1)(rng);
+            for (int op = 0; op < OP_COUNT; op++)
+            {
+                if (u < cumulative_[op])
+                    return static_cast<Op>(op);
+            }
+            return OP_GET;
+        }
+        // zipf 的热点打散到整个 key 空间，避免热 key 都挨在一起
+        auto PickKey(std::mt19937_64 &rng) const -> uint64_t
+        {
+            if (!zipf_)
+                return rng() % opt_.keyspace_;
+            uint64_t rank = zipf_->Next(std::uniform_real_distribution<double>(0, 1)(rng));
+            return kath::hash::Hash64(&rank, sizeof(rank), kath::hash::k_default_seed) % opt_.keyspace_;
+        }
+        auto PickValue(std::mt19937_64 &rng) const -> std::string_view
+        {
+            size_t len = opt_.value_min_;
+            if (opt_.value_max_ > opt_.value_min_)
+                len += rng() % (opt_.value_max_ - opt_.value_min_ + 1);
+            return {value_pool_.data(), len};
+        }
+    };
+
+    // 请求编码，args 中第一个为命令名
+    auto EncodeNative(std::string &out, std::initializer_list<std::string_view> args) -> void
+    {
+        auto put = [&out](uint32_t val)
+        { out.append(reinterpret_cast<const char *>(&val), 4); };
+        uint32_t body = 4;
+        for (auto arg : args)
+        {
+            body += 4 + static_cast<uint32_t>(arg.size());
+        }
+        put(body);
+        put(static_cast<uint32_t>(args.size()));
+        for (auto arg : args)
+        {
+            put(static_cast<uint32_t>(arg.size()));
+            out.append(arg);
+        }
+    }
+    auto EncodeResp(std::string &out, std::initializer_list<std::string_view> args) -> void
+    {
+        out += '*';
+        out += std::to_string(args.size());
+        out += "\r\n";
+        for (auto arg : args)
+        {
+            out += '$';
+            out += std::to_string(arg.size());
+            out += "\r\n";
+            out.append(arg);
+            out += "\r\n";
+        }
+    }
+
+    // 在 [pos, len) 中跳过一个完整的 RESP 回复，数据不完整返回 false
+    auto SkipResp(const char *data, size_t len, size_t &pos, bool &err) -> bool
+    {
+        if (pos >= len)
+            return false;
+        const char *cr = static_cast<const char *>(std::memchr(data + pos, '\r', len - pos));
+        if (cr == nullptr || cr + 1 >= data + len)
+            return false;
+        char type = data[pos];
+        int64_t num = 0;
+        std::from_chars(data + pos + 1, cr, num);
+        size_t next = cr - data + 2;
+        switch (type)
+        {
+        case '-':
+            err = true;
+            pos = next;
+            return true;
+        case '$':
+            if (num < 0)
+            {
+                pos = next;
+                return true;
+            }
+            if (len - next < static_cast<size_t>(num) + 2)
+                return false;
+            pos = next + num + 2;
+            return true;
+        case '*':
+        case '~':
+        case '%':
+        {
+            int64_t items = type == '%' ? num * 2 : num;
+            size_t cur = next;
+            for (int64_t index = 0; index < items; index++)
+            {
+                if (!SkipResp(data, len, cur, err))
+                    return false;
+            }
+            pos = cur;
+            return true;
+        }
+        default: // + : _ , 等单行类型
+            pos = next;
+            return true;
+        }
+    }
+
+    struct BenchConn
+    {
+        int fd_{-1};
+        std::string out_{};
+        size_t out_pos_{0};
+        std::string in_{};
+        size_t in_pos_{0};
+        std::deque<std::pair<Op, uint64_t>> inflight_{}; // 操作类型与写入发送缓冲的时间
+    };
+
+    auto Connect(const Options &opt) -> int
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0)
+            Err("socket");
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(opt.port_);
+        if (inet_pton(AF_INET, opt.host_.c_str(), &addr.sin_addr) != 1)
+            Err("bad host");
+        if (connect(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) != 0)
+            Err("connect");
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        return fd;
+    }
+
+    class Worker
+    {
+    private:
+        const Options &opt_;
+        const Workload &load_;
+        std::vector<BenchConn> conns_;
+        std::mt19937_64 rng_;
+        std::atomic<int64_t> &budget_;
+        uint64_t deadline_ns_{0};
+        bool prefill_;
+        std::atomic<uint64_t> *prefill_next_;
+        char key_buf_[32]{};
+        char zkey_buf_[32]{};
+        char member_buf_[32]{};
+        char score_buf_[32]{};
+
+    public:
+        kath::Histogram hist_[OP_COUNT];
+        uint64_t done_[OP_COUNT]{};
+        uint64_t errors_{0};
+
+        Worker(const Options &opt, const Workload &load, size_t conns, uint64_t seed, std::atomic<int64_t> &budget,
+               std::atomic<uint64_t> *prefill_next = nullptr)
+            : opt_(opt), load_(load), conns_(conns), rng_(seed), budget_(budget),
+              prefill_(prefill_next != nullptr), prefill_next_(prefill_next)
+        {
+            for (auto &conn : conns_)
+            {
+                conn.fd_ = Connect(opt_);
+            }
+        }
+        ~Worker()
+        {
+            for (auto &conn : conns_)
+            {
+                close(conn.fd_);
+            }
+        }
+
+        auto Take() -> bool
+        {
+            if (opt_.duration_ > 0 && !prefill_)
+                return NowNs() < deadline_ns_;
+            return budget_.fetch_sub(1, std::memory_order_relaxed) > 0;
+        }
+
+        auto Fmt(char *buf, std::string_view prefix, uint64_t num) -> std::string_view
+        {
+            std::memcpy(buf, prefix.data(), prefix.size());
+            auto [ptr, ec] = std::to_chars(buf + prefix.size(), buf + 31, num);
+            return {buf, static_cast<size_t>(ptr - buf)};
+        }
+
+        auto Encode(std::string &out, std::initializer_list<std::string_view> args) -> void
+        {
+            opt_.resp_ ? EncodeResp(out, args) : EncodeNative(out, args);
+        }
+
+        auto Generate(BenchConn &conn) -> void
+        {
+            Op op = OP_SET;
+            uint64_t key = 0;
+            if (prefill_)
+            {
+                key = prefill_next_->fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                op = load_.PickOp(rng_);
+                key = load_.PickKey(rng_);
+            }
+            switch (op)
+            {
+            case OP_GET:
+                Encode(conn.out_, {"get", Fmt(key_buf_, "key:", key)});
+                break;
+            case OP_SET:
+                Encode(conn.out_, {"set", Fmt(key_buf_, "key:", key), load_.PickValue(rng_)});
+                break;
+            case OP_ZADD:
+                Encode(conn.out_, {"zadd", Fmt(zkey_buf_, "zset:", key % opt_.zset_keys_),
+                                   Fmt(score_buf_, "", rng_() % 1000000), Fmt(member_buf_, "member:", key)});
+                break;
+            case OP_ZQUERY:
+                Encode(conn.out_, {"zquery", Fmt(zkey_buf_, "zset:", key % opt_.zset_keys_),
+                                   Fmt(score_buf_, "", rng_() % 1000000), "", "0", "20"});
+                break;
+            default:
+                break;
+            }
+            conn.inflight_.emplace_back(op, NowNs());
+        }
+
+        auto Refill(BenchConn &conn) -> void
+        {
+            while (conn.inflight_.size() < opt_.pipeline_ && Take())
+            {
+                Generate(conn);
+            }
+        }
+
+        auto Flush(BenchConn &conn) -> bool
+        {
+            while (conn.out_pos_ < conn.out_.size())
+            {
+                ssize_t rv = send(conn.fd_, conn.out_.data() + conn.out_pos_, conn.out_.size() - conn.out_pos_,
+                                  MSG_NOSIGNAL);
+                if (rv < 0)
+                {
+                    if (errno == EAGAIN || errno == EINTR)
+                        return true;
+                    return false;
+                }
+                conn.out_pos_ += static_cast<size_t>(rv);
+            }
+            conn.out_.clear();
+            conn.out_pos_ = 0;
+            return true;
+        }
+
+        auto Complete(BenchConn &conn, bool err, uint64_t now) -> void
+        {
+            auto [op, start] = conn.inflight_.front();
+            conn.inflight_.pop_front();
+            hist_[op].Record(now - start);
+            done_[op]++;
+            errors_ += err;
+        }
+
+        auto ReadReplies(BenchConn &conn) -> bool
+        {
+            char buf[64 * 1024];
+            ssize_t rv = recv(conn.fd_, buf, sizeof(buf), 0);
+            if (rv == 0)
+                return false;
+            if (rv < 0)
+                return errno == EAGAIN || errno == EINTR;
+            conn.in_.append(buf, static_cast<size_t>(rv));
+            uint64_t now = NowNs();
+            const char *data = conn.in_.data();
+            size_t len = conn.in_.size();
+            while (!conn.inflight_.empty())
+            {
+                size_t pos = conn.in_pos_;
+                bool err = false;
+                if (opt_.resp_)
+                {
+                    if (!SkipResp(data, len, pos, err))
+                        break;
+                }
+                else
+                {
+                    if (len - pos < 5)
+                        break;
+                    uint32_t body = 0;
+                    std::memcpy(&body, data + pos, 4);
+                    if (len - pos - 4 < body)
+                        break;
+                    err = static_cast<kath::SerType>(data[pos + 4]) == kath::SerType::ERR;
+                    pos += 4 + body;
+                }
+                conn.in_pos_ = pos;
+                Complete(conn, err, now);
+            }
+            conn.in_.erase(0, conn.in_pos_);
+            conn.in_pos_ = 0;
+            return true;
+        }
+
+        auto Run(uint64_t deadline_ns) -> void
+        {
+            deadline_ns_ = deadline_ns;
+            std::vector<pollfd> fds(conns_.size());
+            for (auto &conn : conns_)
+            {
+                Refill(conn);
+                Flush(conn);
+            }
+            for (;;)
+            {
+                size_t active = 0;
+                for (size_t index = 0; index < conns_.size(); index++)
+                {
+                    auto &conn = conns_[index];
+                    fds[index] = {conn.fd_, 0, 0};
+                    if (!conn.inflight_.empty())
+                    {
+                        fds[index].events = POLLIN;
+                        active++;
+                    }
+                    if (conn.out_pos_ < conn.out_.size())
+                        fds[index].events |= POLLOUT;
+                }
+                if (active == 0)
+                    return;
+                if (poll(fds.data(), fds.size(), 1000) < 0 && errno != EINTR)
+                    Err("poll");
+                for (size_t index = 0; index < conns_.size(); index++)
+                {
+                    auto &conn = conns_[index];
+                    if (fds[index].revents & (POLLIN | POLLERR | POLLHUP))
+                    {
+                        if (!ReadReplies(conn))
+                            Err("connection closed by server");
+                        Refill(conn);
+                    }
+                    if (!Flush(conn))
+                        Err("send");
+                }
+            }
+        }
+    };
+
+    auto ParseMix(Options &opt, const std::string &mix) -> bool
+    {
+        for (auto &weight : opt.weights_)
+        {
+            weight = 0;
+        }
+        size_t pos = 0;
+        double sum = 0;
+        while (pos < mix.size())
+        {
+            size_t end = mix.find(',', pos);
+            if (end == std::string::npos)
+                end = mix.size();
+            std::string item = mix.substr(pos, end - pos);
+            pos = end + 1;
+            auto eq = item.find('=');
+            if (eq == std::string::npos)
+                return false;
+            std::string name = item.substr(0, eq);
+            double weight = std::strtod(item.c_str() + eq + 1, nullptr);
+            int op = 0;
+            while (op < OP_COUNT && name != k_op_names[op])
+                op++;
+            if (op == OP_COUNT || weight < 0)
+                return false;
+            opt.weights_[op] = weight;
+            sum += weight;
+        }
+        opt.mix_ = mix;
+        return sum > 0;
+    }
+
+    auto Usage(const char *name) -> void
+    {
+        std::fprintf(stderr,
+                     "usage: %s [options]\n"
+                     "  --host h            server host (127.0.0.1)\n"
+                     "  --port p            server port (%d)\n"
+                     "  -c, --conns n       connections (50)\n"
+                     "  -P, --pipeline n    requests in flight per connection (1)\n"
+                     "  -t, --threads n     client threads, connections are split among them (1)\n"
+                     "  -n, --requests n    total requests (100000)\n"
+                     "  -d, --duration s    run for s seconds instead of a request count\n"
+                     "  --mix spec          op weights, e.g. get=9,set=1,zadd=1,zquery=1 (get=1,set=1)\n"
+                     "  --keyspace n        distinct keys (100000)\n"
+                     "  --zset-keys n       distinct sorted sets for zadd/zquery (16)\n"
+                     "  --value-size a[-b]  value size, uniform in [a, b] (100)\n"
+                     "  --zipf theta        zipfian key popularity, 0 < theta < 1 (uniform)\n"
+                     "  --prefill           SET every key once before measuring\n"
+                     "  --resp              speak RESP2 instead of the native protocol\n"
+                     "  --seed n            random seed (1)\n"
+                     "  --json file         also write results as JSON ('-' for stdout)\n",
+                     name, kath::server_port);
+    }
+
+    auto ParseArgs(int argc, char *argv[], Options &opt) -> bool
+    {
+        for (int index = 1; index < argc; index++)
+        {
+            std::string arg = argv[index];
+            bool has_val = index + 1 < argc;
+            auto val = [&]() -> std::string
+            { return argv[++index]; };
+            if (arg == "--host" && has_val)
+                opt.host_ = val();
+            else if (arg == "--port" && has_val)
+                opt.port_ = std::atoi(val().c_str());
+            else if ((arg == "-c" || arg == "--conns") && has_val)
+                opt.conns_ = std::strtoull(val().c_str(), nullptr, 0);
+            else if ((arg == "-P" || arg == "--pipeline") && has_val)
+                opt.pipeline_ = std::strtoull(val().c_str(), nullptr, 0);
+            else if ((arg == "-t" || arg == "--threads") && has_val)
+                opt.threads_ = std::strtoull(val().c_str(), nullptr, 0);
+            else if ((arg == "-n" || arg == "--requests") && has_val)
+                opt.requests_ = std::strtoull(val().c_str(), nullptr, 0);
+            else if ((arg == "-d" || arg == "--duration") && has_val)
+                opt.duration_ = std::strtod(val().c_str(), nullptr);
+            else if (arg == "--mix" && has_val)
+            {
+                if (!ParseMix(opt, val()))
+                    return false;
+            }
+            else if (arg == "--keyspace" && has_val)
+                opt.keyspace_ = std::strtoull(val().c_str(), nullptr, 0);
+            else if (arg == "--zset-keys" && has_val)
+                opt.zset_keys_ = std::strtoull(val().c_str(), nullptr, 0);
+            else if (arg == "--value-size" && has_val)
+            {
+                std::string spec = val();
+                auto dash = spec.find('-');
+                opt.value_min_ = std::strtoull(spec.c_str(), nullptr, 0);
+                opt.value_max_ = dash == std::string::npos ? opt.value_min_ : std::strtoull(spec.c_str() + dash + 1, nullptr, 0);
+            }
+            else if (arg == "--zipf" && has_val)
+                opt.zipf_ = std::strtod(val().c_str(), nullptr);
+            else if (arg == "--prefill")
+                opt.prefill_ = true;
+            else if (arg == "--resp")
+                opt.resp_ = true;
+            else if (arg == "--seed" && has_val)
+                opt.seed_ = std::strtoull(val().c_str(), nullptr, 0);
+            else if (arg == "--json" && has_val)
+                opt.json_ = val();
+            else
+                return false;
+        }
+        return opt.conns_ > 0 && opt.pipeline_ > 0 && opt.threads_ > 0 && opt.keyspace_ > 0 && opt.zset_keys_ > 0 &&
+               opt.value_min_ <= opt.value_max_ && opt.zipf_ >= 0 && opt.zipf_ < 1;
+    }
+
+    auto Prefill(const Options &opt, const Workload &load) -> void
+    {
+        std::atomic<int64_t> budget{static_cast<int64_t>(opt.keyspace_)};
+        std::atomic<uint64_t> next{0};
+        Options fill = opt;
+        fill.pipeline_ = std::max<size_t>(opt.pipeline_, 64);
+        Worker worker(fill, load, std::min<size_t>(opt.conns_, 8), opt.seed_, budget, &next);
+        worker.Run(0);
+    }
+
+    auto Us(uint64_t ns) -> double { return static_cast<double>(ns) / 1000.0; }
+
+    auto PrintLatency(std::FILE *out, const char *name, const kath::Histogram &hist, bool json) -> void
+    {
+        if (json)
+        {
+            std::fprintf(out,
+                         "\"%s\": {\"count\": %llu, \"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, "
+                         "\"p999\": %.3f, \"max\": %.3f}",
+                         name, static_cast<unsigned long long>(hist.Count()), hist.Mean() / 1000.0,
+                         Us(hist.Percentile(50)), Us(hist.Percentile(90)), Us(hist.Percentile(99)),
+                         Us(hist.Percentile(99.9)), Us(hist.Max()));
+            return;
+        }
+        std::fprintf(out, "  %-7s %10llu  %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", name,
+                     static_cast<unsigned long long>(hist.Count()), hist.Mean() / 1000.0, Us(hist.Percentile(50)),
+                     Us(hist.Percentile(90)), Us(hist.Percentile(99)), Us(hist.Percentile(99.9)), Us(hist.Max()));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options opt;
+    if (!ParseArgs(argc, argv, opt))
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+    Workload load(opt);
+    if (opt.prefill_)
+    {
+        Prefill(opt, load);
+    }
+
+    std::atomic<int64_t> budget{static_cast<int64_t>(opt.requests_)};
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (size_t index = 0; index < opt.threads_; index++)
+    {
+        size_t conns = opt.conns_ / opt.threads_ + (index < opt.conns_ % opt.threads_);
+        if (conns)
+        {
+            workers.push_back(std::make_unique<Worker>(opt, load, conns, opt.seed_ + index, budget));
+        }
+    }
+
+    uint64_t start = NowNs();
+    uint64_t deadline = start + static_cast<uint64_t>(opt.duration_ * 1e9);
+    std::vector<std::thread> threads;
+    for (auto &worker : workers)
+    {
+        threads.emplace_back([&worker, deadline]
+                             { worker->Run(deadline); });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    double elapsed = static_cast<double>(NowNs() - start) / 1e9;
+
+    kath::Histogram all;
+    kath::Histogram per_op[OP_COUNT];
+    uint64_t errors = 0;
+    for (auto &worker : workers)
+    {
+        for (int op = 0; op < OP_COUNT; op++)
+        {
+            per_op[op].Merge(worker->hist_[op]);
+            all.Merge(worker->hist_[op]);
+        }
+        errors += worker->errors_;
+    }
+    double throughput = static_cast<double>(all.Count()) / elapsed;
+
+    std::printf("%s:%d %s conns=%zu pipeline=%zu threads=%zu mix=%s keyspace=%llu value=%zu-%zu zipf=%g\n",
+                opt.host_.c_str(), opt.port_, opt.resp_ ? "resp" : "native", opt.conns_, opt.pipeline_,
+                opt.threads_, opt.mix_.c_str(), static_cast<unsigned long long>(opt.keyspace_), opt.value_min_,
+                opt.value_max_, opt.zipf_);
+    std::printf("%llu requests in %.3f s, %.0f req/s, %llu errors\n", static_cast<unsigned long long>(all.Count()),
+                elapsed, throughput, static_cast<unsigned long long>(errors));
+    std::printf("  latency(us)  count       mean       p50       p90       p99      p999       max\n");
+    for (int op = 0; op < OP_COUNT; op++)
+    {
+        if (per_op[op].Count())
+            PrintLatency(stdout, k_op_names[op], per_op[op], false);
+    }
+    PrintLatency(stdout, "all", all, false);
+
+    if (!opt.json_.empty())
+    {
+        std::FILE *out = opt.json_ == "-" ? stdout : std::fopen(opt.json_.c_str(), "w");
+        if (out == nullptr)
+        {
+            Err("open json file");
+        }
+        std::fprintf(out,
+                     "{\"config\": {\"host\": \"%s\", \"port\": %d, \"protocol\": \"%s\", \"conns\": %zu, "
+                     "\"pipeline\": %zu, \"threads\": %zu, \"mix\": \"%s\", \"keyspace\": %llu, \"value_min\": %zu, "
+                     "\"value_max\": %zu, \"zipf\": %g, \"seed\": %llu},\n",
+                     opt.host_.c_str(), opt.port_, opt.resp_ ? "resp" : "native", opt.conns_, opt.pipeline_,
+                     opt.threads_, opt.mix_.c_str(), static_cast<unsigned long long>(opt.keyspace_), opt.value_min_,
+                     opt.value_max_, opt.zipf_, static_cast<unsigned long long>(opt.seed_));
+        std::fprintf(out, " \"requests\": %llu, \"errors\": %llu, \"seconds\": %.6f, \"throughput\": %.1f,\n",
+                     static_cast<unsigned long long>(all.Count()), static_cast<unsigned long long>(errors), elapsed,
+                     throughput);
+        std::fprintf(out, " \"latency_us\": {");
+        for (int op = 0; op < OP_COUNT; op++)
+        {
+            if (per_op[op].Count())
+            {
+                PrintLatency(out, k_op_names[op], per_op[op], true);
+                std::fprintf(out, ", ");
+            }
+        }
+        PrintLatency(out, "all", all, true);
+        std::fprintf(out, "}}\n");
+        if (out != stdout)
+        {
+            std::fclose(out);
+        }
+    }
+}
@@ -0,0 +1,105 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstddef>
+
+#include "msg.h"
+#include "client.h"
+#include "async_client.h"
+
+static auto Usage(const char *name) -> void
+{
+    std::fprintf(stderr, "usage: %s [--host host] [--port port] [--cluster] cmd [args...]\n"
+                         "       %s [--host host] [--port port] [--cluster] [--conns n] --pipe < cmds\n",
+                 name, name);
+}
+
+// 从标准输入逐行读命令（空白分隔），全部异步发出后按顺序打印回复
+static auto RunPipe(kath::AsyncPool &pool) -> int
+{
+    std::vector<std::future<kath::Value>> replies;
+    std::string line;
+    while (std::getline(std::cin, line))
+    {
+        std::istringstream iss(line);
+        std::vector<std::string> cmds;
+        std::string word;
+        while (iss >> word)
+        {
+            cmds.push_back(word);
+        }
+        if (!cmds.empty())
+        {
+            replies.push_back(pool.Call(cmds));
+        }
+    }
+    int errors = 0;
+    for (auto &reply : replies)
+    {
+        auto val = reply.get();
+        errors += val.IsErr();
+        val.Print(std::cout);
+    }
+    return errors != 0;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string host = "127.0.0.1";
+    int port = kath::server_port;
+    bool cluster_mode = false;
+    bool pipe_mode = false;
+    size_t conns = 1;
+    std::vector<std::string> cmds;
+    for (int index = 1; index < argc; index++)
+    {
+        std::string arg = argv[index];
+        if (cmds.empty() && arg == "--host" && index + 1 < argc)
+        {
+            host = argv[++index];
+        }
+        else if (cmds.empty() && arg == "--port" && index + 1 < argc)
+        {
+            port = atoi(argv[++index]);
+        }
+        else if (cmds.empty() && arg == "--cluster")
+        {
+            cluster_mode = true;
+        }
+        else if (cmds.empty() && arg == "--pipe")
+        {
+            pipe_mode = true;
+        }
+        else if (cmds.empty() && arg == "--conns" && index + 1 < argc)
+        {
+            conns = strtoull(argv[++index], nullptr, 0);
+        }
+        else
+        {
+            cmds.push_back(arg);
+        }
+    }
+    if (pipe_mode && cmds.empty())
+    {
+        kath::AsyncPool pool(host, port, conns, cluster_mode);
+        return RunPipe(pool);
+    }
+    if (cmds.empty())
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    kath::Value val;
+    if (cluster_mode)
+    {
+        kath::ClusterClient client(host, port);
+        val = client.Call(cmds);
+    }
+    else
+    {
+        kath::Client client(host, port);
+        val = client.Call(cmds);
+    }
+    val.Print(std::cout);
+    return val.IsErr();
+}
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <csignal>
 #include <cstdlib>
 #include <cstddef>
 
@@ -13,17 +14,121 @@
 #include "heap.h"
 #include "rand.h"
 
-#include "client.h"
 #include "exec.h"
 #include "zset.h"
-[[nodiscard]] bool func() {
-    return true;
+#include "cluster.h"
+#include "frame.h"
+
+static auto Usage(const char *name) -> void
+{
+    std::fprintf(stderr, "usage: %s [--port port] [--cluster-config file] [--cluster-host host] [--hash-seed seed] [--zerocopy-min bytes] [--max-frame bytes]\n"
+                         "       [--slowlog-slower-than us] [--slowlog-max-len n]\n"
+                         "       [--latency-monitor-threshold us] [--stats-interval sec]\n"
+                         "       [--set-max-intset-entries n] [--list-compress-depth n]\n"
+                         "       [--pubsub-output-limit hard-bytes soft-bytes soft-seconds]\n"
+                         "       [--stream-node-max-entries n] [--stream-node-max-bytes bytes]\n", name);
 }
 
-int main(){
-    Msg("abc");
-    kath::Bytes bytes;
-    bytes.AppendStr("abc");
-    std::cout<<bytes<<std::endl;
+int main(int argc, char *argv[])
+{
+    int port = kath::server_port;
+    std::string cluster_config;
+    std::string cluster_host = "127.0.0.1";
+    uint64_t hash_seed = kath::hash::RandomSeed();
+    int64_t slowlog_slower_than = 10000;
+    size_t slowlog_max_len = 128;
+    uint64_t latency_threshold = 0;
+    for (int index = 1; index < argc; index++)
+    {
+        std::string arg = argv[index];
+        if (arg == "--port" && index + 1 < argc)
+        {
+            port = atoi(argv[++index]);
+        }
+        else if (arg == "--cluster-config" && index + 1 < argc)
+        {
+            cluster_config = argv[++index];
+        }
+        else if (arg == "--cluster-host" && index + 1 < argc)
+        {
+            // 配置文件中本节点的 host，与 --port 一起确定哪一行是自己
+            cluster_host = argv[++index];
+        }
+        else if (arg == "--hash-seed" && index + 1 < argc)
+        {
+            // 固定 seed 只用于复现问题
+            hash_seed = strtoull(argv[++index], nullptr, 0);
+        }
+        else if (arg == "--zerocopy-min" && index + 1 < argc)
+        {
+            // 不小于该长度的 value 用 MSG_ZEROCOPY 发送
+            kath::g_zerocopy_min = strtoull(argv[++index], nullptr, 0);
+        }
+        else if (arg == "--max-frame" && index + 1 < argc)
+        {
+            // 超过该长度的请求帧（RESP 为单个参数）直接拒绝并断开连接
+            kath::frame::g_max_frame = strtoull(argv[++index], nullptr, 0);
+        }
+        else if (arg == "--slowlog-slower-than" && index + 1 < argc)
+        {
+            // 微秒，负数关闭慢查询日志，0 记录所有命令
+            slowlog_slower_than = strtoll(argv[++index], nullptr, 0);
+        }
+        else if (arg == "--slowlog-max-len" && index + 1 < argc)
+        {
+            slowlog_max_len = strtoull(argv[++index], nullptr, 0);
+        }
+        else if (arg == "--latency-monitor-threshold" && index + 1 < argc)
+        {
+            // 微秒，一轮事件循环超过该时间时记入 LATENCY，0 关闭
+            latency_threshold = strtoull(argv[++index], nullptr, 0);
+        }
+        else if (arg == "--stats-interval" && index + 1 < argc)
+        {
+            kath::stats::g_dump_interval_s = strtoull(argv[++index], nullptr, 0);
+        }
+        else if (arg == "--set-max-intset-entries" && index + 1 < argc)
+        {
+            // 全是整数的 set 在成员数不超过该值时存成有序数组
+            kath::g_intset_max_entries = strtoull(argv[++index], nullptr, 0);
+        }
+        else if (arg == "--list-compress-depth" && index + 1 < argc)
+        {
+            // list 两端各保留 n 个块不压缩，中间的块用 LZF 压缩，0 为不压缩
+            kath::g_list_compress_depth = strtoull(argv[++index], nullptr, 0);
+        }
+        else if (arg == "--pubsub-output-limit" && index + 3 < argc)
+        {
+            // 订阅者的回复队列超过 hard 立即断开，超过 soft 持续 soft-seconds 秒也断开
+            kath::g_pubsub_hard_limit = strtoull(argv[++index], nullptr, 0);
+            kath::g_pubsub_soft_limit = strtoull(argv[++index], nullptr, 0);
+            kath::g_pubsub_soft_seconds = strtoull(argv[++index], nullptr, 0);
+        }
+        else if (arg == "--stream-node-max-entries" && index + 1 < argc)
+        {
+            // stream 每个块的条目数上限，块越大每个条目占的内存越少，XTRIM ~ 丢弃的粒度越粗
+            kath::g_stream_block_entries = strtoull(argv[++index], nullptr, 0);
+        }
+        else if (arg == "--stream-node-max-bytes" && index + 1 < argc)
+        {
+            kath::g_stream_block_bytes = strtoull(argv[++index], nullptr, 0);
+        }
+        else
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    // 回复都带 MSG_NOSIGNAL 发送（见 File::WriteOut_nb），这里再兜住其他写 socket 的地方，对端重置时只关闭连接
+    std::signal(SIGPIPE, SIG_IGN);
+    kath::hash::SetSeed(hash_seed);
+    kath::slowlog::g_slowlog.Configure(slowlog_slower_than, slowlog_max_len);
+    kath::latency::g_monitor.Configure(latency_threshold);
+    if (!cluster_config.empty() && !kath::cluster::LoadConfig(cluster_config, {cluster_host, port}))
+    {
+        Err("bad cluster config");
+    }
 
-}
\ No newline at end of file
+    kath::Server server(port);
+    server.join();
+}
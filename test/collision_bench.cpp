@@ -0,0 +1,151 @@
+// 哈希碰撞攻击基准
+// 攻击者知道 hash 函数和 seed 时，可以离线挖出大量落在同一批桶里的 key，
+// 这里对比 seed 可预测与每次启动随机 seed 两种情况下，这些 key 的最坏查找延迟。
+// blind 不需要知道 seed：前 8 字节等于 k_secret[1] 的 32 字节 key 曾经在任何 seed 下都是同一个 hash，
+// 再加上 hcode 强制相同的一组，检查长链转成树之后查找的比较次数有上限。
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "hashtable.h"
+
+namespace
+{
+    struct Key : public kath::HNode
+    {
+        std::string name_;
+        explicit Key(const std::string &name) : HNode(kath::string_hash(name)), name_(name) {}
+        [[nodiscard]] auto KeyView() const -> std::string_view override { return name_; }
+    };
+
+    kath::NodeCmp key_cmp = [](kath::HNodePtr node, kath::HNodePtr key) -> bool
+    {
+        return node->hcode_ == key->hcode_ &&
+               kath::dyn_cast<Key, kath::HNode>(node)->name_ == kath::dyn_cast<Key, kath::HNode>(key)->name_;
+    };
+
+    const size_t k_background_keys = 200000;
+    const size_t k_attack_keys = 2000;
+    const uint64_t k_attack_mask = (1u << 12) - 1;
+
+    // 用攻击者已知的 seed 挖出低 12 位全为 0 的 key
+    auto MineKeys(uint64_t known_seed) -> std::vector<std::string>
+    {
+        std::vector<std::string> keys;
+        for (uint64_t index = 0; keys.size() < k_attack_keys; index++)
+        {
+            std::string key = "atk:" + std::to_string(index);
+            if ((kath::hash::Hash64(key, known_seed) & k_attack_mask) == 0)
+            {
+                keys.push_back(std::move(key));
+            }
+        }
+        return keys;
+    }
+
+    // 不依赖 seed 的构造，见文件开头
+    auto BlindKeys() -> std::vector<std::string>
+    {
+        std::vector<std::string> keys;
+        for (uint64_t index = 0; index < k_attack_keys; index++)
+        {
+            std::string key(32, 'x');
+            std::memcpy(key.data(), &kath::hash::k_secret[1], 8);
+            std::memcpy(key.data() + 8, &index, 8);
+            keys.push_back(std::move(key));
+        }
+        return keys;
+    }
+
+    // hcode 全部相同时每次查找最多比较几次，超过 2 * K_MAX_CHAIN（新旧两张表各一条链）返回非 0
+    auto RunSameHash(const std::vector<std::string> &attack) -> int
+    {
+        struct Same : public Key
+        {
+            explicit Same(const std::string &name) : Key(name) { hcode_ = 42; }
+        };
+        kath::HMap hmap;
+        for (const auto &key : attack)
+        {
+            hmap.Insert(std::make_shared<Same>(key));
+        }
+        static size_t compares = 0;
+        kath::NodeCmp counted = [](kath::HNodePtr node, kath::HNodePtr key) -> bool
+        {
+            compares++;
+            return key_cmp(node, key);
+        };
+        size_t max_compares = 0;
+        for (int round = 0; round < 3; round++)
+        {
+            for (const auto &key : attack)
+            {
+                compares = 0;
+                hmap.Lookup(std::make_shared<Same>(key), counted);
+                max_compares = std::max(max_compares, compares);
+            }
+        }
+        std::printf("%-10s tree_nodes=%-6zu max_compares=%zu\n", "same-hash", hmap.TreeNodes(), max_compares);
+        return max_compares <= 2 * kath::K_MAX_CHAIN ? 0 : 1;
+    }
+
+    auto Run(const char *name, uint64_t seed, const std::vector<std::string> &attack) -> void
+    {
+        kath::hash::SetSeed(seed);
+        kath::HMap hmap;
+        for (size_t index = 0; index < k_background_keys; index++)
+        {
+            hmap.Insert(std::make_shared<Key>("user:" + std::to_string(index)));
+        }
+        for (const auto &key : attack)
+        {
+            auto node = std::make_shared<Key>(key);
+            if (hmap.Lookup(node, key_cmp) == nullptr)
+            {
+                hmap.Insert(node);
+            }
+        }
+
+        // 第 0 轮用于触发长链扩容并等迁移完成，不计入延迟
+        std::vector<double> lat;
+        for (int round = 0; round < 6; round++)
+        {
+            for (const auto &key : attack)
+            {
+                auto node = std::make_shared<Key>(key);
+                auto start = std::chrono::steady_clock::now();
+                auto found = hmap.Lookup(node, key_cmp);
+                if (round != 0)
+                    lat.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+                if (found == nullptr)
+                {
+                    std::printf("lookup miss\n");
+                }
+            }
+        }
+        std::sort(lat.begin(), lat.end());
+        std::vector<size_t> hist(257);
+        hmap.ChainHistogram(hist);
+        size_t max_chain = 0;
+        for (size_t len = 0; len < hist.size(); len++)
+        {
+            if (hist[len])
+                max_chain = len;
+        }
+        std::printf("%-10s max_chain=%-4zu early_resizes=%zu lookup p50=%.0fns p99=%.0fns max=%.0fns\n", name, max_chain,
+                    hmap.EarlyResizes(), lat[lat.size() / 2], lat[lat.size() * 99 / 100], lat.back());
+    }
+}
+
+int main()
+{
+    auto attack = MineKeys(kath::hash::k_default_seed);
+    Run("known", kath::hash::k_default_seed, attack);
+    Run("random", kath::hash::RandomSeed(), attack);
+    auto blind = BlindKeys();
+    Run("blind", kath::hash::RandomSeed(), blind);
+    return RunSameHash(blind);
+}
@@ -0,0 +1,1311 @@
+// 命令层的行为测试：不经过网络，直接调用 Interpret，按原生协议解析回复后检查内容，
+// 覆盖各数据类型的命令、边界参数和编码转换。每个 Test 函数使用自己的 key，互不影响。
+// 用法: CommandTest [filter]   只运行名字中包含 filter 的项
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "exec.h"
+#include "client.h"
+
+using kath::Value;
+
+namespace
+{
+    const char *g_filter = nullptr;
+    const char *g_test = "";
+    size_t g_checks = 0;
+    size_t g_failed = 0;
+
+    auto Check(bool ok, const char *expr, int line) -> void
+    {
+        g_checks++;
+        if (!ok)
+        {
+            g_failed++;
+            std::printf("  FAILED %s (line %d): %s\n", g_test, line, expr);
+        }
+    }
+#define CHECK(cond) Check((cond), #cond, __LINE__)
+
+    // 取出 OutBuf 中的全部内容（包括引用的 value）
+    auto Drain(kath::OutBuf &out) -> std::string
+    {
+        std::string data;
+        iovec iov[kath::k_max_iov];
+        while (!out.Empty())
+        {
+            bool zerocopy = false;
+            int cnt = out.BuildIov(iov, kath::k_max_iov, 0, zerocopy);
+            size_t len = 0;
+            for (int index = 0; index < cnt; index++)
+            {
+                data.append(static_cast<const char *>(iov[index].iov_base), iov[index].iov_len);
+                len += iov[index].iov_len;
+            }
+            out.Consume(len);
+        }
+        return data;
+    }
+
+    auto Parse(const std::string &data) -> Value
+    {
+        kath::Bytes buff;
+        buff.AppendStr(data);
+        Value val;
+        if (!kath::ParseValue(buff, val) || !buff.IsReadEnd())
+        {
+            val = Value{};
+            val.type_ = kath::SerType::ERR;
+            val.str_ = "unparsable reply";
+        }
+        return val;
+    }
+
+    // 执行一条命令，返回它的回复
+    auto CallRaw(const std::vector<std::string> &args) -> std::string
+    {
+        kath::Cmd cmd(args.begin(), args.end());
+        kath::OutBuf out;
+        kath::Interpret(cmd, out);
+        return Drain(out);
+    }
+    auto Call(const std::vector<std::string> &args) -> Value { return Parse(CallRaw(args)); }
+
+    // 挂起的命令写给 client 的回复，见 Parked；g_wakes 按唤醒的先后记下每个 client 收到的回复
+    std::string g_unblocked{};
+    std::vector<std::pair<const kath::block::Client *, Value>> g_wakes{};
+    auto FakeClient() -> kath::block::Client
+    {
+        kath::block::Client client;
+        client.unblock_ = [](kath::block::Client *self, const std::function<void(kath::OutBuf &)> &write)
+        {
+            kath::OutBuf out;
+            write(out);
+            g_unblocked = Drain(out);
+            g_wakes.emplace_back(self, Parse(g_unblocked));
+        };
+        return client;
+    }
+    // 以 client 的身份执行一条会挂起的命令，between 在挂起期间执行，之后反复调用 step 直到连接被唤醒
+    auto Parked(kath::block::Client &client, const std::vector<std::string> &args, void (*step)(),
+                void (*between)() = nullptr) -> Value
+    {
+        g_unblocked.clear();
+        kath::block::g_current = &client;
+        auto reply = CallRaw(args);
+        kath::block::g_current = nullptr;
+        CHECK(reply.empty() && client.Blocked());
+        if (between != nullptr)
+            between();
+        for (size_t turn = 0; client.Blocked() && turn < 1000000; turn++)
+        {
+            step();
+        }
+        CHECK(!client.Blocked());
+        return Parse(g_unblocked);
+    }
+
+    auto IsInt(const Value &val, int64_t expect) -> bool
+    {
+        return val.type_ == kath::SerType::INT64 && val.int_ == expect;
+    }
+    auto IsStr(const Value &val, const std::string &expect) -> bool
+    {
+        return val.type_ == kath::SerType::STR && val.str_ == expect;
+    }
+    auto IsNil(const Value &val) -> bool { return val.type_ == kath::SerType::NIL; }
+    auto IsErr(const Value &val, kath::CmdErr code) -> bool { return val.IsErr() && val.ErrCode() == code; }
+    // 字符串数组
+    auto IsStrs(const Value &val, const std::vector<std::string> &expect) -> bool
+    {
+        if (val.type_ != kath::SerType::ARR || val.arr_.size() != expect.size())
+            return false;
+        for (size_t index = 0; index < expect.size(); index++)
+        {
+            if (!IsStr(val.arr_[index], expect[index]))
+                return false;
+        }
+        return true;
+    }
+
+    auto TestZSetRank() -> void
+    {
+        for (auto [score, name] : {std::pair{"1", "a"}, {"2", "b"}, {"3", "c"}, {"4", "d"}, {"5", "e"}})
+        {
+            CHECK(IsInt(Call({"zadd", "zr", score, name}), 1));
+        }
+        CHECK(IsInt(Call({"zrank", "zr", "a"}), 0));
+        CHECK(IsInt(Call({"zrank", "zr", "d"}), 3));
+        CHECK(IsInt(Call({"zrevrank", "zr", "d"}), 1));
+        CHECK(IsNil(Call({"zrank", "zr", "missing"})));
+        CHECK(IsNil(Call({"zrank", "zr-missing", "a"})));
+
+        CHECK(IsStrs(Call({"zrange", "zr", "0", "-1"}), {"a", "b", "c", "d", "e"}));
+        CHECK(IsStrs(Call({"zrange", "zr", "-2", "100"}), {"d", "e"}));
+        CHECK(IsStrs(Call({"zrange", "zr", "3", "1"}), {}));
+        auto with_scores = Call({"zrange", "zr", "1", "1", "withscores"});
+        CHECK(with_scores.arr_.size() == 2 && IsStr(with_scores.arr_[0], "b") && with_scores.arr_[1].dou_ == 2);
+        CHECK(IsErr(Call({"zrange", "zr", "0", "1", "bad"}), kath::CmdErr::ERR_ARG));
+
+        CHECK(IsStrs(Call({"zrevrangebyscore", "zr", "+inf", "-inf"}), {"e", "d", "c", "b", "a"}));
+        CHECK(IsStrs(Call({"zrevrangebyscore", "zr", "(4", "2"}), {"c", "b"}));
+        CHECK(IsStrs(Call({"zrevrangebyscore", "zr", "5", "(1", "limit", "1", "2"}), {"d", "c"}));
+        CHECK(IsStrs(Call({"zrevrangebyscore", "zr", "1", "5"}), {}));
+
+        CHECK(IsInt(Call({"zcount", "zr", "-inf", "+inf"}), 5));
+        CHECK(IsInt(Call({"zcount", "zr", "(1", "(4"}), 2));
+        CHECK(IsInt(Call({"zcount", "zr", "4", "2"}), 0));
+        CHECK(IsErr(Call({"zcount", "zr", "x", "2"}), kath::CmdErr::ERR_ARG));
+    }
+
+    // 本节点只负责 slot 0，其余 slot 属于另一个节点
+    auto TestCluster() -> void
+    {
+        auto &state = kath::cluster::g_cluster;
+        state.slots_.Clear();
+        auto self = state.slots_.AddNode({"127.0.0.1", 7001});
+        auto other = state.slots_.AddNode({"127.0.0.1", 7002});
+        CHECK(state.slots_.Assign(0, 0, self));
+        CHECK(state.slots_.Assign(1, kath::cluster::k_slot_count - 1, other));
+        CHECK(!state.slots_.Assign(0, kath::cluster::k_slot_count, self));
+        state.self_ = self;
+        state.enabled_ = true;
+
+        auto moved = Call({"get", "a"});
+        CHECK(IsErr(moved, kath::CmdErr::ERR_MOVED) && moved.str_.rfind("MOVED ", 0) == 0);
+        auto cross = Call({"sinter", "a", "b"});
+        CHECK(IsErr(cross, kath::CmdErr::ERR_CROSSSLOT) && cross.str_.rfind("CROSSSLOT ", 0) == 0);
+        // RESP 的 CROSSSLOT 与 MOVED 一样不加 ERR 前缀
+        kath::Cmd cmd{"sinter", "a", "b"};
+        kath::OutBuf out;
+        out.SetProto(kath::Proto::RESP2);
+        kath::Interpret(cmd, out);
+        CHECK(Drain(out).rfind("-CROSSSLOT ", 0) == 0);
+
+        // XREAD 的 key 在 STREAMS 之后，后一半参数是 ID，不参与路由
+        std::string mine = "k";
+        for (int index = 0; kath::cluster::KeyHashSlot(mine) != 0; index++)
+            mine = "k" + std::to_string(index);
+        CHECK(IsErr(Call({"xread", "streams", "a", "0"}), kath::CmdErr::ERR_MOVED));
+        CHECK(IsErr(Call({"xread", "COUNT", "1", "STREAMS", "a", "0"}), kath::CmdErr::ERR_MOVED));
+        CHECK(IsNil(Call({"xread", "count", "1", "streams", mine, "0"})));
+        CHECK(IsErr(Call({"xread", "streams", mine, "a"}), kath::CmdErr::ERR_ARG));
+        CHECK(IsErr(Call({"xread", "streams", mine, "a", "0", "0"}), kath::CmdErr::ERR_CROSSSLOT));
+        // ZUNIONSTORE / ZINTERSTORE 的 key 是 destination 和 numkeys 之后的输入
+        auto keys_of = [](const kath::Cmd &cmd)
+        {
+            std::vector<int32_t> keys;
+            kath::LookupCmd(cmd[0])->ForEachKey(cmd, [&](int32_t index)
+                                                { keys.push_back(index); });
+            return keys;
+        };
+        CHECK(keys_of({"zunionstore", "d", "2", "a", "b", "weights", "1", "2"}) == std::vector<int32_t>({1, 3, 4}));
+        CHECK(keys_of({"zinterstore", "d", "9", "a"}) == std::vector<int32_t>({1, 3}));
+        CHECK(keys_of({"zinterstore", "d", "x", "a"}) == std::vector<int32_t>({1}));
+        CHECK(IsErr(Call({"zunionstore", "a", "1", "a"}), kath::CmdErr::ERR_MOVED));
+        CHECK(IsErr(Call({"zunionstore", mine, "1", "a"}), kath::CmdErr::ERR_CROSSSLOT));
+        CHECK(IsErr(Call({"zinterstore", mine, "2", mine, "a"}), kath::CmdErr::ERR_CROSSSLOT));
+        CHECK(IsInt(Call({"zunionstore", mine, "1", mine, "aggregate", "max"}), 0));
+        CHECK(IsErr(Call({"zunionstore", mine, "3", mine}), kath::CmdErr::ERR_ARG));
+
+        state.enabled_ = false;
+        state.self_ = -1;
+        state.slots_.Clear();
+    }
+
+    // 前 8 字节等于 k_secret[1] 的 32 字节 key，第 8~15 字节取 index：旧的 Hash64 在任何 seed 下都算出同一个值
+    auto SeedBlindKey(uint64_t index) -> std::string
+    {
+        std::string key(32, 'x');
+        std::memcpy(key.data(), &kath::hash::k_secret[1], 8);
+        std::memcpy(key.data() + 8, &index, 8);
+        return key;
+    }
+
+    // 不知道 seed 时构造不出碰撞；hcode 完全相同的 key 在 HMap 中的查找代价也有上限
+    auto TestHashFlood() -> void
+    {
+        constexpr size_t k_keys = 4000;
+        uint64_t seed = kath::hash::RandomSeed();
+        std::vector<uint64_t> hcodes;
+        for (uint64_t index = 0; index < k_keys; index++)
+        {
+            hcodes.push_back(kath::hash::Hash64(SeedBlindKey(index), seed));
+        }
+        std::sort(hcodes.begin(), hcodes.end());
+        CHECK(std::unique(hcodes.begin(), hcodes.end()) == hcodes.end());
+
+        // 强制所有节点的 hcode 相同，比较次数不能随 key 数增长
+        kath::HMap hmap;
+        auto node_of = [](uint64_t index)
+        { return std::make_shared<kath::core::Entry>(SeedBlindKey(index), "", 42); };
+        for (uint64_t index = 0; index < k_keys; index++)
+        {
+            hmap.Insert(node_of(index));
+        }
+        static size_t compares = 0;
+        kath::NodeCmp counted = [](kath::HNodePtr lhs, kath::HNodePtr rhs) -> bool
+        {
+            compares++;
+            return kath::core::EntryEq(lhs, rhs);
+        };
+        size_t max_compares = 0;
+        bool found = true;
+        for (int round = 0; round < 3; round++)
+        {
+            for (uint64_t index = 0; index < k_keys; index++)
+            {
+                compares = 0;
+                found = found && hmap.Lookup(node_of(index), counted) != nullptr;
+                max_compares = std::max(max_compares, compares);
+            }
+        }
+        compares = 0;
+        CHECK(hmap.Lookup(node_of(k_keys), counted) == nullptr);
+        max_compares = std::max(max_compares, compares);
+        CHECK(found);
+        CHECK(max_compares <= 2 * kath::K_MAX_CHAIN);
+        CHECK(hmap.TreeNodes() > 0 && hmap.Size() == k_keys);
+        // 删除、遍历也要覆盖树中的节点
+        bool popped = true;
+        for (uint64_t index = 0; index < k_keys; index += 2)
+        {
+            popped = popped && hmap.Pop(node_of(index), kath::core::EntryEq) != nullptr;
+        }
+        CHECK(popped);
+        CHECK(hmap.Pop(node_of(0), kath::core::EntryEq) == nullptr);
+        size_t scanned = 0;
+        hmap.Scan([](kath::HNodePtr, void *extra)
+                  { ++*static_cast<size_t *>(extra); },
+                  &scanned);
+        CHECK(hmap.Size() == k_keys / 2 && scanned == k_keys / 2);
+        size_t cursor = 0;
+        size_t stepped = 0;
+        while (hmap.ScanStep(cursor, 16, [](kath::HNodePtr, void *extra)
+                             { ++*static_cast<size_t *>(extra); },
+                             &stepped))
+            ;
+        CHECK(stepped == k_keys / 2);
+        CHECK(hmap.Lookup(node_of(1), kath::core::EntryEq) != nullptr);
+        CHECK(hmap.Lookup(node_of(2), kath::core::EntryEq) == nullptr);
+    }
+
+    // 分片合并与单线程合并的结果必须完全相同
+    auto TestZStoreMerge() -> void
+    {
+        std::vector<kath::ZSet> zsets(3);
+        uint64_t seed = 42;
+        for (size_t index = 0; index < 60000; index++)
+        {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            auto &zset = zsets[index % 3];
+            zset.Add("m" + std::to_string((seed >> 33) % 40000), static_cast<double>((seed >> 20) % 1000) / 8);
+        }
+        std::vector<kath::zstore::Input> inputs(3);
+        for (size_t index = 0; index < 3; index++)
+        {
+            kath::zstore::Flatten(zsets[index], inputs[index]);
+        }
+        std::vector<double> weights{1, 2.5, -1};
+        for (bool inter : {false, true})
+        {
+            for (auto agg : {kath::zstore::Aggregate::SUM, kath::zstore::Aggregate::MIN, kath::zstore::Aggregate::MAX})
+            {
+                auto serial = kath::zstore::Merge(inputs, weights, agg, inter, 1);
+                CHECK(!serial.empty());
+                CHECK(kath::zstore::Merge(inputs, weights, agg, inter, 4) == serial);
+                CHECK(kath::zstore::Merge(inputs, weights, agg, inter, 7) == serial);
+            }
+        }
+    }
+
+    // 命令层：降低阈值让分片合并生效，同步执行（没有 g_current）与异步执行的结果一致
+    auto TestZStore() -> void
+    {
+        auto saved_threshold = std::exchange(kath::zstore::g_parallel_threshold, 64);
+        auto saved_parts = std::exchange(kath::zstore::g_max_parts, 4);
+        for (int index = 0; index < 500; index++)
+        {
+            auto name = "m" + std::to_string(index);
+            Call({"zadd", "zs-a", std::to_string(index), name});
+            if (index % 2 == 0)
+                Call({"zadd", "zs-b", std::to_string(index * 2), name});
+        }
+        CHECK(IsInt(Call({"zunionstore", "zs-u", "3", "zs-a", "zs-b", "zs-missing"}), 500));
+        CHECK(IsInt(Call({"zinterstore", "zs-i", "2", "zs-a", "zs-b", "aggregate", "max"}), 250));
+        CHECK(IsInt(Call({"zinterstore", "zs-none", "2", "zs-a", "zs-missing"}), 0));
+        auto top = Call({"zrange", "zs-u", "-1", "-1", "withscores"});
+        CHECK(top.arr_.size() == 2 && IsStr(top.arr_[0], "m498") && top.arr_[1].dou_ == 498 * 3);
+        CHECK(IsStrs(Call({"zrange", "zs-i", "0", "1"}), {"m0", "m2"}));
+        CHECK(IsErr(Call({"zunionstore", "zs-u", "1", "zs-a", "weights", "x"}), kath::CmdErr::ERR_ARG));
+
+        // 异步：命令不回复，连接挂起，算完后由 FinishZStoreJobs 回复
+        auto client = FakeClient();
+        auto finish = []
+        { kath::FinishZStoreJobs(); };
+        CHECK(IsInt(Parked(client, {"zunionstore", "zs-u2", "2", "zs-a", "zs-b"}, finish), 500));
+        CHECK(CallRaw({"zrange", "zs-u2", "0", "-1", "withscores"}) ==
+              CallRaw({"zrange", "zs-u", "0", "-1", "withscores"}));
+        // 合并期间修改输入：原来的 zset 不受影响，结果过时后重新执行
+        auto modify = []
+        { CHECK(IsInt(Call({"zadd", "zs-a", "1000", "late"}), 1)); };
+        CHECK(IsInt(Parked(client, {"zunionstore", "zs-u3", "2", "zs-a", "zs-b"}, finish, modify), 501));
+        CHECK(!kath::ZStorePending());
+        CHECK(IsInt(Call({"zrank", "zs-u3", "late"}), 417));
+
+        kath::zstore::g_parallel_threshold = saved_threshold;
+        kath::zstore::g_max_parts = saved_parts;
+    }
+
+    // field 数或长度超过上限时 compact 一次性转成 table，内容不变
+    auto TestHash() -> void
+    {
+        auto encoding = [](const std::string &key)
+        { return kath::core::GetObj<kath::HashObj>(key, false)->Compact() ? "compact" : "table"; };
+        for (size_t index = 0; index < kath::HashObj::k_compact_max_entries; index++)
+        {
+            auto field = "f" + std::to_string(index);
+            CHECK(IsInt(Call({"hset", "h-many", field, "v" + std::to_string(index)}), 1));
+        }
+        CHECK(std::strcmp(encoding("h-many"), "compact") == 0);
+        CHECK(IsInt(Call({"hset", "h-many", "f0", "changed", "extra", "x"}), 1));
+        CHECK(std::strcmp(encoding("h-many"), "table") == 0);
+        CHECK(IsStr(Call({"hget", "h-many", "f0"}), "changed"));
+        CHECK(IsStr(Call({"hget", "h-many", "f127"}), "v127"));
+        CHECK(Call({"hgetall", "h-many"}).arr_.size() == 2 * (kath::HashObj::k_compact_max_entries + 1));
+
+        CHECK(IsInt(Call({"hset", "h-long", "a", "1"}), 1));
+        CHECK(std::strcmp(encoding("h-long"), "compact") == 0);
+        std::string long_val(kath::HashObj::k_compact_max_len + 1, 'x');
+        CHECK(IsInt(Call({"hset", "h-long", "b", long_val}), 1));
+        CHECK(std::strcmp(encoding("h-long"), "table") == 0);
+        CHECK(IsStr(Call({"hget", "h-long", "a"}), "1") && IsStr(Call({"hget", "h-long", "b"}), long_val));
+        CHECK(IsInt(Call({"hincrby", "h-long", "a", "41"}), 42));
+
+        // 删掉最后一个 field 后 key 也被删除
+        CHECK(IsInt(Call({"hdel", "h-long", "a", "b", "c"}), 2));
+        CHECK(kath::core::GetObj<kath::HashObj>("h-long", false) == nullptr);
+
+        // 与别的类型混用
+        CHECK(IsInt(Call({"zadd", "h-zset", "1", "a"}), 1));
+        CHECK(IsErr(Call({"hget", "h-zset", "a"}), kath::CmdErr::ERR_TYPE));
+        CHECK(IsErr(Call({"hset", "h-zset", "a", "1"}), kath::CmdErr::ERR_TYPE));
+        CHECK(IsErr(Call({"zadd", "h-many", "1", "a"}), kath::CmdErr::ERR_TYPE));
+    }
+
+    // 整数成员数超过 g_intset_max_entries，或者加入非整数成员时 intset 转成 table
+    auto TestSetEncoding() -> void
+    {
+        auto is_intset = [](const std::string &key)
+        { return kath::core::GetObj<kath::SetObj>(key, false)->IsIntSet(); };
+        auto sorted = [](Value val)
+        {
+            std::vector<std::string> members;
+            for (auto &item : val.arr_)
+                members.push_back(item.str_);
+            std::sort(members.begin(), members.end());
+            return members;
+        };
+        CHECK(kath::g_intset_max_entries == 512);
+        std::vector<std::string> args{"sadd", "s-ints"};
+        for (size_t index = 0; index < kath::g_intset_max_entries; index++)
+        {
+            args.push_back(std::to_string(index * 2));
+        }
+        CHECK(IsInt(Call(args), 512));
+        CHECK(is_intset("s-ints"));
+        CHECK(IsInt(Call({"sadd", "s-ints", "0", "2"}), 0));
+        CHECK(is_intset("s-ints"));
+        CHECK(IsInt(Call({"sadd", "s-ints", "-1"}), 1));
+        CHECK(!is_intset("s-ints"));
+        CHECK(IsInt(Call({"scard", "s-ints"}), 513));
+        CHECK(IsInt(Call({"sismember", "s-ints", "1022"}), 1) && IsInt(Call({"sismember", "s-ints", "-1"}), 1));
+        CHECK(IsInt(Call({"sismember", "s-ints", "1"}), 0));
+
+        // 非规范写法的整数按字符串处理，取回时与写入的相同
+        CHECK(IsInt(Call({"sadd", "s-small", "3", "1", "2"}), 3));
+        CHECK(is_intset("s-small"));
+        CHECK(IsInt(Call({"sadd", "s-odd", "1", "3", "5"}), 3));
+        CHECK((sorted(Call({"sinter", "s-small", "s-odd"})) == std::vector<std::string>{"1", "3"}));
+        CHECK((sorted(Call({"sdiff", "s-small", "s-odd"})) == std::vector<std::string>{"2"}));
+        CHECK(IsInt(Call({"sadd", "s-small", "007"}), 1));
+        CHECK(!is_intset("s-small"));
+        CHECK(IsInt(Call({"sismember", "s-small", "007"}), 1) && IsInt(Call({"sismember", "s-small", "7"}), 0));
+        CHECK((sorted(Call({"sunion", "s-small", "s-odd"})) == std::vector<std::string>{"007", "1", "2", "3", "5"}));
+        CHECK((sorted(Call({"sinter", "s-small", "s-odd"})) == std::vector<std::string>{"1", "3"}));
+
+        CHECK(IsInt(Call({"srem", "s-odd", "1", "3", "5"}), 3));
+        CHECK(kath::core::GetObj<kath::SetObj>("s-odd", false) == nullptr);
+    }
+
+    // 各级 SIMD 实现与标量实现的计数相同；大的 BITCOUNT 分轮计数，结果是执行命令时的内容
+    auto TestBitOps() -> void
+    {
+        std::string data(100000, '\0');
+        uint64_t seed = 7;
+        for (auto &byte : data)
+        {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            byte = static_cast<char>(seed >> 56);
+        }
+        const auto *bytes = reinterpret_cast<const uint8_t *>(data.data());
+        auto saved_level = kath::simd::g_level;
+        for (size_t len : {0, 1, 31, 63, 64, 65, 1000, 99999})
+        {
+            uint64_t expect = kath::bitops::PopcountScalar(bytes + 1, len);
+            for (auto level : {kath::simd::Level::AVX2, kath::simd::Level::AVX512})
+            {
+                if (level > kath::simd::k_detected)
+                    continue;
+                kath::simd::g_level = level;
+                CHECK(kath::bitops::Popcount(bytes + 1, len) == expect);
+            }
+#if KATH_X86
+            // 有 VPOPCNTDQ 时 Popcount 不会走查表的实现，单独检查
+            if (kath::simd::k_detected >= kath::simd::Level::AVX512)
+                CHECK(kath::bitops::PopcountAVX512(bytes + 1, len) == expect);
+#endif
+        }
+        kath::simd::g_level = saved_level;
+
+        CHECK(IsInt(Call({"setbit", "b-small", "7", "1"}), 0));
+        CHECK(IsInt(Call({"setbit", "b-small", "17", "1"}), 0));
+        CHECK(IsInt(Call({"getbit", "b-small", "17"}), 1) && IsInt(Call({"getbit", "b-small", "1000"}), 0));
+        CHECK(IsInt(Call({"bitcount", "b-small"}), 2));
+        CHECK(IsInt(Call({"bitcount", "b-small", "0", "0"}), 1));
+        CHECK(IsInt(Call({"bitcount", "b-small", "8", "17", "bit"}), 1));
+        CHECK(IsInt(Call({"bitcount", "b-small", "8", "16", "bit"}), 0));
+        CHECK(IsInt(Call({"bitcount", "b-small", "-1", "-1"}), 1));
+        CHECK(IsErr(Call({"bitcount", "b-small", "0"}), kath::CmdErr::ERR_ARG));
+        Call({"set", "b-other", std::string(3, '\xff')});
+        CHECK(IsInt(Call({"bitop", "and", "b-and", "b-small", "b-other"}), 3));
+        CHECK(IsInt(Call({"bitcount", "b-and"}), 2));
+        CHECK(IsInt(Call({"bitop", "not", "b-not", "b-small"}), 3));
+        CHECK(IsInt(Call({"bitcount", "b-not"}), 22));
+
+        // 分轮计数：每轮 1000 字节，挂起期间的 SETBIT 不影响结果
+        Call({"set", "b-big", data});
+        int64_t total = kath::bitops::PopcountScalar(bytes, data.size());
+        auto saved_step = std::exchange(kath::bitops::g_bitcount_step, 1000);
+        auto client = FakeClient();
+        auto step = []
+        { kath::StepBitCounts(); };
+        auto flip = []
+        {
+            Call({"setbit", "b-big", "0", "1"});
+            Call({"setbit", "b-big", "0", "0"});
+            Call({"setbit", "b-big", "9", "1"});
+        };
+        CHECK(IsInt(Parked(client, {"bitcount", "b-big"}, step, flip), total));
+        auto inline_count = Call({"bitcount", "b-big", "5", "700000", "bit"});
+        CHECK(IsInt(Parked(client, {"bitcount", "b-big", "5", "700000", "bit"}, step), inline_count.int_));
+        CHECK(IsInt(Call({"bitcount", "b-big", "0", "999"}),
+                    static_cast<int64_t>(kath::bitops::PopcountScalar(bytes, 1000)) +
+                        ((bytes[1] & 0x40) ? 0 : 1)));
+        CHECK(!kath::BitCountPending());
+        kath::bitops::g_bitcount_step = saved_step;
+    }
+
+    // 估计值在标准误差的几倍以内
+    auto Near(const Value &val, double expect) -> bool
+    {
+        return val.type_ == kath::SerType::INT64 && std::fabs(static_cast<double>(val.int_) - expect) <= expect * 0.03;
+    }
+
+    // sparse 在非 0 寄存器超过上限时转成 dense，转换前后估计值连续；PFMERGE 合并两种编码
+    auto TestHyperLogLog() -> void
+    {
+        auto sparse = [](const std::string &key)
+        { return kath::core::GetObj<kath::HyperLogLog>(key, false)->IsSparse(); };
+        auto add = [](const std::string &key, size_t first, size_t last)
+        {
+            std::vector<std::string> args{"pfadd", key};
+            for (size_t index = first; index < last; index++)
+                args.push_back("e" + std::to_string(index));
+            return Call(args);
+        };
+        CHECK(IsInt(add("hll-a", 0, 100), 1));
+        CHECK(IsInt(add("hll-a", 0, 100), 0));
+        CHECK(sparse("hll-a"));
+        CHECK(Near(Call({"pfcount", "hll-a"}), 100));
+        CHECK(IsInt(Call({"pfadd", "hll-empty"}), 1));
+        CHECK(IsInt(Call({"pfcount", "hll-empty"}), 0));
+
+        // 逐个加入，直到转成 dense
+        size_t added = 100;
+        for (; sparse("hll-a") && added < 10000; added++)
+        {
+            add("hll-a", added, added + 1);
+        }
+        CHECK(!sparse("hll-a"));
+        CHECK(added > kath::HyperLogLog::k_sparse_max_entries);
+        CHECK(Near(Call({"pfcount", "hll-a"}), static_cast<double>(added)));
+        add("hll-a", added, 50000);
+        CHECK(Near(Call({"pfcount", "hll-a"}), 50000));
+
+        // 合并：hll-b 与 hll-a 有一半重叠，hll-c 是 sparse 的
+        add("hll-b", 25000, 75000);
+        add("hll-c", 100000, 100200);
+        CHECK(sparse("hll-c"));
+        CHECK(Near(Call({"pfcount", "hll-a", "hll-b", "hll-c", "hll-missing"}), 75200));
+        // 原生协议中 OK 是 nil
+        CHECK(IsNil(Call({"pfmerge", "hll-m", "hll-a", "hll-b", "hll-c", "hll-missing"})));
+        CHECK(!sparse("hll-m"));
+        CHECK(Near(Call({"pfcount", "hll-m"}), 75200));
+        // 只合并 sparse 的输入时结果仍是 sparse，destkey 原有的寄存器也参与合并
+        add("hll-s", 0, 50);
+        Call({"pfmerge", "hll-s", "hll-c"});
+        CHECK(sparse("hll-s"));
+        CHECK(Near(Call({"pfcount", "hll-s"}), 250));
+
+        // 各级 SIMD 实现与标量实现得到相同的统计
+        kath::hll::Registers regs{};
+        kath::core::GetObj<kath::HyperLogLog>("hll-m", false)->MaxInto(regs);
+        auto expect = kath::hll::StatsScalar(regs.data(), kath::hll::k_registers);
+        auto saved_level = kath::simd::g_level;
+        for (auto level : {kath::simd::Level::AVX2, kath::simd::Level::AVX512})
+        {
+            if (level > kath::simd::k_detected)
+                continue;
+            kath::simd::g_level = level;
+            auto stats = kath::hll::GetStats(regs.data(), kath::hll::k_registers);
+            CHECK(stats.zeros_ == expect.zeros_ && stats.maxed_ == expect.maxed_);
+            CHECK(std::fabs(stats.sum_ - expect.sum_) < 1e-9);
+        }
+        kath::simd::g_level = saved_level;
+
+        Call({"set", "hll-str", "x"});
+        CHECK(IsErr(Call({"pfadd", "hll-str", "a"}), kath::CmdErr::ERR_TYPE));
+        CHECK(IsErr(Call({"pfmerge", "hll-m", "hll-str"}), kath::CmdErr::ERR_TYPE));
+    }
+
+    auto RoundTrip(const std::string &data) -> bool
+    {
+        const auto *in = reinterpret_cast<const uint8_t *>(data.data());
+        // 最坏情况每 32 个原样字节多一个控制字节，再加上预留的控制字节
+        std::string packed(data.size() + data.size() / 16 + 16, '\0');
+        size_t len = kath::lzf::Compress(in, data.size(), reinterpret_cast<uint8_t *>(packed.data()), packed.size());
+        if (len == 0 && !data.empty())
+            return false;
+        std::string raw(data.size(), '\0');
+        if (!kath::lzf::Decompress(reinterpret_cast<const uint8_t *>(packed.data()), len,
+                                   reinterpret_cast<uint8_t *>(raw.data()), raw.size()))
+            return false;
+        // 长度不符或者截断的数据必须报错，不能越界
+        std::string longer(data.size() + 1, '\0');
+        if (!data.empty() && kath::lzf::Decompress(reinterpret_cast<const uint8_t *>(packed.data()), len,
+                                                   reinterpret_cast<uint8_t *>(longer.data()), longer.size()))
+            return false;
+        if (len > 1 && kath::lzf::Decompress(reinterpret_cast<const uint8_t *>(packed.data()), len - 1,
+                                             reinterpret_cast<uint8_t *>(raw.data()), raw.size()) &&
+            raw == data)
+            return false;
+        return raw == data;
+    }
+
+    auto TestLzf() -> void
+    {
+        uint64_t seed = 5;
+        auto random = [&seed](size_t len, int alphabet)
+        {
+            std::string data(len, '\0');
+            for (auto &byte : data)
+            {
+                seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+                byte = static_cast<char>((seed >> 33) % static_cast<uint64_t>(alphabet));
+            }
+            return data;
+        };
+        for (size_t len : {0, 1, 2, 3, 4, 31, 32, 33, 100, 5000, 70000})
+        {
+            CHECK(RoundTrip(std::string(len, 'a')));
+            CHECK(RoundTrip(random(len, 4)));
+            CHECK(RoundTrip(random(len, 256)));
+        }
+        // 超过最大回溯距离和最大复制长度的重复
+        auto block = random(9000, 256);
+        CHECK(RoundTrip(block + block + std::string(1000, 'z') + block.substr(0, 300)));
+        std::string text;
+        for (int index = 0; index < 2000; index++)
+            text += "user:" + std::to_string(index % 97) + ":name,";
+        CHECK(RoundTrip(text));
+
+        // 不可压缩的数据在 cap 不够时返回 0
+        auto noise = random(4096, 256);
+        std::string packed(noise.size() - 1, '\0');
+        CHECK(kath::lzf::Compress(reinterpret_cast<const uint8_t *>(noise.data()), noise.size(),
+                                  reinterpret_cast<uint8_t *>(packed.data()), packed.size()) == 0);
+    }
+
+    // 中间的块压缩后，从两端 push / pop 和 LRANGE / LTRIM 的结果与普通 list 相同
+    auto TestQuickList() -> void
+    {
+        auto saved_chunk = std::exchange(kath::g_list_chunk_bytes, 256);
+        auto saved_depth = std::exchange(kath::g_list_compress_depth, 1);
+        std::deque<std::string> expect;
+        for (int index = 0; index < 600; index++)
+        {
+            auto elem = "item:" + std::to_string(index) + std::string(static_cast<size_t>(index % 40), 'x');
+            if (index % 3 == 0)
+            {
+                Call({"lpush", "ql", elem});
+                expect.push_front(elem);
+            }
+            else
+            {
+                Call({"rpush", "ql", elem});
+                expect.push_back(elem);
+            }
+        }
+        // 单独成块的大元素
+        std::string big(1000, 'B');
+        Call({"rpush", "ql", big});
+        expect.push_back(big);
+        auto list = kath::core::GetObj<kath::QuickList>("ql", false);
+        size_t raw = 0;
+        for (auto &elem : expect)
+            raw += elem.size();
+        CHECK(list->Chunks() > 10 && list->Bytes() < raw / 2);
+
+        auto all = [&expect]
+        { return std::vector<std::string>(expect.begin(), expect.end()); };
+        CHECK(IsInt(Call({"llen", "ql"}), static_cast<int64_t>(expect.size())));
+        CHECK(IsStrs(Call({"lrange", "ql", "0", "-1"}), all()));
+        CHECK(IsStrs(Call({"lrange", "ql", "300", "302"}), {expect[300], expect[301], expect[302]}));
+        for (int index = 0; index < 50; index++)
+        {
+            CHECK(IsStr(Call({"lpop", "ql"}), expect.front()));
+            expect.pop_front();
+            CHECK(IsStr(Call({"rpop", "ql"}), expect.back()));
+            expect.pop_back();
+        }
+        CHECK(IsStrs(Call({"lrange", "ql", "0", "-1"}), all()));
+        // 裁到原来中间压缩过的块
+        CHECK(IsNil(Call({"ltrim", "ql", "200", "-201"})));
+        expect.erase(expect.end() - 200, expect.end());
+        expect.erase(expect.begin(), expect.begin() + 200);
+        CHECK(IsStrs(Call({"lrange", "ql", "0", "-1"}), all()));
+        Call({"rpush", "ql", "tail"});
+        expect.push_back("tail");
+        CHECK(IsStrs(Call({"lrange", "ql", "0", "-1"}), all()));
+        CHECK(IsNil(Call({"ltrim", "ql", "5", "1"})));
+        CHECK(IsInt(Call({"llen", "ql"}), 0));
+
+        kath::g_list_chunk_bytes = saved_chunk;
+        kath::g_list_compress_depth = saved_depth;
+    }
+
+    // 每个元素记住自己在堆中的位置，随机地加入、删除、修改后位置和堆顶都要正确
+    auto TestHeap() -> void
+    {
+        constexpr size_t k_items = 300;
+        kath::Heap heap;
+        std::vector<size_t> pos(k_items);
+        std::vector<uint64_t> val(k_items);
+        std::vector<bool> in(k_items, false);
+        uint64_t seed = 9;
+        auto next = [&seed]
+        {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            return seed >> 33;
+        };
+        bool ok = true;
+        for (size_t round = 0; round < 20000 && ok; round++)
+        {
+            size_t item = next() % k_items;
+            if (!in[item])
+            {
+                val[item] = next() % 1000;
+                heap.Push(val[item], &pos[item]);
+                in[item] = true;
+            }
+            else if (next() % 2 == 0)
+            {
+                heap.Del(pos[item]);
+                in[item] = false;
+            }
+            else
+            {
+                val[item] = next() % 1000;
+                heap.Set(pos[item], val[item]);
+            }
+            uint64_t min = UINT64_MAX;
+            for (size_t index = 0; index < k_items; index++)
+            {
+                if (!in[index])
+                    continue;
+                ok = ok && heap.Get(pos[index]) == val[index];
+                min = std::min(min, val[index]);
+            }
+            ok = ok && (heap.Empty() ? min == UINT64_MAX : heap.Get(0) == min);
+        }
+        CHECK(ok);
+    }
+
+    // 以 client 的身份执行 BLPOP / BRPOP，返回同步写出的回复，挂起时为空
+    auto Block(kath::block::Client &client, const std::vector<std::string> &args) -> std::string
+    {
+        kath::block::g_current = &client;
+        auto reply = CallRaw(args);
+        kath::block::g_current = nullptr;
+        return reply;
+    }
+
+    // 超时参数的范围、按挂起的先后唤醒、超时回复 nil
+    auto TestBlockingPop() -> void
+    {
+        auto client = FakeClient();
+        for (const char *timeout : {"1e300", "nan", "inf", "-1", "abc"})
+        {
+            CHECK(IsErr(Parse(Block(client, {"blpop", "bl", timeout})), kath::CmdErr::ERR_ARG));
+            CHECK(!client.Blocked());
+        }
+        // 不是来自连接时不挂起
+        CHECK(IsNil(Call({"blpop", "bl", "0"})));
+        Call({"rpush", "bl", "v"});
+        CHECK(IsStrs(Parse(Block(client, {"blpop", "bl-none", "bl", "0"})), {"bl", "v"}));
+        CHECK(!client.Blocked() && IsInt(Call({"del", "bl"}), 0));
+
+        // a、b 先后等 bl，c 同时等 bl-other 和 bl
+        auto a = FakeClient();
+        auto b = FakeClient();
+        auto c = FakeClient();
+        g_wakes.clear();
+        CHECK(Block(a, {"blpop", "bl", "0"}).empty());
+        CHECK(Block(b, {"brpop", "bl", "0"}).empty());
+        CHECK(Block(c, {"blpop", "bl-other", "bl", "1e9"}).empty());
+        CHECK(a.Blocked() && b.Blocked() && c.Blocked());
+        // 一次 push 两个元素只唤醒前两个，push 的回复不受影响
+        CHECK(IsInt(Call({"rpush", "bl", "x", "y"}), 2));
+        CHECK(g_wakes.size() == 2 && !a.Blocked() && !b.Blocked() && c.Blocked());
+        if (g_wakes.size() == 2)
+        {
+            CHECK(g_wakes[0].first == &a && IsStrs(g_wakes[0].second, {"bl", "x"}));
+            CHECK(g_wakes[1].first == &b && IsStrs(g_wakes[1].second, {"bl", "y"}));
+        }
+        CHECK(IsInt(Call({"del", "bl"}), 0));
+        // c 已经排到 bl 的队首，也还在等 bl-other
+        CHECK(IsInt(Call({"rpush", "bl-other", "o1", "o2"}), 2));
+        CHECK(!c.Blocked() && IsStrs(Parse(g_unblocked), {"bl-other", "o1"}));
+        CHECK(IsStrs(Call({"lrange", "bl-other", "0", "-1"}), {"o2"}));
+        // BRPOP 从尾部取
+        CHECK(Block(b, {"brpop", "bl", "0"}).empty());
+        Call({"rpush", "bl", "1", "2", "3"});
+        CHECK(!b.Blocked() && IsStrs(Parse(g_unblocked), {"bl", "3"}));
+        CHECK(IsStrs(Call({"lrange", "bl", "0", "-1"}), {"1", "2"}));
+
+        // 只有设置了超时的客户端会超时，回复 nil
+        g_wakes.clear();
+        CHECK(Block(a, {"blpop", "bl-t", "0.05"}).empty());
+        CHECK(Block(b, {"blpop", "bl-t", "0"}).empty());
+        kath::ExpireBlocked(kath::GetMonotonicUsec());
+        CHECK(a.Blocked() && b.Blocked());
+        kath::ExpireBlocked(UINT64_MAX);
+        CHECK(!a.Blocked() && b.Blocked());
+        CHECK(g_wakes.size() == 1 && g_wakes[0].first == &a && IsNil(g_wakes[0].second));
+        Call({"rpush", "bl-t", "late"});
+        CHECK(!b.Blocked() && IsStrs(Parse(g_unblocked), {"bl-t", "late"}));
+        CHECK(IsInt(Call({"del", "bl-t"}), 0));
+    }
+
+    // 以 sub 的身份执行 (P)SUBSCRIBE
+    auto SubscribeAs(kath::pubsub::Subscriber &sub, const std::vector<std::string> &args) -> Value
+    {
+        kath::pubsub::g_current = &sub;
+        auto reply = Call(args);
+        kath::pubsub::g_current = nullptr;
+        return reply;
+    }
+    auto Publish(const std::string &channel, const std::string &payload) -> int64_t
+    {
+        return Call({"publish", channel, payload}).int_;
+    }
+
+    // 回复队列超过硬上限立即断开，超过软上限持续 g_pubsub_soft_seconds 秒也断开
+    auto TestPubSubLimits() -> void
+    {
+        auto &hub = kath::pubsub::g_hub;
+        auto saved_hard = kath::g_pubsub_hard_limit;
+        auto saved_soft = kath::g_pubsub_soft_limit;
+        auto saved_seconds = kath::g_pubsub_soft_seconds;
+        kath::g_pubsub_hard_limit = 1200;
+        kath::g_pubsub_soft_limit = 1200;
+        const std::string payload(300, 'm');
+
+        kath::OutBuf slow_out;
+        kath::OutBuf fast_out;
+        kath::pubsub::Subscriber slow;
+        kath::pubsub::Subscriber fast;
+        slow.out_ = &slow_out;
+        fast.out_ = &fast_out;
+        slow.wake_ = fast.wake_ = [](kath::pubsub::Subscriber *) {};
+        SubscribeAs(slow, {"subscribe", "ps-ch"});
+        SubscribeAs(fast, {"psubscribe", "ps-*"});
+        uint64_t disconnections = hub.Disconnections();
+
+        // 每条消息加上协议开销三百多字节，slow 从不读，第 4 条时超过上限；fast 每次都读完
+        for (int round = 0; round < 4; round++)
+        {
+            CHECK(Publish("ps-ch", payload) == 2);
+            CHECK(Drain(fast_out).size() > payload.size());
+        }
+        CHECK(slow.evicted_ && !fast.evicted_);
+        CHECK(hub.Disconnections() == disconnections + 1);
+        // 超限时已经退订，之后不再收到消息
+        CHECK(slow.Count() == 0 && fast.Count() == 1);
+        size_t slow_size = slow_out.Size();
+        CHECK(Publish("ps-ch", payload) == 1);
+        CHECK(slow_out.Size() == slow_size);
+        auto evicted = hub.TakeEvicted();
+        CHECK(evicted.size() == 1 && evicted[0] == &slow);
+        CHECK(hub.TakeEvicted().empty());
+        Drain(fast_out);
+        Drain(slow_out);
+
+        // 软上限：g_pubsub_soft_seconds 为 0 时第二次超过软上限就断开
+        kath::g_pubsub_soft_limit = 500;
+        kath::g_pubsub_soft_seconds = 0;
+        kath::OutBuf soft_out;
+        kath::pubsub::Subscriber soft;
+        soft.out_ = &soft_out;
+        soft.wake_ = fast.wake_;
+        SubscribeAs(soft, {"subscribe", "pt-soft"});
+        Publish("pt-soft", payload);
+        Publish("pt-soft", payload);
+        CHECK(!soft.evicted_ && soft.soft_since_us_ != 0);
+        // 读到软上限以下之后重新计时
+        Drain(soft_out);
+        Publish("pt-soft", payload);
+        CHECK(!soft.evicted_ && soft.soft_since_us_ == 0);
+        Publish("pt-soft", payload);
+        Publish("pt-soft", payload);
+        CHECK(soft.evicted_ && soft.Count() == 0);
+        // 断开之前连接已经关闭，不会再出现在 TakeEvicted 中
+        hub.Remove(&soft);
+        CHECK(hub.TakeEvicted().empty());
+        CHECK(hub.Disconnections() == disconnections + 2);
+
+        // 软上限持续的时间不够时不断开
+        kath::g_pubsub_soft_seconds = 3600;
+        SubscribeAs(fast, {"subscribe", "pt-soft"});
+        CHECK(Publish("pt-soft", payload) == 1);
+        CHECK(Publish("ps-other", payload) == 1);
+        CHECK(!fast.evicted_ && fast.soft_since_us_ != 0 && fast_out.Size() > kath::g_pubsub_soft_limit);
+        hub.Remove(&fast);
+        CHECK(hub.Channels() == 0 && hub.Patterns() == 0);
+
+        kath::g_pubsub_hard_limit = saved_hard;
+        kath::g_pubsub_soft_limit = saved_soft;
+        kath::g_pubsub_soft_seconds = saved_seconds;
+    }
+
+    // 逐字符回溯的参考实现，只支持测试中用到的记号：字面字符、?、*、[ab]、[^a]、[a-b]
+    auto NaiveMatch(std::string_view pattern, std::string_view channel) -> bool
+    {
+        if (pattern.empty())
+            return channel.empty();
+        if (pattern[0] == '*')
+        {
+            for (size_t skip = 0; skip <= channel.size(); skip++)
+            {
+                if (NaiveMatch(pattern.substr(1), channel.substr(skip)))
+                    return true;
+            }
+            return false;
+        }
+        if (channel.empty())
+            return false;
+        size_t len = 1;
+        bool ok = pattern[0] == '?' || pattern[0] == channel[0];
+        if (pattern[0] == '[')
+        {
+            len = pattern.find(']') + 1;
+            auto set = pattern.substr(1, len - 2);
+            bool negate = set[0] == '^';
+            if (negate)
+                set.remove_prefix(1);
+            bool in = set.size() == 3 && set[1] == '-' ? channel[0] >= set[0] && channel[0] <= set[2]
+                                                       : set.find(channel[0]) != std::string_view::npos;
+            ok = in != negate;
+        }
+        return ok && NaiveMatch(pattern.substr(len), channel.substr(1));
+    }
+
+    // PSUBSCRIBE 的模式匹配：各种记号、与参考实现对拍、病态模式的耗时上限
+    auto TestPubSubPatterns() -> void
+    {
+        kath::OutBuf sub_out;
+        kath::pubsub::Subscriber sub;
+        sub.out_ = &sub_out;
+        sub.wake_ = [](kath::pubsub::Subscriber *) {};
+        auto matches = [&](const std::string &pattern, const std::string &channel)
+        {
+            SubscribeAs(sub, {"psubscribe", pattern});
+            bool hit = Publish(channel, "x") == 1;
+            SubscribeAs(sub, {"punsubscribe", pattern});
+            Drain(sub_out);
+            return hit;
+        };
+        CHECK(matches("h?llo", "hello") && !matches("h?llo", "hllo") && !matches("h?llo", "heello"));
+        CHECK(matches("h*llo", "hllo") && matches("h*llo", "heeeello") && !matches("h*llo", "hellox"));
+        CHECK(matches("h[ae]llo", "hallo") && matches("h[ae]llo", "hello") && !matches("h[ae]llo", "hillo"));
+        CHECK(matches("h[^e]llo", "hallo") && !matches("h[^e]llo", "hello"));
+        CHECK(matches("h[a-c]llo", "hbllo") && matches("h[c-a]llo", "hbllo") && !matches("h[a-c]llo", "hdllo"));
+        CHECK(matches("h\\*llo", "h*llo") && !matches("h\\*llo", "hello"));
+        CHECK(matches("a*b*c", "axxbyyc") && !matches("a*b*c", "acb") && matches("a**", "a"));
+        // 同一个订阅者的两个模式都匹配时收到两条
+        SubscribeAs(sub, {"psubscribe", "n*", "n?"});
+        CHECK(Publish("nx", "x") == 2 && Publish("nxy", "x") == 1);
+        SubscribeAs(sub, {"punsubscribe"});
+        Drain(sub_out);
+
+        // 共享前缀的一组模式放进同一棵 trie，每个 channel 匹配到的模式与参考实现逐个比较
+        const char *toks[] = {"a", "b", "?", "*", "[ab]", "[^a]", "[a-b]"};
+        uint64_t seed = 7;
+        auto next = [&seed](uint64_t n)
+        {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            return (seed >> 33) % n;
+        };
+        std::vector<std::string> patterns;
+        for (int index = 0; index < 300; index++)
+        {
+            std::string pattern;
+            for (uint64_t tok = 1 + next(6); tok > 0; tok--)
+                pattern += toks[next(std::size(toks))];
+            patterns.push_back(pattern);
+        }
+        std::sort(patterns.begin(), patterns.end());
+        patterns.erase(std::unique(patterns.begin(), patterns.end()), patterns.end());
+        kath::pubsub::PatternTrie trie;
+        for (const auto &pattern : patterns)
+            trie.Insert(&pattern);
+        bool same = true;
+        for (int round = 0; round < 500 && same; round++)
+        {
+            std::string channel;
+            for (uint64_t len = 1 + next(8); len > 0; len--)
+                channel += static_cast<char>('a' + next(3));
+            std::vector<std::string> got;
+            trie.Match(channel, [&](const std::string &pattern)
+                       { got.push_back(pattern); });
+            std::sort(got.begin(), got.end());
+            std::vector<std::string> expect;
+            for (const auto &pattern : patterns)
+            {
+                if (NaiveMatch(pattern, channel))
+                    expect.push_back(pattern);
+            }
+            same = got == expect;
+            if (!same)
+                std::printf("  channel %s: %zu matches, expected %zu\n", channel.c_str(), got.size(), expect.size());
+        }
+        CHECK(same);
+
+        // *a*a*...*b 对全是 a 的 channel：逐个位置回溯是指数级的，记忆化之后与长度成正比
+        std::string evil;
+        for (int index = 0; index < 30; index++)
+            evil += "*a";
+        evil += "*b";
+        auto start = std::chrono::steady_clock::now();
+        CHECK(!matches(evil, std::string(40, 'a')));
+        CHECK(matches(evil, std::string(40, 'a') + "b"));
+        kath::pubsub::PatternTrie evil_trie;
+        evil_trie.Insert(&evil);
+        size_t hits = 0;
+        evil_trie.Match(std::string(5000, 'a'), [&](const std::string &)
+                        { hits++; });
+        CHECK(hits == 0);
+        CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+    }
+
+    // XRANGE 回复中条目的 ID
+    auto StreamIds(const Value &val) -> std::vector<std::string>
+    {
+        std::vector<std::string> ids;
+        for (const auto &entry : val.arr_)
+        {
+            ids.push_back(entry.arr_.empty() ? "" : entry.arr_[0].str_);
+        }
+        return ids;
+    }
+
+    // XADD 的 ID 规则、( 开头的不包含端点、XTRIM 的 = 与 ~、变空的 stream 保留最后一个 ID
+    auto TestStream() -> void
+    {
+        auto saved_entries = std::exchange(kath::g_stream_block_entries, 10);
+        using kath::CmdErr;
+
+        // 0-0 和格式错误的 ID 都不创建 key
+        CHECK(IsErr(Call({"xadd", "st", "0-0", "f", "v"}), CmdErr::ERR_ARG));
+        CHECK(IsErr(Call({"xadd", "st", "1-x", "f", "v"}), CmdErr::ERR_ARG));
+        CHECK(IsErr(Call({"xadd", "st", "x-*", "f", "v"}), CmdErr::ERR_ARG));
+        CHECK(IsInt(Call({"xlen", "st"}), 0));
+        CHECK(IsStr(Call({"xadd", "st", "5-1", "f", "v"}), "5-1"));
+        // 显式的 ID 必须大于最后一个，只给 ms 时 seq 为 0
+        CHECK(IsErr(Call({"xadd", "st", "5-1", "f", "v"}), CmdErr::ERR_ARG));
+        CHECK(IsErr(Call({"xadd", "st", "5", "f", "v"}), CmdErr::ERR_ARG));
+        // ms-* 在同一毫秒内递增 seq，更小的 ms 被拒绝
+        CHECK(IsStr(Call({"xadd", "st", "5-*", "f", "v"}), "5-2"));
+        CHECK(IsErr(Call({"xadd", "st", "4-*", "f", "v"}), CmdErr::ERR_ARG));
+        CHECK(IsStr(Call({"xadd", "st", "7-*", "f", "v"}), "7-0"));
+        CHECK(IsStr(Call({"xadd", "st", "8", "f", "v"}), "8-0"));
+        // * 取当前时间，不会小于最后一个 ID
+        auto now = Call({"xadd", "st", "*", "f", "v"});
+        CHECK(now.type_ == kath::SerType::STR && std::stoull(now.str_) > 8);
+        CHECK(IsInt(Call({"xlen", "st"}), 5));
+        // 最后一个 ID 已经是最大值时 * 也无法生成
+        std::string max_id = "18446744073709551615-18446744073709551615";
+        CHECK(IsStr(Call({"xadd", "st-max", max_id, "f", "v"}), max_id));
+        CHECK(IsErr(Call({"xadd", "st-max", "*", "f", "v"}), CmdErr::ERR_ARG));
+
+        // ( 表示不包含端点，只有 ms 的起点从 ms-0 开始、终点到 ms-最大
+        for (const char *id : {"1-1", "1-2", "2-0", "3-5"})
+        {
+            Call({"xadd", "sr", id, "f", "v"});
+        }
+        CHECK(StreamIds(Call({"xrange", "sr", "(1-1", "+"})) == std::vector<std::string>({"1-2", "2-0", "3-5"}));
+        CHECK(StreamIds(Call({"xrange", "sr", "-", "(3-5"})) == std::vector<std::string>({"1-1", "1-2", "2-0"}));
+        CHECK(StreamIds(Call({"xrange", "sr", "(1-1", "(3-5"})) == std::vector<std::string>({"1-2", "2-0"}));
+        CHECK(StreamIds(Call({"xrange", "sr", "(1-2", "(2-0"})).empty());
+        CHECK(StreamIds(Call({"xrange", "sr", "1", "1"})) == std::vector<std::string>({"1-1", "1-2"}));
+        CHECK(StreamIds(Call({"xrange", "sr", "(2", "+"})) == std::vector<std::string>({"3-5"}));
+        CHECK(StreamIds(Call({"xrange", "sr", "(1-1", "+", "count", "1"})) == std::vector<std::string>({"1-2"}));
+        // 不包含的端点越界时无法表示
+        CHECK(IsErr(Call({"xrange", "sr", "(" + max_id, "+"}), CmdErr::ERR_ARG));
+        CHECK(IsErr(Call({"xrange", "sr", "-", "(0-0"}), CmdErr::ERR_ARG));
+
+        // 25 个条目分在 10、10、5 三块中；~ 只整块丢弃，= 和不写时精确裁剪
+        for (int ms = 1; ms <= 25; ms++)
+        {
+            Call({"xadd", "stt", std::to_string(ms) + "-0", "f", "v"});
+        }
+        CHECK(IsInt(Call({"xtrim", "stt", "maxlen", "~", "12"}), 10));
+        CHECK(IsInt(Call({"xlen", "stt"}), 15));
+        CHECK(IsInt(Call({"xtrim", "stt", "maxlen", "=", "12"}), 3));
+        CHECK(StreamIds(Call({"xrange", "stt", "-", "+", "count", "1"})) == std::vector<std::string>({"14-0"}));
+        // 第一块剩下 7 个，整块丢弃后少于 11 个，不裁
+        CHECK(IsInt(Call({"xtrim", "stt", "maxlen", "~", "11"}), 0));
+        CHECK(IsInt(Call({"xtrim", "stt", "minid", "~", "17"}), 0));
+        CHECK(IsInt(Call({"xtrim", "stt", "minid", "17"}), 3));
+        CHECK(StreamIds(Call({"xrange", "stt", "-", "+", "count", "1"})) == std::vector<std::string>({"17-0"}));
+        CHECK(IsInt(Call({"xtrim", "stt", "minid", "~", "21"}), 4));
+        CHECK(IsInt(Call({"xtrim", "stt", "maxlen", "3"}), 2));
+        CHECK(StreamIds(Call({"xrange", "stt", "-", "+"})) == std::vector<std::string>({"23-0", "24-0", "25-0"}));
+
+        // 裁空之后 key 仍在，新的 ID 仍然要大于 25-0
+        CHECK(IsInt(Call({"xtrim", "stt", "maxlen", "0"}), 3));
+        CHECK(IsInt(Call({"xlen", "stt"}), 0));
+        CHECK(StreamIds(Call({"xrange", "stt", "-", "+"})).empty());
+        CHECK(IsNil(Call({"xread", "streams", "stt", "0"})));
+        CHECK(IsErr(Call({"xadd", "stt", "25-0", "f", "v"}), CmdErr::ERR_ARG));
+        CHECK(IsStr(Call({"xadd", "stt", "25-*", "f", "v"}), "25-1"));
+        // XADD 自己裁空也一样
+        CHECK(IsStr(Call({"xadd", "st0", "maxlen", "0", "9-0", "f", "v"}), "9-0"));
+        CHECK(IsInt(Call({"xlen", "st0"}), 0));
+        CHECK(IsErr(Call({"xadd", "st0", "9-0", "f", "v"}), CmdErr::ERR_ARG));
+        CHECK(IsStr(Call({"xadd", "st0", "9-*", "f", "v"}), "9-1"));
+
+        kath::g_stream_block_entries = saved_entries;
+    }
+
+    // 参数在 handler 执行之前记下：SET 会把 value move 走，记录里仍然要有截断后的 value
+    auto TestSlowLog() -> void
+    {
+        auto &log = kath::slowlog::g_slowlog;
+        log.Configure(0, 16);
+        std::string value(200, 'v');
+        value[0] = 'V';
+        CHECK(IsNil(Call({"set", "sl-k", value})));
+        auto got = Call({"slowlog", "get", "1"});
+        CHECK(got.type_ == kath::SerType::ARR && got.arr_.size() == 1);
+        if (got.arr_.size() == 1 && got.arr_[0].arr_.size() == 5)
+        {
+            std::string shown = value.substr(0, kath::slowlog::k_max_arg_len) + "... (" +
+                                std::to_string(value.size() - kath::slowlog::k_max_arg_len) + " more bytes)";
+            CHECK(IsStrs(got.arr_[0].arr_[3], {"set", "sl-k", shown}));
+        }
+        CHECK(IsStr(Call({"get", "sl-k"}), value));
+
+        // 参数太多时最后一个位置换成剩下的个数
+        std::vector<std::string> args{"hdel", "sl-h"};
+        for (int index = 0; index < 40; index++)
+            args.push_back("f" + std::to_string(index));
+        Call(args);
+        got = Call({"slowlog", "get", "1"});
+        CHECK(got.arr_.size() == 1 && got.arr_[0].arr_.size() == 5);
+        if (got.arr_.size() == 1 && got.arr_[0].arr_.size() == 5)
+        {
+            const auto &logged = got.arr_[0].arr_[3].arr_;
+            CHECK(logged.size() == kath::slowlog::k_max_args &&
+                  IsStr(logged.back(), "... (" + std::to_string(args.size() - kath::slowlog::k_max_args + 1) + " more arguments)"));
+        }
+        log.Configure(-1, 128);
+        CHECK(IsInt(Call({"slowlog", "len"}), 0));
+    }
+
+    // TopK 随 g_clock_min 衰减，新的热 key 能挤掉曾经的热 key
+    auto TestHotKeys() -> void
+    {
+        auto saved_clock = kath::lfu::g_clock_min;
+        kath::lfu::TopK top(2);
+        top.Offer("a", 1, 20);
+        top.Offer("c", 2, 10);
+        CHECK(top.Floor() == 10);
+        kath::lfu::g_clock_min += 15;
+        CHECK(top.Floor() == 0);
+        top.Offer("b", 3, 6);
+        top.Offer("d", 4, 7);
+        std::vector<std::string> kept;
+        for (const auto &item : top.Items())
+            kept.push_back(item.key_);
+        std::sort(kept.begin(), kept.end());
+        CHECK(kept == std::vector<std::string>({"b", "d"}));
+
+        // 命令层：先用 32 个 key 占满表，过了很久之后只被访问几百次的 key 也能进表并排在最前面
+        kath::core::g_hot.Clear();
+        for (int index = 0; index < 32; index++)
+        {
+            auto key = "hk-old" + std::to_string(index);
+            Call({"set", key, "v"});
+            for (int round = 0; round < 2000; round++)
+                Call({"get", key});
+        }
+        auto hot = Call({"hotkeys", "1"});
+        CHECK(hot.arr_.size() == 1 && hot.arr_[0].arr_.size() == 2 && hot.arr_[0].arr_[0].str_.rfind("hk-old", 0) == 0 &&
+              hot.arr_[0].arr_[1].int_ > 8);
+        CHECK(kath::core::g_hot.Items().size() == 32 && kath::core::g_hot.Floor() > 8);
+        kath::lfu::g_clock_min += 60;
+        CHECK(kath::core::g_hot.Floor() == 0);
+        Call({"set", "hk-new", "v"});
+        for (int round = 0; round < 300; round++)
+            Call({"get", "hk-new"});
+        hot = Call({"hotkeys", "2"});
+        CHECK(hot.arr_.size() == 2 && hot.arr_[0].arr_.size() == 2 && IsStr(hot.arr_[0].arr_[0], "hk-new"));
+        CHECK(hot.arr_.size() == 2 && IsInt(hot.arr_[1].arr_[1], 0));
+        // 删除的 key 在读取时从表中清掉
+        Call({"del", "hk-new"});
+        hot = Call({"hotkeys"});
+        CHECK(std::none_of(hot.arr_.begin(), hot.arr_.end(), [](const Value &item)
+                           { return IsStr(item.arr_[0], "hk-new"); }));
+        CHECK(IsErr(Call({"hotkeys", "-1"}), kath::CmdErr::ERR_ARG));
+        kath::lfu::g_clock_min = saved_clock;
+    }
+
+    // BIGKEYS 跑完之后每种类型报告的最大 key 与整表遍历的结果一致
+    auto TestBigKeys() -> void
+    {
+        Call({"set", "bk-str", std::string(300000, 's')});
+        for (int index = 0; index < 50; index++)
+        {
+            auto member = "m" + std::to_string(index);
+            Call({"zadd", "bk-zset", std::to_string(index), member});
+            Call({"hset", "bk-hash", member, "v"});
+            Call({"sadd", "bk-set", member});
+            Call({"rpush", "bk-list", member});
+            Call({"xadd", "bk-stream", "*", "f", member});
+        }
+        // 整表遍历得到每种类型的最大值，下标与 BIGKEYS STATUS 中的顺序相同
+        struct Max
+        {
+            size_t size_[6]{};
+        } expect;
+        kath::core::m_map.Scan([](kath::HNodePtr node, void *extra)
+                               {
+                                   auto &max = static_cast<Max *>(extra)->size_;
+                                   auto ent = kath::dyn_cast<kath::core::Entry, kath::HNode>(node);
+                                   using kath::core::EntryType;
+                                   switch (ent->type_)
+                                   {
+                                   case EntryType::T_ZSET:
+                                       max[1] = std::max(max[1], ent->As<kath::ZSet>()->Size());
+                                       break;
+                                   case EntryType::T_HASH:
+                                       max[2] = std::max(max[2], ent->As<kath::HashObj>()->Size());
+                                       break;
+                                   case EntryType::T_SET:
+                                       max[3] = std::max(max[3], ent->As<kath::SetObj>()->Size());
+                                       break;
+                                   case EntryType::T_LIST:
+                                       max[4] = std::max(max[4], ent->As<kath::QuickList>()->Size());
+                                       break;
+                                   case EntryType::T_STREAM:
+                                       max[5] = std::max(max[5], ent->As<kath::Stream>()->Length());
+                                       break;
+                                   default:
+                                       if (ent->val_ != nullptr)
+                                           max[0] = std::max(max[0], ent->val_->size());
+                                   } },
+                               &expect);
+
+        CHECK(IsNil(Call({"bigkeys", "start", "3"})));
+        auto &big = kath::core::g_bigkeys;
+        for (size_t turn = 0; big.Running() && turn < 1000000; turn++)
+            big.Step();
+        auto status = Call({"bigkeys", "status"});
+        CHECK(status.type_ == kath::SerType::ARR && status.arr_.size() == 8);
+        if (status.arr_.size() != 8)
+            return;
+        CHECK(status.arr_[0].str_ == "done");
+        CHECK(IsInt(status.arr_[1], static_cast<int64_t>(kath::core::m_map.Size())));
+        for (size_t type = 0; type < 6; type++)
+        {
+            const auto &items = status.arr_[2 + type].arr_;
+            CHECK(!items.empty() && items.size() <= 3);
+            if (items.empty())
+                continue;
+            CHECK(IsInt(items[0].arr_[1], static_cast<int64_t>(expect.size_[type])));
+            for (size_t index = 1; index < items.size(); index++)
+                CHECK(items[index].arr_[1].int_ <= items[index - 1].arr_[1].int_);
+        }
+        CHECK(IsStr(status.arr_[2].arr_[0].arr_[0], "bk-str"));
+        CHECK(IsErr(Call({"bigkeys", "start", "0"}), kath::CmdErr::ERR_ARG));
+    }
+
+    auto Run(const char *name, void (*test)()) -> void
+    {
+        if (g_filter != nullptr && std::strstr(name, g_filter) == nullptr)
+            return;
+        g_test = name;
+        size_t failed = g_failed;
+        test();
+        std::printf("%-24s %s\n", name, g_failed == failed ? "ok" : "FAILED");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1)
+    {
+        g_filter = argv[1];
+    }
+    Run("cluster", TestCluster);
+    Run("hash flood", TestHashFlood);
+    Run("zset rank", TestZSetRank);
+    Run("zstore merge", TestZStoreMerge);
+    Run("zstore", TestZStore);
+    Run("hash", TestHash);
+    Run("set encoding", TestSetEncoding);
+    Run("bitops", TestBitOps);
+    Run("hyperloglog", TestHyperLogLog);
+    Run("lzf", TestLzf);
+    Run("quicklist", TestQuickList);
+    Run("heap", TestHeap);
+    Run("blocking pop", TestBlockingPop);
+    Run("pubsub limits", TestPubSubLimits);
+    Run("pubsub patterns", TestPubSubPatterns);
+    Run("stream", TestStream);
+    Run("slowlog", TestSlowLog);
+    Run("bigkeys", TestBigKeys);
+    Run("hotkeys", TestHotKeys);
+    std::printf("checks=%zu failed=%zu\n", g_checks, g_failed);
+    return g_failed ? 1 : 0;
+}
@@ -0,0 +1,73 @@
+// string_hash 的基准：吞吐量 + 前缀相同的 key 在 HMap 中的链长分布
+// 与原来逐字节 *257 的实现对比
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "hashtable.h"
+
+static auto OldHash(std::string_view str) -> uint64_t
+{
+    uint64_t hash = 0;
+    for (auto &c : str)
+    {
+        hash = hash * 257 + static_cast<uint8_t>(c);
+    }
+    return hash;
+}
+
+template <typename F>
+static auto BenchThroughput(const char *name, F &&hash_fn, size_t key_len) -> void
+{
+    const size_t rounds = std::max<size_t>(1, (64u << 20) / key_len);
+    std::string key(key_len, 'k');
+    uint64_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t index = 0; index < rounds; index++)
+    {
+        key[index % key_len] = static_cast<char>(index);
+        sink += hash_fn(key);
+    }
+    auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%-8s len=%-6zu %8.2f ns/hash %8.2f GB/s (sink %llx)\n", name, key_len, ns / rounds,
+                static_cast<double>(rounds * key_len) / ns, static_cast<unsigned long long>(sink & 0xf));
+}
+
+template <typename F>
+static auto BenchChains(const char *name, F &&hash_fn, size_t nkeys) -> void
+{
+    kath::HMap hmap;
+    for (size_t index = 0; index < nkeys; index++)
+    {
+        hmap.Insert(std::make_shared<kath::HNode>(hash_fn("user:" + std::to_string(index))));
+    }
+    std::vector<size_t> hist(17);
+    hmap.ChainHistogram(hist);
+    size_t buckets = 0;
+    size_t max_len = 0;
+    for (size_t len = 0; len < hist.size(); len++)
+    {
+        buckets += hist[len];
+        if (hist[len])
+            max_len = len;
+    }
+    std::printf("%-8s keys=%zu buckets=%zu max_chain=%zu%s\n", name, nkeys, buckets, max_len,
+                max_len + 1 == hist.size() ? "+" : "");
+    for (size_t len = 0; len < hist.size(); len++)
+    {
+        if (hist[len])
+            std::printf("    len %2zu%s: %zu\n", len, len + 1 == hist.size() ? "+" : " ", hist[len]);
+    }
+}
+
+int main()
+{
+    for (size_t len : {8, 16, 32, 64, 256, 1024})
+    {
+        BenchThroughput("old", OldHash, len);
+        BenchThroughput("new", [](std::string_view str) { return kath::string_hash(str); }, len);
+    }
+    BenchChains("old", OldHash, 1 << 20);
+    BenchChains("new", [](std::string_view str) { return kath::string_hash(str); }, 1 << 20);
+}
@@ -0,0 +1,809 @@
+// 核心数据结构的微基准：HMap / ZSet / zunionstore 合并 / AVLOperate::Offset / Heap / HashObj / set 求交 / 位图 / HyperLogLog / QuickList / 发布订阅 / Stream / Bytes
+// 随机数全部用固定种子，每项取多轮中最快的一轮，报告 ns/op 与 allocs/op。
+// allocs/op 通过替换全局 operator new 计数，只统计计时区间内的分配。
+//     MicroBench [filter]   只运行名字中包含 filter 的项
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bytes.h"
+#include "heap.h"
+#include "zset.h"
+#include "zstore.h"
+#include "hashobj.h"
+#include "setobj.h"
+#include "bitops.h"
+#include "hyperloglog.h"
+#include "quicklist.h"
+#include "pubsub.h"
+#include "stream.h"
+
+static size_t g_allocs = 0;
+
+void *operator new(size_t size)
+{
+    g_allocs++;
+    if (void *ptr = std::malloc(size != 0 ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+// GCC 把 delete 内联进标准库的 deallocate 之后，认为 free 的指针来自 operator new，
+// 报 -Wmismatched-new-delete；这里的 operator new 本来就是 malloc，配对是对的
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace
+{
+    const uint64_t k_seed = 20240601;
+    const int k_rounds = 3;
+
+    const char *g_filter = nullptr;
+    volatile uint64_t g_sink = 0;
+
+    // setup 不计时，body(state) 计时并返回执行的操作数
+    template <typename Setup, typename Body>
+    auto Run(const std::string &name, Setup &&setup, Body &&body) -> void
+    {
+        if (g_filter != nullptr && name.find(g_filter) == std::string::npos)
+            return;
+        double best_ns = 1e30;
+        double allocs = 0;
+        size_t ops = 0;
+        for (int round = 0; round < k_rounds; round++)
+        {
+            auto state = setup();
+            size_t alloc_start = g_allocs;
+            auto start = std::chrono::steady_clock::now();
+            ops = body(state);
+            auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            size_t alloc_count = g_allocs - alloc_start;
+            if (ops != 0 && ns / ops < best_ns)
+            {
+                best_ns = ns / ops;
+                allocs = static_cast<double>(alloc_count) / ops;
+            }
+        }
+        std::printf("  %-34s %10.1f ns/op %8.2f allocs/op  (%zu ops)\n", name.c_str(), best_ns, allocs, ops);
+    }
+
+    auto Keys(size_t n, const char *prefix) -> std::vector<std::string>
+    {
+        std::vector<std::string> keys(n);
+        for (size_t index = 0; index < n; index++)
+        {
+            keys[index] = prefix + std::to_string(index);
+        }
+        std::shuffle(keys.begin(), keys.end(), std::mt19937_64(k_seed));
+        return keys;
+    }
+
+    auto Perm(size_t n, uint64_t seed) -> std::vector<size_t>
+    {
+        std::vector<size_t> perm(n);
+        std::iota(perm.begin(), perm.end(), 0);
+        std::shuffle(perm.begin(), perm.end(), std::mt19937_64(seed));
+        return perm;
+    }
+
+    // ---------------- HMap ----------------
+    struct Key : public kath::HNode
+    {
+        std::string name_;
+        explicit Key(const std::string &name) : HNode(kath::string_hash(name)), name_(name) {}
+        [[nodiscard]] auto KeyView() const -> std::string_view override { return name_; }
+    };
+
+    kath::NodeCmp key_cmp = [](kath::HNodePtr node, kath::HNodePtr key) -> bool
+    {
+        return node->hcode_ == key->hcode_ &&
+               kath::dyn_cast<Key, kath::HNode>(node)->name_ == kath::dyn_cast<Key, kath::HNode>(key)->name_;
+    };
+
+    auto Fill(const std::vector<std::string> &keys, size_t n) -> std::unique_ptr<kath::HMap>
+    {
+        auto hmap = std::make_unique<kath::HMap>();
+        for (size_t index = 0; index < n; index++)
+        {
+            hmap->Insert(std::make_shared<Key>(keys[index]));
+        }
+        // 让上一次扩容迁移完，测的是稳定状态
+        while (hmap->Migrating() != 0)
+        {
+            hmap->ResizingHlep();
+        }
+        return hmap;
+    }
+
+    // 查找与服务端一样每次构造一个临时节点
+    auto BenchHMap(size_t n) -> void
+    {
+        auto keys = Keys(n, "key:");
+        auto misses = Keys(n, "miss:");
+        auto tag = " n=" + std::to_string(n);
+
+        Run("hmap insert" + tag, []
+            { return std::make_unique<kath::HMap>(); },
+            [&](auto &hmap)
+            {
+                for (const auto &key : keys)
+                {
+                    hmap->Insert(std::make_shared<Key>(key));
+                }
+                return keys.size();
+            });
+        Run("hmap lookup hit" + tag, [&]
+            { return Fill(keys, n); },
+            [&](auto &hmap)
+            {
+                for (size_t index = 0; index < n; index++)
+                {
+                    g_sink += hmap->Lookup(std::make_shared<Key>(keys[n - 1 - index]), key_cmp) != nullptr;
+                }
+                return n;
+            });
+        Run("hmap lookup miss" + tag, [&]
+            { return Fill(keys, n); },
+            [&](auto &hmap)
+            {
+                for (const auto &key : misses)
+                {
+                    g_sink += hmap->Lookup(std::make_shared<Key>(key), key_cmp) != nullptr;
+                }
+                return n;
+            });
+        Run("hmap delete" + tag, [&]
+            { return Fill(keys, n); },
+            [&](auto &hmap)
+            {
+                for (const auto &key : keys)
+                {
+                    g_sink += hmap->Pop(std::make_shared<Key>(key), key_cmp) != nullptr;
+                }
+                return n;
+            });
+    }
+
+    // 表满到触发扩容的前一个节点，再插入一个，然后测迁移期间（直到迁移完成）的查找
+    auto BenchHMapResizing(size_t buckets) -> void
+    {
+        size_t n = buckets * kath::Load_FACTOR_MAX;
+        auto keys = Keys(n, "key:");
+        auto tag = " n=" + std::to_string(n);
+        Run("hmap lookup resizing" + tag, [&]
+            {
+                auto hmap = std::make_unique<kath::HMap>();
+                for (const auto &key : keys)
+                {
+                    hmap->Insert(std::make_shared<Key>(key));
+                }
+                return hmap; },
+            [&](auto &hmap)
+            {
+                size_t ops = 0;
+                while (hmap->Migrating() != 0)
+                {
+                    g_sink += hmap->Lookup(std::make_shared<Key>(keys[ops % n]), key_cmp) != nullptr;
+                    ops++;
+                }
+                return ops;
+            });
+    }
+
+    // ---------------- ZSet / AVL ----------------
+    auto Scores(size_t n, uint64_t seed) -> std::vector<double>
+    {
+        std::mt19937_64 gen(seed);
+        std::uniform_real_distribution<double> dis(0, 1e6);
+        std::vector<double> scores(n);
+        for (auto &score : scores)
+        {
+            score = dis(gen);
+        }
+        return scores;
+    }
+
+    auto FillZSet(const std::vector<std::string> &members, const std::vector<double> &scores)
+        -> std::unique_ptr<kath::ZSet>
+    {
+        auto zset = std::make_unique<kath::ZSet>();
+        for (size_t index = 0; index < members.size(); index++)
+        {
+            zset->Add(members[index], scores[index]);
+        }
+        return zset;
+    }
+
+    auto BenchZSet(size_t n) -> void
+    {
+        auto members = Keys(n, "member:");
+        auto scores = Scores(n, k_seed);
+        auto new_scores = Scores(n, k_seed + 1);
+        auto order = Perm(n, k_seed + 2);
+        auto tag = " n=" + std::to_string(n);
+
+        Run("zset add" + tag, []
+            { return std::make_unique<kath::ZSet>(); },
+            [&](auto &zset)
+            {
+                for (size_t index = 0; index < n; index++)
+                {
+                    zset->Add(members[index], scores[index]);
+                }
+                return n;
+            });
+        Run("zset update" + tag, [&]
+            { return FillZSet(members, scores); },
+            [&](auto &zset)
+            {
+                for (size_t index : order)
+                {
+                    zset->Add(members[index], new_scores[index]);
+                }
+                return n;
+            });
+        Run("zset find" + tag, [&]
+            { return FillZSet(members, scores); },
+            [&](auto &zset)
+            {
+                for (size_t index : order)
+                {
+                    g_sink += zset->Find(members[index]).has_value();
+                }
+                return n;
+            });
+        Run("zset pop" + tag, [&]
+            { return FillZSet(members, scores); },
+            [&](auto &zset)
+            {
+                for (size_t index : order)
+                {
+                    g_sink += zset->Pop(members[index]);
+                }
+                return n;
+            });
+        Run("zset rank" + tag, [&]
+            { return FillZSet(members, scores); },
+            [&](auto &zset)
+            {
+                for (size_t index : order)
+                {
+                    g_sink += zset->Rank(members[index]).value_or(0);
+                }
+                return n;
+            });
+        // zcount：区间两端各一次查找
+        Run("zset count" + tag, [&]
+            { return FillZSet(members, scores); },
+            [&](auto &zset)
+            {
+                for (size_t index = 0; index < n; index++)
+                {
+                    double lo = std::min(scores[index], new_scores[index]);
+                    double hi = std::max(scores[index], new_scores[index]);
+                    g_sink += zset->CountBelow(hi, true) - zset->CountBelow(lo, false);
+                }
+                return n;
+            });
+        // 与 zquery 相同：按 (score, name) 定位后取 10 个
+        Run("zset query limit 10" + tag, [&]
+            { return FillZSet(members, scores); },
+            [&](auto &zset)
+            {
+                for (size_t index : order)
+                {
+                    for (auto &node : zset->Query("", scores[index], 0, 10))
+                    {
+                        g_sink += node.name_.size();
+                    }
+                }
+                return n;
+            });
+        // zunionstore 的单线程路径：与自身求并集（聚合 + 排序），再一次性建树
+        Run("zset union build" + tag, [&]
+            { return FillZSet(members, scores); },
+            [&](auto &zset)
+            {
+                std::vector<kath::zstore::Input> inputs(2);
+                kath::zstore::Flatten(*zset, inputs[0]);
+                kath::zstore::Flatten(*zset, inputs[1]);
+                auto res = kath::zstore::Merge(inputs, {1, 1}, kath::zstore::Aggregate::SUM, false, 1);
+                kath::ZSet dest;
+                dest.BuildSorted(std::move(res));
+                g_sink += dest.Size();
+                return n;
+            });
+    }
+
+    // 从最小的节点出发，向后偏移 rank 个
+    auto BenchOffset(size_t n) -> void
+    {
+        auto members = Keys(n, "member:");
+        auto scores = Scores(n, k_seed);
+        auto zset = FillZSet(members, scores);
+        kath::avl::AVLNodePtr first = zset->Query("", -1, 0);
+        const size_t ops = 100000;
+        for (size_t rank : {size_t{1}, size_t{10}, size_t{100}, size_t{10000}, n / 2, n - 1})
+        {
+            Run("avl offset rank=" + std::to_string(rank) + " n=" + std::to_string(n), []
+                { return 0; },
+                [&](auto &)
+                {
+                    for (size_t index = 0; index < ops; index++)
+                    {
+                        g_sink += kath::avl::AVLOperate::Offset(first, static_cast<int64_t>(rank)) != nullptr;
+                    }
+                    return ops;
+                });
+        }
+    }
+
+    // ---------------- Heap ----------------
+    struct HeapState
+    {
+        kath::Heap heap_{};
+        std::vector<size_t> refs_{};
+    };
+
+    auto BenchHeap(size_t n) -> void
+    {
+        std::mt19937_64 gen(k_seed);
+        std::vector<uint64_t> vals(n);
+        std::vector<uint64_t> new_vals(n);
+        for (size_t index = 0; index < n; index++)
+        {
+            vals[index] = gen();
+            new_vals[index] = gen();
+        }
+        auto order = Perm(n, k_seed + 3);
+        auto tag = " n=" + std::to_string(n);
+        auto empty = [&]
+        {
+            auto state = std::make_unique<HeapState>();
+            state->refs_.resize(n);
+            return state;
+        };
+        auto filled = [&]
+        {
+            auto state = empty();
+            for (size_t index = 0; index < n; index++)
+            {
+                state->heap_.Push(vals[index], &state->refs_[index]);
+            }
+            return state;
+        };
+
+        Run("heap push" + tag, empty, [&](auto &state)
+            {
+                for (size_t index = 0; index < n; index++)
+                {
+                    state->heap_.Push(vals[index], &state->refs_[index]);
+                }
+                return n; });
+        Run("heap set" + tag, filled, [&](auto &state)
+            {
+                for (size_t index : order)
+                {
+                    state->heap_.Set(state->refs_[index], new_vals[index]);
+                }
+                return n; });
+        Run("heap del" + tag, filled, [&](auto &state)
+            {
+                for (size_t index : order)
+                {
+                    state->heap_.Del(state->refs_[index]);
+                }
+                return n; });
+    }
+
+    // ---------------- Bytes ----------------
+    // 与回复的编码方式相同：u32 长度 + 内容
+    // fields 不超过 128 时为 compact 编码（线性扫描），否则为 HMap
+    auto BenchHashObj(size_t fields) -> void
+    {
+        std::vector<std::string> names(fields);
+        for (size_t index = 0; index < fields; index++)
+        {
+            names[index] = "field:" + std::to_string(index);
+        }
+        auto order = Perm(fields, k_seed + 4);
+        auto tag = " fields=" + std::to_string(fields);
+        auto filled = [&]
+        {
+            auto hash = std::make_unique<kath::HashObj>();
+            for (const auto &name : names)
+            {
+                hash->Set(name, "value");
+            }
+            return hash;
+        };
+
+        Run("hash set" + tag, [&]
+            { return std::make_unique<kath::HashObj>(); },
+            [&](auto &hash)
+            {
+                for (size_t index : order)
+                {
+                    hash->Set(names[index], "value");
+                }
+                return fields;
+            });
+        Run("hash get" + tag, filled, [&](auto &hash)
+            {
+                for (size_t index : order)
+                {
+                    g_sink += hash->Get(names[index])->size();
+                }
+                return fields; });
+    }
+
+    // 两个各约 n 个成员的 set 求交，成员取自 [0, 2n)，交集约 n/2
+    // intset 分别用 simd.h 检测到的实现和标量实现，table 为逐个成员查表
+    auto BenchSetInter(size_t n) -> void
+    {
+        std::mt19937_64 gen(k_seed);
+        std::vector<std::string> lhs;
+        std::vector<std::string> rhs;
+        for (size_t index = 0; index < 2 * n; index++)
+        {
+            if (gen() % 2)
+                lhs.push_back(std::to_string(index));
+            if (gen() % 2)
+                rhs.push_back(std::to_string(index));
+        }
+        auto tag = " n=" + std::to_string(n);
+        auto make = [&](const std::string &prefix)
+        {
+            auto sets = std::make_unique<std::pair<kath::SetObj, kath::SetObj>>();
+            for (auto [members, set] : {std::pair{&lhs, &sets->first}, std::pair{&rhs, &sets->second}})
+            {
+                std::vector<std::string> prefixed;
+                for (const auto &member : *members)
+                {
+                    prefixed.push_back(prefix + member);
+                }
+                set->Add(prefixed);
+            }
+            return sets;
+        };
+        auto inter = [&](auto &sets)
+        {
+            kath::setops::Inter({&sets->first, &sets->second}, [](const std::string &member)
+                                { g_sink += member.size(); });
+            return n;
+        };
+
+        Run("set inter intset simd" + tag, [&]
+            { return make(""); },
+            inter);
+        kath::simd::g_level = kath::simd::Level::SCALAR;
+        Run("set inter intset scalar" + tag, [&]
+            { return make(""); },
+            inter);
+        kath::simd::g_level = kath::simd::k_detected;
+        Run("set inter table" + tag, [&]
+            { return make("m"); },
+            inter);
+    }
+
+    // 位图计数与按位运算，每个实现级别各跑一遍，一个 op 为 1KB
+    auto BenchBitmap(size_t len) -> void
+    {
+        std::mt19937_64 gen(k_seed);
+        std::vector<uint8_t> lhs(len);
+        std::vector<uint8_t> rhs(len);
+        for (size_t index = 0; index < len; index++)
+        {
+            lhs[index] = static_cast<uint8_t>(gen());
+            rhs[index] = static_cast<uint8_t>(gen());
+        }
+        auto tag = " len=" + std::to_string(len);
+        for (auto level : {kath::simd::Level::SCALAR, kath::simd::Level::AVX2, kath::simd::Level::AVX512})
+        {
+            if (level > kath::simd::k_detected)
+                break;
+            kath::simd::g_level = level;
+            std::string name = kath::simd::LevelName(level);
+            Run("bitcount " + name + tag, [&]
+                { return 0; },
+                [&](auto &)
+                {
+                    g_sink += kath::bitops::Popcount(lhs.data(), len);
+                    return len / 1024;
+                });
+            Run("bitop xor " + name + tag, [&]
+                { return lhs; },
+                [&](auto &dst)
+                {
+                    kath::bitops::Apply(kath::bitops::Op::XOR, dst.data(), rhs.data(), len);
+                    return len / 1024;
+                });
+        }
+        kath::simd::g_level = kath::simd::k_detected;
+    }
+
+    // count / merge 一次 op 为一个 HLL 的全部 2^14 个寄存器（已展开成每个 1 字节）
+    auto BenchHll(size_t n) -> void
+    {
+        kath::HyperLogLog lhs;
+        kath::HyperLogLog rhs;
+        for (size_t index = 0; index < n; index++)
+        {
+            lhs.Add("l" + std::to_string(index));
+            rhs.Add("r" + std::to_string(index));
+        }
+        kath::hll::Registers lregs{};
+        kath::hll::Registers rregs{};
+        lhs.MaxInto(lregs);
+        rhs.MaxInto(rregs);
+        Run("hll add n=" + std::to_string(n), []
+            { return kath::HyperLogLog(); },
+            [&](auto &hll)
+            {
+                for (size_t index = 0; index < n; index++)
+                {
+                    hll.Add("l" + std::to_string(index));
+                }
+                return n;
+            });
+        const size_t reps = 1000;
+        for (auto level : {kath::simd::Level::SCALAR, kath::simd::Level::AVX2, kath::simd::Level::AVX512})
+        {
+            if (level > kath::simd::k_detected)
+                break;
+            kath::simd::g_level = level;
+            std::string name = kath::simd::LevelName(level);
+            Run("hll count " + name, [&]
+                { return 0; },
+                [&](auto &)
+                {
+                    for (size_t rep = 0; rep < reps; rep++)
+                    {
+                        g_sink += kath::hll::Estimate(kath::hll::GetStats(lregs.data(), lregs.size()));
+                    }
+                    return reps;
+                });
+            Run("hll merge " + name, [&]
+                { return lregs; },
+                [&](auto &regs)
+                {
+                    for (size_t rep = 0; rep < reps; rep++)
+                    {
+                        kath::hll::Max(regs.data(), rregs.data(), regs.size());
+                    }
+                    return reps;
+                });
+        }
+        kath::simd::g_level = kath::simd::k_detected;
+    }
+
+    auto BenchQuickList(size_t n, size_t depth) -> void
+    {
+        kath::g_list_compress_depth = depth;
+        auto elems = Keys(n, "item:");
+        auto tag = " n=" + std::to_string(n) + " depth=" + std::to_string(depth);
+        auto fill = [&]
+        {
+            auto list = std::make_unique<kath::QuickList>();
+            for (const auto &elem : elems)
+            {
+                list->Push(false, elem);
+            }
+            return list;
+        };
+        Run("quicklist rpush" + tag, []
+            { return std::make_unique<kath::QuickList>(); },
+            [&](auto &list)
+            {
+                for (const auto &elem : elems)
+                {
+                    list->Push(false, elem);
+                }
+                return n;
+            });
+        Run("quicklist lrange all" + tag, fill, [&](auto &list)
+            {
+                list->Range(0, n - 1, [](std::string_view elem)
+                            { g_sink += elem.size(); });
+                return n;
+            });
+        Run("quicklist lpop" + tag, fill, [&](auto &list)
+            {
+                for (size_t index = 0; index < n; index++)
+                {
+                    g_sink += list->Pop(true)->size();
+                }
+                return n;
+            });
+        kath::g_list_compress_depth = 0;
+    }
+
+    // publish 按每个订阅者计，消息只序列化一次；pattern match 按每个 channel 名计
+    auto BenchPubSub(size_t subs, size_t patterns) -> void
+    {
+        struct Fanout
+        {
+            std::vector<std::unique_ptr<kath::OutBuf>> outs_{};
+            std::vector<std::unique_ptr<kath::pubsub::Subscriber>> subs_{};
+            kath::pubsub::Hub hub_{};
+        };
+        const size_t msgs = 100;
+        auto frame = std::make_shared<const std::string>(64, 'm');
+        Run("pubsub publish subs=" + std::to_string(subs), [&]
+            {
+                auto state = std::make_unique<Fanout>();
+                for (size_t index = 0; index < subs; index++)
+                {
+                    auto &out = state->outs_.emplace_back(std::make_unique<kath::OutBuf>());
+                    auto &sub = state->subs_.emplace_back(std::make_unique<kath::pubsub::Subscriber>());
+                    sub->out_ = out.get();
+                    sub->wake_ = [](kath::pubsub::Subscriber *) {};
+                    state->hub_.Subscribe(sub.get(), "chan");
+                }
+                return state;
+            },
+            [&](auto &state)
+            {
+                for (size_t index = 0; index < msgs; index++)
+                {
+                    g_sink += state->hub_.Publish("chan", [&](kath::Proto, const std::string *)
+                                                  { return frame; });
+                }
+                return msgs * subs;
+            });
+
+        auto names = Keys(patterns, "news.");
+        auto channels = Keys(100000, "news.");
+        Run("pubsub pattern match patterns=" + std::to_string(patterns), [&]
+            {
+                auto state = std::make_unique<std::pair<kath::pubsub::PatternTrie, std::vector<std::string>>>();
+                for (const auto &name : names)
+                {
+                    state->second.push_back(name + (name.size() % 2 == 0 ? "*" : "?"));
+                }
+                for (const auto &pattern : state->second)
+                {
+                    state->first.Insert(&pattern);
+                }
+                return state;
+            },
+            [&](auto &state)
+            {
+                for (const auto &channel : channels)
+                {
+                    state->first.Match(channel, [](const std::string &pattern)
+                                       { g_sink += pattern.size(); });
+                }
+                return channels.size();
+            });
+    }
+
+    // xrange 按条目计；xtrim ~ 只丢弃整块，每次删掉一半
+    auto BenchStream(size_t n) -> void
+    {
+        auto values = Keys(n, "value:");
+        auto tag = " n=" + std::to_string(n);
+        auto fill = [&]
+        {
+            auto stream = std::make_unique<kath::Stream>();
+            for (size_t index = 0; index < n; index++)
+            {
+                stream->Add({1000 + index / 10, index % 10}, {"field", values[index]});
+            }
+            return stream;
+        };
+        Run("stream xadd" + tag, []
+            { return std::make_unique<kath::Stream>(); },
+            [&](auto &stream)
+            {
+                for (size_t index = 0; index < n; index++)
+                {
+                    stream->Add({1000 + index / 10, index % 10}, {"field", values[index]});
+                }
+                return n;
+            });
+        Run("stream xrange all" + tag, fill, [&](auto &stream)
+            {
+                return stream->Range(kath::stream::k_min_id, kath::stream::k_max_id, 0,
+                                     [](const kath::stream::Id &id, const std::vector<std::string_view> &pairs)
+                                     { g_sink += id.seq_ + pairs.size(); });
+            });
+        Run("stream xtrim maxlen ~" + tag, fill, [&](auto &stream)
+            {
+                size_t ops = 0;
+                for (size_t len = n / 2; len > 0; len /= 2, ops++)
+                {
+                    g_sink += stream->TrimLen(len, true);
+                }
+                return ops;
+            });
+    }
+
+    auto BenchBytes(size_t n, size_t len) -> void
+    {
+        std::string str(len, 'v');
+        auto tag = " len=" + std::to_string(len);
+        Run("bytes append" + tag, []
+            { return kath::Bytes(); },
+            [&](auto &bytes)
+            {
+                for (size_t index = 0; index < n; index++)
+                {
+                    bytes.AppendNum(static_cast<uint32_t>(str.size()), 4);
+                    bytes.AppendStr(str);
+                }
+                return n;
+            });
+        Run("bytes parse" + tag, [&]
+            {
+                kath::Bytes bytes;
+                for (size_t index = 0; index < n; index++)
+                {
+                    bytes.AppendNum(static_cast<uint32_t>(str.size()), 4);
+                    bytes.AppendStr(str);
+                }
+                return bytes; },
+            [&](auto &bytes)
+            {
+                for (size_t index = 0; index < n; index++)
+                {
+                    auto arg_len = bytes.template GetNum<uint32_t>(4);
+                    g_sink += bytes.GetStrView(arg_len).size();
+                }
+                return n;
+            });
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1)
+    {
+        g_filter = argv[1];
+    }
+    for (size_t n : {1000, 100000})
+    {
+        BenchHMap(n);
+    }
+    BenchHMapResizing(1 << 16);
+    for (size_t n : {1000, 100000})
+    {
+        BenchZSet(n);
+    }
+    BenchOffset(100000);
+    for (size_t n : {1000, 100000})
+    {
+        BenchHeap(n);
+    }
+    for (size_t fields : {16, 1000})
+    {
+        BenchHashObj(fields);
+    }
+    for (size_t n : {1000, 100000})
+    {
+        BenchSetInter(n);
+    }
+    BenchBitmap(64 << 20);
+    BenchHll(100000);
+    for (size_t depth : {0, 1})
+    {
+        BenchQuickList(100000, depth);
+    }
+    BenchPubSub(10000, 10000);
+    BenchStream(100000);
+    BenchBytes(100000, 16);
+    BenchBytes(100000, 1024);
+}
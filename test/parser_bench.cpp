@@ -0,0 +1,134 @@
+// 请求解析的基准：可续传的 frame::Parser / resp::Parser 与原来一次性解析整帧的 ParseReq 对比
+// 模拟 pipeline，一块缓冲区中连续放着很多请求，逐条解析并复用同一个 Cmd
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "frame.h"
+#include "resp.h"
+
+using kath::Cmd;
+
+// 原来的实现：调用方先读 4 字节长度，整帧到齐后再解析正文
+static auto ParseReq(const std::byte *data, size_t len, Cmd &cmd) -> bool
+{
+    if (len < 4)
+        return false;
+    uint32_t cmd_num = 0;
+    std::memcpy(&cmd_num, data, 4);
+    size_t pos = 4;
+    if (cmd_num > (len - pos) / 4)
+        return false;
+
+    cmd.resize(cmd_num);
+    for (auto &arg : cmd)
+    {
+        if (len - pos < 4)
+            return false;
+        uint32_t arg_len = 0;
+        std::memcpy(&arg_len, data + pos, 4);
+        pos += 4;
+        if (len - pos < arg_len)
+            return false;
+        arg.assign(reinterpret_cast<const char *>(data + pos), arg_len);
+        pos += arg_len;
+    }
+    return pos == len;
+}
+
+static auto AppendU32(std::string &out, uint32_t val) -> void
+{
+    out.append(reinterpret_cast<const char *>(&val), 4);
+}
+
+static auto EncodeNative(const Cmd &cmd) -> std::string
+{
+    std::string body;
+    AppendU32(body, static_cast<uint32_t>(cmd.size()));
+    for (const auto &arg : cmd)
+    {
+        AppendU32(body, static_cast<uint32_t>(arg.size()));
+        body += arg;
+    }
+    std::string out;
+    AppendU32(out, static_cast<uint32_t>(body.size()));
+    return out + body;
+}
+
+static auto EncodeResp(const Cmd &cmd) -> std::string
+{
+    std::string out = "*" + std::to_string(cmd.size()) + "\r\n";
+    for (const auto &arg : cmd)
+    {
+        out += "$" + std::to_string(arg.size()) + "\r\n" + arg + "\r\n";
+    }
+    return out;
+}
+
+template <typename F>
+static auto Run(const char *name, const std::string &stream, size_t nreq, F &&parse_one) -> void
+{
+    const auto *data = reinterpret_cast<const std::byte *>(stream.data());
+    Cmd cmd;
+    size_t total = 0;
+    double best = 1e30;
+    // 取 5 轮中最快的一轮
+    for (int round = 0; round < 5; round++)
+    {
+        size_t pos = 0;
+        size_t count = 0;
+        auto start = std::chrono::steady_clock::now();
+        while (pos < stream.size())
+        {
+            size_t used = parse_one(data + pos, stream.size() - pos, cmd);
+            if (used == 0)
+            {
+                std::printf("%s: parse failed at %zu\n", name, pos);
+                return;
+            }
+            pos += used;
+            count++;
+            total += cmd.size();
+        }
+        auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        best = std::min(best, ns / count);
+    }
+    std::printf("  %-16s %7.2f ns/req  (%zu reqs, sink %zu)\n", name, best, nreq, total & 0xf);
+}
+
+static auto Bench(const char *label, const Cmd &cmd, size_t nreq) -> void
+{
+    std::string native;
+    std::string resp;
+    for (size_t index = 0; index < nreq; index++)
+    {
+        native += EncodeNative(cmd);
+        resp += EncodeResp(cmd);
+    }
+    std::printf("%s\n", label);
+    Run("ParseReq(old)", native, nreq, [](const std::byte *data, size_t, Cmd &out) -> size_t
+        {
+            uint32_t body = 0;
+            std::memcpy(&body, data, 4);
+            return ParseReq(data + 4, body, out) ? 4 + body : 0; });
+    kath::frame::Parser frame_parser;
+    Run("frame::Parser", native, nreq, [&](const std::byte *data, size_t len, Cmd &out) -> size_t
+        {
+            size_t consumed = 0;
+            return frame_parser.Parse(data, len, out, consumed) == 1 ? consumed : 0; });
+    kath::resp::Parser resp_parser;
+    Run("resp::Parser", resp, nreq, [&](const std::byte *data, size_t len, Cmd &out) -> size_t
+        {
+            size_t consumed = 0;
+            return resp_parser.Parse(data, len, out, consumed) == 1 ? consumed : 0; });
+}
+
+int main()
+{
+    Bench("get key:000001", {"get", "key:000001"}, 1000000);
+    Bench("set key:000001 <100B>", {"set", "key:000001", std::string(100, 'v')}, 1000000);
+    Bench("set key:000001 <4KB>", {"set", "key:000001", std::string(4096, 'v')}, 100000);
+    Bench("zadd with 3 args", {"zadd", "zset:1", "3.14", "member:123456"}, 1000000);
+}
@@ -0,0 +1,236 @@
+// 请求解析器的随机测试（原生帧与 RESP）
+// 随机生成命令流，部分流会被随机改坏，然后分别整块解析和按随机大小分段喂给解析器，
+// 两种方式得到的命令和最终结果必须一致；没被改坏的流必须原样解析出所有命令。
+// 用法: ParserFuzz [rounds] [seed]
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "frame.h"
+#include "resp.h"
+
+using kath::Cmd;
+
+struct Outcome
+{
+    std::vector<Cmd> cmds_{};
+    int last_{0}; // 最后一次 Parse 的返回值
+    size_t consumed_{0};
+
+    auto operator==(const Outcome &rhs) const -> bool
+    {
+        return cmds_ == rhs.cmds_ && last_ == rhs.last_ && consumed_ == rhs.consumed_;
+    }
+};
+
+static std::mt19937_64 rng;
+
+static auto Rand(size_t n) -> size_t { return n ? rng() % n : 0; }
+
+static auto RandomCmd() -> Cmd
+{
+    Cmd cmd(1 + Rand(4));
+    for (auto &arg : cmd)
+    {
+        // 偶尔生成超过帧长上限的参数
+        size_t len = Rand(10) == 0 ? Rand(8192) : Rand(64);
+        arg.resize(len);
+        for (auto &c : arg)
+        {
+            c = static_cast<char>(Rand(256));
+        }
+    }
+    return cmd;
+}
+
+static auto AppendU32(std::string &out, uint32_t val) -> void
+{
+    out.append(reinterpret_cast<const char *>(&val), 4);
+}
+
+static auto EncodeNative(const Cmd &cmd) -> std::string
+{
+    std::string body;
+    AppendU32(body, static_cast<uint32_t>(cmd.size()));
+    for (const auto &arg : cmd)
+    {
+        AppendU32(body, static_cast<uint32_t>(arg.size()));
+        body += arg;
+    }
+    std::string out;
+    AppendU32(out, static_cast<uint32_t>(body.size()));
+    return out + body;
+}
+
+static auto EncodeResp(const Cmd &cmd) -> std::string
+{
+    std::string out = "*" + std::to_string(cmd.size()) + "\r\n";
+    for (const auto &arg : cmd)
+    {
+        out += "$" + std::to_string(arg.size()) + "\r\n" + arg + "\r\n";
+    }
+    return out;
+}
+
+static auto Mutate(std::string &data) -> void
+{
+    if (data.empty())
+        return;
+    switch (Rand(4))
+    {
+    case 0: // 改几个字节
+        for (size_t count = 1 + Rand(3); count; count--)
+        {
+            data[Rand(data.size())] = static_cast<char>(Rand(256));
+        }
+        break;
+    case 1: // 截断
+        data.resize(Rand(data.size()));
+        break;
+    case 2: // 在帧头写一个巨大的长度
+    {
+        uint32_t huge = 0xffffff00u | static_cast<uint32_t>(Rand(256));
+        std::memcpy(data.data(), &huge, std::min<size_t>(4, data.size()));
+        break;
+    }
+    default: // 插入随机字节
+        data.insert(Rand(data.size()), std::string(1 + Rand(8), static_cast<char>(Rand(256))));
+        break;
+    }
+}
+
+// 整块解析
+template <typename P>
+static auto ParseAll(const std::string &data) -> Outcome
+{
+    P parser;
+    Outcome res;
+    const auto *base = reinterpret_cast<const std::byte *>(data.data());
+    for (;;)
+    {
+        Cmd cmd;
+        size_t consumed = 0;
+        res.last_ = parser.Parse(base + res.consumed_, data.size() - res.consumed_, cmd, consumed);
+        if (res.last_ != 1)
+            return res;
+        res.cmds_.push_back(cmd);
+        res.consumed_ += consumed;
+    }
+}
+
+// 按随机大小分段到达；缓冲区会随之重新分配，解析器只能依赖相对偏移
+template <typename P>
+static auto ParseChunked(const std::string &data, bool &ok) -> Outcome
+{
+    P parser;
+    Outcome res;
+    std::vector<std::byte> buf;
+    size_t fed = 0;
+    Cmd cmd; // 与 Conn 一样复用
+    while (fed < data.size())
+    {
+        size_t step = 1 + Rand(std::min<size_t>(data.size() - fed, Rand(2) ? 16 : 4096));
+        buf.insert(buf.end(), reinterpret_cast<const std::byte *>(data.data() + fed),
+                   reinterpret_cast<const std::byte *>(data.data() + fed + step));
+        fed += step;
+        buf.shrink_to_fit();
+        for (;;)
+        {
+            size_t consumed = 0;
+            size_t off = res.consumed_;
+            res.last_ = parser.Parse(buf.data() + off, fed - off, cmd, consumed);
+            if (res.last_ == 0)
+            {
+                // 不会要求在已有数据之外再预留超过帧长上限的空间
+                ok &= parser.Need() <= (fed - off) + kath::frame::g_max_frame + 64;
+                break;
+            }
+            if (res.last_ < 0)
+                return res;
+            res.cmds_.push_back(cmd);
+            res.consumed_ += consumed;
+        }
+    }
+    return res;
+}
+
+template <typename P, typename E>
+static auto Round(E &&encode, size_t &errors, size_t &mutated) -> bool
+{
+    std::vector<Cmd> cmds(1 + Rand(4));
+    std::string data;
+    for (auto &cmd : cmds)
+    {
+        cmd = RandomCmd();
+        data += encode(cmd);
+    }
+    bool mutate = Rand(3) == 0;
+    if (mutate)
+    {
+        Mutate(data);
+        mutated++;
+    }
+
+    bool ok = true;
+    Outcome whole = ParseAll<P>(data);
+    Outcome chunked = ParseChunked<P>(data, ok);
+    ok &= whole == chunked;
+    errors += whole.last_ < 0;
+    if (!mutate)
+    {
+        // 没有参数超过上限时必须完整解析，否则必须在超限处报错
+        bool too_big = false;
+        size_t expect = 0;
+        for (const auto &cmd : cmds)
+        {
+            // 原生协议限制整帧，RESP 限制单个参数
+            constexpr bool native = std::is_same_v<P, kath::frame::Parser>;
+            bool big = native && encode(cmd).size() - 4 > kath::frame::g_max_frame;
+            for (const auto &arg : cmd)
+            {
+                big |= arg.size() > kath::frame::g_max_frame;
+            }
+            if (big)
+            {
+                too_big = true;
+                break;
+            }
+            expect++;
+        }
+        ok &= too_big ? whole.last_ < 0 : (whole.last_ == 0 && whole.consumed_ == data.size());
+        ok &= whole.cmds_.size() == expect && std::equal(whole.cmds_.begin(), whole.cmds_.end(), cmds.begin());
+    }
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t rounds = argc > 1 ? std::strtoull(argv[1], nullptr, 0) : 20000;
+    rng.seed(argc > 2 ? std::strtoull(argv[2], nullptr, 0) : 20240601);
+    // 调小上限，让超限的分支也能被覆盖到
+    kath::frame::g_max_frame = 4096;
+
+    size_t failed = 0;
+    size_t errors[2] = {0, 0};
+    size_t mutated[2] = {0, 0};
+    for (size_t index = 0; index < rounds; index++)
+    {
+        if (!Round<kath::frame::Parser>(EncodeNative, errors[0], mutated[0]))
+        {
+            std::printf("native parser mismatch at round %zu\n", index);
+            failed++;
+        }
+        if (!Round<kath::resp::Parser>(EncodeResp, errors[1], mutated[1]))
+        {
+            std::printf("resp parser mismatch at round %zu\n", index);
+            failed++;
+        }
+    }
+    std::printf("rounds=%zu native: mutated=%zu rejected=%zu  resp: mutated=%zu rejected=%zu  failed=%zu\n",
+                rounds, mutated[0], errors[0], mutated[1], errors[1], failed);
+    return failed ? 1 : 0;
+}